@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <random/rand32.h>
+#include "cloud_batch.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(cloud_batch, CONFIG_ASSET_TRACKER_LOG_LEVEL);
+
+#define CBOR_MAJOR_UINT 0
+#define CBOR_MAJOR_TEXT 3
+#define CBOR_MAJOR_ARRAY 4
+#define CBOR_MAJOR_MAP 5
+#define CBOR_INFO_UINT8 24
+
+#define BOOT_KEY_STR "boot"
+#define UPTIME_KEY_STR "uptime"
+#define DATA_KEY_STR "data"
+
+/* Longest header, in JSON: two 20 digit numbers and the keys */
+#define HEADER_MAX_LEN 72
+
+/* Encoded messages of a channel, oldest first */
+struct channel_ring {
+	struct cloud_data msgs[CONFIG_CLOUD_BATCH_CHANNEL_DEPTH];
+	u8_t head;
+	u8_t count;
+	/* Number of the oldest messages that are in the batch being sent */
+	u8_t sending;
+};
+
+static struct channel_ring rings[CLOUD_CHANNEL__TOTAL];
+static size_t pending_len;
+static size_t pending_count;
+
+/* Set when sending failed, until a batch is sent again. Meanwhile only the
+ * age limit, urgent messages and explicit flushes send a batch.
+ */
+static bool send_failed;
+
+/* Set while a batch is sent, which is done without holding the lock */
+static bool sending;
+
+/* Random ID of this boot. The uptimes of batches with the same ID are
+ * from the same boot and can be compared.
+ */
+static u32_t boot_id;
+
+static struct k_work_q *batch_work_q;
+static struct k_delayed_work flush_work;
+static cloud_batch_send_t batch_send;
+
+static K_MUTEX_DEFINE(batch_lock);
+
+static void ring_drop_oldest(struct channel_ring *ring)
+{
+	struct cloud_data *msg = &ring->msgs[ring->head];
+
+	pending_len -= msg->len;
+	pending_count--;
+	k_free(msg->buf);
+	msg->buf = NULL;
+
+	if (ring->sending > 0) {
+		ring->sending--;
+	}
+
+	ring->head = (ring->head + 1) % CONFIG_CLOUD_BATCH_CHANNEL_DEPTH;
+	ring->count--;
+}
+
+/* Write the head of a CBOR data item, and return its length */
+static size_t cbor_head_write(u8_t *buf, u8_t major, u64_t value)
+{
+	size_t len;
+
+	if (value < CBOR_INFO_UINT8) {
+		buf[0] = (major << 5) | value;
+		return 1;
+	}
+
+	len = (value <= UINT8_MAX) ? 1 : (value <= UINT16_MAX) ? 2 :
+	      (value <= UINT32_MAX) ? 4 : 8;
+
+	/* The additional information is 24 to 27 for 1 to 8 bytes */
+	buf[0] = (major << 5) | (CBOR_INFO_UINT8 + find_lsb_set(len) - 1);
+
+	for (size_t i = 0; i < len; i++) {
+		buf[1 + i] = value >> (8 * (len - 1 - i));
+	}
+
+	return 1 + len;
+}
+
+static size_t cbor_text_write(u8_t *buf, const char *str)
+{
+	size_t len = strlen(str);
+	size_t pos = cbor_head_write(buf, CBOR_MAJOR_TEXT, len);
+
+	memcpy(&buf[pos], str, len);
+
+	return pos + len;
+}
+
+/* The batch is a map of the ID of the boot, the uptime the batch is sent
+ * at, and the array of the messages. The cloud gets the time of each
+ * message from the uptime it was encoded at, the uptime of the batch and
+ * the time the batch is received.
+ */
+static size_t header_write(u8_t *buf, s64_t uptime)
+{
+	size_t pos = 0;
+
+	if (!cloud_codec_cbor()) {
+		return snprintf((char *)buf, HEADER_MAX_LEN,
+				"{\"%s\":%u,\"%s\":%lld,\"%s\":[",
+				BOOT_KEY_STR, boot_id, UPTIME_KEY_STR,
+				(long long)uptime, DATA_KEY_STR);
+	}
+
+	pos += cbor_head_write(&buf[pos], CBOR_MAJOR_MAP, 3);
+	pos += cbor_text_write(&buf[pos], BOOT_KEY_STR);
+	pos += cbor_head_write(&buf[pos], CBOR_MAJOR_UINT, boot_id);
+	pos += cbor_text_write(&buf[pos], UPTIME_KEY_STR);
+	pos += cbor_head_write(&buf[pos], CBOR_MAJOR_UINT, (u64_t)uptime);
+	pos += cbor_text_write(&buf[pos], DATA_KEY_STR);
+	pos += cbor_head_write(&buf[pos], CBOR_MAJOR_ARRAY, pending_count);
+
+	return pos;
+}
+
+/* Length of the separators of the messages, and of the end of the batch */
+static size_t trailer_len(void)
+{
+	return cloud_codec_cbor() ? 0 : (pending_count - 1) + 2;
+}
+
+static void batch_write(char *buf, const u8_t *header, size_t header_len)
+{
+	size_t pos = header_len;
+	bool first = true;
+
+	memcpy(buf, header, header_len);
+
+	for (size_t ch = 0; ch < ARRAY_SIZE(rings); ch++) {
+		struct channel_ring *ring = &rings[ch];
+
+		ring->sending = ring->count;
+
+		for (size_t i = 0; i < ring->count; i++) {
+			struct cloud_data *msg = &ring->msgs[
+				(ring->head + i) %
+				CONFIG_CLOUD_BATCH_CHANNEL_DEPTH];
+
+			if (!cloud_codec_cbor() && !first) {
+				buf[pos++] = ',';
+			}
+
+			memcpy(&buf[pos], msg->buf, msg->len);
+			pos += msg->len;
+			first = false;
+		}
+	}
+
+	if (!cloud_codec_cbor()) {
+		buf[pos++] = ']';
+		buf[pos++] = '}';
+	}
+}
+
+/* Must be called with the batch locked. The lock is released while the
+ * batch is sent, so messages can be added and dropped meanwhile. Only the
+ * messages that were sent are removed afterwards.
+ */
+static int batch_flush(void)
+{
+	int err;
+	u8_t header[HEADER_MAX_LEN];
+	size_t header_len;
+	struct cloud_msg batch = {
+		.qos = CLOUD_QOS_AT_MOST_ONCE,
+		.endpoint.type = CLOUD_EP_TOPIC_MSG
+	};
+
+	if (sending) {
+		return -EBUSY;
+	}
+
+	if (pending_count == 0) {
+		return 0;
+	}
+
+	header_len = header_write(header, k_uptime_get());
+	batch.len = header_len + pending_len + trailer_len();
+	batch.buf = k_malloc(batch.len);
+	if (batch.buf == NULL) {
+		LOG_ERR("Could not allocate batch of %d bytes", batch.len);
+		err = -ENOMEM;
+		goto retry;
+	}
+
+	batch_write(batch.buf, header, header_len);
+
+	LOG_DBG("Sending %d messages in %d bytes", pending_count, batch.len);
+
+	sending = true;
+	k_mutex_unlock(&batch_lock);
+
+	err = batch_send(&batch);
+
+	k_mutex_lock(&batch_lock, K_FOREVER);
+	sending = false;
+	k_free(batch.buf);
+
+	if (err) {
+		for (size_t ch = 0; ch < ARRAY_SIZE(rings); ch++) {
+			rings[ch].sending = 0;
+		}
+
+		goto retry;
+	}
+
+	for (size_t ch = 0; ch < ARRAY_SIZE(rings); ch++) {
+		while (rings[ch].sending > 0) {
+			ring_drop_oldest(&rings[ch]);
+		}
+	}
+
+	send_failed = false;
+
+	/* Messages that were added while sending are sent when due */
+	if (pending_count > 0) {
+		k_delayed_work_submit_to_queue(batch_work_q, &flush_work,
+				K_SECONDS(CONFIG_CLOUD_BATCH_MAX_AGE));
+	} else {
+		k_delayed_work_cancel(&flush_work);
+	}
+
+	return 0;
+
+retry:
+	/* The messages are kept and sent again when they are due */
+	send_failed = true;
+	k_delayed_work_submit_to_queue(batch_work_q, &flush_work,
+				       K_SECONDS(CONFIG_CLOUD_BATCH_MAX_AGE));
+
+	return err;
+}
+
+static void flush_work_fn(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	k_mutex_lock(&batch_lock, K_FOREVER);
+	(void)batch_flush();
+	k_mutex_unlock(&batch_lock);
+}
+
+int cloud_batch_init(struct k_work_q *work_q, cloud_batch_send_t send)
+{
+	if ((work_q == NULL) || (send == NULL)) {
+		return -EINVAL;
+	}
+
+	batch_work_q = work_q;
+	batch_send = send;
+	boot_id = sys_rand32_get();
+	k_delayed_work_init(&flush_work, flush_work_fn);
+
+	return 0;
+}
+
+int cloud_batch_add(enum cloud_channel channel, struct cloud_msg *msg,
+		    bool urgent)
+{
+	struct channel_ring *ring;
+
+	if ((channel >= CLOUD_CHANNEL__TOTAL) || (msg == NULL) ||
+	    (msg->buf == NULL) || (batch_send == NULL)) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&batch_lock, K_FOREVER);
+
+	ring = &rings[channel];
+
+	if (ring->count == CONFIG_CLOUD_BATCH_CHANNEL_DEPTH) {
+		LOG_WRN("Batch full, dropping the oldest message of channel %d",
+			channel);
+		ring_drop_oldest(ring);
+	}
+
+	ring->msgs[(ring->head + ring->count) %
+		   CONFIG_CLOUD_BATCH_CHANNEL_DEPTH] = (struct cloud_data){
+		.buf = msg->buf,
+		.len = msg->len,
+	};
+	ring->count++;
+	pending_len += msg->len;
+	pending_count++;
+
+	/* The buffer now belongs to the batch */
+	msg->buf = NULL;
+
+	if (urgent ||
+	    (!send_failed &&
+	     ((pending_len >= CONFIG_CLOUD_BATCH_SIZE) ||
+	      (ring->count == CONFIG_CLOUD_BATCH_CHANNEL_DEPTH)))) {
+		k_delayed_work_submit_to_queue(batch_work_q, &flush_work,
+					       K_NO_WAIT);
+	} else if (pending_count == 1) {
+		k_delayed_work_submit_to_queue(batch_work_q, &flush_work,
+				K_SECONDS(CONFIG_CLOUD_BATCH_MAX_AGE));
+	}
+
+	k_mutex_unlock(&batch_lock);
+
+	return 0;
+}
+
+int cloud_batch_flush(void)
+{
+	int err;
+
+	if (batch_send == NULL) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&batch_lock, K_FOREVER);
+	err = batch_flush();
+	k_mutex_unlock(&batch_lock);
+
+	return err;
+}
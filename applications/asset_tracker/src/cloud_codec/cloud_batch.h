@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef CLOUD_BATCH_H__
+#define CLOUD_BATCH_H__
+
+#include <zephyr.h>
+#include <net/cloud.h>
+#include "cloud_codec.h"
+
+/**
+ * @file cloud_batch.h
+ *
+ * @brief Aggregation of data messages into batches.
+ * @defgroup cloud_batch Batching of data messages.
+ * @{
+ *
+ * Encoded data messages are kept in a ring buffer per channel, and sent
+ * together as one message. The message is a map, or JSON object, with the
+ * random ID of the boot as "boot", the uptime it was sent at in
+ * milliseconds as "uptime", and the array of the messages as "data". A batch is sent when the messages reach
+ * CONFIG_CLOUD_BATCH_SIZE bytes, when a channel has
+ * CONFIG_CLOUD_BATCH_CHANNEL_DEPTH messages, when the oldest message is
+ * CONFIG_CLOUD_BATCH_MAX_AGE seconds old, or when an urgent message is
+ * added. If a batch cannot be sent, its messages are kept, and the oldest
+ * message of a channel is dropped when the channel is full.
+ */
+
+/**
+ * @brief Function that sends a batch.
+ *
+ * @param msg Batch message. The buffer is freed by the caller.
+ *
+ * @return 0 if the batch was sent, otherwise a negative error code.
+ */
+typedef int (*cloud_batch_send_t)(struct cloud_msg *msg);
+
+/**
+ * @brief Initialize batching.
+ *
+ * @param work_q Work queue that sends the batches.
+ * @param send Function that sends a batch.
+ *
+ * @return 0 if the operation was successful, otherwise a (negative) error code.
+ */
+int cloud_batch_init(struct k_work_q *work_q, cloud_batch_send_t send);
+
+/**
+ * @brief Add a data message to the batch.
+ *
+ * The message must be encoded with @ref cloud_encode_data or one of the
+ * functions that use it. The buffer of the message is taken over and freed
+ * when the batch has been sent or the message is dropped.
+ *
+ * @param channel Channel of the message.
+ * @param msg Message.
+ * @param urgent Send the batch now.
+ *
+ * @return 0 if the operation was successful, otherwise a (negative) error code.
+ */
+int cloud_batch_add(enum cloud_channel channel, struct cloud_msg *msg,
+		    bool urgent);
+
+/**
+ * @brief Send the batch now.
+ *
+ * @return 0 if the batch was sent or was empty, -EBUSY if a batch is being
+ *	   sent, otherwise a (negative) error code from the send function.
+ */
+int cloud_batch_flush(void);
+
+/** @} */
+
+#endif /* CLOUD_BATCH_H__ */
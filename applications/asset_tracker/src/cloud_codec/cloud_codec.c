@@ -15,7 +15,12 @@
 
 #include "cJSON.h"
 #include "cJSON_os.h"
+#include <json_tokenizer.h>
+#include <cbor_writer.h>
 #include "cloud_codec.h"
+#if defined(CONFIG_CLOUD_CODEC_SHADOW_DELTA)
+#include "cloud_shadow.h"
+#endif
 
 #include "env_sensors.h"
 
@@ -25,6 +30,7 @@ LOG_MODULE_REGISTER(cloud_codec, CONFIG_ASSET_TRACKER_LOG_LEVEL);
 #define CMD_GROUP_KEY_STR "messageType"
 #define CMD_CHAN_KEY_STR "appId"
 #define CMD_DATA_TYPE_KEY_STR "data"
+#define UPTIME_KEY_STR "uptime"
 
 #define DISABLE_SEND_INTERVAL_VAL 0
 #define MIN_INTERVAL_VAL_SECONDS 5
@@ -282,21 +288,128 @@ static int json_add_str(cJSON *parent, const char *str, const char *item)
 	return json_add_obj(parent, str, json_str);
 }
 
-static cJSON *json_object_decode(cJSON *obj, const char *str)
+/* Tokens of the received document. Decoding is done in the cloud event
+ * handler, one document at a time.
+ */
+static struct json_tok toks[CONFIG_CLOUD_CODEC_JSON_TOKENS];
+
+/* Unescaped strings of the command being decoded. The received document is
+ * not modified, the cloud library may still decode it after the handler.
+ */
+static char cmd_strings[CONFIG_CLOUD_CODEC_CMD_STRINGS_SIZE];
+static size_t cmd_strings_len;
+
+/* Set if data messages are encoded as CBOR */
+static bool output_cbor;
+
+/* Set if the received document is CBOR. The tokens of both formats are
+ * looked up the same way, only numbers and strings are read differently.
+ */
+static bool input_cbor;
+
+static int tok_double(const char *json, int tok, double *value)
 {
-	return obj ? cJSON_GetObjectItem(obj, str) : NULL;
+	if (IS_ENABLED(CONFIG_CLOUD_CODEC_CBOR) && input_cbor) {
+		return json_tok_cbor_double((const u8_t *)json, &toks[tok],
+					    value);
+	}
+
+	return json_tok_double(json, &toks[tok], value);
 }
 
-static bool json_value_string_compare(cJSON *obj, const char *const str)
+static char *json_string_decode(const char *json, int tok)
 {
-	char *json_str = cJSON_GetStringValue(obj);
+	char *str = &cmd_strings[cmd_strings_len];
+	size_t size = sizeof(cmd_strings) - cmd_strings_len;
+	int len;
+
+	if ((tok < 0) || (toks[tok].type != JSON_TOK_STRING)) {
+		return NULL;
+	}
 
-	if ((json_str == NULL) || (str == NULL)) {
+	if (IS_ENABLED(CONFIG_CLOUD_CODEC_CBOR) && input_cbor) {
+		len = json_tok_cbor_str_copy((const u8_t *)json, &toks[tok],
+					     str, size);
+	} else {
+		len = json_tok_str_copy(json, &toks[tok], str, size);
+	}
+	if (len < 0) {
+		LOG_ERR("[%s:%d] Unable to decode string, error %d",
+			__func__, __LINE__, len);
+		return NULL;
+	}
+
+	cmd_strings_len += len + 1;
+
+	return str;
+}
+
+static bool json_value_string_compare(const char *json, int tok,
+				      const char *const str)
+{
+	if ((tok < 0) || (str == NULL)) {
 		return false;
 	}
 
-	return (strcmp(json_str, str) == 0);
+	return json_tok_str_eq(json, &toks[tok], str);
+
+}
+
+void cloud_codec_backend_set(const struct cloud_backend *const backend)
+{
+	output_cbor = IS_ENABLED(CONFIG_CLOUD_CODEC_CBOR) &&
+		      (backend != NULL) && backend->config->cbor;
+
+	LOG_DBG("Data messages are encoded as %s",
+		output_cbor ? "CBOR" : "JSON");
+}
+
+bool cloud_codec_cbor(void)
+{
+	return output_cbor;
+}
+
+#if defined(CONFIG_CLOUD_CODEC_CBOR)
+/* Channel data is text. Values that are numbers are written as numbers,
+ * integral ones as CBOR integers, everything else as a string.
+ */
+static void cbor_data_write(struct cbor_writer *w, const char *str)
+{
+	size_t len = strlen(str);
+	char *end;
+	double value;
+
+	if ((len > 0) && (strspn(str, "0123456789+-.eE") == len)) {
+		value = strtod(str, &end);
+		if (*end == '\0') {
+			cbor_writer_double(w, CMD_DATA_TYPE_KEY_STR, value);
+			return;
+		}
+	}
+
+	cbor_writer_str(w, CMD_DATA_TYPE_KEY_STR, str);
+}
+
+static int cbor_encode_data(const struct cloud_channel_data *channel,
+			    const enum cloud_cmd_group group, u8_t *buf,
+			    size_t size)
+{
+	struct cbor_writer w;
+
+	/* Errors are kept by the writer and returned when finishing */
+	cbor_writer_init(&w, buf, size);
+	cbor_writer_map_start(&w, NULL);
+	cbor_writer_str(&w, CMD_CHAN_KEY_STR, channel_type_str[channel->type]);
+	cbor_data_write(&w, channel->data.buf);
+	cbor_writer_str(&w, CMD_GROUP_KEY_STR, cmd_group_str[group]);
+	if (IS_ENABLED(CONFIG_CLOUD_BATCH)) {
+		cbor_writer_int(&w, UPTIME_KEY_STR, k_uptime_get());
+	}
+	cbor_writer_map_end(&w);
+
+	return cbor_writer_finish(&w);
 }
+#endif /* CONFIG_CLOUD_CODEC_CBOR */
 
 int cloud_encode_data(const struct cloud_channel_data *channel,
 		      const enum cloud_cmd_group group,
@@ -310,6 +423,26 @@ int cloud_encode_data(const struct cloud_channel_data *channel,
 		return -EINVAL;
 	}
 
+#if defined(CONFIG_CLOUD_CODEC_CBOR)
+	if (output_cbor) {
+		/* Compute the length, then encode into a buffer of that size */
+		ret = cbor_encode_data(channel, group, NULL, 0);
+		if (ret < 0) {
+			return ret;
+		}
+
+		output->buf = k_malloc(ret);
+		if (output->buf == NULL) {
+			return -ENOMEM;
+		}
+
+		output->len = cbor_encode_data(channel, group, output->buf,
+					       ret);
+
+		return 0;
+	}
+#endif /* CONFIG_CLOUD_CODEC_CBOR */
+
 	cJSON *root_obj = cJSON_CreateObject();
 	if (root_obj == NULL) {
 		cJSON_Delete(root_obj);
@@ -320,6 +453,17 @@ int cloud_encode_data(const struct cloud_channel_data *channel,
 			   channel_type_str[channel->type]);
 	ret += json_add_str(root_obj, CMD_DATA_TYPE_KEY_STR, channel->data.buf);
 	ret += json_add_str(root_obj, CMD_GROUP_KEY_STR, cmd_group_str[group]);
+
+	/* Messages in a batch are sent later, and keep the uptime they were
+	 * encoded at. There is no wall clock time on the device, the cloud
+	 * relates the uptimes of the messages to each other.
+	 */
+	if (IS_ENABLED(CONFIG_CLOUD_BATCH) &&
+	    (cJSON_AddNumberToObject(root_obj, UPTIME_KEY_STR,
+				     k_uptime_get()) == NULL)) {
+		ret = -ENOMEM;
+	}
+
 	if (ret != 0) {
 		cJSON_Delete(root_obj);
 		return -ENOMEM;
@@ -341,12 +485,24 @@ int cloud_encode_digital_twin_data(const struct cloud_channel_data *channel,
 {
 	int ret = 0;
 	char *buffer;
+	cJSON *data_obj = (cJSON *)channel->data.buf;
+	bool full_state = true;
 
 	__ASSERT_NO_MSG(channel != NULL);
 	__ASSERT_NO_MSG(channel->data.buf != NULL);
 	__ASSERT_NO_MSG(channel->data.len != 0);
 	__ASSERT_NO_MSG(output != NULL);
 
+#if defined(CONFIG_CLOUD_CODEC_SHADOW_DELTA)
+	if (channel->type == CLOUD_CHANNEL_DEVICE_INFO) {
+		ret = cloud_shadow_delta_get((cJSON *)channel->data.buf,
+					     &data_obj, &full_state);
+		if (ret) {
+			return ret;
+		}
+	}
+#endif
+
 	cJSON *root_obj = cJSON_CreateObject();
 	cJSON *state_obj = cJSON_CreateObject();
 	cJSON *reported_obj = cJSON_CreateObject();
@@ -365,11 +521,15 @@ int cloud_encode_digital_twin_data(const struct cloud_channel_data *channel,
 	 * The cloud implementations expect the key to be lowercase "device",
 	 * but that would duplicate the information and needlessly increase
 	 * the size of the digital twin document if the "DEVICE" is not
-	 * deleted at the same time.
+	 * deleted at the same time. A delta of the state is reported after
+	 * the full state, which already deleted it.
 	 */
 	if (channel->type == CLOUD_CHANNEL_DEVICE_INFO) {
-		cJSON *dummy_obj = cJSON_CreateNull();
-		if (dummy_obj == NULL) {
+		cJSON *dummy_obj = full_state ? cJSON_CreateNull() : NULL;
+
+		if (!full_state) {
+			/* Already deleted */
+		} else if (dummy_obj == NULL) {
 			/* Dummy creation failed, but we'll let it do so
 			 * silently as it's not a functionally critical error.
 			 */
@@ -386,8 +546,7 @@ int cloud_encode_digital_twin_data(const struct cloud_channel_data *channel,
 		channel_type = channel_type_str[channel->type];
 	}
 
-	ret += json_add_obj(reported_obj, channel_type,
-			   (cJSON *)channel->data.buf);
+	ret += json_add_obj(reported_obj, channel_type, data_obj);
 	ret += json_add_obj(state_obj, "reported", reported_obj);
 	ret += json_add_obj(root_obj, "state", state_obj);
 
@@ -407,60 +566,68 @@ int cloud_encode_digital_twin_data(const struct cloud_channel_data *channel,
 	return 0;
 }
 
-static int cloud_decode_modem_params(cJSON *const data_obj,
+static int cloud_decode_modem_params(const char *json, int data_obj,
 			  struct cloud_command_modem_params *const params)
 {
-	cJSON *blob;
-	cJSON *checksum;
+	int blob;
+	int checksum;
 
-	if ((data_obj == NULL) || (params == NULL)) {
+	if ((data_obj < 0) || (params == NULL)) {
 		return -EINVAL;
 	}
 
-	if (!cJSON_IsObject(data_obj)) {
+	if (toks[data_obj].type != JSON_TOK_OBJECT) {
 		return -ESRCH;
 	}
 
-	blob = json_object_decode(data_obj, MODEM_PARAM_BLOB_KEY_STR);
-	params->blob = cJSON_GetStringValue(blob);
+	blob = json_tok_get(json, toks, data_obj, MODEM_PARAM_BLOB_KEY_STR);
+	params->blob = json_string_decode(json, blob);
 
-	checksum = json_object_decode(data_obj, MODEM_PARAM_CHECKSUM_KEY_STR);
-	params->checksum = cJSON_GetStringValue(checksum);
+	checksum = json_tok_get(json, toks, data_obj,
+				MODEM_PARAM_CHECKSUM_KEY_STR);
+	params->checksum = json_string_decode(json, checksum);
 
 	return (((params->blob == NULL) || (params->checksum == NULL)) ?
 			-ESRCH : 0);
 }
 
-static int cloud_cmd_parse_type(const struct cmd *const type_cmd,
-				cJSON *type_obj,
+static int cloud_cmd_parse_type(const char *json,
+				const struct cmd *const type_cmd,
+				int type_obj,
 				struct cloud_command *const parsed_cmd)
 {
 	int err;
-	cJSON *decoded_obj = NULL;
+	int decoded_obj = -ENOENT;
+	char *str;
 
 	if ((type_cmd == NULL) || (parsed_cmd == NULL)) {
 		return -EINVAL;
 	}
 
-	if (type_obj != NULL) {
+	/* Strings of an earlier command are no longer used */
+	cmd_strings_len = 0;
+
+	if (type_obj >= 0) {
 		/* Data string type does not require additional decoding */
 		if (type_cmd->type != CLOUD_CMD_DATA_STRING) {
-			decoded_obj = json_object_decode(type_obj,
+			decoded_obj = json_tok_get(json, toks, type_obj,
 					cmd_type_str[type_cmd->type]);
 
-			if (!decoded_obj) {
+			if (decoded_obj < 0) {
 				return -ENOENT; /* Command not found */
 			}
 		}
 
 		switch (type_cmd->type) {
 		case CLOUD_CMD_ENABLE: {
-			if (cJSON_IsNull(decoded_obj)) {
+			if (toks[decoded_obj].type == JSON_TOK_NULL) {
 				parsed_cmd->data.sv.state =
 					CLOUD_CMD_STATE_FALSE;
-			} else if (cJSON_IsBool(decoded_obj)) {
+			} else if ((toks[decoded_obj].type == JSON_TOK_TRUE) ||
+				   (toks[decoded_obj].type == JSON_TOK_FALSE)) {
 				parsed_cmd->data.sv.state =
-					cJSON_IsTrue(decoded_obj) ?
+					(toks[decoded_obj].type ==
+					 JSON_TOK_TRUE) ?
 						CLOUD_CMD_STATE_TRUE :
 						CLOUD_CMD_STATE_FALSE;
 			} else {
@@ -472,14 +639,13 @@ static int cloud_cmd_parse_type(const struct cmd *const type_cmd,
 		case CLOUD_CMD_INTERVAL:
 		case CLOUD_CMD_THRESHOLD_LOW:
 		case CLOUD_CMD_THRESHOLD_HIGH: {
-			if (cJSON_IsNull(decoded_obj)) {
+			if (toks[decoded_obj].type == JSON_TOK_NULL) {
 				parsed_cmd->data.sv.state =
 					CLOUD_CMD_STATE_FALSE;
-			} else if (cJSON_IsNumber(decoded_obj)) {
+			} else if (tok_double(json, decoded_obj,
+					&parsed_cmd->data.sv.value) == 0) {
 				parsed_cmd->data.sv.state =
 					CLOUD_CMD_STATE_UNDEFINED;
-				parsed_cmd->data.sv.value =
-					decoded_obj->valuedouble;
 			} else {
 				return -ESRCH;
 			}
@@ -487,17 +653,18 @@ static int cloud_cmd_parse_type(const struct cmd *const type_cmd,
 			break;
 		}
 		case CLOUD_CMD_COLOR: {
-			if (cJSON_GetStringValue(decoded_obj) == NULL) {
+			str = json_string_decode(json, decoded_obj);
+			if (str == NULL) {
 				return -ESRCH;
 			}
 
-			parsed_cmd->data.sv.value = (double)strtol(
-				cJSON_GetStringValue(decoded_obj), NULL, 16);
+			parsed_cmd->data.sv.value = (double)strtol(str, NULL,
+								   16);
 
 			break;
 		}
 		case CLOUD_CMD_MODEM_PARAM: {
-			err = cloud_decode_modem_params(decoded_obj,
+			err = cloud_decode_modem_params(json, decoded_obj,
 							&parsed_cmd->data.mp);
 
 			if (err) {
@@ -508,7 +675,7 @@ static int cloud_cmd_parse_type(const struct cmd *const type_cmd,
 		}
 		case CLOUD_CMD_DATA_STRING:
 			parsed_cmd->data.data_string =
-				cJSON_GetStringValue(type_obj);
+				json_string_decode(json, type_obj);
 			if (parsed_cmd->data.data_string == NULL) {
 				return -ESRCH;
 			}
@@ -539,25 +706,26 @@ static int cloud_cmd_parse_type(const struct cmd *const type_cmd,
 	return 0;
 }
 
-static int cloud_search_cmd(cJSON *root_obj)
+static int cloud_search_cmd(const char *json, int root_obj)
 {
 	int ret;
 	struct cmd *group	= NULL;
 	struct cmd *chan	= NULL;
 	struct cmd *type	= NULL;
-	cJSON *group_obj;
-	cJSON *channel_obj;
-	cJSON *type_obj;
+	int group_obj;
+	int channel_obj;
+	int type_obj;
 
-	if (root_obj == NULL) {
+	if (root_obj < 0) {
 		return -EINVAL;
 	}
 
 	for (int i = 0; i < ARRAY_SIZE(cmd_groups); ++i) {
-		group_obj = json_object_decode(root_obj, cmd_groups[i]->key);
+		group_obj = json_tok_get(json, toks, root_obj,
+					 cmd_groups[i]->key);
 
-		if ((group_obj != NULL) &&
-			(json_value_string_compare(group_obj,
+		if ((group_obj >= 0) &&
+			(json_value_string_compare(json, group_obj,
 					cmd_group_str[cmd_groups[i]->group]))) {
 			group = cmd_groups[i];
 			break;
@@ -571,12 +739,12 @@ static int cloud_search_cmd(cJSON *root_obj)
 	cmd_parsed.group = group->group;
 
 	for (size_t j = 0; j < group->num_children; ++j) {
-		channel_obj =
-			json_object_decode(root_obj, group->children[j].key);
+		channel_obj = json_tok_get(json, toks, root_obj,
+					   group->children[j].key);
 
-		if ((channel_obj != NULL) &&
+		if ((channel_obj >= 0) &&
 		    (json_value_string_compare(
-			    channel_obj,
+			    json, channel_obj,
 			    channel_type_str[group->children[j].channel]))) {
 			chan = &group->children[j];
 			break;
@@ -592,9 +760,9 @@ static int cloud_search_cmd(cJSON *root_obj)
 	for (size_t k = 0; k < chan->num_children; ++k) {
 
 		type = &chan->children[k];
-		type_obj = json_object_decode(root_obj, type->key);
+		type_obj = json_tok_get(json, toks, root_obj, type->key);
 
-		ret = cloud_cmd_parse_type(type, type_obj, &cmd_parsed);
+		ret = cloud_cmd_parse_type(json, type, type_obj, &cmd_parsed);
 
 		if (ret != 0) {
 			if (ret != -ENOENT) {
@@ -623,22 +791,23 @@ static int cloud_search_cmd(cJSON *root_obj)
 	return 0;
 }
 
-static int cloud_search_config(cJSON * const root_obj)
+static int cloud_search_config(const char *json, int root_obj)
 {
 	struct cmd const *const group = &group_cfg_set;
-	cJSON *state_obj = NULL;
-	cJSON *config_obj = NULL;
+	int state_obj;
+	int config_obj;
 
-	if (root_obj == NULL) {
+	if (root_obj < 0) {
 		return -EINVAL;
 	}
 
 	/* A delta update will have state */
-	state_obj = cJSON_GetObjectItem(root_obj, "state");
-	config_obj = cJSON_DetachItemFromObject(
-		state_obj ? state_obj : root_obj, "config");
+	state_obj = json_tok_get(json, toks, root_obj, "state");
+	config_obj = json_tok_get(json, toks,
+				  (state_obj >= 0) ? state_obj : root_obj,
+				  "config");
 
-	if (config_obj == NULL) {
+	if (config_obj < 0) {
 		return 0;
 	}
 
@@ -648,11 +817,10 @@ static int cloud_search_config(cJSON * const root_obj)
 				.group = CLOUD_CMD_GROUP_CFG_SET
 			};
 
-		cJSON *channel_obj = json_object_decode(
-			config_obj,
+		int channel_obj = json_tok_get(json, toks, config_obj,
 			channel_type_str[group->children[ch].channel]);
 
-		if (channel_obj == NULL) {
+		if (channel_obj < 0) {
 			continue;
 		}
 
@@ -661,7 +829,8 @@ static int cloud_search_config(cJSON * const root_obj)
 
 		/* Search channel's config types */
 		for (size_t type = 0; type < chan->num_children; ++type) {
-			int ret = cloud_cmd_parse_type(&chan->children[type],
+			int ret = cloud_cmd_parse_type(json,
+						   &chan->children[type],
 						   channel_obj,
 						   &found_config_item);
 
@@ -690,34 +859,99 @@ static int cloud_search_config(cJSON * const root_obj)
 		}
 	}
 
-	/* Config was detached, must be deleted */
-	cJSON_Delete(config_obj);
+	return 0;
+}
+
+int cloud_decode_command(char const *input, size_t len)
+{
+	int ret;
+
+	if (input == NULL) {
+		return -EINVAL;
+	}
+
+	/* A CBOR document starts with a map, a JSON document never starts
+	 * with a character in that range.
+	 */
+	input_cbor = IS_ENABLED(CONFIG_CLOUD_CODEC_CBOR) && (len > 0) &&
+		     (((u8_t)input[0] & 0xe0) == 0xa0);
+
+	if (IS_ENABLED(CONFIG_CLOUD_CODEC_CBOR) && input_cbor) {
+		ret = json_tokenize_cbor((const u8_t *)input, len, toks,
+					 ARRAY_SIZE(toks));
+	} else {
+		ret = json_tokenize(input, len, toks, ARRAY_SIZE(toks));
+	}
+	if (ret == -ENOMEM) {
+		LOG_ERR("Input has more than %d tokens, "
+			"increase CLOUD_CODEC_JSON_TOKENS", ARRAY_SIZE(toks));
+		return -ENOENT;
+	} else if (ret < 0) {
+		LOG_ERR("[%s:%d] Unable to parse input, error %d",
+			__func__, __LINE__, ret);
+		return -ENOENT;
+	}
+
+	cloud_search_cmd(input, 0);
+
+	cloud_search_config(input, 0);
 
 	return 0;
 }
 
-int cloud_decode_command(char const *input)
+#if defined(CONFIG_CLOUD_CODEC_SHADOW_DELTA)
+/* Error codes of rejected shadow updates that are worth reporting the full
+ * state again right away for. Other errors, such as 400 Bad Request,
+ * 413 Payload Too Large or 429 Too Many Requests, would be returned again.
+ */
+#define SHADOW_ERR_INTERNAL 500
+#define SHADOW_ERR_UNAVAILABLE 503
+
+int cloud_decode_state_rejection(char const *input, size_t len)
 {
-	cJSON *root_obj = NULL;
+	int ret;
+	int code_obj;
+	double code;
+	struct cloud_command cmd = {
+		.group = CLOUD_CMD_GROUP_GET,
+		.channel = CLOUD_CHANNEL_DEVICE_INFO,
+		.type = CLOUD_CMD_EMPTY,
+	};
 
 	if (input == NULL) {
 		return -EINVAL;
 	}
 
-	root_obj = cJSON_Parse(input);
-	if (root_obj == NULL) {
-		LOG_ERR("[%s:%d] Unable to parse input", __func__, __LINE__);
+	/* Error documents of the shadow service are always JSON */
+	input_cbor = false;
+
+	ret = json_tokenize(input, len, toks, ARRAY_SIZE(toks));
+	if (ret < 0) {
+		LOG_ERR("[%s:%d] Unable to parse input, error %d",
+			__func__, __LINE__, ret);
 		return -ENOENT;
 	}
 
-	cloud_search_cmd(root_obj);
+	code_obj = json_tok_get(input, toks, 0, "code");
+	if ((code_obj < 0) || tok_double(input, code_obj, &code)) {
+		LOG_ERR("Error code of the rejected update not found");
+		return -EBADMSG;
+	}
 
-	cloud_search_config(root_obj);
+	/* The cloud does not have the state of the rejected update, so the
+	 * kept state no longer matches the shadow.
+	 */
+	LOG_WRN("Shadow update rejected, error: %d", (int)code);
+	cloud_shadow_reset();
 
-	cJSON_Delete(root_obj);
+	if ((((int)code == SHADOW_ERR_INTERNAL) ||
+	     ((int)code == SHADOW_ERR_UNAVAILABLE)) && cloud_command_cb) {
+		cloud_command_cb(&cmd);
+	}
 
 	return 0;
 }
+#endif /* CONFIG_CLOUD_CODEC_SHADOW_DELTA */
 
 int cloud_decode_init(cloud_cmd_cb_t cb)
 {
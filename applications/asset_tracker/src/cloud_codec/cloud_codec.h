@@ -191,9 +191,32 @@ struct cloud_command {
 
 typedef void (*cloud_cmd_cb_t)(struct cloud_command *cmd);
 
+/**
+ * @brief Select the format of data messages for a cloud backend.
+ *
+ * Data messages are encoded as CBOR if CONFIG_CLOUD_CODEC_CBOR is set and
+ * the backend accepts CBOR messages, otherwise as JSON. Must be called
+ * after the backend is initialized.
+ *
+ * @param backend The cloud backend that data messages are sent to.
+ */
+void cloud_codec_backend_set(const struct cloud_backend *const backend);
+
+/**
+ * @brief Check if data messages are encoded as CBOR.
+ *
+ * @return true If data messages are encoded as CBOR, false if as JSON.
+ */
+bool cloud_codec_cbor(void);
+
 /**
  * @brief Encode cloud data.
  *
+ * The data is encoded as JSON, or as CBOR, see cloud_codec_backend_set.
+ * Values that are numbers are encoded as CBOR numbers. The output is allocated and must be freed with cloud_release_data.
+ * If CONFIG_CLOUD_BATCH is set, the message also holds the uptime it was
+ * encoded at, in milliseconds since boot, as "uptime".
+ *
  * @param channel The cloud channel type.
  * @param group The channel data's group.
  * @param output Pointer to the cloud data output.
@@ -206,11 +229,30 @@ int cloud_encode_data(const struct cloud_channel_data *channel,
 /**
  * @brief Decode cloud data.
  *
- * @param output Pointer to the cloud data input.
+ * The input is decoded without modifying it and without allocating memory.
+ * If CONFIG_CLOUD_CODEC_CBOR is set, the input may also be CBOR.
+ *
+ * @param input Pointer to the cloud data input.
+ * @param len Length of the input.
+ *
+ * @return 0 if the operation was successful, otherwise a (negative) error code.
+ */
+int cloud_decode_command(char const *input, size_t len);
+
+/**
+ * @brief Decode the error document of a rejected shadow update.
+ *
+ * The reported state is forgotten, so that the full state is reported
+ * next. If the error is temporary on the cloud side, the full state is
+ * requested from the application right away with a device info get
+ * command.
+ *
+ * @param input Pointer to the error document.
+ * @param len Length of the input.
  *
  * @return 0 if the operation was successful, otherwise a (negative) error code.
  */
-int cloud_decode_command(char const *input);
+int cloud_decode_state_rejection(char const *input, size_t len);
 
 /**
  * @brief Init the cloud decoder.
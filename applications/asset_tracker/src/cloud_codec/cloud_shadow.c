@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <errno.h>
+#include "cloud_shadow.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(cloud_shadow, CONFIG_ASSET_TRACKER_LOG_LEVEL);
+
+/* State that was last reported, and the state that is being reported.
+ * Both are NULL after a reset, which is done from the cloud event handler.
+ */
+static cJSON *reported_state;
+static cJSON *pending_state;
+static K_MUTEX_DEFINE(shadow_lock);
+
+static int object_delta_add(const cJSON *prev, const cJSON *cur,
+			    cJSON *delta)
+{
+	const cJSON *item;
+	cJSON *delta_item;
+	int err;
+
+	cJSON_ArrayForEach(item, cur) {
+		const cJSON *prev_item =
+			cJSON_GetObjectItemCaseSensitive(prev, item->string);
+
+		if ((prev_item != NULL) &&
+		    cJSON_Compare(prev_item, item, true)) {
+			continue;
+		}
+
+		if (cJSON_IsObject(prev_item) && cJSON_IsObject(item)) {
+			delta_item = cJSON_CreateObject();
+			if (delta_item == NULL) {
+				return -ENOMEM;
+			}
+
+			err = object_delta_add(prev_item, item, delta_item);
+			if (err) {
+				cJSON_Delete(delta_item);
+				return err;
+			}
+		} else {
+			delta_item = cJSON_Duplicate(item, true);
+			if (delta_item == NULL) {
+				return -ENOMEM;
+			}
+		}
+
+		cJSON_AddItemToObject(delta, item->string, delta_item);
+	}
+
+	/* Keys that are set to null are deleted from the shadow */
+	cJSON_ArrayForEach(item, prev) {
+		if (cJSON_GetObjectItemCaseSensitive(cur, item->string) !=
+		    NULL) {
+			continue;
+		}
+
+		delta_item = cJSON_CreateNull();
+		if (delta_item == NULL) {
+			return -ENOMEM;
+		}
+
+		cJSON_AddItemToObject(delta, item->string, delta_item);
+	}
+
+	return 0;
+}
+
+int cloud_shadow_delta_get(cJSON *state, cJSON **delta, bool *full)
+{
+	int err = 0;
+
+	if ((state == NULL) || (delta == NULL) || (full == NULL)) {
+		cJSON_Delete(state);
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&shadow_lock, K_FOREVER);
+
+	cJSON_Delete(pending_state);
+	pending_state = state;
+
+	*full = (reported_state == NULL) || !cJSON_IsObject(reported_state) ||
+		!cJSON_IsObject(state);
+
+	if (*full) {
+		*delta = cJSON_Duplicate(state, true);
+		if (*delta == NULL) {
+			err = -ENOMEM;
+		}
+		goto exit;
+	}
+
+	*delta = cJSON_CreateObject();
+	if (*delta == NULL) {
+		err = -ENOMEM;
+		goto exit;
+	}
+
+	err = object_delta_add(reported_state, state, *delta);
+	if ((err == 0) && (cJSON_GetArraySize(*delta) == 0)) {
+		err = -ENODATA;
+	}
+
+	if (err) {
+		cJSON_Delete(*delta);
+		*delta = NULL;
+		goto exit;
+	}
+
+	LOG_DBG("Reporting %d changed keys", cJSON_GetArraySize(*delta));
+
+exit:
+	k_mutex_unlock(&shadow_lock);
+
+	return err;
+}
+
+void cloud_shadow_state_sent(void)
+{
+	k_mutex_lock(&shadow_lock, K_FOREVER);
+
+	if (pending_state != NULL) {
+		cJSON_Delete(reported_state);
+		reported_state = pending_state;
+		pending_state = NULL;
+	}
+
+	k_mutex_unlock(&shadow_lock);
+}
+
+void cloud_shadow_reset(void)
+{
+	k_mutex_lock(&shadow_lock, K_FOREVER);
+
+	cJSON_Delete(reported_state);
+	cJSON_Delete(pending_state);
+	reported_state = NULL;
+	pending_state = NULL;
+
+	k_mutex_unlock(&shadow_lock);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef CLOUD_SHADOW_H__
+#define CLOUD_SHADOW_H__
+
+#include <zephyr.h>
+#include <cJSON.h>
+
+/**
+ * @file cloud_shadow.h
+ *
+ * @brief Reporting of the changed device state to the shadow.
+ * @defgroup cloud_shadow Delta reporting of the device state.
+ * @{
+ *
+ * The device state that was last reported to the shadow is kept, and a new
+ * state is reported as the keys that changed since. The kept state is
+ * forgotten on reconnection and when the cloud rejects an update, so that
+ * the full state is reported again.
+ */
+
+/** @brief Get the part of the device state that changed since the state
+ *	   was last reported.
+ *
+ * Keys that are new or have a different value are in the delta. Nested
+ * objects are compared key by key, other values as a whole. Keys that were
+ * removed are null in the delta, which deletes them from the shadow. If no
+ * state was reported since the last reset, the delta is the full state.
+ *
+ * The state is kept as pending until cloud_shadow_state_sent is called.
+ *
+ * @param state Full device state. The function takes ownership of it.
+ * @param delta Set to the state to report, which the caller must free.
+ * @param full Set to true if the delta is the full state.
+ *
+ * @return 0 If the operation was successful.
+ *	   -ENODATA If the state has not changed.
+ *	   Otherwise, a (negative) error code is returned.
+ */
+int cloud_shadow_delta_get(cJSON *state, cJSON **delta, bool *full);
+
+/** @brief Mark the pending state as reported.
+ *
+ * Must be called when the delta from the last call to
+ * cloud_shadow_delta_get has been sent.
+ */
+void cloud_shadow_state_sent(void);
+
+/** @brief Forget the reported state, so that the full state is reported
+ *	   next.
+ */
+void cloud_shadow_reset(void);
+
+/** @} */
+
+#endif /* CLOUD_SHADOW_H__ */
@@ -20,6 +20,12 @@
 #include <modem_info.h>
 #endif /* CONFIG_BSD_LIBRARY */
 #include <net/cloud.h>
+#if defined(CONFIG_CLOUD_STORE)
+#include <net/cloud_store.h>
+#endif
+#if defined(CONFIG_CLOUD_UPLINK_SCHEDULER)
+#include <net/cloud_uplink.h>
+#endif
 #include <net/socket.h>
 #include <nrf_cloud.h>
 
@@ -28,6 +34,12 @@
 #endif
 
 #include "cloud_codec.h"
+#if defined(CONFIG_CLOUD_BATCH)
+#include "cloud_batch.h"
+#endif
+#if defined(CONFIG_CLOUD_CODEC_SHADOW_DELTA)
+#include "cloud_shadow.h"
+#endif
 #include "env_sensors.h"
 #include "motion.h"
 #include "ui.h"
@@ -98,6 +110,15 @@ K_THREAD_STACK_DEFINE(application_stack_area,
 static struct k_work_q application_work_q;
 static struct cloud_backend *cloud_backend;
 
+#if CONFIG_CLOUD_CODEC_CMD_REASSEMBLY_SIZE > 0
+/* Command received in fragments */
+static char cmd_buf[CONFIG_CLOUD_CODEC_CMD_REASSEMBLY_SIZE];
+static struct cloud_msg_reassembly cmd_reassembly = {
+	.buf = cmd_buf,
+	.size = sizeof(cmd_buf)
+};
+#endif
+
 /* Sensor data */
 static struct gps_data gps_data;
 static struct cloud_channel_data gps_cloud_data;
@@ -160,6 +181,8 @@ static void light_sensor_data_send(void);
 static void sensors_init(void);
 static void work_init(void);
 static void sensor_data_send(struct cloud_channel_data *data);
+static int data_msg_send(enum cloud_channel channel, struct cloud_msg *msg,
+			 bool urgent);
 static void device_status_send(struct k_work *work);
 static void cycle_cloud_connection(struct k_work *work);
 static void set_gps_enable(const bool enable);
@@ -312,6 +335,21 @@ void cloud_connect_error_handler(enum cloud_connect_result err)
 	k_thread_suspend(k_current_get());
 }
 
+#if defined(CONFIG_CLOUD_STORE)
+/**@brief Check if a connect error may be fixed by connecting again. */
+static bool cloud_connect_error_transient(enum cloud_connect_result err)
+{
+	switch (err) {
+	case CLOUD_CONNECT_RES_ERR_NETWORK:
+	case CLOUD_CONNECT_RES_ERR_TIMEOUT_NO_DATA:
+	case CLOUD_CONNECT_RES_ERR_MISC:
+		return true;
+	default:
+		return false;
+	}
+}
+#endif /* CONFIG_CLOUD_STORE */
+
 /**@brief Recoverable BSD library error. */
 void bsd_recoverable_error_handler(uint32_t err)
 {
@@ -472,8 +510,7 @@ static void motion_handler(motion_data_t  motion_data)
 	int err;
 
 	if (cloud_encode_motion_data(&motion_data, &msg) == 0) {
-		err = cloud_send(cloud_backend, &msg);
-		cloud_release_data(&msg);
+		err = data_msg_send(CLOUD_CHANNEL_FLIP, &msg, true);
 		if (err) {
 			LOG_ERR("Transmisison of motion data failed: %d", err);
 			cloud_error_handler(err);
@@ -729,8 +766,7 @@ static void env_data_send(void)
 	if (env_sensors_get_temperature(&env_data) == 0) {
 		if (cloud_is_send_allowed(CLOUD_CHANNEL_TEMP, env_data.value) &&
 		    cloud_encode_env_sensors_data(&env_data, &msg) == 0) {
-			err = cloud_send(cloud_backend, &msg);
-			cloud_release_data(&msg);
+			err = data_msg_send(CLOUD_CHANNEL_TEMP, &msg, false);
 			if (err) {
 				goto error;
 			}
@@ -741,8 +777,7 @@ static void env_data_send(void)
 		if (cloud_is_send_allowed(CLOUD_CHANNEL_HUMID,
 					  env_data.value) &&
 		    cloud_encode_env_sensors_data(&env_data, &msg) == 0) {
-			err = cloud_send(cloud_backend, &msg);
-			cloud_release_data(&msg);
+			err = data_msg_send(CLOUD_CHANNEL_HUMID, &msg, false);
 			if (err) {
 				goto error;
 			}
@@ -753,8 +788,8 @@ static void env_data_send(void)
 		if (cloud_is_send_allowed(CLOUD_CHANNEL_AIR_PRESS,
 					  env_data.value) &&
 		    cloud_encode_env_sensors_data(&env_data, &msg) == 0) {
-			err = cloud_send(cloud_backend, &msg);
-			cloud_release_data(&msg);
+			err = data_msg_send(CLOUD_CHANNEL_AIR_PRESS, &msg,
+					    false);
 			if (err) {
 				goto error;
 			}
@@ -765,8 +800,8 @@ static void env_data_send(void)
 		if (cloud_is_send_allowed(CLOUD_CHANNEL_AIR_QUAL,
 					  env_data.value) &&
 		    cloud_encode_env_sensors_data(&env_data, &msg) == 0) {
-			err = cloud_send(cloud_backend, &msg);
-			cloud_release_data(&msg);
+			err = data_msg_send(CLOUD_CHANNEL_AIR_QUAL, &msg,
+					    false);
 			if (err) {
 				goto error;
 			}
@@ -812,8 +847,7 @@ void light_sensor_data_send(void)
 		return;
 	}
 
-	err = cloud_send(cloud_backend, &msg);
-	cloud_release_data(&msg);
+	err = data_msg_send(CLOUD_CHANNEL_LIGHT_SENSOR, &msg, false);
 
 	if (err) {
 		LOG_ERR("Failed to send light sensor data to cloud, error: %d",
@@ -834,6 +868,11 @@ static void sensor_data_send(struct cloud_channel_data *data)
 
 	if (data->type == CLOUD_CHANNEL_DEVICE_INFO) {
 		msg.endpoint.type = CLOUD_EP_TOPIC_STATE;
+
+		/* A lost delta would not be reported again */
+		if (IS_ENABLED(CONFIG_CLOUD_CODEC_SHADOW_DELTA)) {
+			msg.qos = CLOUD_QOS_AT_LEAST_ONCE;
+		}
 	}
 
 	if (!atomic_get(&send_data_enable) || gps_control_is_active()) {
@@ -846,13 +885,31 @@ static void sensor_data_send(struct cloud_channel_data *data)
 		err = cloud_encode_digital_twin_data(data, &msg);
 	}
 
+	if (err == -ENODATA) {
+		LOG_DBG("Device state not changed");
+		return;
+	}
+
 	if (err) {
 		LOG_ERR("Unable to encode cloud data: %d", err);
 	}
 
-	err = cloud_send(cloud_backend, &msg);
+	if (data->type != CLOUD_CHANNEL_DEVICE_INFO) {
+		err = data_msg_send(data->type, &msg,
+				    data->type == CLOUD_CHANNEL_BUTTON);
+	} else {
+		err = cloud_send(cloud_backend, &msg);
+		cloud_release_data(&msg);
 
-	cloud_release_data(&msg);
+#if defined(CONFIG_CLOUD_CODEC_SHADOW_DELTA)
+		/* With QoS 1, a delta is only lost with the connection, and
+		 * the full state is reported after reconnecting.
+		 */
+		if (!err) {
+			cloud_shadow_state_sent();
+		}
+#endif
+	}
 
 	if (err) {
 		LOG_ERR("sensor_data_send failed: %d", err);
@@ -860,9 +917,80 @@ static void sensor_data_send(struct cloud_channel_data *data)
 	}
 }
 
-/**@brief Reboot the device if CONNACK has not arrived. */
+/**@brief Send a message to the cloud, or store it until the cloud can be
+ *	  reached if the store is enabled. With the uplink scheduler, a
+ *	  message that is not urgent is deferred until the link is RRC
+ *	  connected anyway.
+ */
+static int uplink_send(struct cloud_msg *msg, bool urgent)
+{
+#if defined(CONFIG_CLOUD_STORE)
+	ARG_UNUSED(urgent);
+
+	return cloud_store_send(msg);
+#elif defined(CONFIG_CLOUD_UPLINK_SCHEDULER)
+	return cloud_uplink_send(msg, urgent ? CLOUD_UPLINK_DEADLINE_NOW :
+				 K_SECONDS(CONFIG_CLOUD_UPLINK_DEADLINE));
+#else
+	ARG_UNUSED(urgent);
+
+	return cloud_send(cloud_backend, msg);
+#endif
+}
+
+/**@brief Send a data message to the cloud, or add it to the batch if
+ *	  batching is enabled. The message is released in both cases.
+ */
+static int data_msg_send(enum cloud_channel channel, struct cloud_msg *msg,
+			 bool urgent)
+{
+#if defined(CONFIG_CLOUD_BATCH)
+	return cloud_batch_add(channel, msg, urgent);
+#else
+	int err = uplink_send(msg, urgent);
+
+	cloud_release_data(msg);
+
+	return err;
+#endif /* CONFIG_CLOUD_BATCH */
+}
+
+#if defined(CONFIG_CLOUD_BATCH)
+/**@brief Send a batch of data messages to the cloud. A failure is returned
+ *	  to the batching, which keeps the messages and tries again later.
+ *	  A lost connection is handled when polling the cloud socket.
+ */
+static int batch_send(struct cloud_msg *msg)
+{
+	/* A batch is already the result of deferring its messages */
+	int err = uplink_send(msg, true);
+
+	if (err) {
+		LOG_WRN("Failed to send batch, error: %d", err);
+	}
+
+	return err;
+}
+#endif /* CONFIG_CLOUD_BATCH */
+
+/**@brief Reboot the device, or reconnect if messages are stored,
+ *	  if CONNACK has not arrived.
+ */
 static void cloud_reboot_handler(struct k_work *work)
 {
+#if defined(CONFIG_CLOUD_STORE)
+	/* Reconnect instead, so that stored messages are kept and sent
+	 * when the connection is back. Closing the socket wakes up the
+	 * poll loop, which connects again.
+	 */
+	atomic_set(&reconnect_to_cloud, 1);
+	if (cloud_disconnect(cloud_backend) == 0) {
+		LOG_WRN("Cloud connection not ready, reconnecting");
+		return;
+	}
+
+	atomic_set(&reconnect_to_cloud, 0);
+#endif
 	error_handler(ERROR_CLOUD, -ETIMEDOUT);
 }
 
@@ -926,6 +1054,29 @@ void on_pairing_done(void)
 	}
 }
 
+/* Decode a command that is larger than the receive buffer of the backend
+ * when all its fragments have been received.
+ */
+static void cmd_fragment_handle(const struct cloud_msg_fragment *fragment)
+{
+	int err = -EMSGSIZE;
+
+#if CONFIG_CLOUD_CODEC_CMD_REASSEMBLY_SIZE > 0
+	err = cloud_msg_reassemble(&cmd_reassembly, fragment);
+	if (err == 0) {
+		cloud_decode_command(cmd_reassembly.buf, cmd_reassembly.len);
+		return;
+	}
+#endif
+
+	/* Errors are reported once, with the last fragment */
+	if ((err != -EAGAIN) &&
+	    (fragment->offset + fragment->len == fragment->total_len)) {
+		LOG_ERR("Command of %d bytes not decoded, error: %d",
+			fragment->total_len, err);
+	}
+}
+
 void cloud_event_handler(const struct cloud_backend *const backend,
 			 const struct cloud_event *const evt,
 			 void *user_data)
@@ -936,6 +1087,10 @@ void cloud_event_handler(const struct cloud_backend *const backend,
 	case CLOUD_EVT_CONNECTED:
 		LOG_INF("CLOUD_EVT_CONNECTED");
 		k_delayed_work_cancel(&cloud_reboot_work);
+#if defined(CONFIG_CLOUD_CODEC_SHADOW_DELTA)
+		/* The shadow may have changed while disconnected */
+		cloud_shadow_reset();
+#endif
 		ui_led_set_pattern(UI_CLOUD_CONNECTED);
 		break;
 	case CLOUD_EVT_READY:
@@ -948,10 +1103,16 @@ void cloud_event_handler(const struct cloud_backend *const backend,
 #endif
 
 		sensors_start();
+#if defined(CONFIG_CLOUD_STORE)
+		cloud_store_link_update(true);
+#endif
 		break;
 	case CLOUD_EVT_DISCONNECTED:
 		LOG_INF("CLOUD_EVT_DISCONNECTED");
 		ui_led_set_pattern(UI_LTE_DISCONNECTED);
+#if defined(CONFIG_CLOUD_STORE)
+		cloud_store_link_update(false);
+#endif
 		/* Expect an error event (POLLNVAL) on the cloud socket poll */
 		/* Handle reconnect there if desired */
 		break;
@@ -963,7 +1124,18 @@ void cloud_event_handler(const struct cloud_backend *const backend,
 		break;
 	case CLOUD_EVT_DATA_RECEIVED:
 		LOG_INF("CLOUD_EVT_DATA_RECEIVED");
-		cloud_decode_command(evt->data.msg.buf);
+		cloud_decode_command(evt->data.msg.buf, evt->data.msg.len);
+		break;
+	case CLOUD_EVT_DATA_RECEIVED_FRAGMENT:
+		LOG_DBG("CLOUD_EVT_DATA_RECEIVED_FRAGMENT");
+		cmd_fragment_handle(&evt->data.fragment);
+		break;
+	case CLOUD_EVT_STATE_REJECTED:
+		LOG_INF("CLOUD_EVT_STATE_REJECTED");
+#if defined(CONFIG_CLOUD_CODEC_SHADOW_DELTA)
+		cloud_decode_state_rejection(evt->data.msg.buf,
+					     evt->data.msg.len);
+#endif
 		break;
 	case CLOUD_EVT_PAIR_REQUEST:
 		LOG_INF("CLOUD_EVT_PAIR_REQUEST");
@@ -1030,6 +1202,17 @@ static void work_init(void)
 #endif /* CONFIG_MODEM_INFO */
 }
 
+#if defined(CONFIG_CLOUD_UPLINK_SCHEDULER) && defined(CONFIG_LTE_LINK_CONTROL)
+/**@brief Release deferred messages when the link is RRC connected. */
+static void lte_evt_handler(const struct lte_lc_evt *const evt)
+{
+	if (evt->type == LTE_LC_EVT_RRC_UPDATE) {
+		cloud_uplink_rrc_update(
+			evt->rrc_mode == LTE_LC_RRC_MODE_CONNECTED);
+	}
+}
+#endif
+
 /**@brief Configures modem to provide LTE link. Blocks until link is
  * successfully established.
  */
@@ -1215,8 +1398,9 @@ void main(void)
 	}
 	handle_bsdlib_init_ret();
 
-	cloud_backend = cloud_get_binding("NRF_CLOUD");
-	__ASSERT(cloud_backend != NULL, "nRF Cloud backend not found");
+	cloud_backend = cloud_get_binding(CONFIG_ASSET_TRACKER_CLOUD_BACKEND);
+	__ASSERT(cloud_backend != NULL, "%s backend not found",
+		 CONFIG_ASSET_TRACKER_CLOUD_BACKEND);
 
 	ret = cloud_init(cloud_backend, cloud_event_handler);
 	if (ret) {
@@ -1225,6 +1409,9 @@ void main(void)
 		cloud_error_handler(ret);
 	}
 
+	/* Data messages are encoded in a format that the backend accepts */
+	cloud_codec_backend_set(cloud_backend);
+
 #if defined(CONFIG_USE_UI_MODULE)
 	ui_init(ui_evt_handler);
 #endif
@@ -1235,10 +1422,47 @@ void main(void)
 		cloud_error_handler(ret);
 	}
 
+#if defined(CONFIG_CLOUD_STORE)
+	ret = cloud_store_init(cloud_backend, &application_work_q);
+	if (ret) {
+		LOG_ERR("Cloud store could not be initialized, error: %d", ret);
+		cloud_error_handler(ret);
+	}
+#endif
+
+#if defined(CONFIG_CLOUD_UPLINK_SCHEDULER)
+	ret = cloud_uplink_init(cloud_backend, &application_work_q);
+	if (ret) {
+		LOG_ERR("Uplink scheduler could not be initialized, error: %d",
+			ret);
+		cloud_error_handler(ret);
+	}
+#if defined(CONFIG_LTE_LINK_CONTROL)
+	lte_lc_register_handler(lte_evt_handler);
+#endif
+#endif
+
+#if defined(CONFIG_CLOUD_BATCH)
+	ret = cloud_batch_init(&application_work_q, batch_send);
+	if (ret) {
+		LOG_ERR("Cloud batching could not be initialized, error: %d",
+			ret);
+		cloud_error_handler(ret);
+	}
+#endif
+
 	work_init();
 	modem_configure();
 connect:
 	ret = cloud_connect(cloud_backend);
+#if defined(CONFIG_CLOUD_STORE)
+	if (cloud_connect_error_transient(ret)) {
+		LOG_WRN("Failed to connect to cloud, error %d, retry in %d s",
+			ret, CONFIG_CLOUD_RECONNECT_INTERVAL_S);
+		k_sleep(K_SECONDS(CONFIG_CLOUD_RECONNECT_INTERVAL_S));
+		goto connect;
+	}
+#endif
 	if (ret != CLOUD_CONNECT_RES_SUCCESS) {
 		cloud_connect_error_handler(ret);
 	} else {
@@ -1260,8 +1484,7 @@ connect:
 			   cloud_keepalive_time_left(cloud_backend));
 		if (ret < 0) {
 			LOG_ERR("poll() returned an error: %d", ret);
-			error_handler(ERROR_CLOUD, ret);
-			continue;
+			break;
 		}
 
 		if (ret == 0) {
@@ -1281,25 +1504,36 @@ connect:
 			}
 			LOG_ERR("Socket error: POLLNVAL");
 			LOG_ERR("The cloud socket was unexpectedly closed.");
-			error_handler(ERROR_CLOUD, -EIO);
-			return;
+			ret = -EIO;
+			break;
 		}
 
 		if ((fds[0].revents & POLLHUP) == POLLHUP) {
 			LOG_ERR("Socket error: POLLHUP");
 			LOG_ERR("Connection was closed by the cloud.");
-			error_handler(ERROR_CLOUD, -EIO);
-			return;
+			ret = -EIO;
+			break;
 		}
 
 		if ((fds[0].revents & POLLERR) == POLLERR) {
 			LOG_ERR("Socket error: POLLERR");
 			LOG_ERR("Cloud connection was unexpectedly closed.");
-			error_handler(ERROR_CLOUD, -EIO);
-			return;
+			ret = -EIO;
+			break;
 		}
 	}
 
+#if defined(CONFIG_CLOUD_STORE)
+	/* Messages are stored until the connection is back */
+	k_delayed_work_cancel(&cloud_reboot_work);
+	cloud_store_link_update(false);
 	cloud_disconnect(cloud_backend);
+
+	LOG_INF("Reconnecting in %d seconds",
+		CONFIG_CLOUD_RECONNECT_INTERVAL_S);
+	k_sleep(K_SECONDS(CONFIG_CLOUD_RECONNECT_INTERVAL_S));
 	goto connect;
+#else
+	error_handler(ERROR_CLOUD, ret);
+#endif
 }
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file cbor_writer.h
+ *
+ * @defgroup cbor_writer Streaming CBOR writer
+ * @{
+ * @brief Write CBOR documents into a caller-supplied buffer.
+ *
+ * The writer has the same interface as the JSON writer, so that a document
+ * can be encoded as CBOR or JSON by the same code. Maps have text string
+ * keys, so the documents can be converted to JSON and back.
+ */
+
+#ifndef CBOR_WRITER_H__
+#define CBOR_WRITER_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum nesting depth of maps and arrays. */
+#define CBOR_WRITER_MAX_DEPTH 16
+
+/** @brief State of the writer. The members are internal. */
+struct cbor_writer {
+	/** Buffer for the document, or NULL to only compute its length. */
+	u8_t *buf;
+	/** Size of the buffer. */
+	size_t size;
+	/** Length of the document written so far, also past the buffer. */
+	size_t len;
+	/** Offset of the header of the container at each depth. */
+	size_t start[CBOR_WRITER_MAX_DEPTH + 1];
+	/** Number of values in the container at each depth, up to 24. */
+	u8_t count[CBOR_WRITER_MAX_DEPTH + 1];
+	/** Bit n is set if the container at depth n is a map. */
+	u32_t maps;
+	/** Current nesting depth, 0 for the top level. */
+	u8_t depth;
+	/** First error, reported by all later calls. */
+	int err;
+};
+
+/**
+ * @brief Initialize the writer.
+ *
+ * @param[out] w Writer.
+ * @param[in] buf Buffer for the document, or NULL to only compute its
+ *		  length.
+ * @param[in] size Size of the buffer.
+ */
+void cbor_writer_init(struct cbor_writer *w, u8_t *buf, size_t size);
+
+/**
+ * @brief Start a map.
+ *
+ * Every value function takes the key of the value as its @p key argument.
+ * The key must be given for values in a map, and must be NULL for values
+ * in an array and for the top level value.
+ *
+ * Maps and arrays with fewer than 24 values are written with a definite
+ * length, larger ones with an indefinite length.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the map, or NULL.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the key does not match the container, or if the
+ *		   document is already complete.
+ * @retval -E2BIG If CBOR_WRITER_MAX_DEPTH would be exceeded.
+ */
+int cbor_writer_map_start(struct cbor_writer *w, const char *key);
+
+/**
+ * @brief End the current map.
+ *
+ * @param[in,out] w Writer.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the current container is not a map.
+ */
+int cbor_writer_map_end(struct cbor_writer *w);
+
+/**
+ * @brief Start an array.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the array, or NULL.
+ *
+ * @return 0 if successful, otherwise a negative error code as for
+ *	   @ref cbor_writer_map_start.
+ */
+int cbor_writer_arr_start(struct cbor_writer *w, const char *key);
+
+/**
+ * @brief End the current array.
+ *
+ * @param[in,out] w Writer.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the current container is not an array.
+ */
+int cbor_writer_arr_end(struct cbor_writer *w);
+
+/**
+ * @brief Write a NUL-terminated text string.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the value, or NULL.
+ * @param[in] str String.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int cbor_writer_str(struct cbor_writer *w, const char *key, const char *str);
+
+/**
+ * @brief Write a text string of the given length.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the value, or NULL.
+ * @param[in] str String, does not need to be NUL-terminated.
+ * @param[in] len Length of the string.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int cbor_writer_strn(struct cbor_writer *w, const char *key, const char *str,
+		     size_t len);
+
+/**
+ * @brief Write an integer.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the value, or NULL.
+ * @param[in] value Value.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int cbor_writer_int(struct cbor_writer *w, const char *key, s64_t value);
+
+/**
+ * @brief Write a floating point number.
+ *
+ * Integral values are written as integers. Other values are written as
+ * half, single or double precision floats, whichever is the shortest that
+ * holds the exact value. Values that are not finite are written as null,
+ * like the JSON writer does.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the value, or NULL.
+ * @param[in] value Value.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int cbor_writer_double(struct cbor_writer *w, const char *key, double value);
+
+/**
+ * @brief Write a boolean.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the value, or NULL.
+ * @param[in] value Value.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int cbor_writer_bool(struct cbor_writer *w, const char *key, bool value);
+
+/**
+ * @brief Write null.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the value, or NULL.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int cbor_writer_null(struct cbor_writer *w, const char *key);
+
+/**
+ * @brief Complete the document.
+ *
+ * @param[in,out] w Writer.
+ *
+ * @return Length of the document.
+ * @retval -ENOMEM If the document does not fit in the buffer.
+ * @retval -EINVAL If a container is not ended, there is no value, or the
+ *		   writer was used incorrectly before.
+ * @retval -E2BIG If the nesting was too deep.
+ */
+int cbor_writer_finish(struct cbor_writer *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CBOR_WRITER_H__ */
+
+/**@} */
@@ -22,6 +22,8 @@ extern "C" {
 
 #define DFU_TARGET_IMAGE_TYPE_MCUBOOT 1
 #define DFU_TARGET_IMAGE_TYPE_MODEM_DELTA 2
+#define DFU_TARGET_IMAGE_TYPE_DELTA 3
+#define DFU_TARGET_IMAGE_TYPE_COMPRESSED 4
 
 enum dfu_target_evt_id {
 	DFU_TARGET_EVT_TIMEOUT,
@@ -107,6 +109,26 @@ int dfu_target_write(const void *const buf, size_t len);
  **/
 int dfu_target_done(bool successful);
 
+/**
+ * @brief Get the image type and file size of the download in progress.
+ *
+ *	  The context is set by 'dfu_target_init' and cleared when the
+ *	  download completes successfully. With
+ *	  CONFIG_DFU_TARGET_SAVE_CONTEXT, it is kept across resets.
+ *
+ *	  To continue an aborted DFU procedure before any data has been
+ *	  received, pass the context to 'dfu_target_init' and call
+ *	  'dfu_target_offset_get'.
+ *
+ * @param[out] img_type Image type identifier.
+ * @param[out] file_size Size of the file being downloaded.
+ *
+ * @retval 0 on success.
+ * @retval -ENOENT if no download is in progress.
+ * @return Other negative errno if the context could not be loaded.
+ **/
+int dfu_target_context_get(int *img_type, size_t *file_size);
+
 #ifdef __cplusplus
 }
 #endif
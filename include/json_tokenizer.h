@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file json_tokenizer.h
+ *
+ * @defgroup json_tokenizer In-place JSON tokenizer
+ * @{
+ * @brief Split JSON documents into tokens without copying or allocating.
+ *
+ * The document is parsed once into an array of tokens supplied by the
+ * caller. Each token refers to its text in the document, which is not
+ * copied. Values are then looked up by key or by path, and strings are
+ * unescaped only when they are read.
+ */
+
+#ifndef JSON_TOKENIZER_H__
+#define JSON_TOKENIZER_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum length of a document, limited by the size of the offsets. */
+#define JSON_TOK_MAX_LEN 0xFFFF
+
+/** @brief Token types. */
+enum json_tok_type {
+	JSON_TOK_OBJECT,
+	JSON_TOK_ARRAY,
+	JSON_TOK_STRING,
+	JSON_TOK_NUMBER,
+	JSON_TOK_TRUE,
+	JSON_TOK_FALSE,
+	JSON_TOK_NULL,
+};
+
+/**
+ * @brief A token in a document.
+ *
+ * The first token is the top level value. The tokens of the values in an
+ * object or array follow the token of the container. In an object, the key
+ * of each value is a string token followed by the tokens of the value.
+ */
+struct json_tok {
+	/** Type of the token, see @ref json_tok_type. */
+	u8_t type;
+	/** Offset of the token in the document. For strings, the offset
+	 *  of the first character after the opening quote.
+	 */
+	u16_t start;
+	/** Offset of the first character after the token. For strings, the
+	 *  offset of the closing quote.
+	 */
+	u16_t end;
+	/** Number of values in an object or array, 0 for other tokens. */
+	u16_t size;
+	/** Index of the first token after this token and its values. For
+	 *  keys, the index of the token of the value.
+	 */
+	u16_t next;
+};
+
+/**
+ * @brief Split a document into tokens.
+ *
+ * The document is validated as it is parsed. Parsing stops at the end of
+ * the document or at a NUL character, and only whitespace may follow the
+ * top level value.
+ *
+ * @param[in] json Document.
+ * @param[in] len Length of the document.
+ * @param[out] toks Array for the tokens.
+ * @param[in] num_toks Number of tokens in the array.
+ *
+ * @return Number of tokens if successful.
+ * @retval -EINVAL If the document is not valid JSON.
+ * @retval -ENOMEM If there are more tokens than fit in the array.
+ * @retval -E2BIG If the document is longer than JSON_TOK_MAX_LEN.
+ */
+int json_tokenize(const char *json, size_t len, struct json_tok *toks,
+		  size_t num_toks);
+
+/**
+ * @brief Look up a value in an object by key.
+ *
+ * Keys are compared as they appear in the document, without unescaping.
+ *
+ * @param[in] json Document.
+ * @param[in] toks Tokens of the document.
+ * @param[in] obj Index of the object token.
+ * @param[in] key Key, NUL-terminated.
+ *
+ * @return Index of the token of the value if found.
+ * @retval -ENOENT If @p obj is not an object or has no value with the key.
+ */
+int json_tok_get(const char *json, const struct json_tok *toks, int obj,
+		 const char *key);
+
+/**
+ * @brief Look up a value by path.
+ *
+ * The path is a list of keys separated by dots, for example
+ * "state.pairing.topics". Each key is looked up in the object found by
+ * the previous key, starting from @p obj.
+ *
+ * @param[in] json Document.
+ * @param[in] toks Tokens of the document.
+ * @param[in] obj Index of the object token to start from, or a negative
+ *		  error code from an earlier lookup, which is returned.
+ * @param[in] path Path, NUL-terminated.
+ *
+ * @return Index of the token of the value if found.
+ * @retval -ENOENT If a key on the path is not found.
+ */
+int json_tok_find(const char *json, const struct json_tok *toks, int obj,
+		  const char *path);
+
+/**
+ * @brief Compare a string token with a string.
+ *
+ * @param[in] json Document.
+ * @param[in] tok Token.
+ * @param[in] str String, NUL-terminated.
+ *
+ * @return true if the token is a string with the same text as @p str,
+ *	   without unescaping, otherwise false.
+ */
+bool json_tok_str_eq(const char *json, const struct json_tok *tok,
+		     const char *str);
+
+/**
+ * @brief Read a number token.
+ *
+ * @param[in] json Document.
+ * @param[in] tok Token.
+ * @param[out] value Value of the number.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the token is not a number.
+ */
+int json_tok_double(const char *json, const struct json_tok *tok,
+		    double *value);
+
+/**
+ * @brief Copy a string token into a buffer, unescaping it.
+ *
+ * The unescaped string is never longer than the token, so a buffer of
+ * the token length plus one is always large enough.
+ *
+ * @param[in] json Document.
+ * @param[in] tok Token.
+ * @param[out] buf Buffer for the string, NUL-terminated.
+ * @param[in] size Size of the buffer.
+ *
+ * @return Length of the string if successful.
+ * @retval -EINVAL If the token is not a string.
+ * @retval -ENOMEM If the string does not fit in the buffer.
+ */
+int json_tok_str_copy(const char *json, const struct json_tok *tok, char *buf,
+		      size_t size);
+
+/**
+ * @brief Unescape a string token in place and NUL-terminate it.
+ *
+ * The string is written over its text in the document, and the closing
+ * quote or an earlier character is replaced by the NUL character. The end
+ * of the token is updated, so the token can still be compared and copied.
+ * Other tokens are not affected. The string must be unescaped only once.
+ *
+ * @param[in,out] json Document.
+ * @param[in,out] tok Token.
+ *
+ * @return Pointer to the string in the document, or NULL if the token is
+ *	   not a string.
+ */
+char *json_tok_str_get(char *json, struct json_tok *tok);
+
+/**
+ * @brief Split a CBOR document into tokens.
+ *
+ * Maps, arrays, text and byte strings, integers, floats and the simple
+ * values false, true, null and undefined are mapped to the token types of
+ * the equivalent JSON values, so that documents are looked up the same way.
+ * The keys of maps must be text strings. Maps and arrays may have definite
+ * or indefinite lengths, strings must have definite lengths, and tags are
+ * skipped.
+ *
+ * String tokens refer to the content of the string, so @ref json_tok_get,
+ * @ref json_tok_find and @ref json_tok_str_eq can be used with the document
+ * cast to a character pointer. Number tokens refer to the encoded item, and
+ * are read with @ref json_tok_cbor_double.
+ *
+ * Requires CONFIG_JSON_TOKENIZER_CBOR.
+ *
+ * @param[in] cbor Document.
+ * @param[in] len Length of the document.
+ * @param[out] toks Array for the tokens.
+ * @param[in] num_toks Number of tokens in the array.
+ *
+ * @return Number of tokens if successful.
+ * @retval -EINVAL If the document is not valid or not supported, or if
+ *		   there is data after the top level value.
+ * @retval -ENOMEM If there are more tokens than fit in the array.
+ * @retval -E2BIG If the document is longer than JSON_TOK_MAX_LEN.
+ */
+int json_tokenize_cbor(const u8_t *cbor, size_t len, struct json_tok *toks,
+		       size_t num_toks);
+
+/**
+ * @brief Read a number token of a CBOR document.
+ *
+ * @param[in] cbor Document.
+ * @param[in] tok Token.
+ * @param[out] value Value of the number.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the token is not a number.
+ */
+int json_tok_cbor_double(const u8_t *cbor, const struct json_tok *tok,
+			 double *value);
+
+/**
+ * @brief Copy a string token of a CBOR document into a buffer.
+ *
+ * @param[in] cbor Document.
+ * @param[in] tok Token.
+ * @param[out] buf Buffer for the string, NUL-terminated.
+ * @param[in] size Size of the buffer.
+ *
+ * @return Length of the string if successful.
+ * @retval -EINVAL If the token is not a string.
+ * @retval -ENOMEM If the string does not fit in the buffer.
+ */
+int json_tok_cbor_str_copy(const u8_t *cbor, const struct json_tok *tok,
+			   char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JSON_TOKENIZER_H__ */
+
+/**@} */
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file json_writer.h
+ *
+ * @defgroup json_writer Streaming JSON writer
+ * @{
+ * @brief Write JSON documents into a caller-supplied buffer.
+ *
+ * The document is written in order, one value at a time, without building
+ * a tree and without allocating memory. The writer keeps counting the length
+ * of the document when the buffer is full, so the size of a document can be
+ * computed by writing it with a NULL buffer first.
+ */
+
+#ifndef JSON_WRITER_H__
+#define JSON_WRITER_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum nesting depth of objects and arrays. */
+#define JSON_WRITER_MAX_DEPTH 16
+
+/** @brief State of the writer. The members are internal. */
+struct json_writer {
+	/** Buffer for the document, or NULL to only compute its length. */
+	char *buf;
+	/** Size of the buffer. */
+	size_t size;
+	/** Length of the document written so far, also past the buffer. */
+	size_t len;
+	/** Bit n is set if the container at depth n is an object. */
+	u32_t objects;
+	/** Bit n is set if the container at depth n has a value. */
+	u32_t has_values;
+	/** Current nesting depth, 0 for the top level. */
+	u8_t depth;
+	/** First error, reported by all later calls. */
+	int err;
+};
+
+/**
+ * @brief Initialize the writer.
+ *
+ * @param[out] w Writer.
+ * @param[in] buf Buffer for the document, or NULL to only compute its
+ *		  length.
+ * @param[in] size Size of the buffer, including the terminating NUL
+ *		   character.
+ */
+void json_writer_init(struct json_writer *w, char *buf, size_t size);
+
+/**
+ * @brief Start an object.
+ *
+ * Every value function takes the key of the value as its @p key argument.
+ * The key must be given for values in an object, and must be NULL for values
+ * in an array and for the top level value.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the object, or NULL.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the key does not match the container, or if the
+ *		   document is already complete.
+ * @retval -E2BIG If JSON_WRITER_MAX_DEPTH would be exceeded.
+ */
+int json_writer_obj_start(struct json_writer *w, const char *key);
+
+/**
+ * @brief End the current object.
+ *
+ * @param[in,out] w Writer.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the current container is not an object.
+ */
+int json_writer_obj_end(struct json_writer *w);
+
+/**
+ * @brief Start an array.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the array, or NULL.
+ *
+ * @return 0 if successful, otherwise a negative error code as for
+ *	   @ref json_writer_obj_start.
+ */
+int json_writer_arr_start(struct json_writer *w, const char *key);
+
+/**
+ * @brief End the current array.
+ *
+ * @param[in,out] w Writer.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the current container is not an array.
+ */
+int json_writer_arr_end(struct json_writer *w);
+
+/**
+ * @brief Write a NUL-terminated string, escaping it as needed.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the value, or NULL.
+ * @param[in] str String.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int json_writer_str(struct json_writer *w, const char *key, const char *str);
+
+/**
+ * @brief Write a string of the given length, escaping it as needed.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the value, or NULL.
+ * @param[in] str String, does not need to be NUL-terminated.
+ * @param[in] len Length of the string.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int json_writer_strn(struct json_writer *w, const char *key, const char *str,
+		     size_t len);
+
+/**
+ * @brief Write an integer.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the value, or NULL.
+ * @param[in] value Value.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int json_writer_int(struct json_writer *w, const char *key, s64_t value);
+
+/**
+ * @brief Write a floating point number.
+ *
+ * The number is formatted like cJSON formats it: integral values without
+ * a fraction, other values with the shortest of 15 and 17 significant digits
+ * that reads back as the same value. Values that are not finite are written
+ * as null. This requires a C library with floating point support in printf.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the value, or NULL.
+ * @param[in] value Value.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int json_writer_double(struct json_writer *w, const char *key, double value);
+
+/**
+ * @brief Write a boolean.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the value, or NULL.
+ * @param[in] value Value.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int json_writer_bool(struct json_writer *w, const char *key, bool value);
+
+/**
+ * @brief Write null.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the value, or NULL.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int json_writer_null(struct json_writer *w, const char *key);
+
+/**
+ * @brief Write a value that is already encoded as JSON.
+ *
+ * The value is copied as is, it is not validated.
+ *
+ * @param[in,out] w Writer.
+ * @param[in] key Key of the value, or NULL.
+ * @param[in] json Encoded value.
+ * @param[in] len Length of the encoded value.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int json_writer_raw(struct json_writer *w, const char *key, const char *json,
+		    size_t len);
+
+/**
+ * @brief Complete the document.
+ *
+ * The document is NUL-terminated if it fits in the buffer.
+ *
+ * @param[in,out] w Writer.
+ *
+ * @return Length of the document, not including the terminating NUL
+ *	   character. The buffer must be at least one byte larger.
+ * @retval -ENOMEM If the document does not fit in the buffer.
+ * @retval -EINVAL If a container is not ended, there is no value, or the
+ *		   writer was used incorrectly before.
+ * @retval -E2BIG If the nesting was too deep.
+ */
+int json_writer_finish(struct json_writer *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JSON_WRITER_H__ */
+
+/**@} */
@@ -13,6 +13,7 @@
 #define ZEPHYR_INCLUDE_LTE_LINK_CONTROL_H_
 
 #include <stdbool.h>
+#include <zephyr/types.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -51,6 +52,79 @@ enum lte_lc_func_mode {
 	LTE_LC_FUNC_MODE_OFFLINE_UICC_ON	= 44
 };
 
+/* NOTE: enum lte_lc_rrc_mode maps directly to the RRC mode
+ *	 as returned by the unsolicited AT notification "+CSCON".
+ */
+enum lte_lc_rrc_mode {
+	LTE_LC_RRC_MODE_IDLE			= 0,
+	LTE_LC_RRC_MODE_CONNECTED		= 1,
+};
+
+/* NOTE: enum lte_lc_lte_mode maps directly to the access technology
+ *	 as used by the AT command "AT+CEDRXS".
+ */
+enum lte_lc_lte_mode {
+	LTE_LC_LTE_MODE_NONE			= 0,
+	LTE_LC_LTE_MODE_LTEM			= 4,
+	LTE_LC_LTE_MODE_NBIOT			= 5,
+};
+
+enum lte_lc_evt_type {
+	/** Network registration status has changed. */
+	LTE_LC_EVT_NW_REG_STATUS,
+	/** PSM parameters granted by the network have changed. */
+	LTE_LC_EVT_PSM_UPDATE,
+	/** eDRX parameters granted by the network have changed. */
+	LTE_LC_EVT_EDRX_UPDATE,
+	/** The modem has entered or left RRC connected mode. */
+	LTE_LC_EVT_RRC_UPDATE,
+};
+
+struct lte_lc_psm_cfg {
+	/** Periodic Tracking Area Update interval in seconds,
+	 *  -1 if the timer is deactivated.
+	 */
+	int tau;
+	/** Active time (time from RRC idle to PSM) in seconds,
+	 *  -1 if the timer is deactivated.
+	 */
+	int active_time;
+};
+
+struct lte_lc_edrx_cfg {
+	/** LTE mode the eDRX parameters apply to. */
+	enum lte_lc_lte_mode mode;
+	/** eDRX interval in milliseconds, 0 if eDRX is not in use. */
+	u32_t edrx;
+	/** Paging time window in milliseconds. */
+	u32_t ptw;
+};
+
+struct lte_lc_evt {
+	enum lte_lc_evt_type type;
+	union {
+		enum lte_lc_nw_reg_status nw_reg_status;
+		enum lte_lc_rrc_mode rrc_mode;
+		struct lte_lc_psm_cfg psm_cfg;
+		struct lte_lc_edrx_cfg edrx_cfg;
+	};
+};
+
+/** @brief LTE link control event handler.
+ *
+ * @note The handler is called from the AT notification context and must
+ *	 not block or issue AT commands.
+ */
+typedef void (*lte_lc_evt_handler_t)(const struct lte_lc_evt *const evt);
+
+/** @brief Register a handler to receive LTE link control events.
+ *	   Only one handler can be registered, a new registration
+ *	   replaces the previous one.
+ *
+ * @param handler Event handler, or NULL to stop receiving events.
+ */
+void lte_lc_register_handler(lte_lc_evt_handler_t handler);
+
 /** @brief Function for initializing
  * the modem.  NOTE: a follow-up call to lte_lc_connect()
  * must be made.
@@ -74,6 +148,27 @@ int lte_lc_connect(void);
  */
 int lte_lc_init_and_connect(void);
 
+/** @brief Function to start connecting to the LTE network without blocking.
+ * Registration progress is reported through @p handler as
+ * LTE_LC_EVT_NW_REG_STATUS events.
+ * NOTE: prior to calling this function a call to lte_lc_init()
+ * must be made. No fallback network mode is attempted.
+ *
+ * @param handler Event handler, or NULL to keep the current one.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int lte_lc_connect_async(lte_lc_evt_handler_t handler);
+
+/** @brief Function for initializing the modem and starting to connect
+ * to the LTE network without blocking.
+ *
+ * @param handler Event handler, or NULL to keep the current one.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int lte_lc_init_and_connect_async(lte_lc_evt_handler_t handler);
+
 /** @brief Function for sending the modem to offline mode
  *
  * @return Zero on success or (negative) error code otherwise.
@@ -100,6 +195,32 @@ int lte_lc_normal(void);
  */
 int lte_lc_psm_req(bool enable);
 
+/** @brief Function for setting the PSM parameters that are requested
+ * by lte_lc_psm_req(). The new values take effect the next time PSM is
+ * requested, so the application can adapt them to its traffic pattern.
+ * For reference see 3GPP 24.008 Ch. 10.5.7.4a and Ch. 10.5.7.3.
+ *
+ * @param rptau Requested periodic TAU as an 8 character bit string,
+ *		or NULL to use the Kconfig default.
+ * @param rat Requested active time as an 8 character bit string,
+ *	      or NULL to use the Kconfig default.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int lte_lc_psm_param_set(const char *rptau, const char *rat);
+
+/** @brief Function for setting the PSM parameters that are requested
+ * by lte_lc_psm_req(), in seconds. The values are rounded up to the
+ * nearest value that can be encoded in the GPRS timer information
+ * elements.
+ *
+ * @param tau Requested periodic TAU in seconds.
+ * @param active_time Requested active time in seconds.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int lte_lc_psm_param_set_seconds(u32_t tau, u32_t active_time);
+
 /**@brief Function for getting the current PSM (Power Saving Mode)
  *	  configurations for periodic TAU (Tracking Area Update) and
  *	  active time, both in units of seconds.
@@ -121,6 +242,17 @@ int lte_lc_psm_get(int *tau, int *active_time);
  */
 int lte_lc_edrx_req(bool enable);
 
+/** @brief Function for setting the eDRX value that is requested by
+ * lte_lc_edrx_req(). The new value takes effect the next time eDRX is
+ * requested. For reference see 3GPP 24.008 Ch. 10.5.5.32.
+ *
+ * @param edrx Requested eDRX value as a 4 character bit string,
+ *	       or NULL to use the Kconfig default.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+int lte_lc_edrx_param_set(const char *edrx);
+
 /**@brief Get the current network registration status.
  *
  * @param status Pointer for network registation status.
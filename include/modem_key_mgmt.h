@@ -26,6 +26,18 @@ enum modem_key_mgnt_cred_type {
 	MODEM_KEY_MGMT_CRED_TYPE_IDENTITY
 };
 
+/**@brief Credential to be provisioned with modem_key_mgmt_write_bulk(). */
+struct modem_key_mgmt_cred {
+	/** Security tag to associate with this credential. */
+	nrf_sec_tag_t sec_tag;
+	/** Credential type. */
+	enum modem_key_mgnt_cred_type cred_type;
+	/** Buffer containing the credential data. */
+	const void *buf;
+	/** Length of the buffer. */
+	u16_t len;
+};
+
 /**@brief Write or update a credential in persistent storage.
  *
  * This function will store the credential and associate it with the given
@@ -51,6 +63,34 @@ int modem_key_mgmt_write(nrf_sec_tag_t sec_tag,
 			 enum modem_key_mgnt_cred_type cred_type,
 			 const void *buf, u16_t len);
 
+/**@brief Write or update a set of credentials in persistent storage,
+ *	  skipping those that are already stored with the same content.
+ *
+ * The SHA-256 digest of each credential is compared with the digest
+ * reported by the modem for the stored credential. Only credentials that
+ * are missing or differ are written, and CME error reporting is toggled
+ * once for the whole batch instead of once per operation.
+ *
+ * @note If used when the LTE link is active, the function will return
+ *	 an error and the keys will not be written.
+ *
+ * @param[in]  creds	Array of credentials to provision.
+ * @param[in]  count	Number of entries in @p creds.
+ * @param[out] written	Number of credentials that were written.
+ *			Can be NULL.
+ *
+ * @retval 0		On success.
+ * @retval -EINVAL	Invalid parameters.
+ * @retval -ENOBUFS	Internal buffer is too small.
+ * @retval -ENOMEM	Not enough memory to store the credential.
+ * @retval -EACCES	The operation failed because the LTE link is active.
+ * @retval -ENOENT	The security tag could not be written.
+ * @retval -EPERM	Insufficient permissions.
+ * @retval -EIO		Internal error.
+ */
+int modem_key_mgmt_write_bulk(const struct modem_key_mgmt_cred *creds,
+			      size_t count, size_t *written);
+
 /**@brief Read a credential from persistent storage.
  *
  * @param[in]		sec_tag		The crediantial security tag.
@@ -44,7 +44,38 @@ enum aws_iot_evt_type {
 	/** Data received from AWS message broker. */
 	AWS_IOT_EVT_DATA_RECEIVED,
 	/** FOTA update done, request to reboot. */
-	AWS_IOT_EVT_FOTA_DONE
+	AWS_IOT_EVT_FOTA_DONE,
+	/** A QoS 1 message was acknowledged by the AWS message broker. */
+	AWS_IOT_EVT_DATA_SENT,
+	/** Fragment of a message from the AWS message broker that is larger
+	 *  than CONFIG_AWS_IOT_MQTT_PAYLOAD_BUFFER_LEN.
+	 */
+	AWS_IOT_EVT_DATA_RECEIVED_FRAGMENT
+};
+
+/** @brief Subscribed topics that received data can arrive on. */
+enum aws_iot_rx_topic_type {
+	/** The topic matches none of the subscriptions. */
+	AWS_IOT_RX_TOPIC_UNKNOWN,
+	/** Application specific topic. */
+	AWS_IOT_RX_TOPIC_APP,
+	AWS_IOT_RX_TOPIC_GET_ACCEPTED,
+	AWS_IOT_RX_TOPIC_GET_REJECTED,
+	AWS_IOT_RX_TOPIC_UPDATE_ACCEPTED,
+	AWS_IOT_RX_TOPIC_UPDATE_REJECTED,
+	AWS_IOT_RX_TOPIC_UPDATE_DELTA,
+	AWS_IOT_RX_TOPIC_DELETE_ACCEPTED,
+	AWS_IOT_RX_TOPIC_DELETE_REJECTED
+};
+
+/** @brief Subscription that received data arrived on. */
+struct aws_iot_rx_topic {
+	/** Type of the subscribed topic. */
+	enum aws_iot_rx_topic_type type;
+	/** Index of the topic in the list passed to
+	 *  aws_iot_subscription_topics_add(), for AWS_IOT_RX_TOPIC_APP.
+	 */
+	size_t app_index;
 };
 
 /** @brief Struct with data received from AWS IoT broker. */
@@ -55,6 +86,18 @@ struct aws_iot_evt {
 	char *ptr;
 	/** Length of data. */
 	size_t len;
+	/** Offset of the data in the received message, for
+	 *  AWS_IOT_EVT_DATA_RECEIVED_FRAGMENT.
+	 */
+	size_t offset;
+	/** Length of the whole received message, for
+	 *  AWS_IOT_EVT_DATA_RECEIVED_FRAGMENT.
+	 */
+	size_t total_len;
+	/** Subscription that the data arrived on, for
+	 *  AWS_IOT_EVT_DATA_RECEIVED and AWS_IOT_EVT_DATA_RECEIVED_FRAGMENT.
+	 */
+	struct aws_iot_rx_topic topic;
 };
 
 /** @brief AWS IoT topic data. */
@@ -144,12 +187,29 @@ int aws_iot_connect(struct aws_iot_config *const config);
  */
 int aws_iot_disconnect(void);
 
+/** @brief Get the time that the last connection to the AWS IoT broker took.
+ *
+ *  The time is measured from the call to mqtt_connect() until the broker
+ *  acknowledges the MQTT connection, so it includes the TCP connection and
+ *  the TLS handshake. A reconnection that resumes the TLS session of an
+ *  earlier connection takes less time.
+ *
+ *  @return Time in milliseconds, or 0 if no connection was acknowledged yet.
+ */
+u32_t aws_iot_connect_time_get(void);
+
 /** @brief Send data to AWS IoT broker.
+ *
+ *  QoS 1 messages are kept until the broker acknowledges them, which is
+ *  reported with an AWS_IOT_EVT_DATA_SENT event, and are sent again after
+ *  a reconnect. Up to CONFIG_MQTT_OUTBOX_WINDOW messages can wait for their
+ *  acknowledgment at a time.
  *
  *  @param[in] tx_data Pointer to struct containing data to be transmitted to
  *                     the AWS IoT broker.
  *
  *  @return 0 If successful.
+ *            -EAGAIN If too many messages wait for their acknowledgment.
  *            Otherwise, a (negative) error code is returned.
  */
 int aws_iot_send(const struct aws_iot_tx_data *const tx_data);
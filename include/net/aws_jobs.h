@@ -24,6 +24,8 @@ extern "C" {
 #include <zephyr/types.h>
 #include <net/mqtt.h>
 
+struct mqtt_outbox;
+
 /** @brief Job Execution Status. */
 enum execution_status {
 	AWS_JOBS_QUEUED = 0,
@@ -36,7 +38,10 @@ enum execution_status {
 	AWS_JOBS_CANCELED
 };
 
-/** @name MQTT message IDs used for identifying subscribe message ACKs
+/** @name Topics of subscribe requests
+ *
+ * Without an outbox, see @ref aws_jobs_outbox_set, these are also the
+ * message IDs of the requests.
  * @{
  */
 #define SUBSCRIBE_ID_BASE (2110)
@@ -226,6 +231,30 @@ int aws_jobs_update_job_execution(struct mqtt_client *const client,
 int aws_jobs_get_job_execution(struct mqtt_client *const client,
 			       const char *job_id, u8_t *topic_buf);
 
+/**
+ * @brief Take the message IDs of requests from an outbox.
+ *
+ * When the MQTT client publishes through an outbox, the message IDs of the
+ * subscribe requests and job execution updates must not be used by a
+ * message that waits for its acknowledgment. Without an outbox, subscribe
+ * requests use fixed IDs, and updates random IDs. Requires
+ * CONFIG_MQTT_OUTBOX.
+ *
+ * @param[in] outbox Outbox of the MQTT client, or NULL.
+ */
+void aws_jobs_outbox_set(struct mqtt_outbox *outbox);
+
+/**
+ * @brief Get the topic of a subscribe request from its message ID.
+ *
+ * @param[in] message_id Message ID of a SUBACK.
+ *
+ * @return Topic of the last subscribe request with the ID, one of the
+ *	   SUBSCRIBE_ values.
+ * @retval -ENOENT If the SUBACK is not for a request of this library.
+ */
+int aws_jobs_suback_topic_get(u16_t message_id);
+
 /**
  * @brief Compare topics
  *
@@ -37,6 +37,8 @@ enum cloud_event_type {
 	CLOUD_EVT_PAIR_REQUEST,
 	CLOUD_EVT_PAIR_DONE,
 	CLOUD_EVT_FOTA_DONE,
+	CLOUD_EVT_DATA_RECEIVED_FRAGMENT,
+	CLOUD_EVT_STATE_REJECTED,
 	CLOUD_EVT_COUNT
 };
 
@@ -100,11 +102,40 @@ struct cloud_msg {
 	struct cloud_endpoint endpoint;
 };
 
+/**@brief Fragment of a received message that is larger than the receive
+ *	  buffer of the backend.
+ */
+struct cloud_msg_fragment {
+	/** Data of the fragment, only valid during the event. */
+	char *buf;
+	/** Length of the fragment. */
+	size_t len;
+	/** Offset of the fragment in the message. */
+	size_t offset;
+	/** Length of the whole message. */
+	size_t total_len;
+	/** Endpoint that the message was received on. */
+	struct cloud_endpoint endpoint;
+};
+
+/**@brief Reassembly of a message that is received in fragments. */
+struct cloud_msg_reassembly {
+	/** Buffer for the whole message, provided by the application. */
+	char *buf;
+	/** Size of the buffer. */
+	size_t size;
+	/** Length of the message received so far. */
+	size_t len;
+	/** Length of the whole message, 0 if none is being reassembled. */
+	size_t total_len;
+};
+
 /**@brief Cloud event type. */
 struct cloud_event {
 	enum cloud_event_type type;
 	union {
 		struct cloud_msg msg;
+		struct cloud_msg_fragment fragment;
 		int err;
 	} data;
 };
@@ -156,6 +187,10 @@ struct cloud_backend_config {
 	void *user_data;
 	char *id;
 	size_t id_len;
+	/** Set by the backend when it is initialized, if its data endpoints
+	 *  accept CBOR encoded messages.
+	 */
+	bool cbor;
 };
 
 /**@brief Structure for cloud backend. */
@@ -374,6 +409,27 @@ static inline int cloud_user_data_set(struct cloud_backend *const backend,
 	return backend->api->user_data_set(backend, user_data);
 }
 
+/**
+ * @brief Add a received fragment to the message that is being reassembled.
+ *
+ * A fragment at offset 0 starts a new message, and discards a message that
+ * was not complete. The other fragments must follow the previous one.
+ *
+ * @param reassembly Reassembly of the message, with the buffer and its size
+ *		     set by the application.
+ * @param fragment Fragment from a CLOUD_EVT_DATA_RECEIVED_FRAGMENT event.
+ *
+ * @retval 0 The message is complete. It is in the buffer, and its length
+ *	     is len.
+ * @retval -EAGAIN More fragments of the message are needed.
+ * @retval -EMSGSIZE The message does not fit in the buffer, its fragments
+ *		     are ignored.
+ * @retval -EINVAL A fragment is missing or does not belong to the message,
+ *		   the message is discarded.
+ */
+int cloud_msg_reassemble(struct cloud_msg_reassembly *const reassembly,
+			 const struct cloud_msg_fragment *const fragment);
+
 /**
  * @brief Get binding (pointer) to cloud backend if a registered backend
  *	      matches the provided name.
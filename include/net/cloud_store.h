@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef ZEPHYR_INCLUDE_CLOUD_STORE_H_
+#define ZEPHYR_INCLUDE_CLOUD_STORE_H_
+
+/**
+ * @brief Cloud store-and-forward queue
+ * @defgroup cloud_store Cloud store-and-forward queue
+ * @{
+ */
+
+#include <zephyr.h>
+#include <net/cloud.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@brief Initialize the store.
+ * @details The store is kept in the flash partition labeled cloud_store.
+ *	    Messages that were stored before a reset are sent when the link
+ *	    is reported up.
+ * @param backend Pointer to the cloud backend that stored messages are
+ *		  sent through.
+ * @param work_q Work queue that stored messages are sent from. Sending
+ *		 blocks, so this should not be the system work queue.
+ * @return 0 or a negative error code indicating reason of failure.
+ */
+int cloud_store_init(const struct cloud_backend *const backend,
+		     struct k_work_q *work_q);
+
+/**@brief Send a message to the cloud, or store it if that is not possible.
+ * @details The message is sent immediately if the link is up and no
+ *	    messages are stored. Otherwise, or if sending fails, it is
+ *	    stored and sent after the messages that were stored before it.
+ *	    When the store is full, the oldest messages are dropped.
+ * @param msg Pointer to cloud message structure.
+ * @return 0 if the message was sent or stored, or a negative error code
+ *	   indicating reason of failure.
+ */
+int cloud_store_send(const struct cloud_msg *const msg);
+
+/**@brief Notify the store about a change of the cloud connection.
+ * @details When the link comes up, stored messages are sent in steps of
+ *	    CONFIG_CLOUD_STORE_DRAIN_BATCH messages, every
+ *	    CONFIG_CLOUD_STORE_DRAIN_INTERVAL milliseconds. The application
+ *	    typically calls this on CLOUD_EVT_READY and
+ *	    CLOUD_EVT_DISCONNECTED.
+ * @param connected True if messages can be sent to the cloud.
+ */
+void cloud_store_link_update(bool connected);
+
+/**@brief Get the number of messages that are stored and not yet sent. */
+size_t cloud_store_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ZEPHYR_INCLUDE_CLOUD_STORE_H_ */
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef ZEPHYR_INCLUDE_CLOUD_UPLINK_H_
+#define ZEPHYR_INCLUDE_CLOUD_UPLINK_H_
+
+/**
+ * @brief Cloud uplink scheduler
+ * @defgroup cloud_uplink Cloud uplink scheduler
+ * @{
+ */
+
+#include <zephyr.h>
+#include <net/cloud.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Deadline value for messages that must be sent immediately. */
+#define CLOUD_UPLINK_DEADLINE_NOW 0
+
+/**@brief Initialize the uplink scheduler.
+ *
+ * @param backend Pointer to the cloud backend that deferred messages are
+ *		  sent through.
+ * @param work_q Work queue that deferred messages are sent from when their
+ *		 deadline expires or the link becomes RRC connected. Sending
+ *		 blocks, so this should not be the system work queue.
+ *
+ * @return 0 or a negative error code indicating reason of failure.
+ */
+int cloud_uplink_init(const struct cloud_backend *const backend,
+		      struct k_work_q *work_q);
+
+/**@brief Send or defer a message to the cloud.
+ *
+ * @details The message is copied and held until the link is RRC connected,
+ *	    another message has to be sent immediately, or the deadline
+ *	    expires, whichever happens first. All pending messages are then
+ *	    sent in one burst. A message with deadline
+ *	    @ref CLOUD_UPLINK_DEADLINE_NOW is sent immediately, together with
+ *	    all pending messages. Messages are sent in the order they were
+ *	    passed in. If the pending messages are being sent by another
+ *	    thread, the message is sent by that thread after them.
+ *	    Messages that cannot be sent are kept, and sent again the next
+ *	    time messages are released, or after
+ *	    CONFIG_CLOUD_UPLINK_RETRY_INTERVAL milliseconds.
+ *
+ * @param msg Pointer to cloud message structure.
+ * @param deadline_ms Maximum time in milliseconds the message can be held.
+ *
+ * @retval 0 If the message was sent or is kept to be sent later.
+ * @retval -ENOBUFS If CONFIG_CLOUD_UPLINK_MAX_PENDING messages are kept
+ *		    because they could not be sent.
+ * @return Otherwise, a negative error code indicating reason of failure.
+ */
+int cloud_uplink_send(const struct cloud_msg *const msg, u32_t deadline_ms);
+
+/**@brief Send all pending messages.
+ *
+ * @details If a message cannot be sent, it and the messages after it are
+ *	    kept.
+ *
+ * @return 0 or the error code of the failing send.
+ */
+int cloud_uplink_flush(void);
+
+/**@brief Notify the scheduler about a change in RRC mode.
+ *
+ * @details Pending messages are released when the link enters RRC connected
+ *	    mode, as they can then be sent without a new connection setup.
+ *	    They are sent from the work queue of the scheduler, so this
+ *	    function does not block and can be called from the LTE link
+ *	    control event handler on LTE_LC_EVT_RRC_UPDATE.
+ *
+ * @param connected True if the link is RRC connected, false if RRC idle.
+ */
+void cloud_uplink_rrc_update(bool connected);
+
+/**@brief Get the number of messages that are currently deferred. */
+size_t cloud_uplink_pending_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* ZEPHYR_INCLUDE_CLOUD_UPLINK_H_ */
@@ -65,6 +65,18 @@ struct download_fragment {
 	size_t len;
 };
 
+/**
+ * @brief Fragment handed over to the fragment thread.
+ */
+struct download_client_frag_msg {
+	/** Fragment data, or NULL if there is no data. */
+	const char *buf;
+	/** Fragment length. */
+	size_t len;
+	/** Buffer to release once handled, or -1. */
+	int release;
+};
+
 /**
  * @brief Download client event.
  */
@@ -115,16 +127,45 @@ struct download_client_cfg {
 typedef int (*download_client_callback_t)(
 	const struct download_client_evt *event);
 
+struct download_client_transport;
+
 /**
  * @brief Download client instance.
  */
 struct download_client {
 	/** HTTP socket. */
 	int fd;
+#if defined(CONFIG_DOWNLOAD_CLIENT_DOUBLE_BUFFER)
+	/** HTTP response buffers, received into in turns. */
+	char bufs[2][CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE];
+	/** HTTP response buffer currently received into. */
+	char *buf;
+	/** Index of the buffer currently received into. */
+	int active;
+	/** Buffers available for receiving. */
+	struct k_sem buf_free[2];
+	/** The application has refused a fragment. */
+	bool stopped;
+	/** Fragments waiting to be sent to the application. */
+	struct k_msgq frag_q;
+	/** Storage for @ref frag_q. */
+	char frag_q_buf[CONFIG_DOWNLOAD_CLIENT_FRAGMENT_QUEUE_SIZE *
+			sizeof(struct download_client_frag_msg)];
+	/** Internal fragment thread. */
+	struct k_thread frag_thread;
+	/** Internal fragment thread stack. */
+	K_THREAD_STACK_MEMBER(frag_thread_stack,
+			      CONFIG_DOWNLOAD_CLIENT_FRAGMENT_STACK_SIZE);
+#else
 	/** HTTP response buffer. */
 	char buf[CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE];
+#endif
 	/** Buffer offset. */
 	size_t offset;
+	/** Offset of the payload in the buffer
+	 *  that has not been sent to the application yet.
+	 */
+	size_t body;
 
 	/** Size of the file being downloaded, in bytes. */
 	size_t file_size;
@@ -140,6 +181,36 @@ struct download_client {
 	/** The server has closed the connection. */
 	bool connection_close;
 
+	/** Offset of the first HTTP header line not parsed yet. */
+	size_t hdr_line;
+	/** Offset up to which the current header line
+	 *  has been searched for its end.
+	 */
+	size_t hdr_scan;
+	/** HTTP status code of the current response. */
+	int http_status;
+	/** Whether the current response has a Content-Length. */
+	bool has_content_length;
+	/** Payload bytes of the current response not received yet. */
+	size_t response_remaining;
+
+#if defined(CONFIG_DOWNLOAD_CLIENT_COAP)
+	/** CoAP block-wise transfer state. */
+	struct {
+		/** Token of the requests for this download. */
+		u32_t token;
+		/** Next block to request. */
+		u32_t next_block;
+		/** Block size exponent, block size is 2^(szx + 4). */
+		u8_t szx;
+		/** Number of retransmissions without a response. */
+		u8_t retransmits;
+	} coap;
+#endif
+
+	/** Protocol used to download the file. */
+	const struct download_client_transport *transport;
+
 	/** Server hosting the file, null-terminated. */
 	const char *host;
 	/** File name, null-terminated. */
@@ -175,6 +246,8 @@ int download_client_init(struct download_client *client,
  *
  * @param[in] client	Client instance.
  * @param[in] host	HTTP server to connect to, null-terminated.
+ *			Use the coap:// prefix to download from a CoAP server
+ *			if @c CONFIG_DOWNLOAD_CLIENT_COAP is enabled.
  * @param[in] config	Configuration options.
  *
  * @retval int Zero on success, a negative error code otherwise.
@@ -189,6 +262,10 @@ int download_client_connect(struct download_client *client, const char *host,
  * CONFIG_DOWNLOAD_CLIENT_MAX_FRAGMENT_SIZE bytes,
  * which are delivered to the application
  * via @ref DOWNLOAD_CLIENT_EVT_FRAGMENT events.
+ * If @c CONFIG_DOWNLOAD_CLIENT_STREAM is enabled, the whole file is
+ * requested at once and the fragments are cut from the response body.
+ * If @c CONFIG_DOWNLOAD_CLIENT_DOUBLE_BUFFER is enabled, fragment events
+ * are sent from a separate thread while the next fragment is received.
  *
  * @param[in] client	Client instance.
  * @param[in] file	File to download, null-terminated.
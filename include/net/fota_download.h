@@ -26,6 +26,9 @@
 extern "C" {
 #endif
 
+/** Size of the SHA-256 hash given to fota_download_start_with_hash(). */
+#define FOTA_DOWNLOAD_HASH_SIZE 32
+
 /**
  * @brief FOTA download event IDs.
  */
@@ -80,6 +83,31 @@ int fota_download_init(fota_download_callback_t client_callback);
  */
 int fota_download_start(const char *host, const char *file);
 
+/**@brief Start downloading the given file, and verify its SHA-256 hash.
+ *
+ * Works like @ref fota_download_start, but the hash of the file is computed
+ * while the file is downloaded. When the download is complete, the hash is
+ * compared with the given hash before the secondary slot is tagged as
+ * having valid firmware inside it. If the hashes differ, the image is
+ * discarded and FOTA_DOWNLOAD_EVT_ERROR is sent.
+ *
+ * A download of the same file that was interrupted earlier is resumed from
+ * the latest snapshot of the hash state before its offset. The data from the
+ * snapshot to the offset is downloaded again for the hash. If there is no
+ * snapshot, the data is discarded and the file is downloaded from the start.
+ *
+ * @param host Host to download from.
+ * @param file File to download.
+ * @param hash Expected SHA-256 hash of the file, of
+ *	       FOTA_DOWNLOAD_HASH_SIZE bytes.
+ *
+ * @retval 0	     If download has started successfully.
+ * @retval -ENOTSUP  If CONFIG_FOTA_DOWNLOAD_HASH_VERIFY is not enabled.
+ *                   Otherwise, a negative value is returned.
+ */
+int fota_download_start_with_hash(const char *host, const char *file,
+				  const u8_t *hash);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/** @file
+ */
+
+#ifndef MQTT_OUTBOX_H__
+#define MQTT_OUTBOX_H__
+
+/**
+ * @defgroup mqtt_outbox MQTT outbox
+ * @{
+ * @brief Tracking of MQTT QoS 1 messages until they are acknowledged.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr.h>
+#include <zephyr/types.h>
+#include <net/mqtt.h>
+
+struct mqtt_outbox;
+
+/**@brief Outbox acknowledgment handler.
+ *
+ * @param outbox  Outbox that the message was published through.
+ * @param message Message that was acknowledged or dropped. It is only valid
+ *		  during the call.
+ * @param tag     Tag that was given when the message was published.
+ * @param result  0 if the broker acknowledged the message, or -ECANCELED if
+ *		  it was dropped from the outbox.
+ */
+typedef void (*mqtt_outbox_ack_cb_t)(
+	struct mqtt_outbox *outbox,
+	const struct mqtt_publish_message *message, u32_t tag, int result);
+
+/** @brief QoS 1 message waiting for its acknowledgment. */
+struct mqtt_outbox_entry {
+	/** Copy of the message. */
+	struct mqtt_publish_message message;
+	/** Tag given by the publisher. */
+	u32_t tag;
+	/** Order in which the messages were published. */
+	u32_t seq;
+	/** Message ID, 0 if the entry is free. */
+	u16_t message_id;
+};
+
+/** @brief MQTT outbox.
+ *
+ * The members are internal to the library.
+ */
+struct mqtt_outbox {
+	struct mqtt_client *client;
+	mqtt_outbox_ack_cb_t ack_cb;
+	struct mqtt_outbox_entry entries[CONFIG_MQTT_OUTBOX_WINDOW];
+	struct k_mutex lock;
+	u32_t last_seq;
+	u16_t last_id;
+};
+
+/**@brief Initialize an outbox.
+ *
+ * @param outbox Outbox.
+ * @param client MQTT client that messages are published with.
+ * @param ack_cb Handler that is called when a message is acknowledged, or
+ *		 NULL.
+ *
+ * @return 0 if successful, otherwise a negative error code.
+ */
+int mqtt_outbox_init(struct mqtt_outbox *outbox, struct mqtt_client *client,
+		     mqtt_outbox_ack_cb_t ack_cb);
+
+/**@brief Publish a message.
+ *
+ * A QoS 1 message gets the next free message ID, and the topic and payload
+ * are copied, so that the message can be sent again until it is
+ * acknowledged. QoS 0 messages are published without being tracked.
+ *
+ * @param outbox  Outbox.
+ * @param message Message to publish.
+ * @param tag     Value that is passed to the acknowledgment handler.
+ *
+ * @retval >0 Message ID of a QoS 1 message.
+ * @retval 0 A QoS 0 message was published.
+ * @retval -EAGAIN CONFIG_MQTT_OUTBOX_WINDOW messages are waiting for their
+ *		   acknowledgment.
+ * @return Otherwise a negative error code.
+ */
+int mqtt_outbox_publish(struct mqtt_outbox *outbox,
+			const struct mqtt_publish_message *message, u32_t tag);
+
+/**@brief Handle an acknowledgment from the broker.
+ *
+ * Call this on MQTT_EVT_PUBACK. The message is removed from the outbox and
+ * the acknowledgment handler is called.
+ *
+ * @param outbox Outbox.
+ * @param ack    Acknowledgment.
+ *
+ * @retval 0 The acknowledged message was in the outbox.
+ * @retval -ENOENT The message was not published through the outbox.
+ */
+int mqtt_outbox_puback(struct mqtt_outbox *outbox,
+		       const struct mqtt_puback_param *ack);
+
+/**@brief Publish all messages that wait for their acknowledgment again.
+ *
+ * Call this on MQTT_EVT_CONNACK after a reconnect. The messages are
+ * published with their message IDs and the DUP flag set.
+ *
+ * @param outbox Outbox.
+ *
+ * @return 0 if successful, otherwise the first error of the MQTT library.
+ */
+int mqtt_outbox_resend(struct mqtt_outbox *outbox);
+
+/**@brief Drop all messages from the outbox.
+ *
+ * The acknowledgment handler is called with -ECANCELED for each message.
+ *
+ * @param outbox Outbox.
+ */
+void mqtt_outbox_clear(struct mqtt_outbox *outbox);
+
+/**@brief Get a message ID for a packet that is not a publish.
+ *
+ * The ID is taken from the same sequence as the IDs of published messages,
+ * and is not used by a message in the outbox, so that, for example, a
+ * subscription does not use the ID of a message in flight.
+ *
+ * @param outbox Outbox.
+ *
+ * @return Message ID, never 0.
+ */
+u16_t mqtt_outbox_message_id_get(struct mqtt_outbox *outbox);
+
+/**@brief Get the number of messages that wait for their acknowledgment.
+ *
+ * @param outbox Outbox.
+ */
+size_t mqtt_outbox_count(struct mqtt_outbox *outbox);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* MQTT_OUTBOX_H__ */
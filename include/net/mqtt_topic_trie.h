@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/** @file
+ */
+
+#ifndef MQTT_TOPIC_TRIE_H__
+#define MQTT_TOPIC_TRIE_H__
+
+/**
+ * @defgroup mqtt_topic_trie MQTT topic trie
+ * @{
+ * @brief Matching of MQTT topics against a set of topic filters.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <zephyr/types.h>
+
+/** @brief Node of the trie, holding one topic level.
+ *
+ * The members are internal to the library.
+ */
+struct mqtt_topic_trie_node {
+	/** Topic level, not null-terminated. */
+	const char *level;
+	/** Data of the topic filter that ends at the node, or NULL. */
+	void *data;
+	/** Length of the topic level. */
+	u16_t level_len;
+	/** Index of the first child plus one, 0 if the node has none. */
+	u16_t child;
+	/** Index of the next sibling plus one, 0 if the node has none. */
+	u16_t sibling;
+};
+
+/** @brief Topic trie.
+ *
+ * The members are internal to the library.
+ */
+struct mqtt_topic_trie {
+	struct mqtt_topic_trie_node *nodes;
+	size_t node_count;
+	size_t used;
+};
+
+/**@brief Initialize an empty trie.
+ *
+ * @param trie       Trie.
+ * @param nodes      Nodes that the trie is built in. Each level of a topic
+ *		     filter that is not shared with a filter that was added
+ *		     before takes one node.
+ * @param node_count Number of nodes, at most UINT16_MAX.
+ */
+void mqtt_topic_trie_init(struct mqtt_topic_trie *trie,
+			  struct mqtt_topic_trie_node *nodes,
+			  size_t node_count);
+
+/**@brief Remove all topic filters from a trie.
+ *
+ * @param trie Trie.
+ */
+void mqtt_topic_trie_clear(struct mqtt_topic_trie *trie);
+
+/**@brief Add a topic filter.
+ *
+ * The filter may contain the '+' and '#' wildcards. The trie refers to the
+ * filter string, so it must stay valid as long as the filter is in the trie.
+ *
+ * @param trie   Trie.
+ * @param filter Topic filter, does not need to be null-terminated.
+ * @param len    Length of the topic filter.
+ * @param data   Data that is returned for topics that match the filter. Must
+ *		 not be NULL.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL The filter is not valid.
+ * @retval -EALREADY The filter was added before.
+ * @retval -ENOMEM There are not enough free nodes in the trie.
+ */
+int mqtt_topic_trie_add(struct mqtt_topic_trie *trie, const char *filter,
+			size_t len, void *data);
+
+/**@brief Find the topic filters that a topic matches.
+ *
+ * The topic is matched against all filters with one walk through the
+ * trie. As required by MQTT, wildcards at the first level do not match
+ * topics starting with '$'.
+ *
+ * @param trie  Trie.
+ * @param topic Topic of a received message, does not need to be
+ *		null-terminated.
+ * @param len   Length of the topic.
+ * @param data  Array that the data of the matching filters is stored in.
+ *		Filters without wildcards come first.
+ * @param max   Size of the data array.
+ *
+ * @return Number of matching filters, which can be more than max.
+ */
+size_t mqtt_topic_trie_match(const struct mqtt_topic_trie *trie,
+			     const char *topic, size_t len, void **data,
+			     size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* MQTT_TOPIC_TRIE_H__ */
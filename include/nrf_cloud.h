@@ -41,6 +41,14 @@ enum nrf_cloud_evt_type {
 	NRF_CLOUD_EVT_TRANSPORT_DISCONNECTED,
 	/** The device should be restarted to apply a firmware upgrade */
 	NRF_CLOUD_EVT_FOTA_DONE,
+	/** The device received a fragment of data from the cloud that is
+	 * larger than CONFIG_NRF_CLOUD_MQTT_PAYLOAD_BUFFER_LEN.
+	 */
+	NRF_CLOUD_EVT_RX_DATA_FRAGMENT,
+	/** The cloud rejected a shadow update. The data is the error
+	 * document, with the error code and message.
+	 */
+	NRF_CLOUD_EVT_STATE_REJECTED,
 	/** There was an error communicating with the cloud. */
 	NRF_CLOUD_EVT_ERROR = 0xFF
 };
@@ -112,7 +120,8 @@ struct nrf_cloud_sensor_data {
 	/** Sensor data to be transmitted. */
 	struct nrf_cloud_data data;
 	/** Unique tag to identify the sent data.
-	 *  Useful for matching the acknowledgment.
+	 *  Useful for matching the acknowledgment, it is the status of the
+	 *  @ref NRF_CLOUD_EVT_SENSOR_DATA_ACK event.
 	 */
 	u32_t tag;
 };
@@ -124,6 +133,14 @@ struct nrf_cloud_evt {
 	/** Any status associated with the event. */
 	u32_t status;
 	struct nrf_cloud_data data;
+	/** Offset of the data in the received message, for
+	 * @ref NRF_CLOUD_EVT_RX_DATA_FRAGMENT.
+	 */
+	size_t offset;
+	/** Length of the whole received message, for
+	 * @ref NRF_CLOUD_EVT_RX_DATA_FRAGMENT.
+	 */
+	size_t total_len;
 };
 
 /**
@@ -201,13 +218,30 @@ int nrf_cloud_sensor_data_send(const struct nrf_cloud_sensor_data *param);
 /**
  * @brief Update the device shadow with sensor data.
  *
- * @param[in] param Sensor data.
+ * @param[in] param Sensor data. The data is a cJSON item, which is deleted
+ *		    by this function.
  *
  * @retval 0 If successful.
  *           Otherwise, a (negative) error code is returned.
  */
 int nrf_cloud_shadow_update(const struct nrf_cloud_sensor_data *param);
 
+/**
+ * @brief Update the device shadow with sensor data encoded as JSON.
+ *
+ * The data is reported in the shadow under the name of the sensor type.
+ * Unlike @ref nrf_cloud_shadow_update, no cJSON items are allocated.
+ *
+ * @param[in] param Sensor data. The data is a JSON encoded value, for
+ *		    example an object, that is copied into the shadow update
+ *		    as is. The length may include a terminating NUL.
+ *
+ * @retval 0 If successful.
+ * @retval -EINVAL If the data is not valid JSON.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_cloud_shadow_update_json(const struct nrf_cloud_sensor_data *param);
+
 /**
  * @brief Stream sensor data.
  *
@@ -234,6 +268,18 @@ int nrf_cloud_sensor_data_stream(const struct nrf_cloud_sensor_data *param);
  */
 int nrf_cloud_disconnect(void);
 
+/**
+ * @brief Get the time that the last connection to the cloud took.
+ *
+ * The time is measured from the call to mqtt_connect() until the broker
+ * acknowledges the MQTT connection, so it includes the TCP connection and
+ * the TLS handshake. A reconnection that resumes the TLS session of an
+ * earlier connection takes less time.
+ *
+ * @return Time in milliseconds, or 0 if no connection was acknowledged yet.
+ */
+u32_t nrf_cloud_connect_time_get(void);
+
 /**
  * @brief Function that must be called periodically to keep the module
  * functional.
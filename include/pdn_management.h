@@ -13,6 +13,8 @@
 #ifndef PDN_MANAGEMENT_H_
 #define PDN_MANAGEMENT_H_
 
+#include <stdbool.h>
+
 
 /**@brief  Initialize and connect PDN to APN 'apn_name'
  *
@@ -29,5 +31,78 @@ int pdn_init_and_connect(char *apn_name);
  */
 void pdn_disconnect(int pdn_fd);
 
+/**@brief PDN manager events. */
+enum pdn_evt {
+	/** The PDN connection is active. */
+	PDN_EVT_ACTIVATED,
+	/** The PDN connection was lost, it will be re-established. */
+	PDN_EVT_DEACTIVATED,
+	/** Activation failed, it will be retried. */
+	PDN_EVT_ERROR,
+};
+
+/**@brief PDN manager event handler.
+ *
+ * @param id Identifies the PDN context, as returned by pdn_ctx_add().
+ * @param evt The event.
+ * @param fd The PDN socket for PDN_EVT_ACTIVATED, otherwise the error
+ *	     code.
+ */
+typedef void (*pdn_evt_handler_t)(int id, enum pdn_evt evt, int fd);
+
+/**@brief Initialize the PDN manager.
+ *
+ * The PDN manager keeps the added contexts active. Contexts are activated
+ * concurrently with non-blocking connects, and are re-established when
+ * they are lost.
+ *
+ * @retval 0 on success, else a negative error code.
+ */
+int pdn_manager_init(void);
+
+/**@brief Add a persistent PDN context.
+ *
+ * Activation starts as soon as the network is registered, see
+ * pdn_manager_nw_reg_update().
+ *
+ * @param[in] apn_name APN of the PDN connection.
+ * @param[in] handler Handler to receive readiness events for this context.
+ *
+ * @retval A non-negative context ID on success, else a negative error code.
+ */
+int pdn_ctx_add(const char *apn_name, pdn_evt_handler_t handler);
+
+/**@brief Remove a persistent PDN context, disconnecting it if active.
+ *
+ * @param[in] id The context ID.
+ *
+ * @retval 0 on success, else a negative error code.
+ */
+int pdn_ctx_remove(int id);
+
+/**@brief Get the socket of an active PDN context.
+ *
+ * @param[in] id The context ID.
+ *
+ * @retval The PDN socket if the context is active, else a negative
+ *	   error code.
+ */
+int pdn_ctx_fd_get(int id);
+
+/**@brief Notify the PDN manager about a change in network registration.
+ *
+ * Inactive contexts are activated immediately when the network becomes
+ * registered, instead of waiting for the next retry. It does not wait for
+ * contexts that are being activated.
+ *
+ * With the LTE link control library, pdn_manager_init() gets the current
+ * registration status, and the library calls this function when the status
+ * changes. Otherwise, the application must call it.
+ *
+ * @param[in] registered True if registered to the home or a roaming
+ *			 network.
+ */
+void pdn_manager_nw_reg_update(bool registered);
+
 #endif /* PDN_MANAGEMENT_H_ */
 
@@ -23,12 +23,15 @@ extern "C" {
 
 #include <zephyr/types.h>
 #include <sys/types.h>
+#include <sms_deliver.h>
 
 /** @brief SMS PDU data. */
 struct sms_data {
 	char *alpha;
 	u16_t length;
 	char *pdu;
+	/** Decoded PDU, or NULL if the PDU could not be decoded. */
+	struct sms_deliver *deliver;
 };
 
 /** @brief SMS listener callback function. */
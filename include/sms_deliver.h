@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef SMS_DELIVER_H_
+#define SMS_DELIVER_H_
+
+/**
+ * @file sms_deliver.h
+ *
+ * @defgroup sms_deliver SMS-DELIVER PDU decoder
+ *
+ * @{
+ *
+ * @brief Decoder for SMS-DELIVER PDUs as received in +CMT notifications.
+ *
+ * The decoder reads the hexadecimal PDU string in place and writes the
+ * result into caller-provided structures. It does not allocate memory.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @brief Maximum number of user data septets in one SMS. */
+#define SMS_DELIVER_UD_SEPTETS_MAX 160
+
+/** @brief Maximum length of the decoded text of one SMS, in UTF-8 bytes.
+ *	   Each GSM 7-bit character is at most 3 bytes in UTF-8.
+ */
+#define SMS_DELIVER_TEXT_MAX_LEN (3 * SMS_DELIVER_UD_SEPTETS_MAX)
+
+/** @brief Maximum length of the decoded originating address. */
+#define SMS_DELIVER_ADDRESS_MAX_LEN 32
+
+/** @brief Character set of the user data, from TP-DCS. */
+enum sms_deliver_alphabet {
+	SMS_DELIVER_ALPHABET_GSM7,
+	SMS_DELIVER_ALPHABET_8BIT,
+	SMS_DELIVER_ALPHABET_UCS2,
+};
+
+/** @brief Service centre time stamp, TP-SCTS. */
+struct sms_deliver_time {
+	/** Year, two least significant digits. */
+	u8_t year;
+	u8_t month;
+	u8_t day;
+	u8_t hour;
+	u8_t minute;
+	u8_t second;
+	/** Difference to GMT in quarters of an hour. */
+	s8_t timezone;
+};
+
+/** @brief Concatenated SMS information from the user data header. */
+struct sms_deliver_concat {
+	/** Whether the message is part of a concatenated SMS. */
+	bool present;
+	/** Concatenated SMS reference number. */
+	u16_t ref;
+	/** Total number of parts. */
+	u8_t total;
+	/** Sequence number of this part, starting from 1. */
+	u8_t seq;
+};
+
+/** @brief Decoded SMS-DELIVER PDU. */
+struct sms_deliver {
+	/** Originating address as a null-terminated UTF-8 string. */
+	char address[SMS_DELIVER_ADDRESS_MAX_LEN + 1];
+	/** Protocol identifier, TP-PID. */
+	u8_t pid;
+	/** Data coding scheme, TP-DCS. */
+	u8_t dcs;
+	/** Character set of the user data. */
+	enum sms_deliver_alphabet alphabet;
+	/** Service centre time stamp. */
+	struct sms_deliver_time time;
+	/** Concatenated SMS information. */
+	struct sms_deliver_concat concat;
+	/** User data. Null-terminated UTF-8 text for the GSM 7-bit and UCS2
+	 *  alphabets, raw octets for the 8-bit alphabet.
+	 */
+	u8_t text[SMS_DELIVER_TEXT_MAX_LEN + 1];
+	/** Length of @ref text in bytes, excluding the null terminator. */
+	u16_t text_len;
+};
+
+/** @brief Reassembly state for concatenated SMS. */
+struct sms_deliver_reassembly {
+	/** Reference number of the message being reassembled. */
+	u16_t ref;
+	/** Total number of parts of the message being reassembled. */
+	u8_t total;
+	/** Number of parts received so far. */
+	u8_t received;
+	/** Bitmask of the received parts, bit 0 is the first part. */
+	u32_t received_mask;
+	/** Length of each received part. */
+	u16_t part_len[CONFIG_SMS_DELIVER_CONCAT_MAX_PARTS];
+	/** Text of each received part. */
+	u8_t part[CONFIG_SMS_DELIVER_CONCAT_MAX_PARTS]
+		 [SMS_DELIVER_TEXT_MAX_LEN];
+};
+
+/**
+ * @brief Decode an SMS-DELIVER PDU.
+ *
+ * @param pdu Hexadecimal PDU string, including the SMSC address.
+ * @param pdu_len Length of @p pdu in characters.
+ * @param out Pointer to the structure the decoded PDU is written to.
+ *
+ * @retval 0 On success.
+ * @retval -EINVAL Malformed PDU or invalid parameters.
+ * @retval -ENOTSUP The PDU is not an SMS-DELIVER, or uses compression.
+ */
+int sms_deliver_decode(const char *pdu, size_t pdu_len,
+		       struct sms_deliver *out);
+
+/**
+ * @brief Reset the reassembly state.
+ *
+ * @param ctx Pointer to the reassembly state.
+ */
+void sms_deliver_reassembly_reset(struct sms_deliver_reassembly *ctx);
+
+/**
+ * @brief Add a decoded part of a concatenated SMS to the reassembly state.
+ *
+ * A part with a reference number different from the message being
+ * reassembled discards the previously received parts.
+ *
+ * @param ctx Pointer to the reassembly state.
+ * @param part Pointer to the decoded part.
+ *
+ * @retval 1 The message is complete and can be read with
+ *	     sms_deliver_reassembly_get().
+ * @retval 0 More parts are needed.
+ * @retval -EINVAL The part is not part of a concatenated SMS.
+ * @retval -ENOMEM The message has more parts than can be stored.
+ */
+int sms_deliver_reassembly_add(struct sms_deliver_reassembly *ctx,
+			       const struct sms_deliver *part);
+
+/**
+ * @brief Get the text of a completely reassembled SMS.
+ *
+ * The reassembly state is reset afterwards.
+ *
+ * @param ctx Pointer to the reassembly state.
+ * @param buf Buffer the text is written to, null-terminated.
+ * @param buf_len Size of @p buf.
+ *
+ * @return Length of the text on success, or a negative error code.
+ * @retval -EAGAIN The message is not complete.
+ * @retval -ENOMEM The buffer is too small.
+ */
+int sms_deliver_reassembly_get(struct sms_deliver_reassembly *ctx,
+			       u8_t *buf, size_t buf_len);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SMS_DELIVER_H_ */
@@ -127,6 +127,11 @@ static int z_to_nrf_optname(int z_in_level, int z_in_optname,
 		case TLS_DTLS_ROLE:
 			*nrf_out_optname = NRF_SO_SEC_ROLE;
 			break;
+#if defined(TLS_SESSION_CACHE) && defined(NRF_SO_SEC_SESSION_CACHE)
+		case TLS_SESSION_CACHE:
+			*nrf_out_optname = NRF_SO_SEC_SESSION_CACHE;
+			break;
+#endif
 		default:
 			retval = -1;
 			break;
@@ -483,6 +488,21 @@ static int nrf91_socket_offload_socket(int family, int type, int proto)
 
 	retval = nrf_socket(family, type, proto);
 
+#if defined(CONFIG_BSD_LIBRARY_TLS_SESSION_CACHE) && \
+	defined(NRF_SO_SEC_SESSION_CACHE)
+	/* Libraries such as MQTT create and connect the socket in one call,
+	 * so the session cache is enabled here, before the handshake.
+	 * Failure is not fatal, the handshake is then a full one.
+	 */
+	if ((retval >= 0) && (proto == NRF_SPROTO_TLS1v2)) {
+		int session_cache = 1;
+
+		(void)nrf_setsockopt(retval, NRF_SOL_SECURE,
+				     NRF_SO_SEC_SESSION_CACHE,
+				     &session_cache, sizeof(session_cache));
+	}
+#endif
+
 	return retval;
 }
 
@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr.h>
+#include <cbor_writer.h>
+
+BUILD_ASSERT_MSG(CBOR_WRITER_MAX_DEPTH < 32,
+		 "Nesting depth must fit in the container bit mask");
+
+#define MAJOR_UINT 0
+#define MAJOR_NINT 1
+#define MAJOR_TEXT 3
+#define MAJOR_ARRAY 4
+#define MAJOR_MAP 5
+#define MAJOR_SIMPLE 7
+
+#define INFO_INDEFINITE 31
+#define SIMPLE_FALSE 20
+#define SIMPLE_TRUE 21
+#define SIMPLE_NULL 22
+#define SIMPLE_HALF 25
+#define SIMPLE_FLOAT 26
+#define SIMPLE_DOUBLE 27
+#define BREAK 0xff
+
+/* Containers with fewer values than this get a one-byte definite header */
+#define DEFINITE_MAX 23
+
+static void out(struct cbor_writer *w, const void *data, size_t len)
+{
+	if ((w->buf != NULL) && (w->len < w->size)) {
+		memcpy(&w->buf[w->len], data, MIN(len, w->size - w->len));
+	}
+
+	w->len += len;
+}
+
+static void out_byte(struct cbor_writer *w, u8_t byte)
+{
+	out(w, &byte, 1);
+}
+
+/* Writes an unsigned integer in big-endian order */
+static void out_be(struct cbor_writer *w, u64_t value, size_t len)
+{
+	u8_t bytes[8];
+
+	for (size_t i = len; i > 0; i--) {
+		bytes[i - 1] = value;
+		value >>= 8;
+	}
+
+	out(w, bytes, len);
+}
+
+/* Writes the initial byte of a data item and its argument */
+static void out_head(struct cbor_writer *w, u8_t major, u64_t arg)
+{
+	major <<= 5;
+
+	if (arg < 24) {
+		out_byte(w, major | arg);
+	} else if (arg <= UINT8_MAX) {
+		out_byte(w, major | 24);
+		out_be(w, arg, 1);
+	} else if (arg <= UINT16_MAX) {
+		out_byte(w, major | 25);
+		out_be(w, arg, 2);
+	} else if (arg <= UINT32_MAX) {
+		out_byte(w, major | 26);
+		out_be(w, arg, 4);
+	} else {
+		out_byte(w, major | 27);
+		out_be(w, arg, 8);
+	}
+}
+
+static void out_str(struct cbor_writer *w, const char *str, size_t len)
+{
+	out_head(w, MAJOR_TEXT, len);
+	out(w, str, len);
+}
+
+static bool in_map(const struct cbor_writer *w)
+{
+	return (w->depth > 0) && (w->maps & BIT(w->depth));
+}
+
+/**@brief Check the key and write it before a value. */
+static int value_start(struct cbor_writer *w, const char *key)
+{
+	if (w->err) {
+		return w->err;
+	}
+
+	if ((key != NULL) != in_map(w)) {
+		w->err = -EINVAL;
+		return w->err;
+	}
+
+	/* There can only be one value at the top level */
+	if ((w->depth == 0) && (w->count[0] > 0)) {
+		w->err = -EINVAL;
+		return w->err;
+	}
+
+	if (w->count[w->depth] <= DEFINITE_MAX) {
+		w->count[w->depth]++;
+	}
+
+	if (key != NULL) {
+		out_str(w, key, strlen(key));
+	}
+
+	return 0;
+}
+
+static int container_start(struct cbor_writer *w, const char *key, bool map)
+{
+	int err = value_start(w, key);
+
+	if (err) {
+		return err;
+	}
+
+	if (w->depth == CBOR_WRITER_MAX_DEPTH) {
+		w->err = -E2BIG;
+		return w->err;
+	}
+
+	w->depth++;
+	w->count[w->depth] = 0;
+	w->start[w->depth] = w->len;
+
+	if (map) {
+		w->maps |= BIT(w->depth);
+	} else {
+		w->maps &= ~BIT(w->depth);
+	}
+
+	/* The length is not known yet. The header is rewritten with the
+	 * definite length when the container ends, if it is small enough.
+	 */
+	out_byte(w, ((map ? MAJOR_MAP : MAJOR_ARRAY) << 5) | INFO_INDEFINITE);
+
+	return 0;
+}
+
+static int container_end(struct cbor_writer *w, bool map)
+{
+	u8_t count;
+	size_t start;
+
+	if (w->err) {
+		return w->err;
+	}
+
+	if ((w->depth == 0) || (in_map(w) != map)) {
+		w->err = -EINVAL;
+		return w->err;
+	}
+
+	count = w->count[w->depth];
+	start = w->start[w->depth];
+	w->depth--;
+
+	if (count > DEFINITE_MAX) {
+		out_byte(w, BREAK);
+		return 0;
+	}
+
+	if ((w->buf != NULL) && (start < w->size)) {
+		w->buf[start] = ((map ? MAJOR_MAP : MAJOR_ARRAY) << 5) | count;
+	}
+
+	return 0;
+}
+
+void cbor_writer_init(struct cbor_writer *w, u8_t *buf, size_t size)
+{
+	memset(w, 0, sizeof(*w));
+	w->buf = buf;
+	w->size = (buf != NULL) ? size : 0;
+}
+
+int cbor_writer_map_start(struct cbor_writer *w, const char *key)
+{
+	return container_start(w, key, true);
+}
+
+int cbor_writer_map_end(struct cbor_writer *w)
+{
+	return container_end(w, true);
+}
+
+int cbor_writer_arr_start(struct cbor_writer *w, const char *key)
+{
+	return container_start(w, key, false);
+}
+
+int cbor_writer_arr_end(struct cbor_writer *w)
+{
+	return container_end(w, false);
+}
+
+int cbor_writer_str(struct cbor_writer *w, const char *key, const char *str)
+{
+	return cbor_writer_strn(w, key, str, strlen(str));
+}
+
+int cbor_writer_strn(struct cbor_writer *w, const char *key, const char *str,
+		     size_t len)
+{
+	int err = value_start(w, key);
+
+	if (err) {
+		return err;
+	}
+
+	out_str(w, str, len);
+
+	return 0;
+}
+
+static void out_int(struct cbor_writer *w, s64_t value)
+{
+	if (value < 0) {
+		/* -1 - value, without overflow for the smallest value */
+		out_head(w, MAJOR_NINT, ~(u64_t)value);
+	} else {
+		out_head(w, MAJOR_UINT, value);
+	}
+}
+
+int cbor_writer_int(struct cbor_writer *w, const char *key, s64_t value)
+{
+	int err = value_start(w, key);
+
+	if (err) {
+		return err;
+	}
+
+	out_int(w, value);
+
+	return 0;
+}
+
+/* Returns true if the single precision value fits exactly in half
+ * precision, and the half precision bits in half.
+ */
+static bool float_to_half(u32_t bits, u16_t *half)
+{
+	u16_t sign = (bits >> 16) & 0x8000;
+	int exp = (int)((bits >> 23) & 0xff) - 127;
+	u32_t mant = bits & 0x7fffff;
+
+	if ((bits & 0x7fffffff) == 0) {
+		*half = sign;
+		return true;
+	}
+
+	if ((exp >= -14) && (exp <= 15)) {
+		if (mant & 0x1fff) {
+			return false;
+		}
+
+		*half = sign | ((exp + 15) << 10) | (mant >> 13);
+		return true;
+	}
+
+	if ((exp >= -24) && (exp < -14)) {
+		/* Subnormal in half precision */
+		u32_t shift = -(exp + 1);
+
+		mant |= 0x800000;
+		if (mant & ((1 << shift) - 1)) {
+			return false;
+		}
+
+		*half = sign | (mant >> shift);
+		return true;
+	}
+
+	return false;
+}
+
+int cbor_writer_double(struct cbor_writer *w, const char *key, double value)
+{
+	union {
+		float f;
+		u32_t u;
+	} single;
+	union {
+		double d;
+		u64_t u;
+	} dbl;
+	u16_t half;
+	int err = value_start(w, key);
+
+	if (err) {
+		return err;
+	}
+
+	/* NaN and infinity */
+	if ((value * 0) != 0) {
+		out_head(w, MAJOR_SIMPLE, SIMPLE_NULL);
+		return 0;
+	}
+
+	if ((value >= -9.2e18) && (value <= 9.2e18) &&
+	    ((double)(s64_t)value == value)) {
+		out_int(w, (s64_t)value);
+		return 0;
+	}
+
+	single.f = value;
+	if ((double)single.f == value) {
+		if (float_to_half(single.u, &half)) {
+			out_byte(w, (MAJOR_SIMPLE << 5) | SIMPLE_HALF);
+			out_be(w, half, 2);
+		} else {
+			out_byte(w, (MAJOR_SIMPLE << 5) | SIMPLE_FLOAT);
+			out_be(w, single.u, 4);
+		}
+
+		return 0;
+	}
+
+	dbl.d = value;
+	out_byte(w, (MAJOR_SIMPLE << 5) | SIMPLE_DOUBLE);
+	out_be(w, dbl.u, 8);
+
+	return 0;
+}
+
+int cbor_writer_bool(struct cbor_writer *w, const char *key, bool value)
+{
+	int err = value_start(w, key);
+
+	if (err) {
+		return err;
+	}
+
+	out_head(w, MAJOR_SIMPLE, value ? SIMPLE_TRUE : SIMPLE_FALSE);
+
+	return 0;
+}
+
+int cbor_writer_null(struct cbor_writer *w, const char *key)
+{
+	int err = value_start(w, key);
+
+	if (err) {
+		return err;
+	}
+
+	out_head(w, MAJOR_SIMPLE, SIMPLE_NULL);
+
+	return 0;
+}
+
+int cbor_writer_finish(struct cbor_writer *w)
+{
+	if (w->err) {
+		return w->err;
+	}
+
+	if ((w->depth != 0) || (w->count[0] == 0)) {
+		return -EINVAL;
+	}
+
+	if ((w->buf != NULL) && (w->len > w->size)) {
+		return -ENOMEM;
+	}
+
+	return w->len;
+}
@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr.h>
+#include <json_tokenizer.h>
+
+#define MAJOR_UINT 0
+#define MAJOR_NINT 1
+#define MAJOR_BYTES 2
+#define MAJOR_TEXT 3
+#define MAJOR_ARRAY 4
+#define MAJOR_MAP 5
+#define MAJOR_TAG 6
+#define MAJOR_SIMPLE 7
+
+#define INFO_INDEFINITE 31
+#define SIMPLE_FALSE 20
+#define SIMPLE_TRUE 21
+#define SIMPLE_NULL 22
+#define SIMPLE_UNDEFINED 23
+#define SIMPLE_HALF 25
+#define SIMPLE_FLOAT 26
+#define SIMPLE_DOUBLE 27
+#define BREAK 0xff
+
+/* While a container is open, its end holds the number of data items that
+ * are left in it, or this value if its length is indefinite.
+ */
+#define REMAINING_INDEFINITE 0xFFFF
+
+/* Parses the initial byte of the data item at pos and its argument, and
+ * returns the length of both.
+ */
+static int head_parse(const u8_t *cbor, size_t len, size_t pos, u8_t *major,
+		      u64_t *arg)
+{
+	u8_t info = cbor[pos] & 0x1f;
+	size_t n;
+
+	*major = cbor[pos] >> 5;
+
+	if (info < 24) {
+		*arg = info;
+		return 1;
+	} else if (info == INFO_INDEFINITE) {
+		*arg = 0;
+		return ((*major == MAJOR_ARRAY) || (*major == MAJOR_MAP)) ?
+		       1 : -EINVAL;
+	} else if (info > 27) {
+		return -EINVAL;
+	}
+
+	n = 1 << (info - 24);
+	if (n >= len - pos) {
+		return -EINVAL;
+	}
+
+	*arg = 0;
+	for (size_t i = 1; i <= n; i++) {
+		*arg = (*arg << 8) | cbor[pos + i];
+	}
+
+	return n + 1;
+}
+
+int json_tokenize_cbor(const u8_t *cbor, size_t len, struct json_tok *toks,
+		       size_t num_toks)
+{
+	/* Set after a key, until the value of the key starts */
+	bool value_pending = false;
+	bool tagged = false;
+	int parent = -1;
+	size_t count = 0;
+	size_t pos = 0;
+
+	if ((cbor == NULL) || (toks == NULL)) {
+		return -EINVAL;
+	}
+
+	if (len > JSON_TOK_MAX_LEN) {
+		return -E2BIG;
+	}
+
+	for (;;) {
+		struct json_tok *tok;
+		bool key;
+		u8_t major;
+		u64_t arg;
+		int n;
+
+		/* Close the containers that have all their items */
+		while ((parent >= 0) && (toks[parent].end == 0)) {
+			tok = &toks[parent];
+			tok->end = pos;
+			parent = tok->next - 1;
+			tok->next = count;
+		}
+
+		if ((parent < 0) && (count > 0)) {
+			break;
+		}
+
+		if (pos >= len) {
+			return -EINVAL;
+		}
+
+		if (cbor[pos] == BREAK) {
+			if ((parent < 0) ||
+			    (toks[parent].end != REMAINING_INDEFINITE) ||
+			    value_pending || tagged) {
+				return -EINVAL;
+			}
+
+			toks[parent].end = 0;
+			pos++;
+			continue;
+		}
+
+		n = head_parse(cbor, len, pos, &major, &arg);
+		if (n < 0) {
+			return n;
+		}
+
+		/* Tags only add meaning to the item that follows */
+		if (major == MAJOR_TAG) {
+			tagged = true;
+			pos += n;
+			continue;
+		}
+
+		key = (parent >= 0) && !value_pending &&
+		      (toks[parent].type == JSON_TOK_OBJECT);
+		if (key && (major != MAJOR_TEXT)) {
+			return -EINVAL;
+		}
+
+		if (count == num_toks) {
+			return -ENOMEM;
+		}
+
+		tok = &toks[count];
+		tok->size = 0;
+		tok->start = pos;
+		tok->end = pos + n;
+
+		if (parent >= 0) {
+			if (toks[parent].end != REMAINING_INDEFINITE) {
+				toks[parent].end--;
+			}
+
+			/* Keys count as the values of an object, the values
+			 * after them do not.
+			 */
+			if (key || (toks[parent].type == JSON_TOK_ARRAY)) {
+				toks[parent].size++;
+			}
+		}
+
+		value_pending = key;
+		tagged = false;
+
+		switch (major) {
+		case MAJOR_UINT:
+		case MAJOR_NINT:
+			tok->type = JSON_TOK_NUMBER;
+			break;
+		case MAJOR_BYTES:
+		case MAJOR_TEXT:
+			if (arg > len - pos - n) {
+				return -EINVAL;
+			}
+
+			/* Strings refer to their content, like in JSON */
+			tok->type = JSON_TOK_STRING;
+			tok->start = pos + n;
+			tok->end = pos + n + arg;
+			n += arg;
+			break;
+		case MAJOR_ARRAY:
+		case MAJOR_MAP:
+			tok->type = (major == MAJOR_MAP) ? JSON_TOK_OBJECT :
+							   JSON_TOK_ARRAY;
+
+			if ((cbor[pos] & 0x1f) == INFO_INDEFINITE) {
+				tok->end = REMAINING_INDEFINITE;
+			} else {
+				/* Every item takes at least one byte */
+				if (major == MAJOR_MAP) {
+					arg = (arg > len) ? arg : arg * 2;
+				}
+
+				if (arg > len - pos - n) {
+					return -EINVAL;
+				}
+
+				tok->end = arg;
+			}
+
+			/* While a container is open, next holds the index of
+			 * its parent plus one.
+			 */
+			tok->next = parent + 1;
+			parent = count++;
+			pos += n;
+			continue;
+		case MAJOR_SIMPLE:
+			switch (cbor[pos] & 0x1f) {
+			case SIMPLE_FALSE:
+				tok->type = JSON_TOK_FALSE;
+				break;
+			case SIMPLE_TRUE:
+				tok->type = JSON_TOK_TRUE;
+				break;
+			case SIMPLE_NULL:
+			case SIMPLE_UNDEFINED:
+				tok->type = JSON_TOK_NULL;
+				break;
+			case SIMPLE_HALF:
+			case SIMPLE_FLOAT:
+			case SIMPLE_DOUBLE:
+				tok->type = JSON_TOK_NUMBER;
+				break;
+			default:
+				return -EINVAL;
+			}
+			break;
+		}
+
+		tok->next = ++count;
+		pos += n;
+	}
+
+	if (pos != len) {
+		return -EINVAL;
+	}
+
+	return count;
+}
+
+static double half_to_double(u16_t half)
+{
+	union {
+		float f;
+		u32_t u;
+	} single;
+	u32_t sign = (u32_t)(half & 0x8000) << 16;
+	u32_t exp = (half >> 10) & 0x1f;
+	u32_t mant = half & 0x3ff;
+
+	if (exp == 0) {
+		/* Zero or subnormal, mant * 2^-24 */
+		double value = mant / 16777216.0;
+
+		return sign ? -value : value;
+	}
+
+	if (exp == 0x1f) {
+		single.u = sign | 0x7f800000 | (mant << 13);
+	} else {
+		single.u = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+	}
+
+	return single.f;
+}
+
+int json_tok_cbor_double(const u8_t *cbor, const struct json_tok *tok,
+			 double *value)
+{
+	union {
+		float f;
+		u32_t u;
+	} single;
+	union {
+		double d;
+		u64_t u;
+	} dbl;
+	u8_t major;
+	u64_t arg;
+	int n;
+
+	if (tok->type != JSON_TOK_NUMBER) {
+		return -EINVAL;
+	}
+
+	n = head_parse(cbor, tok->end, tok->start, &major, &arg);
+	if (n < 0) {
+		return n;
+	}
+
+	switch (major) {
+	case MAJOR_UINT:
+		*value = arg;
+		break;
+	case MAJOR_NINT:
+		*value = -1.0 - arg;
+		break;
+	default:
+		switch (cbor[tok->start] & 0x1f) {
+		case SIMPLE_HALF:
+			*value = half_to_double(arg);
+			break;
+		case SIMPLE_FLOAT:
+			single.u = arg;
+			*value = single.f;
+			break;
+		default:
+			dbl.u = arg;
+			*value = dbl.d;
+			break;
+		}
+		break;
+	}
+
+	return 0;
+}
+
+int json_tok_cbor_str_copy(const u8_t *cbor, const struct json_tok *tok,
+			   char *buf, size_t size)
+{
+	size_t len = tok->end - tok->start;
+
+	if (tok->type != JSON_TOK_STRING) {
+		return -EINVAL;
+	}
+
+	if (len >= size) {
+		return -ENOMEM;
+	}
+
+	memcpy(buf, &cbor[tok->start], len);
+	buf[len] = '\0';
+
+	return len;
+}
@@ -0,0 +1,561 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr.h>
+#include <json_tokenizer.h>
+
+/* Longest number that is read, longer numbers are not expected */
+#define NUMBER_MAX_LEN 31
+
+enum expect {
+	EXPECT_VALUE,
+	EXPECT_VALUE_OR_END,
+	EXPECT_KEY,
+	EXPECT_KEY_OR_END,
+	EXPECT_COLON,
+	EXPECT_COMMA_OR_END,
+	EXPECT_NOTHING,
+};
+
+static bool is_digit(char c)
+{
+	return (c >= '0') && (c <= '9');
+}
+
+static int hex_value(char c)
+{
+	if (is_digit(c)) {
+		return c - '0';
+	} else if ((c >= 'a') && (c <= 'f')) {
+		return c - 'a' + 10;
+	} else if ((c >= 'A') && (c <= 'F')) {
+		return c - 'A' + 10;
+	}
+
+	return -EINVAL;
+}
+
+static int hex4(const char *str, size_t len)
+{
+	int value = 0;
+
+	if (len < 4) {
+		return -EINVAL;
+	}
+
+	for (int i = 0; i < 4; i++) {
+		int digit = hex_value(str[i]);
+
+		if (digit < 0) {
+			return digit;
+		}
+
+		value = (value << 4) | digit;
+	}
+
+	return value;
+}
+
+/* Returns the length of the string at pos, which is just after the opening
+ * quote, up to the closing quote.
+ */
+static int string_parse(const char *json, size_t len, size_t pos)
+{
+	size_t start = pos;
+
+	while (pos < len) {
+		u8_t c = json[pos];
+
+		if (c == '"') {
+			return pos - start;
+		} else if (c < ' ') {
+			return -EINVAL;
+		} else if (c != '\\') {
+			pos++;
+			continue;
+		}
+
+		if (++pos == len) {
+			return -EINVAL;
+		}
+
+		switch (json[pos]) {
+		case '"':
+		case '\\':
+		case '/':
+		case 'b':
+		case 'f':
+		case 'n':
+		case 'r':
+		case 't':
+			pos++;
+			break;
+		case 'u':
+			if (hex4(&json[pos + 1], len - pos - 1) < 0) {
+				return -EINVAL;
+			}
+			pos += 5;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static size_t digits(const char *json, size_t len, size_t pos)
+{
+	size_t start = pos;
+
+	while ((pos < len) && is_digit(json[pos])) {
+		pos++;
+	}
+
+	return pos - start;
+}
+
+/* Returns the length of the number at pos */
+static int number_parse(const char *json, size_t len, size_t pos)
+{
+	size_t start = pos;
+	size_t n;
+
+	if ((pos < len) && (json[pos] == '-')) {
+		pos++;
+	}
+
+	n = digits(json, len, pos);
+	if ((n == 0) || ((n > 1) && (json[pos] == '0'))) {
+		return -EINVAL;
+	}
+	pos += n;
+
+	if ((pos < len) && (json[pos] == '.')) {
+		n = digits(json, len, ++pos);
+		if (n == 0) {
+			return -EINVAL;
+		}
+		pos += n;
+	}
+
+	if ((pos < len) && ((json[pos] == 'e') || (json[pos] == 'E'))) {
+		pos++;
+		if ((pos < len) && ((json[pos] == '+') || (json[pos] == '-'))) {
+			pos++;
+		}
+
+		n = digits(json, len, pos);
+		if (n == 0) {
+			return -EINVAL;
+		}
+		pos += n;
+	}
+
+	return pos - start;
+}
+
+/* Returns the length of the number or literal at pos */
+static int primitive_parse(const char *json, size_t len, size_t pos,
+			   u8_t *type)
+{
+	static const struct {
+		const char *text;
+		u8_t type;
+	} literals[] = {
+		{ "true", JSON_TOK_TRUE },
+		{ "false", JSON_TOK_FALSE },
+		{ "null", JSON_TOK_NULL },
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(literals); i++) {
+		size_t n = strlen(literals[i].text);
+
+		if ((len - pos >= n) &&
+		    (memcmp(&json[pos], literals[i].text, n) == 0)) {
+			*type = literals[i].type;
+			return n;
+		}
+	}
+
+	*type = JSON_TOK_NUMBER;
+
+	return number_parse(json, len, pos);
+}
+
+int json_tokenize(const char *json, size_t len, struct json_tok *toks,
+		  size_t num_toks)
+{
+	const char *nul;
+	enum expect expect = EXPECT_VALUE;
+	int parent = -1;
+	size_t count = 0;
+	size_t pos = 0;
+
+	if ((json == NULL) || (toks == NULL)) {
+		return -EINVAL;
+	}
+
+	nul = memchr(json, '\0', len);
+	if (nul != NULL) {
+		len = nul - json;
+	}
+
+	if (len > JSON_TOK_MAX_LEN) {
+		return -E2BIG;
+	}
+
+	while (pos < len) {
+		struct json_tok *tok;
+		char c = json[pos];
+		bool key = false;
+		int n;
+
+		switch (c) {
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+			pos++;
+			continue;
+		case ':':
+			if (expect != EXPECT_COLON) {
+				return -EINVAL;
+			}
+			expect = EXPECT_VALUE;
+			pos++;
+			continue;
+		case ',':
+			if (expect != EXPECT_COMMA_OR_END) {
+				return -EINVAL;
+			}
+			expect = (toks[parent].type == JSON_TOK_OBJECT) ?
+				 EXPECT_KEY : EXPECT_VALUE;
+			pos++;
+			continue;
+		case '}':
+		case ']':
+			if ((parent < 0) ||
+			    (toks[parent].type !=
+			     ((c == '}') ? JSON_TOK_OBJECT : JSON_TOK_ARRAY)) ||
+			    ((expect != EXPECT_COMMA_OR_END) &&
+			     (expect != EXPECT_KEY_OR_END) &&
+			     (expect != EXPECT_VALUE_OR_END))) {
+				return -EINVAL;
+			}
+
+			/* While a container is open, next holds the index of
+			 * its parent plus one.
+			 */
+			tok = &toks[parent];
+			tok->end = pos + 1;
+			parent = tok->next - 1;
+			tok->next = count;
+
+			expect = (parent < 0) ? EXPECT_NOTHING :
+						EXPECT_COMMA_OR_END;
+			pos++;
+			continue;
+		case '"':
+			key = (expect == EXPECT_KEY) ||
+			      (expect == EXPECT_KEY_OR_END);
+			if (!key && (expect != EXPECT_VALUE) &&
+			    (expect != EXPECT_VALUE_OR_END)) {
+				return -EINVAL;
+			}
+			break;
+		default:
+			if ((expect != EXPECT_VALUE) &&
+			    (expect != EXPECT_VALUE_OR_END)) {
+				return -EINVAL;
+			}
+			break;
+		}
+
+		if (count == num_toks) {
+			return -ENOMEM;
+		}
+
+		tok = &toks[count];
+		tok->size = 0;
+
+		/* Keys count as the values of an object, the values after
+		 * them do not.
+		 */
+		if ((parent >= 0) &&
+		    (key || (toks[parent].type == JSON_TOK_ARRAY))) {
+			toks[parent].size++;
+		}
+
+		if ((c == '{') || (c == '[')) {
+			tok->type = (c == '{') ? JSON_TOK_OBJECT :
+						 JSON_TOK_ARRAY;
+			tok->start = pos;
+			tok->next = parent + 1;
+			parent = count++;
+			expect = (c == '{') ? EXPECT_KEY_OR_END :
+					      EXPECT_VALUE_OR_END;
+			pos++;
+			continue;
+		}
+
+		if (c == '"') {
+			n = string_parse(json, len, pos + 1);
+			if (n < 0) {
+				return n;
+			}
+
+			tok->type = JSON_TOK_STRING;
+			tok->start = pos + 1;
+			tok->end = pos + 1 + n;
+			pos += n + 2;
+		} else {
+			n = primitive_parse(json, len, pos, &tok->type);
+			if (n < 0) {
+				return n;
+			}
+
+			tok->start = pos;
+			tok->end = pos + n;
+			pos += n;
+		}
+
+		tok->next = ++count;
+
+		if (key) {
+			expect = EXPECT_COLON;
+		} else {
+			expect = (parent < 0) ? EXPECT_NOTHING :
+						EXPECT_COMMA_OR_END;
+		}
+	}
+
+	if (expect != EXPECT_NOTHING) {
+		return -EINVAL;
+	}
+
+	return count;
+}
+
+static int get(const char *json, const struct json_tok *toks, int obj,
+	       const char *key, size_t key_len)
+{
+	int i;
+
+	if ((obj < 0) || (toks[obj].type != JSON_TOK_OBJECT)) {
+		return -ENOENT;
+	}
+
+	i = obj + 1;
+
+	for (size_t n = 0; n < toks[obj].size; n++) {
+		const struct json_tok *k = &toks[i];
+
+		if ((k->end - k->start == key_len) &&
+		    (memcmp(&json[k->start], key, key_len) == 0)) {
+			return i + 1;
+		}
+
+		/* Skip the key and the value */
+		i = toks[i + 1].next;
+	}
+
+	return -ENOENT;
+}
+
+int json_tok_get(const char *json, const struct json_tok *toks, int obj,
+		 const char *key)
+{
+	return get(json, toks, obj, key, strlen(key));
+}
+
+int json_tok_find(const char *json, const struct json_tok *toks, int obj,
+		  const char *path)
+{
+	const char *dot;
+
+	if (obj < 0) {
+		return obj;
+	}
+
+	do {
+		dot = strchr(path, '.');
+		obj = get(json, toks, obj, path,
+			  dot ? dot - path : strlen(path));
+		path = dot + 1;
+	} while ((dot != NULL) && (obj >= 0));
+
+	return obj;
+}
+
+bool json_tok_str_eq(const char *json, const struct json_tok *tok,
+		     const char *str)
+{
+	size_t len = strlen(str);
+
+	return (tok->type == JSON_TOK_STRING) &&
+	       (tok->end - tok->start == len) &&
+	       (memcmp(&json[tok->start], str, len) == 0);
+}
+
+int json_tok_double(const char *json, const struct json_tok *tok,
+		    double *value)
+{
+	/* The document does not need to be NUL-terminated after the number */
+	char buf[NUMBER_MAX_LEN + 1];
+	size_t len = tok->end - tok->start;
+
+	if ((tok->type != JSON_TOK_NUMBER) || (len > NUMBER_MAX_LEN)) {
+		return -EINVAL;
+	}
+
+	memcpy(buf, &json[tok->start], len);
+	buf[len] = '\0';
+
+	*value = strtod(buf, NULL);
+
+	return 0;
+}
+
+static size_t utf8_encode(u32_t cp, char *out)
+{
+	if (cp < 0x80) {
+		out[0] = cp;
+		return 1;
+	} else if (cp < 0x800) {
+		out[0] = 0xC0 | (cp >> 6);
+		out[1] = 0x80 | (cp & 0x3F);
+		return 2;
+	} else if (cp < 0x10000) {
+		out[0] = 0xE0 | (cp >> 12);
+		out[1] = 0x80 | ((cp >> 6) & 0x3F);
+		out[2] = 0x80 | (cp & 0x3F);
+		return 3;
+	}
+
+	out[0] = 0xF0 | (cp >> 18);
+	out[1] = 0x80 | ((cp >> 12) & 0x3F);
+	out[2] = 0x80 | ((cp >> 6) & 0x3F);
+	out[3] = 0x80 | (cp & 0x3F);
+	return 4;
+}
+
+/* Unescapes a string that was validated by string_parse. The output is
+ * never longer than the input and is written in order, so dst may be the
+ * same as src.
+ */
+static int unescape(const char *src, size_t len, char *dst, size_t size)
+{
+	size_t out = 0;
+
+	for (size_t i = 0; i < len; ) {
+		char utf8[4];
+		size_t n = 1;
+		int cp;
+
+		if (src[i] != '\\') {
+			utf8[0] = src[i++];
+		} else {
+			switch (src[i + 1]) {
+			case 'b':
+				utf8[0] = '\b';
+				break;
+			case 'f':
+				utf8[0] = '\f';
+				break;
+			case 'n':
+				utf8[0] = '\n';
+				break;
+			case 'r':
+				utf8[0] = '\r';
+				break;
+			case 't':
+				utf8[0] = '\t';
+				break;
+			case 'u':
+				cp = hex4(&src[i + 2], len - i - 2);
+				i += 4;
+
+				/* Combine UTF-16 surrogate pairs */
+				if ((cp >= 0xDC00) && (cp <= 0xDFFF)) {
+					return -EINVAL;
+				} else if ((cp >= 0xD800) && (cp <= 0xDBFF)) {
+					int low;
+
+					if ((i + 8 > len) ||
+					    (src[i + 2] != '\\') ||
+					    (src[i + 3] != 'u')) {
+						return -EINVAL;
+					}
+
+					low = hex4(&src[i + 4], len - i - 4);
+					if ((low < 0xDC00) || (low > 0xDFFF)) {
+						return -EINVAL;
+					}
+
+					cp = 0x10000 + ((cp - 0xD800) << 10) +
+					     (low - 0xDC00);
+					i += 6;
+				}
+
+				n = utf8_encode(cp, utf8);
+				break;
+			default:
+				utf8[0] = src[i + 1];
+				break;
+			}
+
+			i += 2;
+		}
+
+		if (out + n >= size) {
+			return -ENOMEM;
+		}
+
+		memcpy(&dst[out], utf8, n);
+		out += n;
+	}
+
+	if (out >= size) {
+		return -ENOMEM;
+	}
+
+	dst[out] = '\0';
+
+	return out;
+}
+
+int json_tok_str_copy(const char *json, const struct json_tok *tok, char *buf,
+		      size_t size)
+{
+	if (tok->type != JSON_TOK_STRING) {
+		return -EINVAL;
+	}
+
+	return unescape(&json[tok->start], tok->end - tok->start, buf, size);
+}
+
+char *json_tok_str_get(char *json, struct json_tok *tok)
+{
+	int len;
+
+	if (tok->type != JSON_TOK_STRING) {
+		return NULL;
+	}
+
+	len = unescape(&json[tok->start], tok->end - tok->start,
+		       &json[tok->start], tok->end - tok->start + 1);
+	if (len < 0) {
+		return NULL;
+	}
+
+	tok->end = tok->start + len;
+
+	return &json[tok->start];
+}
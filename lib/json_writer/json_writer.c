@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr.h>
+#include <json_writer.h>
+
+BUILD_ASSERT_MSG(JSON_WRITER_MAX_DEPTH < 32,
+		 "Nesting depth must fit in the container bit masks");
+
+static void out(struct json_writer *w, const char *data, size_t len)
+{
+	if ((w->buf != NULL) && (w->len < w->size)) {
+		memcpy(&w->buf[w->len], data, MIN(len, w->size - w->len));
+	}
+
+	w->len += len;
+}
+
+static void out_char(struct json_writer *w, char c)
+{
+	if ((w->buf != NULL) && (w->len < w->size)) {
+		w->buf[w->len] = c;
+	}
+
+	w->len++;
+}
+
+static void out_str(struct json_writer *w, const char *str, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	size_t start = 0;
+	char esc[6] = { '\\', 'u', '0', '0' };
+
+	out_char(w, '"');
+
+	for (size_t i = 0; i < len; i++) {
+		u8_t c = str[i];
+
+		if ((c >= ' ') && (c != '"') && (c != '\\')) {
+			continue;
+		}
+
+		/* Write the characters that need no escaping in one go */
+		out(w, &str[start], i - start);
+		start = i + 1;
+
+		switch (c) {
+		case '"':
+		case '\\':
+			esc[1] = c;
+			break;
+		case '\b':
+			esc[1] = 'b';
+			break;
+		case '\f':
+			esc[1] = 'f';
+			break;
+		case '\n':
+			esc[1] = 'n';
+			break;
+		case '\r':
+			esc[1] = 'r';
+			break;
+		case '\t':
+			esc[1] = 't';
+			break;
+		default:
+			esc[1] = 'u';
+			esc[4] = hex[c >> 4];
+			esc[5] = hex[c & 0xf];
+			out(w, esc, sizeof(esc));
+			continue;
+		}
+
+		out(w, esc, 2);
+	}
+
+	out(w, &str[start], len - start);
+	out_char(w, '"');
+}
+
+static bool in_object(const struct json_writer *w)
+{
+	return (w->depth > 0) && (w->objects & BIT(w->depth));
+}
+
+/**@brief Write the separator and key that go before a value. */
+static int value_start(struct json_writer *w, const char *key)
+{
+	if (w->err) {
+		return w->err;
+	}
+
+	if ((key != NULL) != in_object(w)) {
+		w->err = -EINVAL;
+		return w->err;
+	}
+
+	if (w->has_values & BIT(w->depth)) {
+		if (w->depth == 0) {
+			/* There can only be one value at the top level */
+			w->err = -EINVAL;
+			return w->err;
+		}
+
+		out_char(w, ',');
+	}
+
+	w->has_values |= BIT(w->depth);
+
+	if (key != NULL) {
+		out_str(w, key, strlen(key));
+		out_char(w, ':');
+	}
+
+	return 0;
+}
+
+static int container_start(struct json_writer *w, const char *key,
+			   bool object)
+{
+	int err = value_start(w, key);
+
+	if (err) {
+		return err;
+	}
+
+	if (w->depth == JSON_WRITER_MAX_DEPTH) {
+		w->err = -E2BIG;
+		return w->err;
+	}
+
+	w->depth++;
+	w->has_values &= ~BIT(w->depth);
+
+	if (object) {
+		w->objects |= BIT(w->depth);
+	} else {
+		w->objects &= ~BIT(w->depth);
+	}
+
+	out_char(w, object ? '{' : '[');
+
+	return 0;
+}
+
+static int container_end(struct json_writer *w, bool object)
+{
+	if (w->err) {
+		return w->err;
+	}
+
+	if ((w->depth == 0) || (in_object(w) != object)) {
+		w->err = -EINVAL;
+		return w->err;
+	}
+
+	w->depth--;
+	out_char(w, object ? '}' : ']');
+
+	return 0;
+}
+
+void json_writer_init(struct json_writer *w, char *buf, size_t size)
+{
+	memset(w, 0, sizeof(*w));
+	w->buf = buf;
+	w->size = (buf != NULL) ? size : 0;
+}
+
+int json_writer_obj_start(struct json_writer *w, const char *key)
+{
+	return container_start(w, key, true);
+}
+
+int json_writer_obj_end(struct json_writer *w)
+{
+	return container_end(w, true);
+}
+
+int json_writer_arr_start(struct json_writer *w, const char *key)
+{
+	return container_start(w, key, false);
+}
+
+int json_writer_arr_end(struct json_writer *w)
+{
+	return container_end(w, false);
+}
+
+int json_writer_str(struct json_writer *w, const char *key, const char *str)
+{
+	return json_writer_strn(w, key, str, strlen(str));
+}
+
+int json_writer_strn(struct json_writer *w, const char *key, const char *str,
+		     size_t len)
+{
+	int err = value_start(w, key);
+
+	if (err) {
+		return err;
+	}
+
+	out_str(w, str, len);
+
+	return 0;
+}
+
+int json_writer_int(struct json_writer *w, const char *key, s64_t value)
+{
+	char digits[20];
+	size_t i = sizeof(digits);
+	u64_t u = (value < 0) ? -(u64_t)value : (u64_t)value;
+	int err = value_start(w, key);
+
+	if (err) {
+		return err;
+	}
+
+	do {
+		digits[--i] = '0' + (u % 10);
+		u /= 10;
+	} while (u > 0);
+
+	if (value < 0) {
+		out_char(w, '-');
+	}
+
+	out(w, &digits[i], sizeof(digits) - i);
+
+	return 0;
+}
+
+int json_writer_double(struct json_writer *w, const char *key, double value)
+{
+	char number[26];
+	int len;
+	int err = value_start(w, key);
+
+	if (err) {
+		return err;
+	}
+
+	/* NaN and infinity */
+	if ((value * 0) != 0) {
+		out(w, "null", 4);
+		return 0;
+	}
+
+	/* Use 15 digits unless more are needed to read back the same value */
+	len = snprintf(number, sizeof(number), "%1.15g", value);
+	if (strtod(number, NULL) != value) {
+		len = snprintf(number, sizeof(number), "%1.17g", value);
+	}
+
+	if ((len < 0) || ((size_t)len >= sizeof(number))) {
+		w->err = -EINVAL;
+		return w->err;
+	}
+
+	out(w, number, len);
+
+	return 0;
+}
+
+int json_writer_bool(struct json_writer *w, const char *key, bool value)
+{
+	int err = value_start(w, key);
+
+	if (err) {
+		return err;
+	}
+
+	if (value) {
+		out(w, "true", 4);
+	} else {
+		out(w, "false", 5);
+	}
+
+	return 0;
+}
+
+int json_writer_null(struct json_writer *w, const char *key)
+{
+	int err = value_start(w, key);
+
+	if (err) {
+		return err;
+	}
+
+	out(w, "null", 4);
+
+	return 0;
+}
+
+int json_writer_raw(struct json_writer *w, const char *key, const char *json,
+		    size_t len)
+{
+	int err = value_start(w, key);
+
+	if (err) {
+		return err;
+	}
+
+	out(w, json, len);
+
+	return 0;
+}
+
+int json_writer_finish(struct json_writer *w)
+{
+	if (w->err) {
+		return w->err;
+	}
+
+	if ((w->depth != 0) || !(w->has_values & BIT(0))) {
+		return -EINVAL;
+	}
+
+	if (w->buf == NULL) {
+		return w->len;
+	}
+
+	if (w->len >= w->size) {
+		return -ENOMEM;
+	}
+
+	w->buf[w->len] = '\0';
+
+	return w->len;
+}
@@ -16,6 +16,7 @@
 #include <at_cmd_parser/at_cmd_parser.h>
 #include <at_cmd_parser/at_params.h>
 #include <at_notif.h>
+#include <pdn_management.h>
 #include <logging/log.h>
 
 LOG_MODULE_REGISTER(lte_lc, CONFIG_LTE_LINK_CONTROL_LOG_LEVEL);
@@ -36,6 +37,11 @@ LOG_MODULE_REGISTER(lte_lc, CONFIG_LTE_LINK_CONTROL_LOG_LEVEL);
 #define AT_CEREG_READ_REG_STATUS_INDEX		2
 #define AT_CEREG_ACTIVE_TIME_INDEX		8
 #define AT_CEREG_TAU_INDEX			9
+/* The notification lacks the <n> parameter of the read response, so
+ * its timer indices are one less.
+ */
+#define AT_CEREG_NOTIF_ACTIVE_TIME_INDEX	7
+#define AT_CEREG_NOTIF_TAU_INDEX		8
 #define AT_CEREG_RESPONSE_MAX_LEN		80
 #define AT_XSYSTEMMODE_READ			"AT%XSYSTEMMODE?"
 #define AT_XSYSTEMMODE_RESPONSE_PREFIX		"%XSYSTEMMODE"
@@ -49,6 +55,20 @@ LOG_MODULE_REGISTER(lte_lc, CONFIG_LTE_LINK_CONTROL_LOG_LEVEL);
 /* Parameter values for AT+CEDRXS command. */
 #define AT_CEDRXS_ACTT_WB			4
 #define AT_CEDRXS_ACTT_NB			5
+#define AT_CSCON_1				"AT+CSCON=1"
+#define AT_CSCON_RESPONSE_PREFIX		"+CSCON"
+#define AT_CSCON_PARAMS_COUNT_MAX		4
+#define AT_CSCON_RRC_MODE_INDEX			1
+#define AT_CEDRXP_RESPONSE_PREFIX		"+CEDRXP"
+#define AT_CEDRXP_PARAMS_COUNT_MAX		5
+#define AT_CEDRXP_ACTT_INDEX			1
+#define AT_CEDRXP_NW_EDRX_INDEX			3
+#define AT_CEDRXP_NW_PTW_INDEX			4
+#define AT_NOTIF_PREFIX_MAX_LEN			sizeof(AT_CEDRXP_RESPONSE_PREFIX)
+#define PSM_PARAM_STR_LEN			8
+#define EDRX_PARAM_STR_LEN			4
+#define TIMER_UNIT_STR_LEN			3
+#define TIMER_VALUE_MAX				31
 
 /* Forward declarations */
 static int parse_nw_reg_status(const char *at_response,
@@ -56,6 +76,9 @@ static int parse_nw_reg_status(const char *at_response,
 			       size_t reg_status_index);
 static bool response_is_valid(const char *response, size_t response_len,
 			      const char *check);
+static int parse_psm_cfg(struct at_param_list *at_params,
+			 size_t tau_index, size_t active_time_index,
+			 struct lte_lc_psm_cfg *psm_cfg);
 
 /* Lookup table for T3324 timer used for PSM active time. Unit is seconds.
  * Ref: GPRS Timer 2 IE in 3GPP TS 24.008 Table 10.5.163/3GPP TS 24.008.
@@ -68,12 +91,31 @@ static const u32_t t3324_lookup[8] = {2, 60, 600, 60, 60, 60, 60, 0};
 static const u32_t t3412_lookup[8] = {600, 3600, 36000, 2, 30, 60,
 				      1152000, 0};
 
+/* Lookup tables for eDRX cycle length and paging time window.
+ * Unit is milliseconds. Index is the 4-bit value reported by the network.
+ * For NB-IoT, the reserved values 0, 1, 4, 6, 7 and 8 are interpreted as
+ * 0010, 20.48 seconds.
+ * Ref: 3GPP TS 24.008 Ch. 10.5.5.32 and 3GPP TS 27.007 Ch. 7.41.
+ */
+static const u32_t edrx_lookup_ltem[16] = {
+	5120, 10240, 20480, 40960, 61440, 81920, 102400, 122880,
+	143360, 163840, 327680, 655360, 1310720, 2621440, 2621440, 2621440
+};
+static const u32_t edrx_lookup_nbiot[16] = {
+	20480, 20480, 20480, 40960, 20480, 81920, 20480, 20480,
+	20480, 163840, 327680, 655360, 1310720, 2621440, 5242880, 10485760
+};
+static const u32_t ptw_unit_ltem = 1280;
+static const u32_t ptw_unit_nbiot = 2560;
+
 #if defined(CONFIG_BSD_LIBRARY_TRACE_ENABLED)
 /* Enable modem trace */
 static const char mdm_trace[] = "AT%XMODEMTRACE=1,2";
 #endif
 /* Subscribes to notifications with level 5 */
 static const char cereg_5_subscribe[] = AT_CEREG_5;
+/* Subscribes to RRC connection state notifications */
+static const char cscon_subscribe[] = AT_CSCON_1;
 
 #if defined(CONFIG_LTE_LOCK_BANDS)
 /* Lock LTE bands 3, 4, 13 and 20 (volatile setting) */
@@ -90,9 +132,10 @@ static const char unlock_plmn[] = "AT+COPS=0";
 #endif
 /* Request eDRX to be disabled */
 static const char edrx_disable[] = "AT+CEDRXS=3";
-/* Request modem to go to power saving mode */
-static const char psm_req[] = "AT+CPSMS=1,,,\""CONFIG_LTE_PSM_REQ_RPTAU
-			      "\",\""CONFIG_LTE_PSM_REQ_RAT"\"";
+/* Requested PSM and eDRX parameters, may be changed at runtime */
+static char psm_rptau[PSM_PARAM_STR_LEN + 1] = CONFIG_LTE_PSM_REQ_RPTAU;
+static char psm_rat[PSM_PARAM_STR_LEN + 1] = CONFIG_LTE_PSM_REQ_RAT;
+static char edrx_value[EDRX_PARAM_STR_LEN + 1] = CONFIG_LTE_EDRX_REQ_VALUE;
 
 /* Request PSM to be disabled */
 static const char psm_disable[] = "AT+CPSMS=";
@@ -125,7 +168,8 @@ static const char nw_mode_preferred[] = "AT%XSYSTEMMODE=1,0,1,0";
 static const char nw_mode_fallback[] = "AT%XSYSTEMMODE=0,1,1,0";
 #endif
 
-static struct k_sem link;
+static K_SEM_DEFINE(link, 0, 1);
+static lte_lc_evt_handler_t evt_handler;
 
 #if defined(CONFIG_LTE_PDP_CMD) && defined(CONFIG_LTE_PDP_CONTEXT)
 static const char cgdcont[] = "AT+CGDCONT="CONFIG_LTE_PDP_CONTEXT;
@@ -137,32 +181,238 @@ static const char cgauth[] = "AT+CGAUTH="CONFIG_LTE_PDN_AUTH;
 static const char legacy_pco[] = "AT%XEPCO=0";
 #endif
 
-void at_handler(void *context, const char *response)
+static void evt_send(const struct lte_lc_evt *const evt)
+{
+	lte_lc_evt_handler_t handler = evt_handler;
+
+	if (handler != NULL) {
+		handler(evt);
+	}
+}
+
+static void cereg_notif_handle(const char *response)
+{
+	int err;
+	bool registered;
+	struct lte_lc_evt evt;
+	struct at_param_list resp_list = {0};
+	static struct lte_lc_psm_cfg prev_psm_cfg = { .tau = -1,
+						      .active_time = -1 };
+
+	err = parse_nw_reg_status(response, &evt.nw_reg_status,
+				  AT_CEREG_REG_STATUS_INDEX);
+	if (err) {
+		LOG_ERR("Could not get network registration status");
+		return;
+	}
+
+	registered = (evt.nw_reg_status == LTE_LC_NW_REG_REGISTERED_HOME) ||
+		     (evt.nw_reg_status == LTE_LC_NW_REG_REGISTERED_ROAMING);
+	if (registered) {
+		k_sem_give(&link);
+	}
+
+	if (IS_ENABLED(CONFIG_PDN_MANAGER)) {
+		pdn_manager_nw_reg_update(registered);
+	}
+
+	evt.type = LTE_LC_EVT_NW_REG_STATUS;
+	evt_send(&evt);
+
+	if (evt_handler == NULL) {
+		return;
+	}
+
+	/* The PSM timers granted by the network are only present in the
+	 * notification when the device is registered.
+	 */
+	err = at_params_list_init(&resp_list, AT_CEREG_PARAMS_COUNT_MAX);
+	if (err) {
+		LOG_ERR("Could not init AT params list, error: %d", err);
+		return;
+	}
+
+	err = at_parser_max_params_from_str(response, NULL, &resp_list,
+					    AT_CEREG_PARAMS_COUNT_MAX);
+	if (err) {
+		goto clean_exit;
+	}
+
+	err = parse_psm_cfg(&resp_list, AT_CEREG_NOTIF_TAU_INDEX,
+			    AT_CEREG_NOTIF_ACTIVE_TIME_INDEX, &evt.psm_cfg);
+	if (err) {
+		goto clean_exit;
+	}
+
+	if ((evt.psm_cfg.tau == prev_psm_cfg.tau) &&
+	    (evt.psm_cfg.active_time == prev_psm_cfg.active_time)) {
+		goto clean_exit;
+	}
+
+	prev_psm_cfg = evt.psm_cfg;
+	evt.type = LTE_LC_EVT_PSM_UPDATE;
+	evt_send(&evt);
+
+clean_exit:
+	at_params_list_free(&resp_list);
+}
+
+static void cscon_notif_handle(struct at_param_list *resp_list)
+{
+	int err;
+	u32_t mode;
+	struct lte_lc_evt evt = {
+		.type = LTE_LC_EVT_RRC_UPDATE,
+	};
+
+	err = at_params_int_get(resp_list, AT_CSCON_RRC_MODE_INDEX, &mode);
+	if (err) {
+		LOG_ERR("Could not get RRC mode, error: %d", err);
+		return;
+	}
+
+	evt.rrc_mode = mode ? LTE_LC_RRC_MODE_CONNECTED : LTE_LC_RRC_MODE_IDLE;
+
+	LOG_DBG("RRC mode: %s", mode ? "Connected" : "Idle");
+
+	evt_send(&evt);
+}
+
+static void cedrxp_notif_handle(struct at_param_list *resp_list)
+{
+	int err;
+	u32_t actt;
+	char value_str[EDRX_PARAM_STR_LEN + 1] = {0};
+	size_t value_str_len = sizeof(value_str) - 1;
+	size_t index;
+	const u32_t *edrx_lookup;
+	u32_t ptw_unit;
+	struct lte_lc_evt evt = {
+		.type = LTE_LC_EVT_EDRX_UPDATE,
+	};
+
+	err = at_params_int_get(resp_list, AT_CEDRXP_ACTT_INDEX, &actt);
+	if (err) {
+		LOG_ERR("Could not get eDRX access technology, error: %d", err);
+		return;
+	}
+
+	switch (actt) {
+	case AT_CEDRXS_ACTT_WB:
+		evt.edrx_cfg.mode = LTE_LC_LTE_MODE_LTEM;
+		edrx_lookup = edrx_lookup_ltem;
+		ptw_unit = ptw_unit_ltem;
+		break;
+	case AT_CEDRXS_ACTT_NB:
+		evt.edrx_cfg.mode = LTE_LC_LTE_MODE_NBIOT;
+		edrx_lookup = edrx_lookup_nbiot;
+		ptw_unit = ptw_unit_nbiot;
+		break;
+	default:
+		/* eDRX is not in use */
+		evt.edrx_cfg.mode = LTE_LC_LTE_MODE_NONE;
+		evt_send(&evt);
+		return;
+	}
+
+	err = at_params_string_get(resp_list, AT_CEDRXP_NW_EDRX_INDEX,
+				   value_str, &value_str_len);
+	if (err) {
+		LOG_ERR("Could not get eDRX value, error: %d", err);
+		return;
+	}
+
+	value_str[value_str_len] = '\0';
+	index = strtoul(value_str, NULL, 2);
+	if (index >= ARRAY_SIZE(edrx_lookup_ltem)) {
+		LOG_ERR("Invalid eDRX value");
+		return;
+	}
+
+	evt.edrx_cfg.edrx = edrx_lookup[index];
+
+	value_str_len = sizeof(value_str) - 1;
+
+	err = at_params_string_get(resp_list, AT_CEDRXP_NW_PTW_INDEX,
+				   value_str, &value_str_len);
+	if (err) {
+		LOG_ERR("Could not get PTW value, error: %d", err);
+		return;
+	}
+
+	value_str[value_str_len] = '\0';
+	evt.edrx_cfg.ptw = (strtoul(value_str, NULL, 2) + 1) * ptw_unit;
+
+	LOG_DBG("eDRX: %d ms, PTW: %d ms", evt.edrx_cfg.edrx, evt.edrx_cfg.ptw);
+
+	evt_send(&evt);
+}
+
+static void at_handler(void *context, const char *response)
 {
 	ARG_UNUSED(context);
 
 	int err;
-	enum lte_lc_nw_reg_status status;
+	struct at_param_list resp_list = {0};
+	char response_prefix[AT_NOTIF_PREFIX_MAX_LEN] = {0};
+	size_t response_prefix_len = sizeof(response_prefix);
 
 	if (response == NULL) {
 		LOG_ERR("Response buffer is NULL-pointer");
 		return;
 	}
 
-	err = parse_nw_reg_status(response, &status, AT_CEREG_REG_STATUS_INDEX);
+	if (strncmp(response, AT_CEREG_RESPONSE_PREFIX,
+		    AT_CMD_SIZE(AT_CEREG_RESPONSE_PREFIX)) == 0) {
+		cereg_notif_handle(response);
+		return;
+	}
+
+	if ((evt_handler == NULL) ||
+	    ((strncmp(response, AT_CSCON_RESPONSE_PREFIX,
+		      AT_CMD_SIZE(AT_CSCON_RESPONSE_PREFIX)) != 0) &&
+	     (strncmp(response, AT_CEDRXP_RESPONSE_PREFIX,
+		      AT_CMD_SIZE(AT_CEDRXP_RESPONSE_PREFIX)) != 0))) {
+		/* Not a notification we are interested in. */
+		return;
+	}
+
+	err = at_params_list_init(&resp_list, AT_CEDRXP_PARAMS_COUNT_MAX);
 	if (err) {
-		LOG_ERR("Could not get network registration status");
+		LOG_ERR("Could not init AT params list, error: %d", err);
 		return;
 	}
 
-	if ((status == LTE_LC_NW_REG_REGISTERED_HOME) ||
-	    (status == LTE_LC_NW_REG_REGISTERED_ROAMING)) {
-		k_sem_give(&link);
+	err = at_parser_max_params_from_str(response, NULL, &resp_list,
+					    AT_CEDRXP_PARAMS_COUNT_MAX);
+	if (err) {
+		LOG_ERR("Could not parse notification, error: %d", err);
+		goto clean_exit;
 	}
+
+	err = at_params_string_get(&resp_list, AT_RESPONSE_PREFIX_INDEX,
+				   response_prefix, &response_prefix_len);
+	if (err) {
+		LOG_ERR("Could not get response prefix, error: %d", err);
+		goto clean_exit;
+	}
+
+	if (response_is_valid(response_prefix, response_prefix_len,
+			      AT_CSCON_RESPONSE_PREFIX)) {
+		cscon_notif_handle(&resp_list);
+	} else if (response_is_valid(response_prefix, response_prefix_len,
+				     AT_CEDRXP_RESPONSE_PREFIX)) {
+		cedrxp_notif_handle(&resp_list);
+	}
+
+clean_exit:
+	at_params_list_free(&resp_list);
 }
 
 static int w_lte_lc_init(void)
 {
+	int err;
+
 	if (at_cmd_write(nw_mode_preferred, NULL, 0, NULL) != 0) {
 		return -EIO;
 	}
@@ -182,6 +432,16 @@ static int w_lte_lc_init(void)
 		return -EIO;
 	}
 
+	if (at_cmd_write(cscon_subscribe, NULL, 0, NULL) != 0) {
+		return -EIO;
+	}
+
+	err = at_notif_register_handler(NULL, at_handler);
+	if (err) {
+		LOG_ERR("Can't register handler err=%d", err);
+		return err;
+	}
+
 #if defined(CONFIG_LTE_LOCK_BANDS)
 	/* Set LTE band lock (volatile setting).
 	 * Has to be done every time before activating the modem.
@@ -228,16 +488,16 @@ static int w_lte_lc_init(void)
 
 static int w_lte_lc_connect(void)
 {
-	int err, rc;
+	int err;
 	const char *current_network_mode = nw_mode_preferred;
 	bool retry;
 
-	k_sem_init(&link, 0, 1);
+	k_sem_reset(&link);
 
-	rc = at_notif_register_handler(NULL, at_handler);
-	if (rc != 0) {
-		LOG_ERR("Can't register handler rc=%d", rc);
-		return rc;
+	err = at_notif_register_handler(NULL, at_handler);
+	if (err) {
+		LOG_ERR("Can't register handler err=%d", err);
+		return err;
 	}
 
 	do {
@@ -246,13 +506,11 @@ static int w_lte_lc_connect(void)
 		LOG_DBG("Network mode: %s", log_strdup(current_network_mode));
 
 		if (at_cmd_write(current_network_mode, NULL, 0, NULL) != 0) {
-			err = -EIO;
-			goto exit;
+			return -EIO;
 		}
 
 		if (at_cmd_write(normal, NULL, 0, NULL) != 0) {
-			err = -EIO;
-			goto exit;
+			return -EIO;
 		}
 
 		err = k_sem_take(&link, K_SECONDS(CONFIG_LTE_NETWORK_TIMEOUT));
@@ -265,8 +523,7 @@ static int w_lte_lc_connect(void)
 				retry = true;
 
 				if (at_cmd_write(offline, NULL, 0, NULL) != 0) {
-					err = -EIO;
-					goto exit;
+					return -EIO;
 				}
 
 				LOG_INF("Using fallback network mode");
@@ -276,13 +533,34 @@ static int w_lte_lc_connect(void)
 		}
 	} while (retry);
 
-exit:
-	rc = at_notif_deregister_handler(NULL, at_handler);
-	if (rc != 0) {
-		LOG_ERR("Can't de-register handler rc=%d", rc);
+	return err;
+}
+
+static int w_lte_lc_connect_async(lte_lc_evt_handler_t handler)
+{
+	int err;
+
+	if (handler != NULL) {
+		evt_handler = handler;
 	}
 
-	return err;
+	err = at_notif_register_handler(NULL, at_handler);
+	if (err) {
+		LOG_ERR("Can't register handler err=%d", err);
+		return err;
+	}
+
+	LOG_DBG("Network mode: %s", log_strdup(nw_mode_preferred));
+
+	if (at_cmd_write(nw_mode_preferred, NULL, 0, NULL) != 0) {
+		return -EIO;
+	}
+
+	if (at_cmd_write(normal, NULL, 0, NULL) != 0) {
+		return -EIO;
+	}
+
+	return 0;
 }
 
 static int w_lte_lc_init_and_connect(struct device *unused)
@@ -319,6 +597,32 @@ int lte_lc_init_and_connect(void)
 	return err;
 }
 
+void lte_lc_register_handler(lte_lc_evt_handler_t handler)
+{
+	if (handler == NULL && evt_handler != NULL) {
+		LOG_DBG("Event handler deregistered");
+	}
+
+	evt_handler = handler;
+}
+
+int lte_lc_connect_async(lte_lc_evt_handler_t handler)
+{
+	return w_lte_lc_connect_async(handler);
+}
+
+int lte_lc_init_and_connect_async(lte_lc_evt_handler_t handler)
+{
+	int err;
+
+	err = w_lte_lc_init();
+	if (err) {
+		return err;
+	}
+
+	return w_lte_lc_connect_async(handler);
+}
+
 int lte_lc_offline(void)
 {
 	if (at_cmd_write(offline, NULL, 0, NULL) != 0) {
@@ -348,6 +652,11 @@ int lte_lc_normal(void)
 
 int lte_lc_psm_req(bool enable)
 {
+	char psm_req[sizeof("AT+CPSMS=1,,,\"\",\"\"") + 2 * PSM_PARAM_STR_LEN];
+
+	snprintf(psm_req, sizeof(psm_req), "AT+CPSMS=1,,,\"%s\",\"%s\"",
+		 psm_rptau, psm_rat);
+
 	if (at_cmd_write(enable ? psm_req : psm_disable,
 			 NULL, 0, NULL) != 0) {
 		return -EIO;
@@ -356,17 +665,135 @@ int lte_lc_psm_req(bool enable)
 	return 0;
 }
 
+/**@brief Check that a string consists of exactly @p len binary digits. */
+static bool is_bit_string(const char *str, size_t len)
+{
+	if (strlen(str) != len) {
+		return false;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		if ((str[i] != '0') && (str[i] != '1')) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int lte_lc_psm_param_set(const char *rptau, const char *rat)
+{
+	if (rptau == NULL) {
+		rptau = CONFIG_LTE_PSM_REQ_RPTAU;
+	}
+
+	if (rat == NULL) {
+		rat = CONFIG_LTE_PSM_REQ_RAT;
+	}
+
+	if (!is_bit_string(rptau, PSM_PARAM_STR_LEN) ||
+	    !is_bit_string(rat, PSM_PARAM_STR_LEN)) {
+		LOG_ERR("Invalid PSM parameters");
+		return -EINVAL;
+	}
+
+	strcpy(psm_rptau, rptau);
+	strcpy(psm_rat, rat);
+
+	LOG_DBG("RPTAU set to %s, RAT set to %s", log_strdup(psm_rptau),
+		log_strdup(psm_rat));
+
+	return 0;
+}
+
+/**@brief Encode a timer value in seconds as a GPRS timer bit string.
+ *	  The unit giving the smallest value not less than @p seconds
+ *	  is selected.
+ *
+ * @param seconds Timer value in seconds.
+ * @param lookup Timer unit lookup table, indexed by the unit bits.
+ * @param lookup_len Number of entries in @p lookup.
+ * @param buf Buffer of at least PSM_PARAM_STR_LEN + 1 bytes.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+static int timer_encode(u32_t seconds, const u32_t *lookup, size_t lookup_len,
+			char *buf)
+{
+	u64_t best = UINT64_MAX;
+	size_t best_unit = 0;
+	u32_t best_value = 0;
+
+	for (size_t unit = 0; unit < lookup_len; unit++) {
+		u32_t value;
+
+		if (lookup[unit] == 0) {
+			/* Timer deactivated */
+			continue;
+		}
+
+		value = ceiling_fraction(seconds, lookup[unit]);
+		if (value > TIMER_VALUE_MAX) {
+			continue;
+		}
+
+		if ((u64_t)value * lookup[unit] < best) {
+			best = (u64_t)value * lookup[unit];
+			best_unit = unit;
+			best_value = value;
+		}
+	}
+
+	if (best == UINT64_MAX) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < TIMER_UNIT_STR_LEN; i++) {
+		buf[i] = (best_unit & BIT(TIMER_UNIT_STR_LEN - 1 - i)) ?
+			 '1' : '0';
+	}
+
+	for (size_t i = 0; i < PSM_PARAM_STR_LEN - TIMER_UNIT_STR_LEN; i++) {
+		buf[TIMER_UNIT_STR_LEN + i] =
+			(best_value &
+			 BIT(PSM_PARAM_STR_LEN - TIMER_UNIT_STR_LEN - 1 - i)) ?
+			'1' : '0';
+	}
+
+	buf[PSM_PARAM_STR_LEN] = '\0';
+
+	return 0;
+}
+
+int lte_lc_psm_param_set_seconds(u32_t tau, u32_t active_time)
+{
+	int err;
+	char rptau[PSM_PARAM_STR_LEN + 1];
+	char rat[PSM_PARAM_STR_LEN + 1];
+
+	err = timer_encode(tau, t3412_lookup, ARRAY_SIZE(t3412_lookup), rptau);
+	if (err) {
+		LOG_ERR("Periodic TAU of %d seconds can not be encoded", tau);
+		return err;
+	}
+
+	err = timer_encode(active_time, t3324_lookup,
+			   ARRAY_SIZE(t3324_lookup), rat);
+	if (err) {
+		LOG_ERR("Active time of %d seconds can not be encoded",
+			active_time);
+		return err;
+	}
+
+	return lte_lc_psm_param_set(rptau, rat);
+}
+
 int lte_lc_psm_get(int *tau, int *active_time)
 {
 	int err;
 	struct at_param_list at_resp_list = {0};
 	char buf[AT_CEREG_RESPONSE_MAX_LEN] = {0};
-	char timer_str[9] = {0};
-	char unit_str[4] = {0};
-	size_t timer_str_len = sizeof(timer_str) - 1;
-	size_t unit_str_len = sizeof(unit_str) - 1;
-	size_t index;
-	u32_t timer_unit, timer_value;
+	struct lte_lc_psm_cfg psm_cfg;
 
 	if ((tau == NULL) || (active_time == NULL)) {
 		return -EINVAL;
@@ -401,51 +828,14 @@ int lte_lc_psm_get(int *tau, int *active_time)
 		goto parse_psm_clean_exit;
 	}
 
-	/* Parse periodic TAU string */
-	err = at_params_string_get(&at_resp_list,
-				   AT_CEREG_TAU_INDEX,
-				   timer_str,
-				   &timer_str_len);
+	err = parse_psm_cfg(&at_resp_list, AT_CEREG_TAU_INDEX,
+			    AT_CEREG_ACTIVE_TIME_INDEX, &psm_cfg);
 	if (err) {
-		LOG_ERR("Could not get TAU, error: %d", err);
-		goto parse_psm_clean_exit;
-	}
-
-	memcpy(unit_str, timer_str, unit_str_len);
-
-	index = strtoul(unit_str, NULL, 2);
-	if (index > (ARRAY_SIZE(t3412_lookup) - 1)) {
-		LOG_ERR("Unable to parse periodic TAU string");
-		err = -EINVAL;
 		goto parse_psm_clean_exit;
 	}
 
-	timer_unit = t3412_lookup[index];
-	timer_value = strtoul(timer_str + unit_str_len, NULL, 2);
-	*tau = timer_unit ? timer_unit * timer_value : -1;
-
-	/* Parse active time string */
-	err = at_params_string_get(&at_resp_list,
-				   AT_CEREG_ACTIVE_TIME_INDEX,
-				   timer_str,
-				   &timer_str_len);
-	if (err) {
-		LOG_ERR("Could not get TAU, error: %d", err);
-		goto parse_psm_clean_exit;
-	}
-
-	memcpy(unit_str, timer_str, unit_str_len);
-
-	index = strtoul(unit_str, NULL, 2);
-	if (index > (ARRAY_SIZE(t3324_lookup) - 1)) {
-		LOG_ERR("Unable to parse active time string");
-		err = -EINVAL;
-		goto parse_psm_clean_exit;
-	}
-
-	timer_unit = t3324_lookup[index];
-	timer_value = strtoul(timer_str + unit_str_len, NULL, 2);
-	*active_time = timer_unit ? timer_unit * timer_value : -1;
+	*tau = psm_cfg.tau;
+	*active_time = psm_cfg.active_time;
 
 	LOG_DBG("TAU: %d sec, active time: %d sec\n", *tau, *active_time);
 
@@ -481,8 +871,11 @@ int lte_lc_edrx_req(bool enable)
 		return -EOPNOTSUPP;
 	}
 
+	/* Mode 2 enables eDRX and the +CEDRXP notification reporting
+	 * the parameters granted by the network.
+	 */
 	snprintf(edrx_req, sizeof(edrx_req),
-		 "AT+CEDRXS=1,%d,\""CONFIG_LTE_EDRX_REQ_VALUE"\"", actt);
+		 "AT+CEDRXS=2,%d,\"%s\"", actt, edrx_value);
 
 	err = at_cmd_write(enable ? edrx_req : edrx_disable, NULL, 0, NULL);
 	if (err) {
@@ -492,6 +885,94 @@ int lte_lc_edrx_req(bool enable)
 	return 0;
 }
 
+int lte_lc_edrx_param_set(const char *edrx)
+{
+	if (edrx == NULL) {
+		edrx = CONFIG_LTE_EDRX_REQ_VALUE;
+	}
+
+	if (!is_bit_string(edrx, EDRX_PARAM_STR_LEN)) {
+		LOG_ERR("Invalid eDRX value");
+		return -EINVAL;
+	}
+
+	strcpy(edrx_value, edrx);
+
+	LOG_DBG("eDRX value set to %s", log_strdup(edrx_value));
+
+	return 0;
+}
+
+/**@brief Parses the PSM timers from a parsed +CEREG response.
+ *
+ * @param at_params Parsed +CEREG response or notification.
+ * @param tau_index Index of the periodic TAU parameter.
+ * @param active_time_index Index of the active time parameter.
+ * @param psm_cfg Pointer to where the parsed timers are stored.
+ *
+ * @return Zero on success or (negative) error code otherwise.
+ */
+static int parse_psm_cfg(struct at_param_list *at_params,
+			 size_t tau_index, size_t active_time_index,
+			 struct lte_lc_psm_cfg *psm_cfg)
+{
+	int err;
+	char timer_str[PSM_PARAM_STR_LEN + 1] = {0};
+	char unit_str[TIMER_UNIT_STR_LEN + 1] = {0};
+	size_t timer_str_len = sizeof(timer_str) - 1;
+	size_t unit_str_len = sizeof(unit_str) - 1;
+	size_t index;
+	u32_t timer_unit, timer_value;
+
+	/* Parse periodic TAU string */
+	err = at_params_string_get(at_params,
+				   tau_index,
+				   timer_str,
+				   &timer_str_len);
+	if (err) {
+		LOG_DBG("Could not get TAU, error: %d", err);
+		return err;
+	}
+
+	memcpy(unit_str, timer_str, unit_str_len);
+
+	index = strtoul(unit_str, NULL, 2);
+	if (index > (ARRAY_SIZE(t3412_lookup) - 1)) {
+		LOG_ERR("Unable to parse periodic TAU string");
+		return -EINVAL;
+	}
+
+	timer_unit = t3412_lookup[index];
+	timer_value = strtoul(timer_str + unit_str_len, NULL, 2);
+	psm_cfg->tau = timer_unit ? timer_unit * timer_value : -1;
+
+	/* Parse active time string */
+	timer_str_len = sizeof(timer_str) - 1;
+
+	err = at_params_string_get(at_params,
+				   active_time_index,
+				   timer_str,
+				   &timer_str_len);
+	if (err) {
+		LOG_DBG("Could not get active time, error: %d", err);
+		return err;
+	}
+
+	memcpy(unit_str, timer_str, unit_str_len);
+
+	index = strtoul(unit_str, NULL, 2);
+	if (index > (ARRAY_SIZE(t3324_lookup) - 1)) {
+		LOG_ERR("Unable to parse active time string");
+		return -EINVAL;
+	}
+
+	timer_unit = t3324_lookup[index];
+	timer_value = strtoul(timer_str + unit_str_len, NULL, 2);
+	psm_cfg->active_time = timer_unit ? timer_unit * timer_value : -1;
+
+	return 0;
+}
+
 /**@brief Helper function to check if a response is what was expected
  *
  * @param response Pointer to response prefix
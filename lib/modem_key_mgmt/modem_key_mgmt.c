@@ -12,6 +12,13 @@
 #include <at_cmd_parser/at_params.h>
 #include <bsd_limits.h>
 #include <modem_key_mgmt.h>
+#if defined(CONFIG_MODEM_KEY_MGMT_BULK)
+#include <ctype.h>
+#include <tinycrypt/constants.h>
+#include <tinycrypt/sha256.h>
+
+#define AT_CMNG_SHA_STR_LEN (2 * TC_SHA256_DIGEST_SIZE)
+#endif
 
 #define MODEM_KEY_MGMT_OP_LS "AT%CMNG=1"
 #define MODEM_KEY_MGMT_OP_RD "AT%CMNG=2"
@@ -20,6 +27,7 @@
 
 #define AT_CMNG_PARAMS_COUNT 5
 #define AT_CMNG_CONTENT_INDEX 4
+#define AT_CMNG_SHA_INDEX 3
 
 static char scratch_buf[4096];
 static char at_cmee_strings[2][10] = {"AT+CMEE=0", "AT+CMEE=1"};
@@ -76,45 +84,67 @@ static int translate_error(int err, enum at_cmd_state state)
 	return err;
 }
 
-static int write_at_cmd_with_cme_enabled(char *cmd, char *buf, size_t buf_len,
-					 enum at_cmd_state *state)
+/**@brief Enable CME error reporting if it is not already enabled.
+ *
+ * @param[out] was_active Whether error reporting was already enabled.
+ */
+static int cmee_enable(bool *was_active)
 {
-	int err;
 	int cmee_was_active = cmee_active();
 
 	if (cmee_was_active < 0) {
 		return -EFAULT;
 	}
 
+	*was_active = cmee_was_active;
+
 	if (!cmee_was_active) {
 		if (cmee_set(true)) {
 			return -EIO;
 		}
 	}
 
-	err = at_cmd_write(cmd, buf, buf_len, state);
+	return 0;
+}
 
-	if (!cmee_was_active) {
+/**@brief Restore CME error reporting to the state before cmee_enable(). */
+static int cmee_restore(bool was_active)
+{
+	if (!was_active) {
 		if (cmee_set(false)) {
 			return -EIO;
 		}
 	}
 
-	return err;
+	return 0;
 }
 
-int modem_key_mgmt_write(nrf_sec_tag_t sec_tag,
-			 enum modem_key_mgnt_cred_type cred_type,
-			 const void *buf, u16_t len)
+static int write_at_cmd_with_cme_enabled(char *cmd, char *buf, size_t buf_len,
+					 enum at_cmd_state *state)
 {
 	int err;
-	int written;
-	enum at_cmd_state state;
+	bool cmee_was_active;
 
-	if ((buf == NULL) || (len == 0)) {
-		return -EINVAL;
+	err = cmee_enable(&cmee_was_active);
+	if (err) {
+		return err;
 	}
 
+	err = at_cmd_write(cmd, buf, buf_len, state);
+
+	if (cmee_restore(cmee_was_active)) {
+		return -EIO;
+	}
+
+	return err;
+}
+
+static int write_cmd_build(nrf_sec_tag_t sec_tag,
+			   enum modem_key_mgnt_cred_type cred_type,
+			   const void *buf, u16_t len)
+{
+	int written;
+
 	written = snprintf(scratch_buf, sizeof(scratch_buf),
 			   "%s,%u,%u,\"", MODEM_KEY_MGMT_OP_WR,
 			   (u32_t)sec_tag, (u8_t)cred_type);
@@ -132,6 +162,25 @@ int modem_key_mgmt_write(nrf_sec_tag_t sec_tag,
 
 	memcpy(&scratch_buf[written], "\"\r\n", sizeof("\"\r\n"));
 
+	return 0;
+}
+
+int modem_key_mgmt_write(nrf_sec_tag_t sec_tag,
+			 enum modem_key_mgnt_cred_type cred_type,
+			 const void *buf, u16_t len)
+{
+	int err;
+	enum at_cmd_state state;
+
+	if ((buf == NULL) || (len == 0)) {
+		return -EINVAL;
+	}
+
+	err = write_cmd_build(sec_tag, cred_type, buf, len);
+	if (err) {
+		return err;
+	}
+
 	err = write_at_cmd_with_cme_enabled(scratch_buf, NULL, 0, &state);
 
 	return translate_error(err, state);
@@ -240,3 +289,137 @@ int modem_key_mgmt_exists(nrf_sec_tag_t sec_tag,
 
 	return translate_error(err, state);
 }
+
+#if defined(CONFIG_MODEM_KEY_MGMT_BULK)
+/**@brief Check if the credential stored in the modem has the same
+ *	  SHA-256 digest as the given credential.
+ *	  CME error reporting must be enabled by the caller.
+ *
+ * @return 1 if the credential is unchanged, 0 if it differs or does not
+ *	   exist, or a negative error code.
+ */
+static int cred_unchanged(const struct modem_key_mgmt_cred *cred)
+{
+	int err;
+	int written;
+	enum at_cmd_state state;
+	struct tc_sha256_state_struct sha_state;
+	u8_t digest[TC_SHA256_DIGEST_SIZE];
+	char stored[AT_CMNG_SHA_STR_LEN + 1];
+	char computed[AT_CMNG_SHA_STR_LEN + 1];
+	size_t stored_len = sizeof(stored) - 1;
+	struct at_param_list cmng_list;
+
+	written = snprintf(scratch_buf, sizeof(scratch_buf),
+			   "%s,%u,%u\r\n", MODEM_KEY_MGMT_OP_LS,
+			   (u32_t)cred->sec_tag, (u8_t)cred->cred_type);
+
+	if ((written < 0) || (written >= sizeof(scratch_buf))) {
+		return -ENOBUFS;
+	}
+
+	err = at_cmd_write(scratch_buf, scratch_buf, sizeof(scratch_buf),
+			   &state);
+	if (err) {
+		return translate_error(err, state);
+	}
+
+	if (strlen(scratch_buf) == 0) {
+		/* Credential does not exist */
+		return 0;
+	}
+
+	err = at_params_list_init(&cmng_list, AT_CMNG_PARAMS_COUNT);
+	if (err) {
+		return err;
+	}
+
+	err = at_parser_params_from_str(scratch_buf, NULL, &cmng_list);
+	if (err == 0) {
+		err = at_params_string_get(&cmng_list, AT_CMNG_SHA_INDEX,
+					   stored, &stored_len);
+	}
+
+	at_params_list_free(&cmng_list);
+
+	if (err || (stored_len != AT_CMNG_SHA_STR_LEN)) {
+		/* No digest reported, the credential has to be written. */
+		return 0;
+	}
+
+	/* The modem reports the digest in upper case hex. */
+	for (size_t i = 0; i < stored_len; i++) {
+		stored[i] = toupper((unsigned char)stored[i]);
+	}
+
+	(void)tc_sha256_init(&sha_state);
+	(void)tc_sha256_update(&sha_state, cred->buf, cred->len);
+	(void)tc_sha256_final(digest, &sha_state);
+
+	for (size_t i = 0; i < sizeof(digest); i++) {
+		snprintf(&computed[2 * i], 3, "%02X", digest[i]);
+	}
+
+	return memcmp(stored, computed, AT_CMNG_SHA_STR_LEN) == 0;
+}
+
+int modem_key_mgmt_write_bulk(const struct modem_key_mgmt_cred *creds,
+			      size_t count, size_t *written)
+{
+	int err;
+	int restore_err;
+	bool cmee_was_active;
+	enum at_cmd_state state;
+	size_t num_written = 0;
+
+	if ((creds == NULL) || (count == 0)) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if ((creds[i].buf == NULL) || (creds[i].len == 0)) {
+			return -EINVAL;
+		}
+	}
+
+	/* Toggle CME error reporting once for the whole batch. */
+	err = cmee_enable(&cmee_was_active);
+	if (err) {
+		return err;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		const struct modem_key_mgmt_cred *cred = &creds[i];
+
+		err = cred_unchanged(cred);
+		if (err < 0) {
+			break;
+		} else if (err == 1) {
+			err = 0;
+			continue;
+		}
+
+		err = write_cmd_build(cred->sec_tag, cred->cred_type,
+				      cred->buf, cred->len);
+		if (err) {
+			break;
+		}
+
+		err = at_cmd_write(scratch_buf, NULL, 0, &state);
+		if (err) {
+			err = translate_error(err, state);
+			break;
+		}
+
+		num_written++;
+	}
+
+	restore_err = cmee_restore(cmee_was_active);
+
+	if (written != NULL) {
+		*written = num_written;
+	}
+
+	return err ? err : restore_err;
+}
+#endif /* CONFIG_MODEM_KEY_MGMT_BULK */
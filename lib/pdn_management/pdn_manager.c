@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <net/socket.h>
+#include <lte_lc.h>
+#include <pdn_management.h>
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(pdn_manager, CONFIG_PDN_MANAGER_LOG_LEVEL);
+
+enum pdn_ctx_state {
+	PDN_CTX_UNUSED,
+	/* Waiting to be activated. */
+	PDN_CTX_INACTIVE,
+	/* Socket being created and connected, without the lock held. */
+	PDN_CTX_ACTIVATING,
+	/* Non-blocking connect in progress. */
+	PDN_CTX_CONNECTING,
+	PDN_CTX_ACTIVE,
+};
+
+struct pdn_ctx {
+	enum pdn_ctx_state state;
+	char apn[CONFIG_PDN_MANAGER_APN_MAX_LEN + 1];
+	pdn_evt_handler_t handler;
+	int fd;
+	/* Uptime at which activation is retried. */
+	s64_t retry_at;
+};
+
+static struct pdn_ctx contexts[CONFIG_PDN_MANAGER_MAX_CONTEXTS];
+static bool nw_registered;
+
+static K_MUTEX_DEFINE(ctx_lock);
+static K_SEM_DEFINE(wakeup_sem, 0, 1);
+
+static K_THREAD_STACK_DEFINE(pdn_manager_stack,
+			     CONFIG_PDN_MANAGER_STACK_SIZE);
+static struct k_thread pdn_manager_thread;
+static bool initialized;
+
+static void evt_notify(int id, enum pdn_evt evt, int fd)
+{
+	if (contexts[id].handler != NULL) {
+		contexts[id].handler(id, evt, fd);
+	}
+}
+
+static void ctx_close(struct pdn_ctx *ctx)
+{
+	if (ctx->fd >= 0) {
+		close(ctx->fd);
+		ctx->fd = -1;
+	}
+}
+
+static void ctx_retry_schedule(struct pdn_ctx *ctx)
+{
+	ctx_close(ctx);
+	ctx->state = PDN_CTX_INACTIVE;
+	ctx->retry_at = k_uptime_get() +
+			K_SECONDS(CONFIG_PDN_MANAGER_RETRY_INTERVAL);
+}
+
+/**@brief Start activating a context without waiting for it to complete.
+ *
+ * Called with ctx_lock held. The lock is released while the socket is
+ * created and connected, because this can block on AT commands to the
+ * modem, and network registration updates must not wait for it.
+ */
+static void ctx_activate(int id)
+{
+	int fd;
+	int err;
+	struct pdn_ctx *ctx = &contexts[id];
+	char apn[sizeof(ctx->apn)];
+
+	strcpy(apn, ctx->apn);
+	ctx->state = PDN_CTX_ACTIVATING;
+
+	k_mutex_unlock(&ctx_lock);
+
+	fd = socket(AF_LTE, SOCK_MGMT, NPROTO_PDN);
+	if (fd < 0) {
+		err = -errno;
+	} else {
+		err = fcntl(fd, F_SETFL, O_NONBLOCK);
+		if (err) {
+			/* Fall back to a blocking connect. */
+			LOG_WRN("Could not make PDN socket non-blocking, "
+				"errno %d", errno);
+		}
+
+		err = connect(fd, (struct sockaddr *)apn, strlen(apn));
+		if (err) {
+			err = -errno;
+		}
+	}
+
+	k_mutex_lock(&ctx_lock, K_FOREVER);
+
+	if (ctx->state != PDN_CTX_ACTIVATING) {
+		/* Removed while activating. */
+		if (fd >= 0) {
+			close(fd);
+		}
+		return;
+	}
+
+	ctx->fd = fd;
+
+	if (fd < 0) {
+		LOG_ERR("Failed to create PDN socket, errno %d", -err);
+		ctx_retry_schedule(ctx);
+		evt_notify(id, PDN_EVT_ERROR, err);
+	} else if (err == 0) {
+		LOG_INF("PDN %s active", log_strdup(apn));
+		ctx->state = PDN_CTX_ACTIVE;
+		evt_notify(id, PDN_EVT_ACTIVATED, fd);
+	} else if ((err == -EINPROGRESS) || (err == -EAGAIN)) {
+		LOG_DBG("PDN %s activation in progress", log_strdup(apn));
+		ctx->state = PDN_CTX_CONNECTING;
+	} else {
+		LOG_ERR("PDN %s activation failed, errno %d",
+			log_strdup(apn), -err);
+		ctx_retry_schedule(ctx);
+		evt_notify(id, PDN_EVT_ERROR, err);
+	}
+}
+
+/**@brief Start activation of all contexts that are due.
+ *
+ * @return Time in milliseconds until the next retry, or K_FOREVER.
+ */
+static s32_t ctx_activate_due(void)
+{
+	s64_t now = k_uptime_get();
+	s64_t next = -1;
+
+	if (!nw_registered) {
+		return K_FOREVER;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(contexts); i++) {
+		/* The network may be lost while the lock is released. */
+		if (!nw_registered) {
+			return K_FOREVER;
+		}
+
+		if (contexts[i].state != PDN_CTX_INACTIVE) {
+			continue;
+		}
+
+		if (contexts[i].retry_at <= now) {
+			ctx_activate(i);
+			now = k_uptime_get();
+		}
+
+		/* Activation may have failed immediately. */
+		if ((contexts[i].state == PDN_CTX_INACTIVE) &&
+		    ((next < 0) || (contexts[i].retry_at < next))) {
+			next = contexts[i].retry_at;
+		}
+	}
+
+	return (next < 0) ? K_FOREVER : (s32_t)MAX(next - now, 0);
+}
+
+static void poll_events_handle(struct pollfd *fds, int *ids, int nfds)
+{
+	for (int i = 0; i < nfds; i++) {
+		struct pdn_ctx *ctx = &contexts[ids[i]];
+
+		if ((ctx->state == PDN_CTX_UNUSED) || (ctx->fd != fds[i].fd)) {
+			/* Removed while polling. */
+			continue;
+		}
+
+		if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			enum pdn_evt evt = (ctx->state == PDN_CTX_ACTIVE) ?
+					   PDN_EVT_DEACTIVATED : PDN_EVT_ERROR;
+
+			LOG_WRN("PDN %s %s", log_strdup(ctx->apn),
+				(evt == PDN_EVT_DEACTIVATED) ?
+				"lost" : "activation failed");
+
+			ctx_retry_schedule(ctx);
+
+			/* Re-establish right away if the network is still
+			 * available.
+			 */
+			if (evt == PDN_EVT_DEACTIVATED) {
+				ctx->retry_at = k_uptime_get();
+			}
+
+			evt_notify(ids[i], evt, -ENETDOWN);
+		} else if ((ctx->state == PDN_CTX_CONNECTING) &&
+			   (fds[i].revents & POLLOUT)) {
+			LOG_INF("PDN %s active", log_strdup(ctx->apn));
+			ctx->state = PDN_CTX_ACTIVE;
+			evt_notify(ids[i], PDN_EVT_ACTIVATED, ctx->fd);
+		}
+	}
+}
+
+static void pdn_manager_thread_fn(void *p1, void *p2, void *p3)
+{
+	struct pollfd fds[CONFIG_PDN_MANAGER_MAX_CONTEXTS];
+	int ids[CONFIG_PDN_MANAGER_MAX_CONTEXTS];
+
+	while (true) {
+		int nfds = 0;
+		s32_t timeout;
+		int ret;
+
+		k_mutex_lock(&ctx_lock, K_FOREVER);
+
+		timeout = ctx_activate_due();
+
+		for (size_t i = 0; i < ARRAY_SIZE(contexts); i++) {
+			if ((contexts[i].state != PDN_CTX_CONNECTING) &&
+			    (contexts[i].state != PDN_CTX_ACTIVE)) {
+				continue;
+			}
+
+			fds[nfds].fd = contexts[i].fd;
+			fds[nfds].events =
+				(contexts[i].state == PDN_CTX_CONNECTING) ?
+				POLLOUT : 0;
+			fds[nfds].revents = 0;
+			ids[nfds] = i;
+			nfds++;
+		}
+
+		k_mutex_unlock(&ctx_lock);
+
+		if (nfds == 0) {
+			(void)k_sem_take(&wakeup_sem, timeout);
+			continue;
+		}
+
+		/* Poll in bounded intervals so that new contexts and
+		 * network updates are picked up.
+		 */
+		if ((timeout == K_FOREVER) ||
+		    (timeout > CONFIG_PDN_MANAGER_POLL_INTERVAL)) {
+			timeout = CONFIG_PDN_MANAGER_POLL_INTERVAL;
+		}
+
+		ret = poll(fds, nfds, timeout);
+		if (ret < 0) {
+			LOG_ERR("poll() failed, errno %d", errno);
+			k_sleep(CONFIG_PDN_MANAGER_POLL_INTERVAL);
+			continue;
+		}
+
+		if (ret > 0) {
+			k_mutex_lock(&ctx_lock, K_FOREVER);
+			poll_events_handle(fds, ids, nfds);
+			k_mutex_unlock(&ctx_lock);
+		}
+	}
+}
+
+int pdn_manager_init(void)
+{
+	if (initialized) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(contexts); i++) {
+		contexts[i].state = PDN_CTX_UNUSED;
+		contexts[i].fd = -1;
+	}
+
+	if (IS_ENABLED(CONFIG_LTE_LINK_CONTROL)) {
+		enum lte_lc_nw_reg_status status;
+
+		/* Later changes are reported by the LTE link control
+		 * library.
+		 */
+		if (lte_lc_nw_reg_status_get(&status) == 0) {
+			pdn_manager_nw_reg_update(
+				(status == LTE_LC_NW_REG_REGISTERED_HOME) ||
+				(status == LTE_LC_NW_REG_REGISTERED_ROAMING));
+		}
+	}
+
+	k_thread_create(&pdn_manager_thread, pdn_manager_stack,
+			K_THREAD_STACK_SIZEOF(pdn_manager_stack),
+			pdn_manager_thread_fn, NULL, NULL, NULL,
+			K_LOWEST_APPLICATION_THREAD_PRIO, 0, K_NO_WAIT);
+	k_thread_name_set(&pdn_manager_thread, "pdn_manager");
+
+	initialized = true;
+
+	return 0;
+}
+
+int pdn_ctx_add(const char *apn_name, pdn_evt_handler_t handler)
+{
+	int id = -ENOMEM;
+
+	if ((apn_name == NULL) ||
+	    (strlen(apn_name) > CONFIG_PDN_MANAGER_APN_MAX_LEN)) {
+		return -EINVAL;
+	}
+
+	if (!initialized) {
+		return -EPERM;
+	}
+
+	k_mutex_lock(&ctx_lock, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(contexts); i++) {
+		if (contexts[i].state == PDN_CTX_UNUSED) {
+			strcpy(contexts[i].apn, apn_name);
+			contexts[i].handler = handler;
+			contexts[i].fd = -1;
+			contexts[i].retry_at = 0;
+			contexts[i].state = PDN_CTX_INACTIVE;
+			id = i;
+			break;
+		}
+	}
+
+	k_mutex_unlock(&ctx_lock);
+
+	if (id >= 0) {
+		k_sem_give(&wakeup_sem);
+	}
+
+	return id;
+}
+
+int pdn_ctx_remove(int id)
+{
+	if ((id < 0) || (id >= ARRAY_SIZE(contexts))) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&ctx_lock, K_FOREVER);
+
+	if (contexts[id].state == PDN_CTX_UNUSED) {
+		k_mutex_unlock(&ctx_lock);
+		return -ENOENT;
+	}
+
+	ctx_close(&contexts[id]);
+	contexts[id].state = PDN_CTX_UNUSED;
+	contexts[id].handler = NULL;
+
+	k_mutex_unlock(&ctx_lock);
+
+	return 0;
+}
+
+int pdn_ctx_fd_get(int id)
+{
+	int fd;
+
+	if ((id < 0) || (id >= ARRAY_SIZE(contexts))) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&ctx_lock, K_FOREVER);
+	fd = (contexts[id].state == PDN_CTX_ACTIVE) ? contexts[id].fd :
+						      -ENOTCONN;
+	k_mutex_unlock(&ctx_lock);
+
+	return fd;
+}
+
+void pdn_manager_nw_reg_update(bool registered)
+{
+	k_mutex_lock(&ctx_lock, K_FOREVER);
+
+	if (registered && !nw_registered) {
+		/* Activate all inactive contexts without waiting for
+		 * their retry interval.
+		 */
+		for (size_t i = 0; i < ARRAY_SIZE(contexts); i++) {
+			contexts[i].retry_at = 0;
+		}
+	}
+
+	nw_registered = registered;
+
+	k_mutex_unlock(&ctx_lock);
+
+	k_sem_give(&wakeup_sem);
+}
@@ -8,6 +8,7 @@
 #include <zephyr.h>
 #include <stdio.h>
 #include <sms.h>
+#include <sms_deliver.h>
 #include <errno.h>
 #include <at_cmd.h>
 #include <at_cmd_parser/at_cmd_parser.h>
@@ -22,6 +23,15 @@ LOG_MODULE_REGISTER(sms, CONFIG_SMS_LOG_LEVEL);
 #define AT_CNMI_PARAMS_COUNT 6
 #define AT_CMT_PARAMS_COUNT 4
 
+/** @brief Maximum length of the alpha field of a +CMT notification. Longer
+ *	   fields are truncated.
+ */
+#define AT_CMT_ALPHA_MAX_LEN 32
+/** @brief Maximum length of a hexadecimal PDU: a 12 octet SMSC address
+ *	   followed by a 164 octet TPDU.
+ */
+#define AT_CMT_PDU_MAX_LEN (2 * (12 + 164))
+
 /** @brief AT command to check if a client already exist. */
 #define AT_SMS_SUBSCRIBER_READ "AT+CNMI?"
 
@@ -50,6 +60,11 @@ static bool sms_client_registered;
 /** @brief SMS event. */
 static struct sms_data cmt_rsp;
 
+/** @brief Storage for the SMS event, reused for every notification. */
+static char cmt_alpha[AT_CMT_ALPHA_MAX_LEN + 1];
+static char cmt_pdu[AT_CMT_PDU_MAX_LEN + 1];
+static struct sms_deliver cmt_deliver;
+
 struct sms_subscriber {
 	/* Listener user context. */
 	void *ctx;
@@ -99,38 +114,49 @@ static int sms_cmt_notif_parse(const char *const buf)
 /** @brief Save the SMS notification parameters. */
 static int sms_cmt_notif_save(void)
 {
-	if (cmt_rsp.alpha != NULL) {
-		k_free(cmt_rsp.alpha);
-	}
+	int err;
 
-	if (cmt_rsp.pdu != NULL) {
-		k_free(cmt_rsp.pdu);
-	}
+	/* Save alpha as a null-terminated String. It is read through the
+	 * PDU buffer, which is only filled afterwards, and truncated if it
+	 * does not fit.
+	 */
+	size_t alpha_len = sizeof(cmt_pdu) - 1;
 
-	/* Save alpha as a null-terminated String. */
-	size_t alpha_len;
-	(void)at_params_size_get(&resp_list, 1, &alpha_len);
+	err = at_params_string_get(&resp_list, 1, cmt_pdu, &alpha_len);
+	if (err) {
+		return err;
+	}
 
-	cmt_rsp.alpha = k_malloc(alpha_len + 1);
-	if (cmt_rsp.alpha == NULL) {
-		return -ENOMEM;
+	if (alpha_len > AT_CMT_ALPHA_MAX_LEN) {
+		LOG_WRN("Alpha field of %d characters truncated", alpha_len);
+		alpha_len = AT_CMT_ALPHA_MAX_LEN;
 	}
-	(void)at_params_string_get(&resp_list, 1, cmt_rsp.alpha, &alpha_len);
-	cmt_rsp.alpha[alpha_len] = '\0';
+
+	memcpy(cmt_alpha, cmt_pdu, alpha_len);
+	cmt_alpha[alpha_len] = '\0';
+	cmt_rsp.alpha = cmt_alpha;
 
 	/* Length field saved as number. */
 	(void)at_params_short_get(&resp_list, 2, &cmt_rsp.length);
 
 	/* Save PDU as a null-terminated String. */
-	size_t pdu_len;
-	(void)at_params_size_get(&resp_list, 3, &pdu_len);
-	cmt_rsp.pdu = k_malloc(pdu_len + 1);
-	if (cmt_rsp.pdu == NULL) {
-		return -ENOMEM;
-	}
+	size_t pdu_len = sizeof(cmt_pdu) - 1;
 
-	(void)at_params_string_get(&resp_list, 3, cmt_rsp.pdu, &pdu_len);
-	cmt_rsp.pdu[pdu_len] = '\0';
+	err = at_params_string_get(&resp_list, 3, cmt_pdu, &pdu_len);
+	if (err) {
+		return err;
+	}
+	cmt_pdu[pdu_len] = '\0';
+	cmt_rsp.pdu = cmt_pdu;
+
+	/* Decode the PDU once on behalf of all subscribers. */
+	err = sms_deliver_decode(cmt_pdu, pdu_len, &cmt_deliver);
+	if (err) {
+		LOG_WRN("Could not decode SMS-DELIVER PDU, err: %d", err);
+		cmt_rsp.deliver = NULL;
+	} else {
+		cmt_rsp.deliver = &cmt_deliver;
+	}
 
 	return 0;
 }
@@ -293,13 +319,9 @@ void sms_uninit(void)
 	/* Cleanup resources. */
 	at_params_list_free(&resp_list);
 
-	if (cmt_rsp.alpha != NULL) {
-		k_free(cmt_rsp.alpha);
-	}
-
-	if (cmt_rsp.pdu != NULL) {
-		k_free(cmt_rsp.pdu);
-	}
+	cmt_rsp.alpha = NULL;
+	cmt_rsp.pdu = NULL;
+	cmt_rsp.deliver = NULL;
 
 	/* Unregister from AT commands notifications. */
 	(void)at_notif_deregister_handler(NULL, sms_at_handler);
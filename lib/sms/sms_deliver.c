@@ -0,0 +1,614 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <errno.h>
+#include <string.h>
+#include <sms_deliver.h>
+
+/* TP-MTI value for SMS-DELIVER, ref. 3GPP TS 23.040 Ch. 9.2.3.1. */
+#define TP_MTI_MASK			0x03
+#define TP_MTI_DELIVER			0x00
+#define TP_UDHI_MASK			0x40
+
+/* Type of number of an address, ref. 3GPP TS 23.040 Ch. 9.1.2.5. */
+#define TON_MASK			0x70
+#define TON_INTERNATIONAL		0x10
+#define TON_ALPHANUMERIC		0x50
+
+/* Information element identifiers of the user data header,
+ * ref. 3GPP TS 23.040 Ch. 9.2.3.24.
+ */
+#define UDH_IEI_CONCAT_8BIT_REF		0x00
+#define UDH_IEI_CONCAT_16BIT_REF	0x08
+
+#define SCTS_LEN			7
+#define SMS_DELIVER_UD_OCTETS_MAX	140
+#define UCS2_CHAR_LEN			2
+#define GSM7_ESCAPE			0x1B
+#define GSM7_BITS			7
+
+/** @brief Reader for a hexadecimal PDU string. Octets are decoded on
+ *	   demand, the string is never copied.
+ */
+struct pdu_reader {
+	const char *hex;
+	/* Number of octets in the PDU. */
+	size_t len;
+	/* Current octet position. */
+	size_t pos;
+};
+
+/* GSM 7-bit default alphabet to Unicode, ref. 3GPP TS 23.038 Ch. 6.2.1. */
+static const u16_t gsm7_default[128] = {
+	0x0040, 0x00A3, 0x0024, 0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC,
+	0x00F2, 0x00C7, 0x000A, 0x00D8, 0x00F8, 0x000D, 0x00C5, 0x00E5,
+	0x0394, 0x005F, 0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8,
+	0x03A3, 0x0398, 0x039E, 0x00A0, 0x00C6, 0x00E6, 0x00DF, 0x00C9,
+	0x0020, 0x0021, 0x0022, 0x0023, 0x00A4, 0x0025, 0x0026, 0x0027,
+	0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+	0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+	0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+	0x00A1, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+	0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+	0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+	0x0058, 0x0059, 0x005A, 0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7,
+	0x00BF, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+	0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+	0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+	0x0078, 0x0079, 0x007A, 0x00E4, 0x00F6, 0x00F1, 0x00FC, 0x00E0,
+};
+
+/* GSM 7-bit extension table, ref. 3GPP TS 23.038 Ch. 6.2.1.1. */
+static u16_t gsm7_extension(u8_t c)
+{
+	switch (c) {
+	case 0x0A: return 0x000C;
+	case 0x14: return 0x005E;
+	case 0x28: return 0x007B;
+	case 0x29: return 0x007D;
+	case 0x2F: return 0x005C;
+	case 0x3C: return 0x005B;
+	case 0x3D: return 0x007E;
+	case 0x3E: return 0x005D;
+	case 0x40: return 0x007C;
+	case 0x65: return 0x20AC;
+	default:
+		/* Unknown extensions are displayed as the default character. */
+		return gsm7_default[c];
+	}
+}
+
+static int hex_nibble(char c)
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	} else if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	} else if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+
+	return -EINVAL;
+}
+
+/** @brief Decode the octet at @p index of the PDU without moving. */
+static int octet_at(const struct pdu_reader *r, size_t index)
+{
+	int hi, lo;
+
+	if (index >= r->len) {
+		return -EINVAL;
+	}
+
+	hi = hex_nibble(r->hex[2 * index]);
+	lo = hex_nibble(r->hex[2 * index + 1]);
+	if (hi < 0 || lo < 0) {
+		return -EINVAL;
+	}
+
+	return (hi << 4) | lo;
+}
+
+static int octet_get(struct pdu_reader *r)
+{
+	int ret = octet_at(r, r->pos);
+
+	if (ret >= 0) {
+		r->pos++;
+	}
+
+	return ret;
+}
+
+/** @brief Decode septet number @p n of the 7-bit packed data starting at
+ *	   octet @p start.
+ */
+static int septet_at(const struct pdu_reader *r, size_t start, size_t n)
+{
+	size_t bit = n * GSM7_BITS;
+	size_t index = start + bit / 8;
+	size_t shift = bit % 8;
+	int lo, hi = 0;
+
+	lo = octet_at(r, index);
+	if (lo < 0) {
+		return lo;
+	}
+
+	if (shift > 8 - GSM7_BITS) {
+		hi = octet_at(r, index + 1);
+		if (hi < 0) {
+			return hi;
+		}
+	}
+
+	return ((lo >> shift) | (hi << (8 - shift))) & 0x7F;
+}
+
+static size_t utf8_put(u16_t ucs, u8_t *buf)
+{
+	if (ucs < 0x80) {
+		buf[0] = ucs;
+		return 1;
+	} else if (ucs < 0x800) {
+		buf[0] = 0xC0 | (ucs >> 6);
+		buf[1] = 0x80 | (ucs & 0x3F);
+		return 2;
+	}
+
+	buf[0] = 0xE0 | (ucs >> 12);
+	buf[1] = 0x80 | ((ucs >> 6) & 0x3F);
+	buf[2] = 0x80 | (ucs & 0x3F);
+	return 3;
+}
+
+/** @brief Unpack @p count septets, skipping the first @p skip, and
+ *	   convert them to UTF-8.
+ *
+ * @return Number of bytes written to @p buf or a negative error code.
+ */
+static int gsm7_decode(const struct pdu_reader *r, size_t start, size_t skip,
+		       size_t count, u8_t *buf, size_t buf_len)
+{
+	size_t len = 0;
+	bool escape = false;
+
+	for (size_t i = skip; i < count; i++) {
+		int c = septet_at(r, start, i);
+		u16_t ucs;
+
+		if (c < 0) {
+			return c;
+		}
+
+		if (escape) {
+			ucs = gsm7_extension(c);
+			escape = false;
+		} else if (c == GSM7_ESCAPE) {
+			escape = true;
+			continue;
+		} else {
+			ucs = gsm7_default[c];
+		}
+
+		if (len + 3 > buf_len) {
+			return -EINVAL;
+		}
+
+		len += utf8_put(ucs, &buf[len]);
+	}
+
+	return len;
+}
+
+static int ucs2_decode(struct pdu_reader *r, size_t count, u8_t *buf,
+		       size_t buf_len)
+{
+	size_t len = 0;
+
+	for (size_t i = 0; i + 1 < count; i += UCS2_CHAR_LEN) {
+		int hi = octet_get(r);
+		int lo = octet_get(r);
+		u32_t ucs;
+
+		if (hi < 0 || lo < 0) {
+			return -EINVAL;
+		}
+
+		ucs = (hi << 8) | lo;
+
+		/* Combine UTF-16 surrogate pairs. */
+		if (ucs >= 0xD800 && ucs < 0xDC00 &&
+		    i + 3 < count) {
+			int hi2 = octet_at(r, r->pos);
+			int lo2 = octet_at(r, r->pos + 1);
+			u32_t low = ((hi2 << 8) | lo2);
+
+			if (hi2 >= 0 && lo2 >= 0 &&
+			    low >= 0xDC00 && low < 0xE000) {
+				ucs = 0x10000 + ((ucs - 0xD800) << 10) +
+				      (low - 0xDC00);
+				r->pos += UCS2_CHAR_LEN;
+				i += UCS2_CHAR_LEN;
+			}
+		}
+
+		if (len + 4 > buf_len) {
+			return -EINVAL;
+		}
+
+		if (ucs > 0xFFFF) {
+			buf[len++] = 0xF0 | (ucs >> 18);
+			buf[len++] = 0x80 | ((ucs >> 12) & 0x3F);
+			buf[len++] = 0x80 | ((ucs >> 6) & 0x3F);
+			buf[len++] = 0x80 | (ucs & 0x3F);
+		} else {
+			len += utf8_put(ucs, &buf[len]);
+		}
+	}
+
+	return len;
+}
+
+static int bcd_swapped(int octet)
+{
+	return (octet & 0x0F) * 10 + ((octet >> 4) & 0x0F);
+}
+
+static int address_decode(struct pdu_reader *r, char *buf, size_t buf_len)
+{
+	int digits = octet_get(r);
+	int toa = octet_get(r);
+	size_t octets;
+	size_t len = 0;
+
+	if (digits < 0 || toa < 0) {
+		return -EINVAL;
+	}
+
+	octets = (digits + 1) / 2;
+	if (r->pos + octets > r->len) {
+		return -EINVAL;
+	}
+
+	if ((toa & TON_MASK) == TON_ALPHANUMERIC) {
+		int ret = gsm7_decode(r, r->pos, 0, digits * 4 / GSM7_BITS,
+				      (u8_t *)buf, buf_len - 1);
+
+		if (ret < 0) {
+			return ret;
+		}
+
+		len = ret;
+	} else {
+		if ((toa & TON_MASK) == TON_INTERNATIONAL) {
+			buf[len++] = '+';
+		}
+
+		for (int i = 0; i < digits; i++) {
+			int octet = octet_at(r, r->pos + i / 2);
+			int digit = (i % 2) ? (octet >> 4) : (octet & 0x0F);
+
+			if (octet < 0 || len + 1 >= buf_len) {
+				return -EINVAL;
+			}
+
+			buf[len++] = (digit < 10) ? ('0' + digit) : '?';
+		}
+	}
+
+	buf[len] = '\0';
+	r->pos += octets;
+
+	return 0;
+}
+
+static int time_decode(struct pdu_reader *r, struct sms_deliver_time *time)
+{
+	int scts[SCTS_LEN];
+
+	for (size_t i = 0; i < SCTS_LEN; i++) {
+		scts[i] = octet_get(r);
+		if (scts[i] < 0) {
+			return -EINVAL;
+		}
+	}
+
+	time->year = bcd_swapped(scts[0]);
+	time->month = bcd_swapped(scts[1]);
+	time->day = bcd_swapped(scts[2]);
+	time->hour = bcd_swapped(scts[3]);
+	time->minute = bcd_swapped(scts[4]);
+	time->second = bcd_swapped(scts[5]);
+	/* Bit 3 of the time zone octet is the sign. */
+	time->timezone = bcd_swapped(scts[6] & ~0x08);
+	if (scts[6] & 0x08) {
+		time->timezone = -time->timezone;
+	}
+
+	return 0;
+}
+
+static int alphabet_decode(u8_t dcs, enum sms_deliver_alphabet *alphabet)
+{
+	/* Ref. 3GPP TS 23.038 Ch. 4. */
+	switch (dcs >> 4) {
+	case 0x0:
+	case 0x1:
+	case 0x2:
+	case 0x3:
+	case 0x4:
+	case 0x5:
+	case 0x6:
+	case 0x7:
+		/* General data coding and automatic deletion groups */
+		if (dcs & 0x20) {
+			/* Compressed */
+			return -ENOTSUP;
+		}
+
+		switch ((dcs >> 2) & 0x03) {
+		case 0x01:
+			*alphabet = SMS_DELIVER_ALPHABET_8BIT;
+			break;
+		case 0x02:
+			*alphabet = SMS_DELIVER_ALPHABET_UCS2;
+			break;
+		default:
+			*alphabet = SMS_DELIVER_ALPHABET_GSM7;
+			break;
+		}
+		break;
+	case 0xC:
+	case 0xD:
+		/* Message waiting indication, GSM 7-bit */
+		*alphabet = SMS_DELIVER_ALPHABET_GSM7;
+		break;
+	case 0xE:
+		/* Message waiting indication, UCS2 */
+		*alphabet = SMS_DELIVER_ALPHABET_UCS2;
+		break;
+	case 0xF:
+		*alphabet = (dcs & 0x04) ? SMS_DELIVER_ALPHABET_8BIT :
+					   SMS_DELIVER_ALPHABET_GSM7;
+		break;
+	default:
+		/* Reserved coding groups */
+		return -ENOTSUP;
+	}
+
+	return 0;
+}
+
+static int udh_decode(const struct pdu_reader *r, size_t start, size_t udhl,
+		      struct sms_deliver_concat *concat)
+{
+	size_t pos = start;
+	size_t end = start + udhl;
+
+	while (pos + 2 <= end) {
+		int iei = octet_at(r, pos);
+		int iedl = octet_at(r, pos + 1);
+
+		if (iei < 0 || iedl < 0 || pos + 2 + iedl > end) {
+			return -EINVAL;
+		}
+
+		if (iei == UDH_IEI_CONCAT_8BIT_REF && iedl == 3) {
+			concat->ref = octet_at(r, pos + 2);
+			concat->total = octet_at(r, pos + 3);
+			concat->seq = octet_at(r, pos + 4);
+			concat->present = true;
+		} else if (iei == UDH_IEI_CONCAT_16BIT_REF && iedl == 4) {
+			concat->ref = (octet_at(r, pos + 2) << 8) |
+				      octet_at(r, pos + 3);
+			concat->total = octet_at(r, pos + 4);
+			concat->seq = octet_at(r, pos + 5);
+			concat->present = true;
+		}
+
+		pos += 2 + iedl;
+	}
+
+	return 0;
+}
+
+int sms_deliver_decode(const char *pdu, size_t pdu_len,
+		       struct sms_deliver *out)
+{
+	int ret;
+	int smsc_len, first, pid, dcs, udl;
+	size_t ud_start, ud_octets;
+	size_t skip = 0;
+	struct pdu_reader r = {
+		.hex = pdu,
+		.len = pdu_len / 2,
+		.pos = 0,
+	};
+
+	if (pdu == NULL || out == NULL || (pdu_len % 2) != 0) {
+		return -EINVAL;
+	}
+
+	memset(&out->concat, 0, sizeof(out->concat));
+
+	/* Skip the SMSC address. */
+	smsc_len = octet_get(&r);
+	if (smsc_len < 0) {
+		return -EINVAL;
+	}
+
+	r.pos += smsc_len;
+
+	first = octet_get(&r);
+	if (first < 0) {
+		return -EINVAL;
+	}
+
+	if ((first & TP_MTI_MASK) != TP_MTI_DELIVER) {
+		return -ENOTSUP;
+	}
+
+	ret = address_decode(&r, out->address, sizeof(out->address));
+	if (ret) {
+		return ret;
+	}
+
+	pid = octet_get(&r);
+	dcs = octet_get(&r);
+	if (pid < 0 || dcs < 0) {
+		return -EINVAL;
+	}
+
+	out->pid = pid;
+	out->dcs = dcs;
+
+	ret = alphabet_decode(dcs, &out->alphabet);
+	if (ret) {
+		return ret;
+	}
+
+	ret = time_decode(&r, &out->time);
+	if (ret) {
+		return ret;
+	}
+
+	udl = octet_get(&r);
+	if (udl < 0) {
+		return -EINVAL;
+	}
+
+	ud_start = r.pos;
+	ud_octets = (out->alphabet == SMS_DELIVER_ALPHABET_GSM7) ?
+		    ceiling_fraction(udl * GSM7_BITS, 8) : udl;
+
+	if (ud_start + ud_octets > r.len ||
+	    ud_octets > SMS_DELIVER_UD_OCTETS_MAX) {
+		return -EINVAL;
+	}
+
+	if (first & TP_UDHI_MASK) {
+		int udhl = octet_at(&r, ud_start);
+
+		if (udhl < 0 || (size_t)udhl + 1 > ud_octets) {
+			return -EINVAL;
+		}
+
+		ret = udh_decode(&r, ud_start + 1, udhl, &out->concat);
+		if (ret) {
+			return ret;
+		}
+
+		/* Octets, or septets including fill bits, taken by the
+		 * header.
+		 */
+		skip = 1 + udhl;
+		if (out->alphabet == SMS_DELIVER_ALPHABET_GSM7) {
+			skip = ceiling_fraction(skip * 8, GSM7_BITS);
+		}
+	}
+
+	switch (out->alphabet) {
+	case SMS_DELIVER_ALPHABET_GSM7:
+		ret = gsm7_decode(&r, ud_start, skip, udl, out->text,
+				  sizeof(out->text) - 1);
+		break;
+	case SMS_DELIVER_ALPHABET_UCS2:
+		r.pos = ud_start + skip;
+		ret = ucs2_decode(&r, udl - skip, out->text,
+				  sizeof(out->text) - 1);
+		break;
+	case SMS_DELIVER_ALPHABET_8BIT:
+	default:
+		r.pos = ud_start + skip;
+		ret = 0;
+
+		for (size_t i = skip; i < (size_t)udl; i++) {
+			int octet = octet_get(&r);
+
+			if (octet < 0) {
+				return -EINVAL;
+			}
+
+			out->text[ret++] = octet;
+		}
+		break;
+	}
+
+	if (ret < 0) {
+		return ret;
+	}
+
+	out->text_len = ret;
+	out->text[ret] = '\0';
+
+	return 0;
+}
+
+void sms_deliver_reassembly_reset(struct sms_deliver_reassembly *ctx)
+{
+	ctx->ref = 0;
+	ctx->total = 0;
+	ctx->received = 0;
+	ctx->received_mask = 0;
+}
+
+int sms_deliver_reassembly_add(struct sms_deliver_reassembly *ctx,
+			       const struct sms_deliver *part)
+{
+	const struct sms_deliver_concat *concat = &part->concat;
+
+	if (!concat->present || concat->seq == 0 ||
+	    concat->seq > concat->total) {
+		return -EINVAL;
+	}
+
+	if (concat->total > CONFIG_SMS_DELIVER_CONCAT_MAX_PARTS) {
+		return -ENOMEM;
+	}
+
+	if (ctx->received == 0 || ctx->ref != concat->ref ||
+	    ctx->total != concat->total) {
+		/* A new message, drop what was collected so far. */
+		sms_deliver_reassembly_reset(ctx);
+		ctx->ref = concat->ref;
+		ctx->total = concat->total;
+	}
+
+	if ((ctx->received_mask & BIT(concat->seq - 1)) == 0) {
+		memcpy(ctx->part[concat->seq - 1], part->text, part->text_len);
+		ctx->part_len[concat->seq - 1] = part->text_len;
+		ctx->received_mask |= BIT(concat->seq - 1);
+		ctx->received++;
+	}
+
+	return (ctx->received == ctx->total) ? 1 : 0;
+}
+
+int sms_deliver_reassembly_get(struct sms_deliver_reassembly *ctx,
+			       u8_t *buf, size_t buf_len)
+{
+	size_t len = 0;
+
+	if (ctx->received == 0 || ctx->received != ctx->total) {
+		return -EAGAIN;
+	}
+
+	for (size_t i = 0; i < ctx->total; i++) {
+		if (len + ctx->part_len[i] + 1 > buf_len) {
+			return -ENOMEM;
+		}
+
+		memcpy(&buf[len], ctx->part[i], ctx->part_len[i]);
+		len += ctx->part_len[i];
+	}
+
+	buf[len] = '\0';
+	sms_deliver_reassembly_reset(ctx);
+
+	return len;
+}
@@ -0,0 +1,385 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+
+"""Create and apply delta patches for the delta DFU target.
+
+A patch describes the new image in the style of bsdiff: regions of the new
+image that approximately match the old image are stored as the byte by byte
+difference to the old image, and other data is stored as is. Code that
+moves between images mostly differs in a few address bytes, so the
+differences are mostly zero. Runs of zeros are stored as copies from the
+old image, which keeps the patch small without compressing it.
+
+The patch is applied against the image in the MCUboot primary slot, so the
+old image must be the signed image that is currently running, for example
+build/zephyr/app_update.bin of the running version.
+
+Example:
+    delta_patch.py create old/app_update.bin new/app_update.bin patch.bin
+    delta_patch.py apply old/app_update.bin patch.bin new.bin
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = 0x31544c44  # "DLT1"
+HEADER = struct.Struct("<IIII")
+
+# Length of the blocks used to find matches between the images
+BLOCK_LEN = 8
+
+# Number of old image positions remembered for each block
+MAX_CANDIDATES = 8
+
+# A match is extended until it has this many more mismatches than matches
+MAX_MISMATCH = 32
+
+# Shorter runs of equal bytes are stored as part of a diff
+MIN_COPY_LEN = 4
+
+# Fields of a patch record, in order
+FIELDS = ("copy", "diff", "extra", "adjust")
+
+
+def varint(value):
+    """Encode an unsigned integer as LEB128."""
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def index_build(old):
+    """Map blocks of the old image to their positions.
+
+    Blocks occurring more often than MAX_CANDIDATES times say little about
+    where the new image matches the old one, and are left out.
+    """
+    index = {}
+    for pos in range(len(old) - BLOCK_LEN + 1):
+        index.setdefault(old[pos:pos + BLOCK_LEN], []).append(pos)
+    return {block: positions for block, positions in index.items()
+            if len(positions) <= MAX_CANDIDATES}
+
+
+def match_len(old, old_pos, new, new_pos, limit=None):
+    if limit is None:
+        limit = min(len(old) - old_pos, len(new) - new_pos)
+    length = 0
+    while length < limit and old[old_pos + length] == new[new_pos + length]:
+        length += 1
+    return length
+
+
+def match_extend(old, old_pos, new, new_pos, limit, step=1):
+    """Extend a match with bytes that mostly match, return its length.
+
+    The match is extended forward from the given positions, or backward
+    from the bytes before them if step is -1. It is cut where the
+    difference between the number of matching and mismatching bytes is the
+    largest, as bsdiff does.
+    """
+    score = 0
+    best_score = 0
+    best_len = 0
+
+    if step < 0:
+        old_pos -= 1
+        new_pos -= 1
+        limit = min(limit, old_pos + 1, new_pos + 1)
+    else:
+        limit = min(limit, len(old) - old_pos, len(new) - new_pos)
+
+    for length in range(1, limit + 1):
+        if old[old_pos] == new[new_pos]:
+            score += 1
+        else:
+            score -= 1
+        old_pos += step
+        new_pos += step
+
+        if score > best_score:
+            best_score = score
+            best_len = length
+        elif score < best_score - MAX_MISMATCH:
+            break
+
+    return best_len
+
+
+def matches_find(old, new):
+    """Return a list of (new_pos, old_pos, length) of approximate matches."""
+    index = index_build(old)
+    matches = []
+    new_pos = 0
+    # End of the last match in both images
+    last_new = 0
+    last_old = 0
+
+    while new_pos < len(new):
+        # Continue where the last match ended if the images still match
+        length = match_extend(old, last_old, new, new_pos, len(new))
+        if length >= BLOCK_LEN:
+            old_pos = last_old
+        else:
+            candidates = index.get(new[new_pos:new_pos + BLOCK_LEN], [])
+            if not candidates:
+                new_pos += 1
+                continue
+
+            old_pos = max(candidates, key=lambda pos: match_extend(
+                old, pos, new, new_pos, len(new)))
+            length = match_extend(old, old_pos, new, new_pos, len(new))
+
+            # Include the preceding bytes that match as well
+            back = match_extend(old, old_pos, new, new_pos,
+                                new_pos - last_new, -1)
+            new_pos -= back
+            old_pos -= back
+            length += back
+
+        if length == 0:
+            new_pos += 1
+            continue
+
+        matches.append((new_pos, old_pos, length))
+        new_pos += length
+        last_new = new_pos
+        last_old = old_pos + length
+
+    return matches
+
+
+def diff_ops(old, old_pos, new, new_pos, length):
+    """Return copy and diff operations for an approximate match."""
+    ops = []
+    start = 0
+    pos = 0
+
+    while pos < length:
+        if old[old_pos + pos] != new[new_pos + pos]:
+            pos += 1
+            continue
+
+        run = match_len(old, old_pos + pos, new, new_pos + pos,
+                        length - pos)
+        if run < MIN_COPY_LEN and pos + run < length:
+            pos += run
+            continue
+
+        if pos > start:
+            ops.append(("diff", bytes(
+                (new[new_pos + k] - old[old_pos + k]) & 0xFF
+                for k in range(start, pos))))
+        ops.append(("copy", run))
+        pos += run
+        start = pos
+
+    if pos > start:
+        ops.append(("diff", bytes(
+            (new[new_pos + k] - old[old_pos + k]) & 0xFF
+            for k in range(start, pos))))
+
+    return ops
+
+
+def patch_ops(old, new):
+    """Return the operations creating the new image from the old one."""
+    ops = []
+    new_pos = 0
+    old_pos = 0
+
+    for match_new, match_old, length in matches_find(old, new):
+        if match_new > new_pos:
+            ops.append(("extra", new[new_pos:match_new]))
+        if match_old != old_pos:
+            ops.append(("adjust", match_old - old_pos))
+        ops += diff_ops(old, match_old, new, match_new, length)
+        new_pos = match_new + length
+        old_pos = match_old + length
+
+    if new_pos < len(new):
+        ops.append(("extra", new[new_pos:]))
+
+    return ops
+
+
+def patch_create(old, new):
+    patch = bytearray(HEADER.pack(MAGIC, len(old), zlib.crc32(old),
+                                  len(new)))
+    field = 0
+    written = 0
+
+    for kind, value in patch_ops(old, new):
+        # Fields not used by the operation are written as zero
+        while FIELDS[field] != kind:
+            patch += varint(0)
+            field = (field + 1) % len(FIELDS)
+
+        if kind == "copy":
+            patch += varint(value)
+            written += value
+        elif kind == "adjust":
+            patch += varint(zigzag(value))
+        else:
+            patch += varint(len(value)) + value
+            written += len(value)
+
+        field = (field + 1) % len(FIELDS)
+
+        # The patch ends as soon as the new image is complete
+        if written == len(new):
+            break
+
+    return bytes(patch)
+
+
+class PatchError(Exception):
+    pass
+
+
+class PatchReader:
+    def __init__(self, patch):
+        self.patch = patch
+        self.pos = 0
+
+    def read(self, length):
+        if self.pos + length > len(self.patch):
+            raise PatchError("Patch truncated")
+        data = self.patch[self.pos:self.pos + length]
+        self.pos += length
+        return data
+
+    def varint(self):
+        value = 0
+        shift = 0
+        while True:
+            byte = self.read(1)[0]
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value
+
+
+def patch_apply(old, patch):
+    reader = PatchReader(patch)
+    magic, old_size, old_crc, new_size = HEADER.unpack(
+        reader.read(HEADER.size))
+
+    if magic != MAGIC:
+        raise PatchError("Not a delta patch")
+    if old_size != len(old) or zlib.crc32(old) != old_crc:
+        raise PatchError("Patch does not apply to the old image")
+
+    new = bytearray()
+    old_pos = 0
+    field = 0
+
+    while len(new) < new_size:
+        kind = FIELDS[field]
+        field = (field + 1) % len(FIELDS)
+        value = reader.varint()
+
+        if kind == "adjust":
+            old_pos += (value >> 1) ^ -(value & 1)
+            if not 0 <= old_pos <= len(old):
+                raise PatchError("Patch seeks outside the old image")
+            continue
+
+        if len(new) + value > new_size:
+            raise PatchError("Patch exceeds the new image size")
+
+        if kind == "extra":
+            new += reader.read(value)
+            continue
+
+        if old_pos + value > len(old):
+            raise PatchError("Patch reads past the end of the old image")
+
+        if kind == "copy":
+            new += old[old_pos:old_pos + value]
+        else:
+            new += bytes((d + o) & 0xFF for d, o in
+                         zip(reader.read(value), old[old_pos:old_pos + value]))
+        old_pos += value
+
+    if reader.pos != len(patch):
+        raise PatchError("Data after the end of the patch")
+
+    return bytes(new)
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description="Create and apply delta patches for the delta DFU "
+                    "target.",
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    subparsers = parser.add_subparsers(dest="command")
+    subparsers.required = True
+
+    create = subparsers.add_parser("create", help="Create a patch.")
+    create.add_argument("old", help="Image the patch applies to.")
+    create.add_argument("new", help="Image created by the patch.")
+    create.add_argument("patch", help="Output patch file.")
+
+    apply = subparsers.add_parser("apply", help="Apply a patch.")
+    apply.add_argument("old", help="Image the patch applies to.")
+    apply.add_argument("patch", help="Patch file.")
+    apply.add_argument("new", help="Output image file.")
+
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+
+    with open(args.old, "rb") as f:
+        old = f.read()
+
+    if args.command == "create":
+        with open(args.new, "rb") as f:
+            new = f.read()
+
+        if not new:
+            sys.exit("The new image is empty")
+
+        patch = patch_create(old, new)
+
+        # Verify the patch before handing it out
+        if patch_apply(old, patch) != new:
+            sys.exit("Patch verification failed")
+
+        with open(args.patch, "wb") as f:
+            f.write(patch)
+
+        print("Patch size {} bytes, new image {} bytes".format(
+            len(patch), len(new)))
+    else:
+        with open(args.patch, "rb") as f:
+            patch = f.read()
+
+        try:
+            new = patch_apply(old, patch)
+        except PatchError as e:
+            sys.exit(str(e))
+
+        with open(args.new, "wb") as f:
+            f.write(new)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+
+"""Compress images for the compressed DFU target.
+
+The image is compressed with LZSS into a heatshrink style bit stream. The
+device decompresses it with a window of 2^window-bits bytes of RAM, so the
+window size must not be larger than what the device is configured for,
+see CONFIG_DFU_TARGET_COMPRESSED_WINDOW_BITS.
+
+Example:
+    image_compress.py compress app_update.bin app_update.lz
+    image_compress.py decompress app_update.lz app_update.bin
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = 0x315a4c44  # "DLZ1"
+HEADER = struct.Struct("<IBBHII")
+
+# Number of earlier positions tried for each match
+MAX_CHAIN = 128
+
+
+class BitWriter:
+    def __init__(self):
+        self.data = bytearray()
+        self.byte = 0
+        self.count = 0
+
+    def write(self, value, bits):
+        for bit in range(bits - 1, -1, -1):
+            self.byte = (self.byte << 1) | ((value >> bit) & 1)
+            self.count += 1
+            if self.count == 8:
+                self.data.append(self.byte)
+                self.byte = 0
+                self.count = 0
+
+    def flush(self):
+        if self.count:
+            self.data.append(self.byte << (8 - self.count))
+            self.byte = 0
+            self.count = 0
+        return bytes(self.data)
+
+
+class BitReader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def read(self, bits):
+        value = 0
+        for _ in range(bits):
+            if self.pos >= len(self.data) * 8:
+                raise ValueError("Compressed data truncated")
+            byte = self.data[self.pos // 8]
+            value = (value << 1) | ((byte >> (7 - self.pos % 8)) & 1)
+            self.pos += 1
+        return value
+
+
+def compress(image, window_bits, length_bits):
+    window = 1 << window_bits
+    max_len = 1 << length_bits
+    # A back-reference must be shorter than the literals it replaces
+    min_len = (1 + window_bits + length_bits) // 9 + 1
+
+    writer = BitWriter()
+    # Last position of each pair of bytes, and the previous position of the
+    # same pair for each position.
+    head = {}
+    prev = [None] * len(image)
+    pos = 0
+
+    def insert(i):
+        if i + 1 < len(image):
+            key = image[i:i + 2]
+            prev[i] = head.get(key)
+            head[key] = i
+
+    while pos < len(image):
+        best_len = 0
+        best_dist = 0
+
+        if pos + 1 < len(image):
+            candidate = head.get(image[pos:pos + 2])
+            limit = min(max_len, len(image) - pos)
+            for _ in range(MAX_CHAIN):
+                if candidate is None or pos - candidate > window:
+                    break
+                length = 0
+                while length < limit and \
+                        image[candidate + length] == image[pos + length]:
+                    length += 1
+                if length > best_len:
+                    best_len = length
+                    best_dist = pos - candidate
+                    if length == limit:
+                        break
+                candidate = prev[candidate]
+
+        if best_len >= min_len:
+            writer.write(0, 1)
+            writer.write(best_dist - 1, window_bits)
+            writer.write(best_len - 1, length_bits)
+        else:
+            best_len = 1
+            writer.write(1, 1)
+            writer.write(image[pos], 8)
+
+        for i in range(pos, pos + best_len):
+            insert(i)
+        pos += best_len
+
+    header = HEADER.pack(MAGIC, window_bits, length_bits, 0, len(image),
+                         zlib.crc32(image))
+    return header + writer.flush()
+
+
+def decompress(data):
+    magic, window_bits, length_bits, _, size, crc = \
+        HEADER.unpack(data[:HEADER.size])
+    if magic != MAGIC:
+        raise ValueError("Not a compressed image")
+
+    reader = BitReader(data[HEADER.size:])
+    image = bytearray()
+
+    while len(image) < size:
+        if reader.read(1):
+            image.append(reader.read(8))
+            continue
+
+        distance = reader.read(window_bits) + 1
+        length = reader.read(length_bits) + 1
+        if distance > len(image) or len(image) + length > size:
+            raise ValueError("Invalid back-reference")
+        for _ in range(length):
+            image.append(image[-distance])
+
+    if (reader.pos + 7) // 8 != len(data) - HEADER.size:
+        raise ValueError("Data after the end of the image")
+    if zlib.crc32(image) != crc:
+        raise ValueError("Checksum mismatch")
+
+    return bytes(image)
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description="Compress images for the compressed DFU target.",
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    subparsers = parser.add_subparsers(dest="command")
+    subparsers.required = True
+
+    comp = subparsers.add_parser("compress", help="Compress an image.")
+    comp.add_argument("input", help="Image to compress.")
+    comp.add_argument("output", help="Output file.")
+    comp.add_argument("--window-bits", type=int, default=10,
+                      choices=range(4, 16),
+                      help="Window size in bits, the device needs this "
+                           "much RAM to decompress the image. Default 10.")
+    comp.add_argument("--length-bits", type=int, default=4,
+                      help="Maximum back-reference length in bits, must be "
+                           "less than the window size. Default 4.")
+
+    decomp = subparsers.add_parser("decompress",
+                                   help="Decompress an image.")
+    decomp.add_argument("input", help="Compressed image.")
+    decomp.add_argument("output", help="Output file.")
+
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+
+    with open(args.input, "rb") as f:
+        data = f.read()
+
+    if args.command == "compress":
+        if not data:
+            sys.exit("The image is empty")
+        if not 3 <= args.length_bits < args.window_bits:
+            sys.exit("Length bits must be at least 3 and less than the "
+                     "window bits")
+
+        out = compress(data, args.window_bits, args.length_bits)
+
+        # Verify the compressed image before handing it out
+        if decompress(out) != data:
+            sys.exit("Verification failed")
+
+        print("Compressed {} bytes to {} bytes".format(len(data), len(out)))
+    else:
+        try:
+            out = decompress(data)
+        except ValueError as e:
+            sys.exit(str(e))
+
+    with open(args.output, "wb") as f:
+        f.write(out)
+
+
+if __name__ == "__main__":
+    main()
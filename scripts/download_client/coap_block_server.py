@@ -0,0 +1,267 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+
+"""Minimal CoAP server serving files with block-wise transfers (RFC 7959).
+
+Intended for testing the CoAP transport of the download client on a host,
+without depending on a full CoAP implementation. Only GET requests with the
+Uri-Path, Block2 and Size2 options are supported. Packet loss and a maximum
+block size can be configured to exercise retransmissions and block size
+negotiation.
+
+Example:
+    coap_block_server.py --root build/zephyr --port 5683 --loss 0.1
+"""
+
+import argparse
+import os
+import random
+import socket
+import struct
+import sys
+
+VERSION = 1
+
+TYPE_CON = 0
+TYPE_NON = 1
+TYPE_ACK = 2
+TYPE_RST = 3
+
+CODE_GET = 0x01
+CODE_CONTENT = 0x45
+CODE_BAD_REQUEST = 0x80
+CODE_BAD_OPTION = 0x82
+CODE_NOT_FOUND = 0x84
+CODE_METHOD_NOT_ALLOWED = 0x85
+
+OPTION_URI_PATH = 11
+OPTION_BLOCK2 = 23
+OPTION_SIZE2 = 28
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description="Serve files over CoAP with block-wise transfers.",
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+
+    parser.add_argument("--root", default=".",
+                        help="Directory to serve files from.")
+    parser.add_argument("--address", default="0.0.0.0",
+                        help="Address to listen on.")
+    parser.add_argument("--port", type=int, default=5683,
+                        help="UDP port to listen on.")
+    parser.add_argument("--max-block-size", type=int, default=1024,
+                        choices=[16, 32, 64, 128, 256, 512, 1024],
+                        help="Largest block size to send. Larger requests "
+                             "are answered with this block size.")
+    parser.add_argument("--loss", type=float, default=0.0,
+                        help="Probability of dropping a request, for "
+                             "testing retransmissions.")
+    parser.add_argument("--no-size2", action="store_true",
+                        help="Do not send the Size2 option.")
+    parser.add_argument("--verbose", "-v", action="store_true",
+                        help="Print every request.")
+    return parser.parse_args()
+
+
+def decode_uint(value):
+    return int.from_bytes(value, "big") if value else 0
+
+
+def encode_uint(value):
+    length = (value.bit_length() + 7) // 8
+    return value.to_bytes(length, "big")
+
+
+def option_nibble(value):
+    """Return the nibble and extended bytes of an option delta or length."""
+    if value < 13:
+        return value, b""
+    if value < 269:
+        return 13, struct.pack("!B", value - 13)
+    return 14, struct.pack("!H", value - 269)
+
+
+def parse_message(data):
+    """Parse a CoAP message, return None if malformed."""
+    if len(data) < 4:
+        return None
+
+    first, code, mid = struct.unpack("!BBH", data[:4])
+    if first >> 6 != VERSION:
+        return None
+
+    tkl = first & 0x0F
+    if tkl > 8 or len(data) < 4 + tkl:
+        return None
+
+    msg = {
+        "type": (first >> 4) & 0x03,
+        "code": code,
+        "mid": mid,
+        "token": data[4:4 + tkl],
+        "options": [],
+        "payload": b"",
+    }
+
+    pos = 4 + tkl
+    number = 0
+
+    while pos < len(data):
+        if data[pos] == 0xFF:
+            msg["payload"] = data[pos + 1:]
+            break
+
+        delta = data[pos] >> 4
+        length = data[pos] & 0x0F
+        pos += 1
+
+        for field in ("delta", "length"):
+            nibble = delta if field == "delta" else length
+            if nibble == 13:
+                nibble = data[pos] + 13
+                pos += 1
+            elif nibble == 14:
+                nibble = struct.unpack("!H", data[pos:pos + 2])[0] + 269
+                pos += 2
+            elif nibble == 15:
+                return None
+            if field == "delta":
+                delta = nibble
+            else:
+                length = nibble
+
+        number += delta
+        msg["options"].append((number, data[pos:pos + length]))
+        pos += length
+
+    return msg
+
+
+def build_message(msg_type, code, mid, token, options=(), payload=b""):
+    data = struct.pack("!BBH", (VERSION << 6) | (msg_type << 4) | len(token),
+                       code, mid) + token
+    number = 0
+
+    for option, value in sorted(options, key=lambda o: o[0]):
+        delta, delta_ext = option_nibble(option - number)
+        length, length_ext = option_nibble(len(value))
+        data += struct.pack("!B", (delta << 4) | length)
+        data += delta_ext + length_ext + value
+        number = option
+
+    if payload:
+        data += b"\xFF" + payload
+
+    return data
+
+
+def option_get(msg, number):
+    for option, value in msg["options"]:
+        if option == number:
+            return value
+    return None
+
+
+class BlockServer:
+    def __init__(self, args):
+        self.args = args
+        self.root = os.path.realpath(args.root)
+        self.max_szx = args.max_block_size.bit_length() - 5
+
+    def file_read(self, segments):
+        path = os.path.realpath(os.path.join(self.root, *segments))
+        if not path.startswith(self.root + os.sep) or \
+                not os.path.isfile(path):
+            return None
+        with open(path, "rb") as f:
+            return f.read()
+
+    def handle(self, req):
+        """Return the response code, options and payload for a request."""
+        if req["code"] != CODE_GET:
+            return CODE_METHOD_NOT_ALLOWED, [], b""
+
+        segments = [value.decode("utf-8", "replace")
+                    for option, value in req["options"]
+                    if option == OPTION_URI_PATH]
+
+        content = self.file_read(segments)
+        if content is None:
+            return CODE_NOT_FOUND, [], b""
+
+        block2 = option_get(req, OPTION_BLOCK2)
+        if block2 is None:
+            num, szx = 0, self.max_szx
+        else:
+            block2 = decode_uint(block2)
+            num, szx = block2 >> 4, block2 & 0x07
+            if szx == 7:
+                return CODE_BAD_REQUEST, [], b""
+
+        if szx > self.max_szx:
+            # Answer with a smaller block containing the requested offset
+            num <<= szx - self.max_szx
+            szx = self.max_szx
+
+        size = 1 << (szx + 4)
+        offset = num * size
+
+        if offset > len(content) or (offset == len(content) and num > 0):
+            return CODE_BAD_OPTION, [], b""
+
+        payload = content[offset:offset + size]
+        more = offset + size < len(content)
+
+        options = [(OPTION_BLOCK2,
+                    encode_uint((num << 4) | (int(more) << 3) | szx))]
+
+        if option_get(req, OPTION_SIZE2) is not None and \
+                not self.args.no_size2:
+            options.append((OPTION_SIZE2, encode_uint(len(content))))
+
+        if self.args.verbose:
+            print("GET /{} block {} ({} bytes){}".format(
+                "/".join(segments), num, size, "" if more else ", last"))
+
+        return CODE_CONTENT, options, payload
+
+    def serve(self):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        sock.bind((self.args.address, self.args.port))
+
+        print("Serving {} on coap://{}:{}".format(
+            self.root, self.args.address, sock.getsockname()[1]))
+        sys.stdout.flush()
+
+        while True:
+            data, addr = sock.recvfrom(2048)
+
+            if random.random() < self.args.loss:
+                if self.args.verbose:
+                    print("Dropping request")
+                continue
+
+            req = parse_message(data)
+            if req is None:
+                continue
+
+            if req["type"] == TYPE_CON:
+                resp_type = TYPE_ACK
+            elif req["type"] == TYPE_NON:
+                resp_type = TYPE_NON
+            else:
+                # Nothing to do for acknowledgments and resets
+                continue
+
+            code, options, payload = self.handle(req)
+            sock.sendto(build_message(resp_type, code, req["mid"],
+                                      req["token"], options, payload), addr)
+
+
+if __name__ == "__main__":
+    BlockServer(parse_args()).serve()
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/** @file dfu_target_compressed.h
+ *
+ * @defgroup dfu_target_compressed Compressed DFU Target
+ * @{
+ * @brief DFU Target for compressed MCUboot images
+ *
+ * The image is decompressed while it is received, and written to the
+ * secondary slot through the MCUboot DFU target. Images are compressed with
+ * scripts/dfu/image_compress.py.
+ */
+
+#ifndef DFU_TARGET_COMPRESSED_H__
+#define DFU_TARGET_COMPRESSED_H__
+
+#include <stddef.h>
+#include <dfu/dfu_target.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief See if data in buf indicates a compressed image.
+ *
+ * @retval true if data matches, false otherwise.
+ */
+bool dfu_target_compressed_identify(const void *const buf);
+
+/**
+ * @brief Initialize dfu target, perform steps necessary to receive an image.
+ *
+ * @param[in] file_size Size of the compressed image being downloaded.
+ * @param[in] cb Callback for signaling events(unused).
+ *
+ * @retval 0 If successful, negative errno otherwise.
+ */
+int dfu_target_compressed_init(size_t file_size, dfu_target_callback_t cb);
+
+/**
+ * @brief Get offset of the compressed image.
+ *
+ * The state of the decompression is not retained across resets, so a
+ * download can only be resumed while the device is running.
+ *
+ * @param[out] offset Returns the number of compressed bytes processed.
+ *
+ * @return 0 if success, otherwise negative value if unable to get the offset
+ */
+int dfu_target_compressed_offset_get(size_t *offset);
+
+/**
+ * @brief Decompress and write the next part of the image.
+ *
+ * @param[in] buf Pointer to compressed data.
+ * @param[in] len Length of compressed data.
+ *
+ * @retval 0 on success.
+ * @retval -EINVAL if the compressed data is malformed.
+ * @retval -ENOTSUP if the image was compressed with a larger window than
+ *	   supported.
+ * @retval -EFBIG if the image does not fit in the secondary slot.
+ * @return Other negative errno on flash errors.
+ */
+int dfu_target_compressed_write(const void *const buf, size_t len);
+
+/**
+ * @brief Deinitialize resources and schedule the upgrade if successful.
+ *
+ * @param[in] successful Indicate whether the image was successfully received.
+ *
+ * @retval 0 on success.
+ * @retval -EINVAL if successful is set but the image is incomplete or its
+ *	   checksum does not match.
+ * @return Other negative errno if the upgrade could not be scheduled.
+ */
+int dfu_target_compressed_done(bool successful);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DFU_TARGET_COMPRESSED_H__ */
+
+/**@} */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/** @file dfu_target_delta.h
+ *
+ * @defgroup dfu_target_delta Delta DFU Target
+ * @{
+ * @brief DFU Target for application updates delivered as a delta patch
+ *
+ * The patch is applied against the image in the MCUboot primary slot while it
+ * is received, and the resulting image is written to the secondary slot
+ * through the MCUboot DFU target. Patches are created with
+ * scripts/dfu/delta_patch.py.
+ */
+
+#ifndef DFU_TARGET_DELTA_H__
+#define DFU_TARGET_DELTA_H__
+
+#include <stddef.h>
+#include <dfu/dfu_target.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief See if data in buf indicates a delta patch.
+ *
+ * @retval true if data matches, false otherwise.
+ */
+bool dfu_target_delta_identify(const void *const buf);
+
+/**
+ * @brief Initialize dfu target, perform steps necessary to receive a patch.
+ *
+ * @param[in] file_size Size of the patch being downloaded.
+ * @param[in] cb Callback for signaling events(unused).
+ *
+ * @retval 0 If successful, negative errno otherwise.
+ */
+int dfu_target_delta_init(size_t file_size, dfu_target_callback_t cb);
+
+/**
+ * @brief Get offset of the patch.
+ *
+ * The state of the patch process is not retained across resets, so a patch
+ * can only be resumed while the device is running.
+ *
+ * @param[out] offset Returns the number of patch bytes processed.
+ *
+ * @return 0 if success, otherwise negative value if unable to get the offset
+ */
+int dfu_target_delta_offset_get(size_t *offset);
+
+/**
+ * @brief Apply the next part of the patch.
+ *
+ * @param[in] buf Pointer to patch data.
+ * @param[in] len Length of patch data.
+ *
+ * @retval 0 on success.
+ * @retval -EINVAL if the patch is malformed or does not apply to the
+ *	   image in the primary slot.
+ * @retval -EFBIG if the resulting image does not fit in the secondary slot.
+ * @return Other negative errno on flash errors.
+ */
+int dfu_target_delta_write(const void *const buf, size_t len);
+
+/**
+ * @brief Deinitialize resources and schedule the upgrade if successful.
+ *
+ * @param[in] successful Indicate whether the patch was successfully received.
+ *
+ * @retval 0 on success.
+ * @retval -EINVAL if successful is set but the patch is incomplete.
+ * @return Other negative errno if the upgrade could not be scheduled.
+ */
+int dfu_target_delta_done(bool successful);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DFU_TARGET_DELTA_H__ */
+
+/**@} */
@@ -30,6 +30,11 @@ bool dfu_target_modem_identify(const void *const buf);
 /**
  * @brief Initialize dfu target, perform steps necessary to receive firmware.
  *
+ * If the modem holds an old firmware patch, it is deleted in the background.
+ * Calling this function again before dfu_target_modem_done only updates the
+ * callback and checks the file size, so the target can be initialized before
+ * the size of the file is known.
+ *
  * @param[in] file_size Size of the current file being downloaded.
  * @param[in] callback Callback function for signaling if the modem is not able
  *		       to service the erase request.
@@ -41,7 +46,9 @@ int dfu_target_modem_init(size_t file_size, dfu_target_callback_t callback);
 /**
  * @brief Get offset of firmware
  *
- * @param[out] offset Returns the offset of the firmware upgrade.
+ * @param[out] offset Returns the offset of the firmware upgrade, that is the
+ *		      number of bytes stored by the modem. Queued data is not
+ *		      included.
  *
  * @return 0 if success, otherwise negative value if unable to get the offset
  */
@@ -50,16 +57,25 @@ int dfu_target_modem_offset_get(size_t *offset);
 /**
  * @brief Write firmware data.
  *
+ * The data is queued and sent to the modem from the system work queue. This
+ * function blocks only while the queue is full, so it must not be called from
+ * the system work queue.
+ *
  * @param[in] buf Pointer to data that should be written.
  * @param[in] len Length of data to write.
  *
- * @return 0 on success, negative errno otherwise.
+ * @return 0 on success, negative errno if sending earlier data to the modem
+ *	   failed.
  */
 int dfu_target_modem_write(const void *const buf, size_t len);
 
 /**
  * @brief Deinitialize resources and finalize firmware upgrade if successful.
  *
+ * Waits until the queued data has been sent to the modem. If the upgrade is
+ * aborted, the queued data is dropped instead. Must not be called from the
+ * system work queue.
+ *
  * @param[in] successful Indicate whether the firmware was successfully recived.
  *
  * @return 0 on success, negative errno otherwise.
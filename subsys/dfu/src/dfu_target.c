@@ -3,12 +3,16 @@
  *
  * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
  */
+#include <string.h>
 #include <zephyr.h>
 #include <logging/log.h>
 #include <dfu/mcuboot.h>
 #include <dfu/dfu_target.h>
+#include <settings/settings.h>
 #include "dfu_target_mcuboot.h"
 #include "dfu_target_modem.h"
+#include "dfu_target_delta.h"
+#include "dfu_target_compressed.h"
 
 #ifdef CONFIG_DFU_TARGET_MODEM
 const struct dfu_target dfu_target_modem = {
@@ -28,12 +32,133 @@ const struct dfu_target dfu_target_mcuboot = {
 };
 #endif
 
+#ifdef CONFIG_DFU_TARGET_DELTA
+const struct dfu_target dfu_target_delta = {
+	.init  = dfu_target_delta_init,
+	.offset_get = dfu_target_delta_offset_get,
+	.write = dfu_target_delta_write,
+	.done  = dfu_target_delta_done,
+};
+#endif
+
+#ifdef CONFIG_DFU_TARGET_COMPRESSED
+const struct dfu_target dfu_target_compressed = {
+	.init  = dfu_target_compressed_init,
+	.offset_get = dfu_target_compressed_offset_get,
+	.write = dfu_target_compressed_write,
+	.done  = dfu_target_compressed_done,
+};
+#endif
+
 #define MIN_SIZE_IDENTIFY_BUF 32
 
 LOG_MODULE_REGISTER(dfu_target, CONFIG_DFU_TARGET_LOG_LEVEL);
 
 static const struct dfu_target *current_target;
 
+/* Image type and file size of the download in progress. An image type of 0
+ * means that no download is in progress.
+ */
+struct dfu_target_ctx {
+	int img_type;
+	size_t file_size;
+};
+
+static struct dfu_target_ctx ctx;
+
+#ifdef CONFIG_DFU_TARGET_SAVE_CONTEXT
+#define MODULE "dfu_target"
+#define FILE_CTX "ctx"
+
+/**
+ * @brief Function used by settings_load() to restore the context.
+ *	  See the Zephyr documentation of the settings subsystem for more
+ *	  information.
+ */
+static int settings_set(const char *key, size_t len_rd,
+			settings_read_cb read_cb, void *cb_arg)
+{
+	if (!strcmp(key, FILE_CTX)) {
+		ssize_t len = read_cb(cb_arg, &ctx, sizeof(ctx));
+
+		if (len != sizeof(ctx)) {
+			LOG_ERR("Can't read context from storage");
+			ctx.img_type = 0;
+			return len;
+		}
+	}
+
+	return 0;
+}
+
+static int ctx_load(void)
+{
+	static bool loaded;
+	static struct settings_handler sh = {
+		.name = MODULE,
+		.h_set = settings_set,
+	};
+	int err;
+
+	if (loaded) {
+		return 0;
+	}
+
+	/* settings_subsys_init is idempotent so this is safe to do. */
+	err = settings_subsys_init();
+	if (err) {
+		LOG_ERR("settings_subsys_init failed (err %d)", err);
+		return err;
+	}
+
+	err = settings_register(&sh);
+	if (err) {
+		LOG_ERR("Cannot register settings (err %d)", err);
+		return err;
+	}
+
+	err = settings_load();
+	if (err) {
+		LOG_ERR("Cannot load settings (err %d)", err);
+		return err;
+	}
+
+	loaded = true;
+
+	return 0;
+}
+
+static void ctx_store(void)
+{
+	int err = settings_save_one(MODULE "/" FILE_CTX, &ctx, sizeof(ctx));
+
+	if (err) {
+		/* The download can still be resumed after the first
+		 * fragment has been received.
+		 */
+		LOG_WRN("Unable to store context: %d", err);
+	}
+}
+#else
+static inline int ctx_load(void)
+{
+	return 0;
+}
+
+static inline void ctx_store(void) {}
+#endif /* CONFIG_DFU_TARGET_SAVE_CONTEXT */
+
+static void ctx_set(int img_type, size_t file_size)
+{
+	if (ctx.img_type == img_type && ctx.file_size == file_size) {
+		return;
+	}
+
+	ctx.img_type = img_type;
+	ctx.file_size = file_size;
+	ctx_store();
+}
+
 int dfu_target_img_type(const void *const buf, size_t len)
 {
 	if (IS_ENABLED(CONFIG_DFU_TARGET_MCUBOOT) &&
@@ -46,6 +171,16 @@ int dfu_target_img_type(const void *const buf, size_t len)
 		return DFU_TARGET_IMAGE_TYPE_MODEM_DELTA;
 	}
 
+	if (IS_ENABLED(CONFIG_DFU_TARGET_DELTA) &&
+	    dfu_target_delta_identify(buf)) {
+		return DFU_TARGET_IMAGE_TYPE_DELTA;
+	}
+
+	if (IS_ENABLED(CONFIG_DFU_TARGET_COMPRESSED) &&
+	    dfu_target_compressed_identify(buf)) {
+		return DFU_TARGET_IMAGE_TYPE_COMPRESSED;
+	}
+
 	if (len < MIN_SIZE_IDENTIFY_BUF) {
 		return -EAGAIN;
 	}
@@ -56,21 +191,38 @@ int dfu_target_img_type(const void *const buf, size_t len)
 
 int dfu_target_init(int img_type, size_t file_size, dfu_target_callback_t cb)
 {
+	int err;
 	const struct dfu_target *new_target = NULL;
 
-	if (IS_ENABLED(CONFIG_DFU_TARGET_MCUBOOT) &&
-	    img_type == DFU_TARGET_IMAGE_TYPE_MCUBOOT) {
+	/* The targets are only defined when enabled */
+#ifdef CONFIG_DFU_TARGET_MCUBOOT
+	if (img_type == DFU_TARGET_IMAGE_TYPE_MCUBOOT) {
 		new_target = &dfu_target_mcuboot;
-	} else if (IS_ENABLED(CONFIG_DFU_TARGET_MODEM) &&
-		   img_type == DFU_TARGET_IMAGE_TYPE_MODEM_DELTA) {
+	}
+#endif
+#ifdef CONFIG_DFU_TARGET_MODEM
+	if (img_type == DFU_TARGET_IMAGE_TYPE_MODEM_DELTA) {
 		new_target = &dfu_target_modem;
 	}
+#endif
+#ifdef CONFIG_DFU_TARGET_DELTA
+	if (img_type == DFU_TARGET_IMAGE_TYPE_DELTA) {
+		new_target = &dfu_target_delta;
+	}
+#endif
+#ifdef CONFIG_DFU_TARGET_COMPRESSED
+	if (img_type == DFU_TARGET_IMAGE_TYPE_COMPRESSED) {
+		new_target = &dfu_target_compressed;
+	}
+#endif
 
 	if (new_target == NULL) {
 		LOG_ERR("Unknown image type");
 		return -ENOTSUP;
 	}
 
+	(void)ctx_load();
+
 	/* The user is re-initializing with an previously aborted target.
 	 * Avoid re-initializing generally to ensure that the download can
 	 * continue where it left off. Re-initializing is required for modem
@@ -78,12 +230,18 @@ int dfu_target_init(int img_type, size_t file_size, dfu_target_callback_t cb)
 	 */
 	if (new_target == current_target
 	   && img_type != DFU_TARGET_IMAGE_TYPE_MODEM_DELTA) {
+		ctx_set(img_type, file_size);
 		return 0;
 	}
 
 	current_target = new_target;
 
-	return current_target->init(file_size, cb);
+	err = current_target->init(file_size, cb);
+	if (err == 0) {
+		ctx_set(img_type, file_size);
+	}
+
+	return err;
 }
 
 int dfu_target_offset_get(size_t *offset)
@@ -120,7 +278,31 @@ int dfu_target_done(bool successful)
 
 	if (successful) {
 		current_target = NULL;
+		ctx_set(0, 0);
 	}
 
 	return 0;
 }
+
+int dfu_target_context_get(int *img_type, size_t *file_size)
+{
+	int err;
+
+	if (img_type == NULL || file_size == NULL) {
+		return -EINVAL;
+	}
+
+	err = ctx_load();
+	if (err) {
+		return err;
+	}
+
+	if (ctx.img_type == 0) {
+		return -ENOENT;
+	}
+
+	*img_type = ctx.img_type;
+	*file_size = ctx.file_size;
+
+	return 0;
+}
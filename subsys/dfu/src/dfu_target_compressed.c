@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <string.h>
+#include <zephyr.h>
+#include <sys/crc.h>
+#include <sys/byteorder.h>
+#include <pm_config.h>
+#include <logging/log.h>
+#include <dfu/dfu_target.h>
+#include "dfu_target_mcuboot.h"
+#include "dfu_target_compressed.h"
+
+LOG_MODULE_REGISTER(dfu_target_compressed, CONFIG_DFU_TARGET_LOG_LEVEL);
+
+/* Image format, as created by scripts/dfu/image_compress.py.
+ *
+ * The 16 byte header holds, in little endian: a 32-bit magic, the window
+ * size and the lookahead size in bits as one byte each, two reserved
+ * bytes, and the size and CRC-32 of the decompressed image as 32-bit words.
+ *
+ * It is followed by a heatshrink style LZSS bit stream, most significant bit
+ * first. A 1 bit is followed by an 8-bit literal. A 0 bit is followed by the
+ * distance minus one of a back-reference into the already decompressed data,
+ * in window size bits, and its length minus one, in lookahead size bits.
+ * The stream ends when the image is complete.
+ */
+#define COMPRESSED_HEADER_MAGIC 0x315a4c44 /* "DLZ1" */
+#define COMPRESSED_HEADER_SIZE 16
+
+#define WINDOW_SIZE BIT(CONFIG_DFU_TARGET_COMPRESSED_WINDOW_BITS)
+
+enum compressed_state {
+	COMPRESSED_HEADER,
+	COMPRESSED_TAG,
+	COMPRESSED_LITERAL,
+	COMPRESSED_DISTANCE,
+	COMPRESSED_LENGTH,
+	COMPRESSED_DONE,
+};
+
+static struct {
+	enum compressed_state state;
+	u8_t header[COMPRESSED_HEADER_SIZE];
+	size_t header_len;
+	u8_t window_bits;
+	u8_t length_bits;
+	u32_t size;
+	u32_t crc;
+	/* Bits of the current field, and how many have been read */
+	u16_t bits;
+	u8_t bit_count;
+	u16_t distance;
+	/* Decompressed bytes, and the first of them not written to flash */
+	u32_t out;
+	u32_t flushed;
+	/* Bytes of the compressed image processed. Only whole bytes are
+	 * counted, so that a download resumed from here continues with the
+	 * first byte that was not decompressed.
+	 */
+	size_t in;
+} lz;
+
+/* The last decompressed bytes, which back-references refer to */
+static u8_t window[WINDOW_SIZE];
+
+bool dfu_target_compressed_identify(const void *const buf)
+{
+	return sys_get_le32(buf) == COMPRESSED_HEADER_MAGIC;
+}
+
+static int header_parse(void)
+{
+	int err;
+	size_t offset;
+
+	if (sys_get_le32(&lz.header[0]) != COMPRESSED_HEADER_MAGIC) {
+		LOG_ERR("Invalid image header");
+		return -EINVAL;
+	}
+
+	lz.window_bits = lz.header[4];
+	lz.length_bits = lz.header[5];
+	lz.size = sys_get_le32(&lz.header[8]);
+
+	if ((lz.window_bits < 4) || (lz.length_bits < 3) ||
+	    (lz.length_bits >= lz.window_bits) || (lz.size == 0)) {
+		LOG_ERR("Invalid image header");
+		return -EINVAL;
+	}
+
+	if (lz.window_bits > CONFIG_DFU_TARGET_COMPRESSED_WINDOW_BITS) {
+		LOG_ERR("Window of %d bits not supported", lz.window_bits);
+		return -ENOTSUP;
+	}
+
+	if (lz.size > PM_MCUBOOT_SECONDARY_SIZE) {
+		LOG_ERR("Image too big to fit in flash %d > %d",
+			lz.size, PM_MCUBOOT_SECONDARY_SIZE);
+		return -EFBIG;
+	}
+
+	err = dfu_target_mcuboot_init(lz.size, NULL);
+	if (err) {
+		return err;
+	}
+
+	/* The image is decompressed from its start, discard any progress
+	 * stored by an earlier download of an uncompressed image.
+	 */
+	err = dfu_target_mcuboot_offset_get(&offset);
+	if (err) {
+		return err;
+	}
+
+	if (offset != 0) {
+		(void)dfu_target_mcuboot_done(false);
+	}
+
+	LOG_INF("Decompressing %d byte image", lz.size);
+
+	return 0;
+}
+
+/**@brief Write the decompressed data not yet written to flash.
+ *
+ * If a write fails, the data that was written is accounted for, and the
+ * rest is written by the next flush.
+ */
+static int flush(void)
+{
+	int err;
+
+	while (lz.flushed != lz.out) {
+		u32_t start = lz.flushed & (WINDOW_SIZE - 1);
+		u32_t len = MIN(lz.out - lz.flushed, WINDOW_SIZE - start);
+
+		err = dfu_target_mcuboot_write(&window[start], len);
+		if (err) {
+			return err;
+		}
+
+		lz.crc = crc32_ieee_update(lz.crc, &window[start], len);
+		lz.flushed += len;
+	}
+
+	return 0;
+}
+
+static void byte_output(u8_t byte)
+{
+	window[lz.out & (WINDOW_SIZE - 1)] = byte;
+	lz.out++;
+
+	if (lz.out == lz.size) {
+		lz.state = COMPRESSED_DONE;
+	}
+}
+
+static int backref_output(u16_t distance, u16_t length)
+{
+	if (distance > lz.out) {
+		LOG_ERR("Reference before the start of the image");
+		return -EINVAL;
+	}
+
+	if (length > lz.size - lz.out) {
+		LOG_ERR("Reference past the end of the image");
+		return -EINVAL;
+	}
+
+	for (u16_t i = 0; i < length; i++) {
+		byte_output(window[(lz.out - distance) & (WINDOW_SIZE - 1)]);
+	}
+
+	return 0;
+}
+
+/**@brief Process one bit of the compressed stream. */
+static int bit_process(u8_t bit)
+{
+	int err = 0;
+
+	lz.bits = (lz.bits << 1) | bit;
+	lz.bit_count++;
+
+	switch (lz.state) {
+	case COMPRESSED_TAG:
+		lz.state = bit ? COMPRESSED_LITERAL : COMPRESSED_DISTANCE;
+		break;
+	case COMPRESSED_LITERAL:
+		if (lz.bit_count < 8) {
+			return 0;
+		}
+
+		lz.state = COMPRESSED_TAG;
+		byte_output(lz.bits);
+		break;
+	case COMPRESSED_DISTANCE:
+		if (lz.bit_count < lz.window_bits) {
+			return 0;
+		}
+
+		lz.distance = lz.bits + 1;
+		lz.state = COMPRESSED_LENGTH;
+		break;
+	case COMPRESSED_LENGTH:
+		if (lz.bit_count < lz.length_bits) {
+			return 0;
+		}
+
+		lz.state = COMPRESSED_TAG;
+		err = backref_output(lz.distance, lz.bits + 1);
+		break;
+	default:
+		break;
+	}
+
+	/* The field is complete */
+	lz.bits = 0;
+	lz.bit_count = 0;
+
+	return err;
+}
+
+int dfu_target_compressed_init(size_t file_size, dfu_target_callback_t cb)
+{
+	ARG_UNUSED(file_size);
+	ARG_UNUSED(cb);
+
+	memset(&lz, 0, sizeof(lz));
+	lz.state = COMPRESSED_HEADER;
+
+	return 0;
+}
+
+int dfu_target_compressed_offset_get(size_t *offset)
+{
+	*offset = lz.in;
+	return 0;
+}
+
+/**@brief Decompress one byte of the compressed stream.
+ *
+ * Errors are caused by invalid data, and are not recovered from.
+ */
+static int byte_process(u8_t byte)
+{
+	int err;
+
+	for (int bit = 7; bit >= 0; bit--) {
+		err = bit_process((byte >> bit) & 1);
+		if (err) {
+			return err;
+		}
+
+		if (lz.state == COMPRESSED_DONE) {
+			/* The rest of the byte is padding */
+			break;
+		}
+	}
+
+	return 0;
+}
+
+int dfu_target_compressed_write(const void *const buf, size_t len)
+{
+	int err;
+	size_t n;
+	const u8_t *data = buf;
+
+	if (lz.state == COMPRESSED_HEADER) {
+		n = MIN(len, COMPRESSED_HEADER_SIZE - lz.header_len);
+		memcpy(&lz.header[lz.header_len], data, n);
+		lz.header_len += n;
+
+		if (lz.header_len < COMPRESSED_HEADER_SIZE) {
+			lz.in += n;
+			return 0;
+		}
+
+		err = header_parse();
+		if (err) {
+			/* Parse the header again when the write is resumed */
+			lz.header_len -= n;
+			return err;
+		}
+
+		lz.state = COMPRESSED_TAG;
+		lz.in += n;
+		data += n;
+		len -= n;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		if (lz.state == COMPRESSED_DONE) {
+			LOG_ERR("Data after the end of the image");
+			return -EINVAL;
+		}
+
+		/* One byte outputs at most one back-reference. Make room for
+		 * it in the window before the byte is processed, so that a
+		 * failed flash write leaves the byte unprocessed.
+		 */
+		if (lz.out - lz.flushed > WINDOW_SIZE - BIT(lz.length_bits)) {
+			err = flush();
+			if (err) {
+				return err;
+			}
+		}
+
+		err = byte_process(data[i]);
+		if (err) {
+			return err;
+		}
+
+		lz.in++;
+	}
+
+	/* Hand over the data decompressed so far */
+	return flush();
+}
+
+int dfu_target_compressed_done(bool successful)
+{
+	int err = 0;
+
+	if (successful && lz.state != COMPRESSED_DONE) {
+		LOG_ERR("Image incomplete");
+		successful = false;
+		err = -EINVAL;
+	}
+
+	/* The last write may have failed after the image was complete */
+	if (successful) {
+		err = flush();
+		if (err) {
+			successful = false;
+		}
+	}
+
+	if (successful && lz.crc != sys_get_le32(&lz.header[12])) {
+		LOG_ERR("Image checksum mismatch");
+		successful = false;
+		err = -EINVAL;
+	}
+
+	if (lz.state == COMPRESSED_HEADER) {
+		/* The MCUboot target has not been initialized */
+		(void)dfu_target_compressed_init(0, NULL);
+		return err;
+	}
+
+	if (successful) {
+		err = dfu_target_mcuboot_done(true);
+	} else {
+		(void)dfu_target_mcuboot_done(false);
+	}
+
+	(void)dfu_target_compressed_init(0, NULL);
+
+	return err;
+}
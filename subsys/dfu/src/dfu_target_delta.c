@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <string.h>
+#include <zephyr.h>
+#include <sys/crc.h>
+#include <sys/byteorder.h>
+#include <storage/flash_map.h>
+#include <pm_config.h>
+#include <logging/log.h>
+#include <dfu/dfu_target.h>
+#include "dfu_target_mcuboot.h"
+#include "dfu_target_delta.h"
+
+LOG_MODULE_REGISTER(dfu_target_delta, CONFIG_DFU_TARGET_LOG_LEVEL);
+
+/* Patch format, as created by scripts/dfu/delta_patch.py.
+ *
+ * The header holds four little endian 32-bit words: the magic, the size and
+ * CRC-32 of the image the patch applies to, and the size of the new image.
+ * It is followed by a sequence of records, each consisting of:
+ *
+ * - The number of bytes to copy from the old image.
+ * - The length of a diff segment, followed by the segment. Each byte of the
+ *   new image is the sum of a diff byte and a byte of the old image.
+ * - The length of an extra segment, followed by the segment. These bytes are
+ *   copied to the new image as is.
+ * - A signed adjustment of the read position in the old image.
+ *
+ * Lengths and adjustments are LEB128 encoded, adjustments are zigzag encoded.
+ * The patch ends as soon as the new image is complete.
+ */
+#define DELTA_HEADER_MAGIC 0x31544c44 /* "DLT1" */
+#define DELTA_HEADER_SIZE 16
+
+enum delta_state {
+	DELTA_HEADER,
+	DELTA_COPY_LEN,
+	DELTA_COPY,
+	DELTA_DIFF_LEN,
+	DELTA_DIFF,
+	DELTA_EXTRA_LEN,
+	DELTA_EXTRA,
+	DELTA_ADJUST,
+	DELTA_DONE,
+};
+
+static struct {
+	enum delta_state state;
+	u8_t header[DELTA_HEADER_SIZE];
+	size_t header_len;
+	u32_t from_size;
+	u32_t to_size;
+	/* Variable length integer being decoded */
+	u32_t value;
+	u8_t shift;
+	/* Bytes left of the current segment */
+	u32_t remaining;
+	/* Read position in the old image */
+	u32_t from_off;
+	/* Bytes of the new image written */
+	u32_t to_off;
+	/* Bytes of the patch processed. A write that fails is counted up to
+	 * the last byte that took effect, so that the download resumes with
+	 * the byte that failed.
+	 */
+	size_t patch_off;
+	const struct flash_area *fa;
+} delta;
+
+static u8_t from_buf[CONFIG_DFU_TARGET_DELTA_BUF_SIZE];
+
+static void delta_reset(void)
+{
+	if (delta.fa != NULL) {
+		flash_area_close(delta.fa);
+	}
+
+	memset(&delta, 0, sizeof(delta));
+	delta.state = DELTA_HEADER;
+}
+
+bool dfu_target_delta_identify(const void *const buf)
+{
+	return sys_get_le32(buf) == DELTA_HEADER_MAGIC;
+}
+
+static int from_crc_check(u32_t expected)
+{
+	int err;
+	u32_t crc = 0;
+
+	for (u32_t off = 0; off < delta.from_size; off += sizeof(from_buf)) {
+		size_t len = MIN(sizeof(from_buf), delta.from_size - off);
+
+		err = flash_area_read(delta.fa, off, from_buf, len);
+		if (err) {
+			LOG_ERR("flash_area_read error %d", err);
+			return err;
+		}
+
+		crc = crc32_ieee_update(crc, from_buf, len);
+	}
+
+	if (crc != expected) {
+		LOG_ERR("Patch does not apply to the running image");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int header_parse(void)
+{
+	int err;
+	size_t offset;
+
+	if (sys_get_le32(&delta.header[0]) != DELTA_HEADER_MAGIC) {
+		LOG_ERR("Invalid patch header");
+		return -EINVAL;
+	}
+
+	delta.from_size = sys_get_le32(&delta.header[4]);
+	delta.to_size = sys_get_le32(&delta.header[12]);
+
+	if (delta.to_size == 0) {
+		LOG_ERR("Invalid patch header");
+		return -EINVAL;
+	}
+
+	err = flash_area_open(PM_MCUBOOT_PRIMARY_ID, &delta.fa);
+	if (err) {
+		LOG_ERR("flash_area_open error %d", err);
+		return err;
+	}
+
+	if (delta.from_size > delta.fa->fa_size) {
+		LOG_ERR("Patch base larger than the primary slot");
+		return -EINVAL;
+	}
+
+	err = from_crc_check(sys_get_le32(&delta.header[8]));
+	if (err) {
+		return err;
+	}
+
+	err = dfu_target_mcuboot_init(delta.to_size, NULL);
+	if (err) {
+		return err;
+	}
+
+	/* The patch is applied from its start, discard any progress stored by
+	 * an earlier download of a full image.
+	 */
+	err = dfu_target_mcuboot_offset_get(&offset);
+	if (err) {
+		return err;
+	}
+
+	if (offset != 0) {
+		(void)dfu_target_mcuboot_done(false);
+	}
+
+	LOG_INF("Applying patch to %d byte image, new image %d bytes",
+		delta.from_size, delta.to_size);
+
+	return 0;
+}
+
+/**@brief Decode one byte of a LEB128 integer.
+ *
+ * @return 1 if the integer is complete, 0 if more bytes are needed, or
+ *	   -EINVAL if it does not fit in 32 bits.
+ */
+static int varint_decode(u8_t byte)
+{
+	if (delta.shift > 28 ||
+	    (delta.shift == 28 && (byte & 0x7f) > 0x0f)) {
+		LOG_ERR("Invalid integer in patch");
+		return -EINVAL;
+	}
+
+	delta.value |= (u32_t)(byte & 0x7f) << delta.shift;
+	delta.shift += 7;
+
+	return (byte & 0x80) ? 0 : 1;
+}
+
+/**@brief Enter the next state once a segment has been completed. */
+static void segment_done(enum delta_state next)
+{
+	delta.state = (delta.to_off == delta.to_size) ? DELTA_DONE : next;
+}
+
+static void segment_advance(size_t len, enum delta_state next)
+{
+	delta.remaining -= len;
+	delta.to_off += len;
+
+	if (delta.remaining == 0) {
+		segment_done(next);
+	}
+}
+
+static int segment_start(enum delta_state state, enum delta_state next)
+{
+	if (delta.value > delta.to_size - delta.to_off) {
+		LOG_ERR("Patch exceeds the new image size");
+		return -EINVAL;
+	}
+
+	if ((state != DELTA_EXTRA) &&
+	    (delta.value > delta.from_size - delta.from_off)) {
+		LOG_ERR("Patch reads past the end of the old image");
+		return -EINVAL;
+	}
+
+	delta.remaining = delta.value;
+
+	if (delta.remaining == 0) {
+		segment_done(next);
+	} else {
+		delta.state = state;
+	}
+
+	return 0;
+}
+
+/**@brief Copy bytes from the old image, which needs no further patch data.
+ *
+ * The progress is kept in the state, so that a copy that fails continues
+ * when the write is resumed.
+ */
+static int copy_apply(void)
+{
+	int err;
+	size_t len;
+
+	while (delta.remaining > 0) {
+		len = MIN(delta.remaining, sizeof(from_buf));
+
+		err = flash_area_read(delta.fa, delta.from_off, from_buf, len);
+		if (err) {
+			LOG_ERR("flash_area_read error %d", err);
+			return err;
+		}
+
+		err = dfu_target_mcuboot_write(from_buf, len);
+		if (err) {
+			return err;
+		}
+
+		delta.from_off += len;
+		segment_advance(len, DELTA_DIFF_LEN);
+	}
+
+	return 0;
+}
+
+static int adjust_apply(void)
+{
+	/* Zigzag decoding */
+	s32_t adjust = (s32_t)(delta.value >> 1) ^ -(s32_t)(delta.value & 1);
+
+	if ((adjust < 0 && (u32_t)-adjust > delta.from_off) ||
+	    (adjust > 0 && (u32_t)adjust > delta.from_size - delta.from_off)) {
+		LOG_ERR("Patch seeks outside the old image");
+		return -EINVAL;
+	}
+
+	delta.from_off += adjust;
+	delta.state = DELTA_COPY_LEN;
+
+	return 0;
+}
+
+static int field_decode(u8_t byte)
+{
+	u32_t value = delta.value;
+	u8_t shift = delta.shift;
+	int err = varint_decode(byte);
+
+	if (err <= 0) {
+		return err;
+	}
+
+	switch (delta.state) {
+	case DELTA_COPY_LEN:
+		err = segment_start(DELTA_COPY, DELTA_DIFF_LEN);
+		break;
+	case DELTA_DIFF_LEN:
+		err = segment_start(DELTA_DIFF, DELTA_EXTRA_LEN);
+		break;
+	case DELTA_EXTRA_LEN:
+		err = segment_start(DELTA_EXTRA, DELTA_ADJUST);
+		break;
+	default:
+		err = adjust_apply();
+		break;
+	}
+
+	if (err) {
+		/* Decode the byte again when the write is resumed */
+		delta.value = value;
+		delta.shift = shift;
+		return err;
+	}
+
+	delta.value = 0;
+	delta.shift = 0;
+
+	return 0;
+}
+
+static int diff_apply(const u8_t *diff, size_t len)
+{
+	int err;
+
+	err = flash_area_read(delta.fa, delta.from_off, from_buf, len);
+	if (err) {
+		LOG_ERR("flash_area_read error %d", err);
+		return err;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		from_buf[i] += diff[i];
+	}
+
+	err = dfu_target_mcuboot_write(from_buf, len);
+	if (err) {
+		return err;
+	}
+
+	delta.from_off += len;
+
+	return 0;
+}
+
+int dfu_target_delta_init(size_t file_size, dfu_target_callback_t cb)
+{
+	ARG_UNUSED(file_size);
+	ARG_UNUSED(cb);
+
+	delta_reset();
+
+	return 0;
+}
+
+int dfu_target_delta_offset_get(size_t *offset)
+{
+	*offset = delta.patch_off;
+	return 0;
+}
+
+int dfu_target_delta_write(const void *const buf, size_t len)
+{
+	int err = 0;
+	size_t n;
+	const u8_t *data = buf;
+	const u8_t *end = data + len;
+
+	/* Only bytes that took effect are consumed. The last byte of a copy
+	 * length is consumed once the copy is complete, so that a copy that
+	 * fails is continued when that byte is written again.
+	 */
+	while (data < end && err == 0) {
+		switch (delta.state) {
+		case DELTA_HEADER:
+			n = MIN((size_t)(end - data),
+				DELTA_HEADER_SIZE - delta.header_len);
+			memcpy(&delta.header[delta.header_len], data, n);
+			delta.header_len += n;
+
+			if (delta.header_len == DELTA_HEADER_SIZE) {
+				err = header_parse();
+				if (err) {
+					delta.header_len -= n;
+					break;
+				}
+
+				delta.state = DELTA_COPY_LEN;
+			}
+
+			data += n;
+			break;
+		case DELTA_COPY_LEN:
+		case DELTA_DIFF_LEN:
+		case DELTA_EXTRA_LEN:
+		case DELTA_ADJUST:
+			err = field_decode(*data);
+			if (err == 0 && delta.state != DELTA_COPY) {
+				data++;
+			}
+			break;
+		case DELTA_COPY:
+			err = copy_apply();
+			if (err == 0) {
+				data++;
+			}
+			break;
+		case DELTA_DIFF:
+			n = MIN(MIN((size_t)(end - data), delta.remaining),
+				sizeof(from_buf));
+			err = diff_apply(data, n);
+			if (err == 0) {
+				data += n;
+				segment_advance(n, DELTA_EXTRA_LEN);
+			}
+			break;
+		case DELTA_EXTRA:
+			n = MIN((size_t)(end - data), delta.remaining);
+			err = dfu_target_mcuboot_write(data, n);
+			if (err == 0) {
+				data += n;
+				segment_advance(n, DELTA_ADJUST);
+			}
+			break;
+		case DELTA_DONE:
+			LOG_ERR("Data after the end of the patch");
+			err = -EINVAL;
+			break;
+		}
+	}
+
+	delta.patch_off += data - (const u8_t *)buf;
+
+	return err;
+}
+
+int dfu_target_delta_done(bool successful)
+{
+	int err = 0;
+
+	if (successful && delta.state != DELTA_DONE) {
+		LOG_ERR("Patch incomplete");
+		successful = false;
+		err = -EINVAL;
+	}
+
+	if (delta.state == DELTA_HEADER) {
+		/* The MCUboot target has not been initialized */
+		delta_reset();
+		return err;
+	}
+
+	if (successful) {
+		err = dfu_target_mcuboot_done(true);
+	} else {
+		(void)dfu_target_mcuboot_done(false);
+	}
+
+	delta_reset();
+
+	return err;
+}
@@ -68,21 +68,72 @@ int dfu_ctx_mcuboot_set_b1_file(const char *file, bool s0_active,
 }
 
 #define MODULE "dfu"
-#define FILE_FLASH_IMG "mcuboot/flash_img"
+#define FILE_FLASH_IMG "mcuboot/progress"
+
+/* Write progress as stored in flash. Only data that has been written to flash
+ * is accounted for, data still held in the flash_img buffer is downloaded
+ * again after a reset.
+ */
+struct flash_img_progress {
+	size_t bytes_written;
+	/* Last erased flash page, so that the page holding the resume offset
+	 * is not erased again.
+	 */
+	off_t off_last;
+};
+
+/* Progress as last stored, and when it was stored. */
+static size_t stored_bytes_written;
+static s64_t stored_time;
+
+static bool progress_save_due(size_t bytes_written, s64_t now)
+{
+	if (bytes_written <= stored_bytes_written) {
+		/* Nothing new has been written to flash */
+		return false;
+	}
+
+	if (bytes_written - stored_bytes_written >=
+	    CONFIG_DFU_TARGET_MCUBOOT_SAVE_PROGRESS_INTERVAL) {
+		return true;
+	}
+
+	return (CONFIG_DFU_TARGET_MCUBOOT_SAVE_PROGRESS_TIMEOUT > 0) &&
+	       (now - stored_time >=
+		K_SECONDS(CONFIG_DFU_TARGET_MCUBOOT_SAVE_PROGRESS_TIMEOUT));
+}
+
 /**
- * @brief Store the information stored in the flash_img instance so that it can
+ * @brief Store the write progress of the flash_img instance so that it can
  *	  be restored from flash in case of a power failure, reboot etc.
+ *
+ * @param force Store the progress even if the configured interval has not
+ *		passed.
  */
-static int store_flash_img_context(void)
+static int store_flash_img_context(bool force)
 {
 	if (IS_ENABLED(CONFIG_DFU_TARGET_MCUBOOT_SAVE_PROGRESS)) {
 		char key[] = MODULE "/" FILE_FLASH_IMG;
-		int err = settings_save_one(key, &flash_img, sizeof(flash_img));
+		struct flash_img_progress progress = {
+			.bytes_written = flash_img_bytes_written(&flash_img),
+			.off_last = flash_img.off_last,
+		};
+		s64_t now = k_uptime_get();
+		int err;
+
+		/* Coalesce saves, as each one is a flash write as well */
+		if (!force && !progress_save_due(progress.bytes_written, now)) {
+			return 0;
+		}
 
+		err = settings_save_one(key, &progress, sizeof(progress));
 		if (err) {
 			LOG_ERR("Problem storing offset (err %d)", err);
 			return err;
 		}
+
+		stored_bytes_written = progress.bytes_written;
+		stored_time = now;
 	}
 
 	return 0;
@@ -97,12 +148,17 @@ static int settings_set(const char *key, size_t len_rd,
 			settings_read_cb read_cb, void *cb_arg)
 {
 	if (!strcmp(key, FILE_FLASH_IMG)) {
-		ssize_t len = read_cb(cb_arg, &flash_img,
-				      sizeof(flash_img));
-		if (len != sizeof(flash_img)) {
+		struct flash_img_progress progress;
+		ssize_t len = read_cb(cb_arg, &progress, sizeof(progress));
+
+		if (len != sizeof(progress)) {
 			LOG_ERR("Can't read flash_img from storage");
 			return len;
 		}
+
+		flash_img.bytes_written = progress.bytes_written;
+		flash_img.off_last = progress.off_last;
+		stored_bytes_written = progress.bytes_written;
 	}
 
 	return 0;
@@ -149,6 +205,9 @@ int dfu_target_mcuboot_init(size_t file_size, dfu_target_callback_t cb)
 			return err;
 		}
 
+		stored_bytes_written = 0;
+		stored_time = k_uptime_get();
+
 		err = settings_load();
 		if (err) {
 			LOG_ERR("Cannot load settings (err %d)", err);
@@ -174,7 +233,7 @@ int dfu_target_mcuboot_write(const void *const buf, size_t len)
 		return err;
 	}
 
-	err = store_flash_img_context();
+	err = store_flash_img_context(false);
 	if (err != 0) {
 		/* Failing to store progress is not a critical error you'll just
 		 * be left to download a bit more if you fail and resume.
@@ -193,7 +252,7 @@ static void reset_flash_context(void)
 	if (err) {
 		LOG_ERR("Unable to re-initialize flash_img");
 	}
-	err = store_flash_img_context();
+	err = store_flash_img_context(true);
 	if (err != 0) {
 		LOG_ERR("Unable to reset write progress: %d", err);
 	}
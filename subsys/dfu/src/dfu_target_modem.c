@@ -3,6 +3,7 @@
 #include <drivers/flash.h>
 #include <net/socket.h>
 #include <nrf_socket.h>
+#include <sys/ring_buffer.h>
 #include <logging/log.h>
 #include <dfu/dfu_target.h>
 
@@ -11,16 +12,45 @@ LOG_MODULE_REGISTER(dfu_target_modem, CONFIG_DFU_TARGET_LOG_LEVEL);
 #define DIRTY_IMAGE 0x280000
 #define MODEM_MAGIC 0x7544656d
 
+#define QUEUE_SIZE CONFIG_DFU_TARGET_MODEM_QUEUE_SIZE
+
 struct modem_delta_header {
 	u16_t pad1;
 	u16_t pad2;
 	u32_t magic;
 };
 
-static int  fd;
+static int  fd = -1;
+/* Number of bytes the modem has accepted */
 static int  offset;
 static dfu_target_callback_t callback;
 
+/* Data given to dfu_target_modem_write, waiting to be sent to the modem from
+ * the system work queue. The buffer is allocated by dfu_target_modem_init and
+ * freed by dfu_target_modem_done, so it only takes memory during an upgrade.
+ */
+static u8_t *queue_buf;
+static struct ring_buf dfu_queue;
+static K_MUTEX_DEFINE(queue_lock);
+static struct k_work send_work;
+/* Polls the modem until the banked firmware is deleted */
+static struct k_delayed_work erase_work;
+/* Signals the caller that there is space in the queue */
+static K_SEM_DEFINE(queue_space, 0, 1);
+/* Signals the caller that the queue is empty */
+static K_SEM_DEFINE(queue_idle, 0, 1);
+
+static bool erasing;
+/* The banked firmware was deleted for the data being sent */
+static bool erase_retried;
+static int erase_timeout;
+/* Drop the queued data instead of sending it */
+static bool discard;
+/* First error of sending the queued data, reported by the next write or
+ * done
+ */
+static int send_err;
+
 static int get_modem_error(void)
 {
 	int rc;
@@ -53,12 +83,23 @@ static int apply_modem_upgrade(void)
 	}
 	return 0;
 }
+
+static void callback_send(enum dfu_target_evt_id evt)
+{
+	if (callback != NULL) {
+		callback(evt);
+	}
+}
+
 #define SLEEP_TIME 1
-static int delete_banked_modem_fw(void)
+
+/**@brief Request the modem to delete the banked firmware.
+ *
+ * The queued data is sent when the erase is complete.
+ */
+static int erase_start(void)
 {
 	int err;
-	socklen_t len = sizeof(offset);
-	int timeout = CONFIG_DFU_TARGET_MODEM_TIMEOUT;
 
 	LOG_INF("Deleting firmware image, this can take several minutes");
 	err = setsockopt(fd, SOL_DFU, SO_DFU_BACKUP_DELETE, NULL, 0);
@@ -66,29 +107,191 @@ static int delete_banked_modem_fw(void)
 		LOG_ERR("Failed to delete backup, errno %d", errno);
 		return -EFAULT;
 	}
-	while (true) {
-		err = getsockopt(fd, SOL_DFU, SO_DFU_OFFSET, &offset, &len);
+
+	erasing = true;
+	erase_timeout = CONFIG_DFU_TARGET_MODEM_TIMEOUT;
+	k_delayed_work_submit(&erase_work, K_NO_WAIT);
+
+	return 0;
+}
+
+static void erase_end(int err)
+{
+	if (err < 0 && send_err == 0) {
+		send_err = err;
+	}
+
+	erasing = false;
+	k_work_submit(&send_work);
+}
+
+static void erase_poll(struct k_work *work)
+{
+	int err;
+	socklen_t len = sizeof(offset);
+
+	err = getsockopt(fd, SOL_DFU, SO_DFU_OFFSET, &offset, &len);
+	if (err == 0) {
+		callback_send(DFU_TARGET_EVT_ERASE_DONE);
+		LOG_INF("Modem FW delete complete");
+		erase_end(0);
+		return;
+	}
+
+	if (errno != ENOEXEC) {
+		LOG_ERR("Failed to get offset, errno %d", errno);
+		erase_end(-EFAULT);
+		return;
+	}
+
+	err = get_modem_error();
+	if (err != DFU_ERASE_PENDING) {
+		LOG_ERR("DFU error: %d", err);
+	}
+
+	if (discard) {
+		/* The modem completes the erase on its own */
+		LOG_INF("Modem upgrade aborted while erasing");
+		erase_end(0);
+		return;
+	}
+
+	if (erase_timeout < 0) {
+		callback_send(DFU_TARGET_EVT_TIMEOUT);
+		erase_timeout = CONFIG_DFU_TARGET_MODEM_TIMEOUT;
+	}
+
+	erase_timeout -= SLEEP_TIME;
+	k_delayed_work_submit(&erase_work, K_SECONDS(SLEEP_TIME));
+}
+
+/**@brief Send data to the modem, starting an erase of the banked firmware if
+ *	  required.
+ *
+ * @return Number of bytes sent, or a negative error code. 0 if the data is
+ *	   sent again when the erase is complete.
+ */
+static int modem_send(const u8_t *buf, size_t len)
+{
+	int err;
+	int sent;
+	int modem_error;
+
+	sent = send(fd, buf, len, 0);
+	if (sent > 0) {
+		erase_retried = false;
+		return sent;
+	}
+
+	if (errno != ENOEXEC) {
+		return -EFAULT;
+	}
+
+	modem_error = get_modem_error();
+	LOG_ERR("send failed, modem errno %d, dfu err %d", errno, modem_error);
+	switch (modem_error) {
+	case DFU_INVALID_UUID:
+		return -EINVAL;
+	case DFU_INVALID_FILE_OFFSET:
+	case DFU_AREA_NOT_BLANK:
+		/* Erase and retry once */
+		if (erase_retried) {
+			return -EINVAL;
+		}
+
+		err = erase_start();
 		if (err < 0) {
-			if (timeout < 0) {
-				callback(DFU_TARGET_EVT_TIMEOUT);
-				timeout = CONFIG_DFU_TARGET_MODEM_TIMEOUT;
-			}
-			if (errno == ENOEXEC) {
-				err = get_modem_error();
-				if (err != DFU_ERASE_PENDING) {
-					LOG_ERR("DFU error: %d", err);
-				}
-				k_sleep(K_SECONDS(SLEEP_TIME));
-			}
-			timeout -= SLEEP_TIME;
-		} else {
-			callback(DFU_TARGET_EVT_ERASE_DONE);
-			LOG_INF("Modem FW delete complete");
+			return -EINVAL;
+		}
+
+		erase_retried = true;
+		return 0;
+	default:
+		return -EFAULT;
+	}
+}
+
+static void queue_flush(void)
+{
+	u8_t *data;
+	u32_t len;
+
+	k_mutex_lock(&queue_lock, K_FOREVER);
+	do {
+		len = ring_buf_get_claim(&dfu_queue, &data, QUEUE_SIZE);
+		(void)ring_buf_get_finish(&dfu_queue, len);
+	} while (len > 0);
+	k_mutex_unlock(&queue_lock);
+}
+
+/**@brief Send the queued data until the queue is empty, an erase is started
+ *	  or an error occurs.
+ */
+static void queue_send(struct k_work *work)
+{
+	int sent;
+	u8_t *data;
+	u32_t len;
+
+	while (!erasing && !discard && send_err == 0) {
+		k_mutex_lock(&queue_lock, K_FOREVER);
+		len = ring_buf_get_claim(&dfu_queue, &data, QUEUE_SIZE);
+		k_mutex_unlock(&queue_lock);
+
+		if (len == 0) {
 			break;
 		}
+
+		/* The claimed data is not overwritten until it is finished,
+		 * so new data can be queued while it is sent.
+		 */
+		sent = modem_send(data, len);
+		if (sent < 0) {
+			send_err = sent;
+			sent = 0;
+		}
+
+		k_mutex_lock(&queue_lock, K_FOREVER);
+		(void)ring_buf_get_finish(&dfu_queue, sent);
+		k_mutex_unlock(&queue_lock);
+
+		offset += sent;
+		k_sem_give(&queue_space);
 	}
 
-	return 0;
+	if (erasing) {
+		/* Submitted again when the erase is complete */
+		return;
+	}
+
+	if (discard || send_err != 0) {
+		queue_flush();
+		k_sem_give(&queue_space);
+	}
+
+	k_sem_give(&queue_idle);
+}
+
+/**@brief Wait until the queued data is sent, or dropped if the upgrade is
+ *	  aborted.
+ */
+static void queue_wait_idle(void)
+{
+	if (discard && k_delayed_work_cancel(&erase_work) == 0) {
+		/* The modem completes the erase on its own */
+		LOG_INF("Modem upgrade aborted while erasing");
+		erasing = false;
+	}
+
+	k_sem_reset(&queue_idle);
+	k_work_submit(&send_work);
+	k_sem_take(&queue_idle, K_FOREVER);
+}
+
+static void queue_free(void)
+{
+	k_free(queue_buf);
+	queue_buf = NULL;
 }
 
 /**@brief Initialize DFU socket. */
@@ -124,24 +327,24 @@ static int modem_dfu_socket_init(void)
 	return err;
 }
 
-bool dfu_target_modem_identify(const void *const buf)
+static int modem_dfu_socket_close(void)
 {
-	return ((const struct modem_delta_header *)buf)->magic == MODEM_MAGIC;
+	int err = close(fd);
+
+	fd = -1;
+	if (err < 0) {
+		LOG_ERR("Failed to close modem DFU socket.");
+		return err;
+	}
 
+	return 0;
 }
 
-int dfu_target_modem_init(size_t file_size, dfu_target_callback_t cb)
+static int file_size_check(size_t file_size)
 {
 	int err;
 	size_t scratch_space;
-	socklen_t len = sizeof(offset);
-
-	callback = cb;
-
-	err = modem_dfu_socket_init();
-	if (err < 0) {
-		return err;
-	}
+	socklen_t len = sizeof(scratch_space);
 
 	err = getsockopt(fd, SOL_DFU, SO_DFU_RESOURCES, &scratch_space, &len);
 	if (err < 0) {
@@ -158,6 +361,55 @@ int dfu_target_modem_init(size_t file_size, dfu_target_callback_t cb)
 		return -EFBIG;
 	}
 
+	return 0;
+}
+
+bool dfu_target_modem_identify(const void *const buf)
+{
+	return ((const struct modem_delta_header *)buf)->magic == MODEM_MAGIC;
+
+}
+
+int dfu_target_modem_init(size_t file_size, dfu_target_callback_t cb)
+{
+	int err;
+	socklen_t len = sizeof(offset);
+
+	callback = cb;
+
+	if (fd >= 0) {
+		/* Already initialized, possibly before the size of the file
+		 * was known. Keep the erase and the queued data going.
+		 */
+		return file_size_check(file_size);
+	}
+
+	err = modem_dfu_socket_init();
+	if (err < 0) {
+		return err;
+	}
+
+	err = file_size_check(file_size);
+	if (err < 0) {
+		(void)modem_dfu_socket_close();
+		return err;
+	}
+
+	queue_buf = k_malloc(QUEUE_SIZE);
+	if (queue_buf == NULL) {
+		LOG_ERR("Unable to allocate the write queue");
+		(void)modem_dfu_socket_close();
+		return -ENOMEM;
+	}
+
+	ring_buf_init(&dfu_queue, QUEUE_SIZE, queue_buf);
+	k_work_init(&send_work, queue_send);
+	k_delayed_work_init(&erase_work, erase_poll);
+	send_err = 0;
+	discard = false;
+	erasing = false;
+	erase_retried = false;
+
 	/* Check offset, store to local variable */
 	err = getsockopt(fd, SOL_DFU, SO_DFU_OFFSET, &offset, &len);
 	if (err < 0) {
@@ -169,7 +421,16 @@ int dfu_target_modem_init(size_t file_size, dfu_target_callback_t cb)
 	}
 
 	if (offset == DIRTY_IMAGE) {
-		delete_banked_modem_fw();
+		/* Data written while the modem erases is queued until the
+		 * erase is complete.
+		 */
+		offset = 0;
+		err = erase_start();
+		if (err < 0) {
+			queue_free();
+			(void)modem_dfu_socket_close();
+			return err;
+		}
 	} else if (offset != 0) {
 		LOG_INF("Setting offset to 0x%x", offset);
 		len = sizeof(offset);
@@ -190,50 +451,55 @@ int dfu_target_modem_offset_get(size_t *out)
 
 int dfu_target_modem_write(const void *const buf, size_t len)
 {
-	int err = 0;
-	int sent = 0;
-	int modem_error = 0;
+	u32_t queued;
+	const u8_t *data = buf;
 
-	sent = send(fd, buf, len, 0);
-	if (sent > 0) {
-		offset += len;
-		return 0;
+	if (queue_buf == NULL) {
+		return -EACCES;
 	}
 
-	if (errno != ENOEXEC) {
-		return -EFAULT;
-	}
+	while (send_err == 0) {
+		k_mutex_lock(&queue_lock, K_FOREVER);
+		queued = ring_buf_put(&dfu_queue, data, len);
+		k_mutex_unlock(&queue_lock);
 
-	modem_error = get_modem_error();
-	LOG_ERR("send failed, modem errno %d, dfu err %d", errno, modem_error);
-	switch (modem_error) {
-	case DFU_INVALID_UUID:
-		return -EINVAL;
-	case DFU_INVALID_FILE_OFFSET:
-		delete_banked_modem_fw();
-		err = dfu_target_modem_write(buf, len);
-		if (err < 0) {
-			return -EINVAL;
-		} else {
-			return 0;
+		if (queued > 0) {
+			k_work_submit(&send_work);
 		}
-	case DFU_AREA_NOT_BLANK:
-		delete_banked_modem_fw();
-		err = dfu_target_modem_write(buf, len);
-		if (err < 0) {
-			return -EINVAL;
-		} else {
+
+		data += queued;
+		len -= queued;
+		if (len == 0) {
 			return 0;
 		}
-	default:
-		return -EFAULT;
+
+		/* Wait for the queued data to be sent */
+		k_sem_take(&queue_space, K_FOREVER);
 	}
+
+	return send_err;
 }
 
 int dfu_target_modem_done(bool successful)
 {
 	int err = 0;
 
+	if (fd < 0) {
+		/* Already closed */
+		return 0;
+	}
+
+	/* Send the queued data, or drop it if the upgrade is aborted */
+	discard = !successful;
+	queue_wait_idle();
+	queue_free();
+
+	if (successful && send_err != 0) {
+		LOG_ERR("Failed to write modem firmware, err %d", send_err);
+		(void)modem_dfu_socket_close();
+		return send_err;
+	}
+
 	if (successful) {
 		err = apply_modem_upgrade();
 		if (err < 0) {
@@ -244,12 +510,5 @@ int dfu_target_modem_done(bool successful)
 		LOG_INF("Modem upgrade aborted.");
 	}
 
-
-	err = close(fd);
-	if (err < 0) {
-		LOG_ERR("Failed to close modem DFU socket.");
-		return err;
-	}
-
-	return 0;
+	return modem_dfu_socket_close();
 }
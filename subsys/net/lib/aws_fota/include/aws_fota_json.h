@@ -27,6 +27,9 @@ extern "C" {
  */
 #define STATUS_MAX_LEN (12)
 
+/** @brief Length of the hex encoded SHA-256 hash of the file. */
+#define HASH_STR_LEN (64)
+
 /**
  * @brief The bit set when the status field in a job execution object is
  * decoded.
@@ -50,6 +53,9 @@ extern "C" {
  *			     Document
  * @param[out] file_path_buf  Output buffer for the "file" field from the Job
  *			      Document
+ * @param[out] hash_buf  Output buffer of HASH_STR_LEN + 1 bytes for the
+ *			 optional "sha256" field from the Job Document. Set to
+ *			 an empty string if the field is not present.
  * @param[out] version_number  Version number from the Job Execution data type.
  *
  * @return 0 if the Job Execution object is empty, 1 if Job Execution object was
@@ -61,6 +67,7 @@ int aws_fota_parse_DescribeJobExecution_rsp(const char *job_document,
 					    char *job_id_buf,
 					    char *hostname_buf,
 					    char *file_path_buf,
+					    char *hash_buf,
 					    int *version_number);
 
 /**
@@ -7,6 +7,7 @@
 #include <zephyr.h>
 #include <stdio.h>
 #include <data/json.h>
+#include <sys/util.h>
 #include <net/fota_download.h>
 #include <net/aws_jobs.h>
 #include <net/aws_fota.h>
@@ -59,6 +60,7 @@ static u8_t get_topic[AWS_JOBS_TOPIC_MAX_LEN];
 static u8_t payload_buf[CONFIG_AWS_FOTA_PAYLOAD_SIZE];
 static u8_t hostname[CONFIG_AWS_FOTA_HOSTNAME_MAX_LEN];
 static u8_t file_path[CONFIG_AWS_FOTA_FILE_PATH_MAX_LEN];
+static u8_t file_hash[HASH_STR_LEN + 1];
 static u8_t job_id[AWS_JOBS_JOB_ID_MAX_LEN];
 static aws_fota_callback_t callback;
 
@@ -187,7 +189,7 @@ static int get_job_execution(struct mqtt_client *const client,
 	/* Check if message received is a job. */
 	err = aws_fota_parse_DescribeJobExecution_rsp(payload_buf, payload_len,
 						      job_id, hostname,
-						      file_path,
+						      file_path, file_hash,
 						     &execution_version_number);
 
 	if (err < 0) {
@@ -202,6 +204,7 @@ static int get_job_execution(struct mqtt_client *const client,
 	LOG_DBG("Job ID: %s", log_strdup(job_id));
 	LOG_DBG("hostname: %s", log_strdup(hostname));
 	LOG_DBG("file_path %s", log_strdup(file_path));
+	LOG_DBG("file_hash %s", log_strdup(file_hash));
 	LOG_DBG("execution_version_number: %d ", execution_version_number);
 
 	/* Subscribe to update topic to receive feedback on whether an
@@ -223,6 +226,35 @@ static int get_job_execution(struct mqtt_client *const client,
 	return 0;
 }
 
+/**
+ * @brief Start the firmware download, and verify the hash of the file if the
+ *	  job document holds one.
+ *
+ * @return 0 If successful otherwise a negative error code is returned.
+ */
+static int download_start(void)
+{
+	u8_t hash[FOTA_DOWNLOAD_HASH_SIZE];
+
+	if (file_hash[0] == '\0') {
+		return fota_download_start(hostname, file_path);
+	}
+
+	if (!IS_ENABLED(CONFIG_FOTA_DOWNLOAD_HASH_VERIFY)) {
+		LOG_WRN("Hash of the file not verified, enable "
+			"CONFIG_FOTA_DOWNLOAD_HASH_VERIFY");
+		return fota_download_start(hostname, file_path);
+	}
+
+	if (hex2bin(file_hash, HASH_STR_LEN, hash, sizeof(hash)) !=
+	    sizeof(hash)) {
+		LOG_ERR("Invalid hash in the job document");
+		return -EINVAL;
+	}
+
+	return fota_download_start_with_hash(hostname, file_path, hash);
+}
+
 /**
  * @brief Updating the program state when a job document update is accepted.
  *
@@ -259,7 +291,7 @@ static int job_update_accepted(struct mqtt_client *const client,
 		execution_state = AWS_JOBS_IN_PROGRESS;
 		LOG_INF("Start downloading firmware from %s/%s",
 			log_strdup(hostname), log_strdup(file_path));
-		err = fota_download_start(hostname, file_path);
+		err = download_start();
 		if (err) {
 			LOG_ERR("Error (%d) when trying to start firmware "
 				"download", err);
@@ -361,6 +393,7 @@ int aws_fota_mqtt_evt_handler(struct mqtt_client *const client,
 			      const struct mqtt_evt *evt)
 {
 	int err;
+	int topic;
 
 	switch (evt->type) {
 	case MQTT_EVT_CONNACK:
@@ -433,7 +466,9 @@ int aws_fota_mqtt_evt_handler(struct mqtt_client *const client,
 		if (evt->result != 0) {
 			return evt->result;
 		}
-		if (evt->param.suback.message_id == SUBSCRIBE_NOTIFY_NEXT) {
+
+		topic = aws_jobs_suback_topic_get(evt->param.suback.message_id);
+		if (topic == SUBSCRIBE_NOTIFY_NEXT) {
 			LOG_INF("subscribed to notify-next topic");
 			err = aws_jobs_get_job_execution(client, "$next",
 							 get_topic);
@@ -443,13 +478,13 @@ int aws_fota_mqtt_evt_handler(struct mqtt_client *const client,
 			return 0;
 		}
 
-		if (evt->param.suback.message_id == SUBSCRIBE_GET) {
+		if (topic == SUBSCRIBE_GET) {
 			LOG_INF("subscribed to get topic");
 			return 0;
 		}
 
 		if ((fota_state == DOWNLOAD_FIRMWARE) &&
-		   (evt->param.suback.message_id == SUBSCRIBE_JOB_ID_UPDATE)) {
+		   (topic == SUBSCRIBE_JOB_ID_UPDATE)) {
 			stored_progress = 0;
 			err = update_job_execution(client, job_id,
 						   AWS_JOBS_IN_PROGRESS,
@@ -61,12 +61,14 @@ int aws_fota_parse_DescribeJobExecution_rsp(const char *job_document,
 					   char *job_id_buf,
 					   char *hostname_buf,
 					   char *file_path_buf,
+					   char *hash_buf,
 					   int *execution_version_number)
 {
 	if (job_document == NULL
 	    || job_id_buf == NULL
 	    || hostname_buf == NULL
 	    || file_path_buf == NULL
+	    || hash_buf == NULL
 	    || execution_version_number == NULL) {
 		return -EINVAL;
 	}
@@ -127,6 +129,20 @@ int aws_fota_parse_DescribeJobExecution_rsp(const char *job_document,
 		goto cleanup;
 	}
 
+	/* The hash of the file is optional */
+	cJSON *hash = cJSON_GetObjectItemCaseSensitive(job_data, "sha256");
+
+	if (hash == NULL) {
+		hash_buf[0] = '\0';
+	} else if ((cJSON_GetStringValue(hash) != NULL)
+		   && (strlen(hash->valuestring) == HASH_STR_LEN)) {
+		strncpy_nullterm(hash_buf, hash->valuestring,
+				 HASH_STR_LEN + 1);
+	} else {
+		ret = -ENODATA;
+		goto cleanup;
+	}
+
 	cJSON *version_number = cJSON_GetObjectItemCaseSensitive(
 					execution, "versionNumber");
 
@@ -1,5 +1,7 @@
 #include <net/aws_iot.h>
 #include <net/mqtt.h>
+#include <net/mqtt_outbox.h>
+#include <net/mqtt_topic_trie.h>
 #include <net/socket.h>
 #include <net/cloud.h>
 #include <net/cloud_backend.h>
@@ -7,6 +9,7 @@
 
 #if defined(CONFIG_AWS_FOTA)
 #include <net/aws_fota.h>
+#include <net/aws_jobs.h>
 #endif
 
 #include <logging/log.h>
@@ -86,13 +89,34 @@ static char delete_rejected_topic[DELETE_REJECTED_TOPIC_LEN + 1];
 
 static struct aws_iot_app_topic_data app_topic_data;
 
+/* Subscribed topics that received messages are dispatched by. The data of
+ * each topic in the trie is its entry in shadow_rx_topics or app_rx_topics.
+ */
+static struct mqtt_topic_trie topic_trie;
+static struct mqtt_topic_trie_node
+	topic_trie_nodes[CONFIG_AWS_IOT_TOPIC_TRIE_NODES];
+static struct aws_iot_rx_topic
+	shadow_rx_topics[AWS_IOT_RX_TOPIC_DELETE_REJECTED + 1];
+static struct aws_iot_rx_topic
+	app_rx_topics[CONFIG_AWS_IOT_APP_SUBSCRIPTION_LIST_COUNT];
+static const struct aws_iot_rx_topic rx_topic_unknown = {
+	.type = AWS_IOT_RX_TOPIC_UNKNOWN
+};
+
 static char rx_buffer[CONFIG_AWS_IOT_MQTT_RX_TX_BUFFER_LEN];
 static char tx_buffer[CONFIG_AWS_IOT_MQTT_RX_TX_BUFFER_LEN];
 static char payload_buf[CONFIG_AWS_IOT_MQTT_PAYLOAD_BUFFER_LEN];
 
 static struct mqtt_client client;
+static struct mqtt_outbox outbox;
 static struct sockaddr_storage broker;
 
+/* Uptime when the last connection was started, and the time it took until
+ * the broker acknowledged it.
+ */
+static s64_t connect_start;
+static u32_t connect_time;
+
 #if !defined(CONFIG_CLOUD_API)
 static aws_iot_evt_handler_t module_evt_handler;
 #endif
@@ -226,6 +250,102 @@ static void aws_fota_cb_handler(enum aws_fota_evt_id evt)
 }
 #endif
 
+static void topic_trie_add(const char *topic, size_t len,
+			   struct aws_iot_rx_topic *rx_topic)
+{
+	int err = mqtt_topic_trie_add(&topic_trie, topic, len, rx_topic);
+
+	if (err) {
+		LOG_ERR("Could not add topic %s to the trie, error: %d",
+			log_strdup(topic), err);
+	}
+}
+
+static void shadow_topic_trie_add(const char *topic,
+				  enum aws_iot_rx_topic_type type)
+{
+	shadow_rx_topics[type].type = type;
+	topic_trie_add(topic, strlen(topic), &shadow_rx_topics[type]);
+}
+
+/* Build the trie of the topics that are subscribed to */
+static void topic_trie_build(void)
+{
+	mqtt_topic_trie_init(&topic_trie, topic_trie_nodes,
+			     ARRAY_SIZE(topic_trie_nodes));
+
+#if defined(CONFIG_AWS_IOT_TOPIC_GET_ACCEPTED_SUBSCRIBE)
+	shadow_topic_trie_add(get_accepted_topic,
+			      AWS_IOT_RX_TOPIC_GET_ACCEPTED);
+#endif
+#if defined(CONFIG_AWS_IOT_TOPIC_GET_REJECTED_SUBSCRIBE)
+	shadow_topic_trie_add(get_rejected_topic,
+			      AWS_IOT_RX_TOPIC_GET_REJECTED);
+#endif
+#if defined(CONFIG_AWS_IOT_TOPIC_UPDATE_ACCEPTED_SUBSCRIBE)
+	shadow_topic_trie_add(update_accepted_topic,
+			      AWS_IOT_RX_TOPIC_UPDATE_ACCEPTED);
+#endif
+#if defined(CONFIG_AWS_IOT_TOPIC_UPDATE_REJECTED_SUBSCRIBE)
+	shadow_topic_trie_add(update_rejected_topic,
+			      AWS_IOT_RX_TOPIC_UPDATE_REJECTED);
+#endif
+#if defined(CONFIG_AWS_IOT_TOPIC_UPDATE_DELTA_SUBSCRIBE)
+	shadow_topic_trie_add(update_delta_topic,
+			      AWS_IOT_RX_TOPIC_UPDATE_DELTA);
+#endif
+#if defined(CONFIG_AWS_IOT_TOPIC_DELETE_ACCEPTED_SUBSCRIBE)
+	shadow_topic_trie_add(delete_accepted_topic,
+			      AWS_IOT_RX_TOPIC_DELETE_ACCEPTED);
+#endif
+#if defined(CONFIG_AWS_IOT_TOPIC_DELETE_REJECTED_SUBSCRIBE)
+	shadow_topic_trie_add(delete_rejected_topic,
+			      AWS_IOT_RX_TOPIC_DELETE_REJECTED);
+#endif
+
+	for (size_t i = 0; i < app_topic_data.list_count; i++) {
+		app_rx_topics[i].type = AWS_IOT_RX_TOPIC_APP;
+		app_rx_topics[i].app_index = i;
+		topic_trie_add((const char *)app_topic_data.list[i].topic.utf8,
+			       app_topic_data.list[i].topic.size,
+			       &app_rx_topics[i]);
+	}
+}
+
+/* Find the subscription that a received message arrived on */
+static const struct aws_iot_rx_topic *rx_topic_get(
+	const struct mqtt_topic *topic)
+{
+	void *rx_topic;
+
+	if (mqtt_topic_trie_match(&topic_trie, (const char *)topic->topic.utf8,
+				  topic->topic.size, &rx_topic, 1) == 0) {
+		return &rx_topic_unknown;
+	}
+
+	return rx_topic;
+}
+
+#if defined(CONFIG_CLOUD_API)
+static enum cloud_endpoint_type rx_topic_endpoint_type(
+	const struct aws_iot_rx_topic *rx_topic)
+{
+	switch (rx_topic->type) {
+	case AWS_IOT_RX_TOPIC_GET_ACCEPTED:
+	case AWS_IOT_RX_TOPIC_GET_REJECTED:
+	case AWS_IOT_RX_TOPIC_UPDATE_ACCEPTED:
+	case AWS_IOT_RX_TOPIC_UPDATE_REJECTED:
+	case AWS_IOT_RX_TOPIC_UPDATE_DELTA:
+		return CLOUD_EP_TOPIC_STATE;
+	case AWS_IOT_RX_TOPIC_DELETE_ACCEPTED:
+	case AWS_IOT_RX_TOPIC_DELETE_REJECTED:
+		return CLOUD_EP_TOPIC_STATE_DELETE;
+	default:
+		return CLOUD_EP_TOPIC_MSG;
+	}
+}
+#endif
+
 static int topic_subscribe(void)
 {
 	int err;
@@ -295,11 +415,13 @@ static int topic_subscribe(void)
 #endif
 	};
 
+	topic_trie_build();
+
 	if (app_topic_data.list_count > 0) {
 		const struct mqtt_subscription_list app_sub_list = {
 			.list = app_topic_data.list,
 			.list_count = app_topic_data.list_count,
-			.message_id = sys_rand32_get()
+			.message_id = mqtt_outbox_message_id_get(&outbox)
 		};
 
 		for (size_t i = 0; i < app_sub_list.list_count; i++) {
@@ -317,7 +439,7 @@ static int topic_subscribe(void)
 		const struct mqtt_subscription_list aws_sub_list = {
 			.list = (struct mqtt_topic *)&aws_iot_rx_list,
 			.list_count = ARRAY_SIZE(aws_iot_rx_list),
-			.message_id = sys_rand32_get()
+			.message_id = mqtt_outbox_message_id_get(&outbox)
 		};
 
 		for (size_t i = 0; i < aws_sub_list.list_count; i++) {
@@ -334,14 +456,117 @@ static int topic_subscribe(void)
 	return err;
 }
 
-static int publish_get_payload(struct mqtt_client *const c, size_t length)
+static void data_received_notify(const struct mqtt_publish_param *p,
+				 const struct aws_iot_rx_topic *rx_topic,
+				 size_t offset, size_t len)
 {
-	if (length > sizeof(payload_buf)) {
-		LOG_ERR("Incoming MQTT message too large for payload buffer");
-		return -EMSGSIZE;
+	size_t total_len = p->message.payload.len;
+#if defined(CONFIG_CLOUD_API)
+	struct cloud_backend_config *config = aws_iot_backend->config;
+	struct cloud_event cloud_evt = { 0 };
+	const struct cloud_endpoint endpoint = {
+		.type = rx_topic_endpoint_type(rx_topic),
+		.str = (char *)p->message.topic.topic.utf8,
+		.len = p->message.topic.topic.size
+	};
+
+	if (len < total_len) {
+		cloud_evt.type = CLOUD_EVT_DATA_RECEIVED_FRAGMENT;
+		cloud_evt.data.fragment.buf = payload_buf;
+		cloud_evt.data.fragment.len = len;
+		cloud_evt.data.fragment.offset = offset;
+		cloud_evt.data.fragment.total_len = total_len;
+		cloud_evt.data.fragment.endpoint = endpoint;
+	} else {
+		cloud_evt.type = CLOUD_EVT_DATA_RECEIVED;
+		cloud_evt.data.msg.buf = payload_buf;
+		cloud_evt.data.msg.len = len;
+		cloud_evt.data.msg.endpoint = endpoint;
+	}
+
+	cloud_notify_event(aws_iot_backend, &cloud_evt, config->user_data);
+#else
+	struct aws_iot_evt aws_iot_evt = {
+		.type = (len < total_len) ? AWS_IOT_EVT_DATA_RECEIVED_FRAGMENT :
+					    AWS_IOT_EVT_DATA_RECEIVED,
+		.ptr = payload_buf,
+		.len = len,
+		.offset = offset,
+		.total_len = total_len,
+		.topic = *rx_topic
+	};
+
+	aws_iot_notify_event(&aws_iot_evt);
+#endif
+}
+
+/* Read the payload of an incoming message and notify it. A payload that does
+ * not fit in the payload buffer is read in fragments of the size of the
+ * buffer, which are notified if enabled.
+ */
+static int publish_get_payload(struct mqtt_client *const c,
+			       const struct mqtt_publish_param *p)
+{
+	int err;
+	size_t length = p->message.payload.len;
+	size_t offset = 0;
+	/* The subscription is found with one walk through the trie */
+	const struct aws_iot_rx_topic *rx_topic =
+		rx_topic_get(&p->message.topic);
+	bool deliver = (length <= sizeof(payload_buf)) ||
+		       IS_ENABLED(CONFIG_AWS_IOT_MQTT_PAYLOAD_FRAGMENTS);
+
+	if (!deliver) {
+		LOG_ERR("Incoming message of %d bytes discarded, "
+			"AWS_IOT_MQTT_PAYLOAD_BUFFER_LEN is %d",
+			length, sizeof(payload_buf));
 	}
 
-	return mqtt_readall_publish_payload(c, payload_buf, length);
+	/* The payload is read even if it is discarded, otherwise the client
+	 * can not receive further packets.
+	 */
+	do {
+		size_t chunk = MIN(length - offset, sizeof(payload_buf));
+
+		err = mqtt_readall_publish_payload(c, payload_buf, chunk);
+		if (err) {
+			return err;
+		}
+
+		if (deliver) {
+			data_received_notify(p, rx_topic, offset, chunk);
+		}
+
+		offset += chunk;
+	} while (offset < length);
+
+	return deliver ? 0 : -EMSGSIZE;
+}
+
+static void outbox_ack_handler(struct mqtt_outbox *o,
+			       const struct mqtt_publish_message *message,
+			       u32_t tag, int result)
+{
+#if defined(CONFIG_CLOUD_API)
+	struct cloud_backend_config *config = aws_iot_backend->config;
+	struct cloud_event cloud_evt = {
+		.type = CLOUD_EVT_DATA_SENT
+	};
+#else
+	struct aws_iot_evt aws_iot_evt = {
+		.type = AWS_IOT_EVT_DATA_SENT
+	};
+#endif
+
+	if (result) {
+		return;
+	}
+
+#if defined(CONFIG_CLOUD_API)
+	cloud_notify_event(aws_iot_backend, &cloud_evt, config->user_data);
+#else
+	aws_iot_notify_event(&aws_iot_evt);
+#endif
 }
 
 static void mqtt_evt_handler(struct mqtt_client *const c,
@@ -375,8 +600,19 @@ static void mqtt_evt_handler(struct mqtt_client *const c,
 	case MQTT_EVT_CONNACK:
 		LOG_DBG("MQTT client connected!");
 
+		connect_time = (u32_t)(k_uptime_get() - connect_start);
+		LOG_INF("Connected in %d ms", connect_time);
+
 		topic_subscribe();
 
+		/* Messages that were not acknowledged before the connection
+		 * was lost are sent again.
+		 */
+		err = mqtt_outbox_resend(&outbox);
+		if (err) {
+			LOG_ERR("mqtt_outbox_resend, error: %d", err);
+		}
+
 #if defined(CONFIG_CLOUD_API)
 		cloud_evt.type = CLOUD_EVT_CONNECTED;
 		cloud_notify_event(aws_iot_backend, &cloud_evt,
@@ -410,8 +646,17 @@ static void mqtt_evt_handler(struct mqtt_client *const c,
 			p->message_id,
 			p->message.payload.len);
 
-		err = publish_get_payload(c, p->message.payload.len);
-		if (err) {
+		/* The payload is notified while it is read */
+		err = publish_get_payload(c, p);
+		if (err == -EMSGSIZE) {
+			/* Without an acknowledgment, the broker sends the
+			 * message again after the client reconnects.
+			 */
+			LOG_ERR("Message %d too large, disconnecting",
+				p->message_id);
+			mqtt_disconnect(c);
+			break;
+		} else if (err != 0) {
 			LOG_ERR("publish_get_payload, error: %d", err);
 			break;
 		}
@@ -423,26 +668,13 @@ static void mqtt_evt_handler(struct mqtt_client *const c,
 
 			mqtt_publish_qos1_ack(c, &ack);
 		}
-
-#if defined(CONFIG_CLOUD_API)
-		cloud_evt.type = CLOUD_EVT_DATA_RECEIVED;
-		cloud_evt.data.msg.buf = payload_buf;
-		cloud_evt.data.msg.len = p->message.payload.len;
-
-		cloud_notify_event(aws_iot_backend, &cloud_evt,
-				   config->user_data);
-#else
-		aws_iot_evt.type = AWS_IOT_EVT_DATA_RECEIVED;
-		aws_iot_evt.ptr = payload_buf;
-		aws_iot_evt.len = p->message.payload.len;
-		aws_iot_notify_event(&aws_iot_evt);
-#endif
-
 	} break;
 	case MQTT_EVT_PUBACK:
 		LOG_DBG("MQTT_EVT_PUBACK: id = %d result = %d",
 			mqtt_evt->param.puback.message_id,
 			mqtt_evt->result);
+
+		(void)mqtt_outbox_puback(&outbox, &mqtt_evt->param.puback);
 		break;
 	case MQTT_EVT_SUBACK:
 		LOG_DBG("MQTT_EVT_SUBACK: id = %d result = %d",
@@ -626,21 +858,22 @@ int aws_iot_send(const struct aws_iot_tx_data *const tx_data)
 	}
 #endif
 
-	struct mqtt_publish_param param;
+	struct mqtt_publish_message message;
+	int err;
 
-	param.message.topic.qos		= tx_data_pub.qos;
-	param.message.topic.topic.utf8	= tx_data_pub.topic.str;
-	param.message.topic.topic.size	= tx_data_pub.topic.len;
-	param.message.payload.data	= tx_data_pub.str;
-	param.message.payload.len	= tx_data_pub.len;
-	param.message_id		= sys_rand32_get();
-	param.dup_flag			= 0;
-	param.retain_flag		= 0;
+	message.topic.qos		= tx_data_pub.qos;
+	message.topic.topic.utf8	= tx_data_pub.topic.str;
+	message.topic.topic.size	= tx_data_pub.topic.len;
+	message.payload.data		= tx_data_pub.str;
+	message.payload.len		= tx_data_pub.len;
 
 	LOG_DBG("Publishing to topic: %s",
-		log_strdup(param.message.topic.topic.utf8));
+		log_strdup(message.topic.topic.utf8));
 
-	return mqtt_publish(&client, &param);
+	/* QoS 1 messages are kept until they are acknowledged */
+	err = mqtt_outbox_publish(&outbox, &message, 0);
+
+	return (err < 0) ? err : 0;
 }
 
 int aws_iot_disconnect(void)
@@ -658,6 +891,8 @@ int aws_iot_connect(struct aws_iot_config *const config)
 		return err;
 	}
 
+	connect_start = k_uptime_get();
+
 	err = mqtt_connect(&client);
 	if (err) {
 		LOG_ERR("mqtt_connect, error: %d", err);
@@ -671,6 +906,11 @@ int aws_iot_connect(struct aws_iot_config *const config)
 	return err;
 }
 
+u32_t aws_iot_connect_time_get(void)
+{
+	return connect_time;
+}
+
 int aws_iot_subscription_topics_add(
 			const struct aws_iot_topic_data *const topic_list,
 			size_t list_count)
@@ -719,7 +959,16 @@ int aws_iot_init(const struct aws_iot_config *const config,
 		return err;
 	}
 
+	err = mqtt_outbox_init(&outbox, &client, outbox_ack_handler);
+	if (err) {
+		LOG_ERR("mqtt_outbox_init, error: %d", err);
+		return err;
+	}
+
 #if defined(CONFIG_AWS_FOTA)
+	/* The jobs of the FOTA library are requested with the same client */
+	aws_jobs_outbox_set(&outbox);
+
 	err = aws_fota_init(&client, aws_fota_cb_handler);
 	if (err) {
 		LOG_ERR("aws_fota_init, error: %d", err);
@@ -739,6 +988,8 @@ static int c_init(const struct cloud_backend *const backend,
 		  cloud_evt_handler_t handler)
 {
 	backend->config->handler = handler;
+	/* Messages are published unchanged, in any format */
+	backend->config->cbor = true;
 	aws_iot_backend = (struct cloud_backend *)backend;
 
 	struct aws_iot_config config = {
@@ -8,6 +8,9 @@
 #include <net/mqtt.h>
 #include <logging/log.h>
 #include <net/aws_jobs.h>
+#if defined(CONFIG_MQTT_OUTBOX)
+#include <net/mqtt_outbox.h>
+#endif
 
 LOG_MODULE_REGISTER(aws_jobs, CONFIG_AWS_JOBS_LOG_LEVEL);
 
@@ -23,6 +26,12 @@ static const char *execution_status_strings[] = {
 	[AWS_JOBS_CANCELED]    = "CANCELED"
 };
 
+/* Outbox of the MQTT client that message IDs are taken from, if any. */
+static struct mqtt_outbox *id_outbox;
+
+/* Message IDs of the last subscribe requests, by topic. */
+static u16_t subscribe_ids[SUBSCRIBE_JOB_ID_UPDATE - SUBSCRIBE_ID_BASE];
+
 struct topic_conf {
 	int msg_id;
 	const u8_t *name;
@@ -100,6 +109,17 @@ static int construct_topic(const u8_t *client_id, const u8_t *job_id,
 	return 0;
 }
 
+/* Get a message ID from the outbox, or use the given one without outbox. */
+static u16_t message_id_get(u16_t id)
+{
+#if defined(CONFIG_MQTT_OUTBOX)
+	if (id_outbox != NULL) {
+		return mqtt_outbox_message_id_get(id_outbox);
+	}
+#endif
+	return id;
+}
+
 static int reg_topic(struct mqtt_client *const client, u8_t *topic_buf,
 		     struct topic_conf const *conf, const u8_t *job_id,
 		     bool subscribe)
@@ -115,7 +135,7 @@ static int reg_topic(struct mqtt_client *const client, u8_t *topic_buf,
 	const struct mqtt_subscription_list subscription_list = {
 		.list = &topic,
 		.list_count = 1,
-		.message_id = conf->msg_id
+		.message_id = message_id_get(conf->msg_id)
 	};
 
 	if (err) {
@@ -124,6 +144,8 @@ static int reg_topic(struct mqtt_client *const client, u8_t *topic_buf,
 
 	if (subscribe) {
 		LOG_INF("Subscribe: %s", log_strdup(topic.topic.utf8));
+		subscribe_ids[conf->msg_id - SUBSCRIBE_ID_BASE - 1] =
+			subscription_list.message_id;
 		return mqtt_subscribe(client, &subscription_list);
 	}
 
@@ -199,7 +221,7 @@ static int publish(struct mqtt_client *const client, const u8_t *job_id,
 		.message.topic = topic,
 		.message.payload.data = payload_data,
 		.message.payload.len = payload_data_len,
-		.message_id = sys_rand32_get(),
+		.message_id = message_id_get(sys_rand32_get()),
 		.dup_flag = 0,
 		.retain_flag = 0,
 	};
@@ -252,6 +274,22 @@ int aws_jobs_get_job_execution(struct mqtt_client *const client,
 		       strlen(JOB_ID_GET_PAYLOAD), topic_buf);
 }
 
+void aws_jobs_outbox_set(struct mqtt_outbox *outbox)
+{
+	id_outbox = outbox;
+}
+
+int aws_jobs_suback_topic_get(u16_t message_id)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(subscribe_ids); i++) {
+		if (subscribe_ids[i] == message_id) {
+			return SUBSCRIBE_ID_BASE + 1 + i;
+		}
+	}
+
+	return -ENOENT;
+}
+
 bool aws_jobs_cmp(const char *sub, const char *pub, size_t pub_len,
 		 const u8_t *suffix)
 {
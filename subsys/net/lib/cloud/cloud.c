@@ -37,3 +37,43 @@ void cloud_backend_list_get(
 	*backend_list = __cloud_backends_start;
 	*backend_count = __cloud_backends_end - __cloud_backends_start;
 }
+
+int cloud_msg_reassemble(struct cloud_msg_reassembly *const reassembly,
+			 const struct cloud_msg_fragment *const fragment)
+{
+	struct cloud_msg_reassembly *r = reassembly;
+
+	if ((r == NULL) || (r->buf == NULL) || (fragment == NULL) ||
+	    (fragment->buf == NULL) || (fragment->len == 0)) {
+		return -EINVAL;
+	}
+
+	if (fragment->offset == 0) {
+		r->len = 0;
+		r->total_len = fragment->total_len;
+	} else if ((r->total_len == 0) ||
+		   (fragment->total_len != r->total_len) ||
+		   (fragment->offset != r->len)) {
+		/* A fragment was lost, or the message was already discarded */
+		r->total_len = 0;
+		return -EINVAL;
+	}
+
+	if (fragment->len > r->total_len - r->len) {
+		r->total_len = 0;
+		return -EINVAL;
+	}
+
+	/* The fragments of a message that does not fit are only counted */
+	if (r->total_len <= r->size) {
+		memcpy(&r->buf[r->len], fragment->buf, fragment->len);
+	}
+
+	r->len += fragment->len;
+
+	if (r->total_len > r->size) {
+		return -EMSGSIZE;
+	}
+
+	return (r->len < r->total_len) ? -EAGAIN : 0;
+}
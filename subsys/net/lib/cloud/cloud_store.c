@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <errno.h>
+#include <string.h>
+#include <fs/fcb.h>
+#include <storage/flash_map.h>
+#include <pm_config.h>
+#include <net/cloud.h>
+#include <net/cloud_store.h>
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(cloud_store, CONFIG_CLOUD_STORE_LOG_LEVEL);
+
+#define STORE_MAGIC 0x434c5354
+#define STORE_VERSION 1
+
+/* Entry lengths are encoded in at most two bytes by the FCB */
+#define STORE_ENTRY_MAX_LEN 0x7fff
+
+/* Header of a stored message. It is followed by the payload and then the
+ * endpoint string, if any.
+ */
+struct store_hdr {
+	u8_t qos;
+	u8_t ep_type;
+	u16_t ep_len;
+} __packed;
+
+static const struct cloud_backend *store_backend;
+static struct fcb store_fcb;
+static struct flash_sector store_sectors[CONFIG_CLOUD_STORE_MAX_SECTORS];
+
+/* Last entry that was sent. The sector is NULL if no entry of the buffer
+ * has been sent. It is kept in RAM only, so messages that were sent before
+ * a reset are sent again after it.
+ */
+static struct fcb_entry sent_loc;
+static size_t stored_count;
+static bool link_up;
+static struct k_work_q *store_work_q;
+static struct k_delayed_work drain_work;
+
+static K_MUTEX_DEFINE(store_lock);
+
+static size_t unsent_count(void)
+{
+	struct fcb_entry loc = sent_loc;
+	size_t count = 0;
+
+	while (fcb_getnext(&store_fcb, &loc) == 0) {
+		count++;
+	}
+
+	return count;
+}
+
+/**@brief Erase the oldest sector to make room for new messages.
+ *	  Its unsent messages are lost.
+ */
+static int oldest_drop(void)
+{
+	int err;
+
+	if (sent_loc.fe_sector == store_fcb.f_oldest) {
+		sent_loc.fe_sector = NULL;
+	}
+
+	err = fcb_rotate(&store_fcb);
+	if (err) {
+		LOG_ERR("Failed to erase the oldest sector, error: %d", err);
+		return err;
+	}
+
+	stored_count = unsent_count();
+
+	return 0;
+}
+
+/**@brief Erase the sectors that only hold messages which have been sent.
+ *	  The sector that is appended to is erased only when all its
+ *	  messages have been sent, so that each sector is erased once per
+ *	  pass through the buffer at most.
+ */
+static void sent_release(void)
+{
+	while ((sent_loc.fe_sector != NULL) &&
+	       (store_fcb.f_oldest != sent_loc.fe_sector)) {
+		if (fcb_rotate(&store_fcb)) {
+			return;
+		}
+	}
+
+	if ((sent_loc.fe_sector != NULL) && (stored_count == 0)) {
+		if (fcb_rotate(&store_fcb) == 0) {
+			sent_loc.fe_sector = NULL;
+		}
+	}
+}
+
+static int store_append(const struct cloud_msg *msg)
+{
+	int err;
+	struct fcb_entry loc;
+	struct store_hdr *hdr;
+	size_t ep_len = (msg->endpoint.str != NULL) ? msg->endpoint.len : 0;
+	size_t len = sizeof(*hdr) + msg->len + ep_len;
+	size_t write_len;
+	u8_t *entry;
+
+	if (len > STORE_ENTRY_MAX_LEN) {
+		return -EMSGSIZE;
+	}
+
+	err = fcb_append(&store_fcb, len, &loc);
+	if (err == -ENOSPC) {
+		LOG_WRN("Store full, dropping the oldest messages");
+
+		err = oldest_drop();
+		if (err) {
+			return err;
+		}
+
+		err = fcb_append(&store_fcb, len, &loc);
+	}
+
+	if (err) {
+		LOG_ERR("Failed to append message, error: %d", err);
+		return err;
+	}
+
+	/* Flash is written in units of its write block size. The FCB has
+	 * reserved the entry rounded up to that size.
+	 */
+	write_len = ROUND_UP(len, store_fcb.f_align);
+
+	entry = k_malloc(write_len);
+	if (entry == NULL) {
+		LOG_ERR("Could not allocate message of %d bytes", write_len);
+		return -ENOMEM;
+	}
+
+	memset(entry, 0, write_len);
+	hdr = (struct store_hdr *)entry;
+	hdr->qos = msg->qos;
+	hdr->ep_type = msg->endpoint.type;
+	hdr->ep_len = ep_len;
+	memcpy(entry + sizeof(*hdr), msg->buf, msg->len);
+	if (ep_len > 0) {
+		memcpy(entry + sizeof(*hdr) + msg->len, msg->endpoint.str,
+		       ep_len);
+	}
+
+	err = flash_area_write(store_fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc),
+			       entry, write_len);
+	k_free(entry);
+	if (err) {
+		LOG_ERR("Failed to write message, error: %d", err);
+		return err;
+	}
+
+	/* An entry that is not finished is skipped when reading */
+	err = fcb_append_finish(&store_fcb, &loc);
+	if (err) {
+		LOG_ERR("Failed to finish message, error: %d", err);
+		return err;
+	}
+
+	stored_count++;
+
+	return 0;
+}
+
+static int entry_send(struct fcb_entry loc)
+{
+	int err;
+	struct store_hdr *hdr;
+	struct cloud_msg msg;
+	u8_t *entry;
+
+	if (loc.fe_data_len < sizeof(*hdr)) {
+		/* Nothing that can be sent, skip it */
+		return 0;
+	}
+
+	/* One more byte terminates the endpoint string */
+	entry = k_malloc(loc.fe_data_len + 1);
+	if (entry == NULL) {
+		return -ENOMEM;
+	}
+
+	err = flash_area_read(store_fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc),
+			      entry, loc.fe_data_len);
+	if (err) {
+		goto exit;
+	}
+
+	entry[loc.fe_data_len] = '\0';
+	hdr = (struct store_hdr *)entry;
+
+	if (hdr->ep_len > loc.fe_data_len - sizeof(*hdr)) {
+		LOG_WRN("Skipping malformed message");
+		goto exit;
+	}
+
+	msg = (struct cloud_msg){
+		.buf = entry + sizeof(*hdr),
+		.len = loc.fe_data_len - sizeof(*hdr) - hdr->ep_len,
+		.qos = hdr->qos,
+		.endpoint = {
+			.type = hdr->ep_type,
+			.str = (hdr->ep_len > 0) ?
+			       (char *)entry + loc.fe_data_len - hdr->ep_len :
+			       NULL,
+			.len = hdr->ep_len,
+		},
+	};
+
+	err = cloud_send(store_backend, &msg);
+
+exit:
+	k_free(entry);
+
+	return err;
+}
+
+/**@brief Send the next step of stored messages.
+ *	  Must be called with the store locked.
+ */
+static int store_drain(void)
+{
+	int err = 0;
+
+	for (size_t i = 0; i < CONFIG_CLOUD_STORE_DRAIN_BATCH; i++) {
+		struct fcb_entry loc = sent_loc;
+
+		if (fcb_getnext(&store_fcb, &loc)) {
+			break;
+		}
+
+		err = entry_send(loc);
+		if (err) {
+			LOG_ERR("Failed to send stored message, error: %d",
+				err);
+			break;
+		}
+
+		sent_loc = loc;
+		stored_count = (stored_count > 0) ? (stored_count - 1) : 0;
+	}
+
+	sent_release();
+
+	LOG_DBG("%d messages left in store", stored_count);
+
+	/* After an error the messages are sent again in the next step */
+	if (link_up && (stored_count > 0)) {
+		k_delayed_work_submit_to_queue(store_work_q, &drain_work,
+					CONFIG_CLOUD_STORE_DRAIN_INTERVAL);
+	}
+
+	return err;
+}
+
+static void drain_work_fn(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	if (link_up) {
+		(void)store_drain();
+	}
+
+	k_mutex_unlock(&store_lock);
+}
+
+int cloud_store_init(const struct cloud_backend *const backend,
+		     struct k_work_q *work_q)
+{
+	int err;
+	u32_t sector_cnt = ARRAY_SIZE(store_sectors);
+	const struct flash_area *fa;
+
+	if ((backend == NULL) || (work_q == NULL)) {
+		return -EINVAL;
+	}
+
+	err = flash_area_get_sectors(PM_CLOUD_STORE_ID, &sector_cnt,
+				     store_sectors);
+	if ((err != 0) && (err != -ENOMEM)) {
+		LOG_ERR("Failed to get sectors of the store, error: %d", err);
+		return err;
+	}
+
+	/* -ENOMEM means that the partition has more sectors than are used */
+	sector_cnt = MIN(sector_cnt, ARRAY_SIZE(store_sectors));
+
+	store_fcb.f_magic = STORE_MAGIC;
+	store_fcb.f_version = STORE_VERSION;
+	store_fcb.f_sectors = store_sectors;
+	store_fcb.f_sector_cnt = sector_cnt;
+	store_fcb.f_scratch_cnt = 0;
+
+	err = fcb_init(PM_CLOUD_STORE_ID, &store_fcb);
+	if (err) {
+		/* The partition holds something else, or an older version */
+		LOG_WRN("Store is not valid, erasing it");
+
+		err = flash_area_open(PM_CLOUD_STORE_ID, &fa);
+		if (err) {
+			return err;
+		}
+
+		err = flash_area_erase(fa, 0, fa->fa_size);
+		flash_area_close(fa);
+		if (err) {
+			LOG_ERR("Failed to erase the store, error: %d", err);
+			return err;
+		}
+
+		err = fcb_init(PM_CLOUD_STORE_ID, &store_fcb);
+		if (err) {
+			LOG_ERR("Failed to initialize the store, error: %d",
+				err);
+			return err;
+		}
+	}
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	store_backend = backend;
+	store_work_q = work_q;
+	sent_loc.fe_sector = NULL;
+	link_up = false;
+	stored_count = unsent_count();
+	k_delayed_work_init(&drain_work, drain_work_fn);
+
+	k_mutex_unlock(&store_lock);
+
+	LOG_INF("%d messages in store", stored_count);
+
+	return 0;
+}
+
+int cloud_store_send(const struct cloud_msg *const msg)
+{
+	int err;
+	struct cloud_msg direct;
+
+	if (store_backend == NULL) {
+		return -ENOENT;
+	}
+
+	if ((msg == NULL) || (msg->buf == NULL)) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	/* Stored messages go first, so that messages stay in order */
+	if (link_up && (stored_count == 0)) {
+		direct = *msg;
+		err = cloud_send(store_backend, &direct);
+		if (err == 0) {
+			goto exit;
+		}
+
+		LOG_WRN("Failed to send message, error: %d, storing it", err);
+	}
+
+	err = store_append(msg);
+	if ((err == 0) && link_up && (stored_count == 1)) {
+		/* Nothing is being drained, retry after an interval */
+		k_delayed_work_submit_to_queue(store_work_q, &drain_work,
+					CONFIG_CLOUD_STORE_DRAIN_INTERVAL);
+	}
+
+exit:
+	k_mutex_unlock(&store_lock);
+
+	return err;
+}
+
+void cloud_store_link_update(bool connected)
+{
+	if (store_backend == NULL) {
+		return;
+	}
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	link_up = connected;
+
+	if (!connected) {
+		k_delayed_work_cancel(&drain_work);
+	} else if (stored_count > 0) {
+		LOG_DBG("Link up, sending %d stored messages", stored_count);
+		k_delayed_work_submit_to_queue(store_work_q, &drain_work,
+					       K_NO_WAIT);
+	}
+
+	k_mutex_unlock(&store_lock);
+}
+
+size_t cloud_store_count(void)
+{
+	size_t count;
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+	count = stored_count;
+	k_mutex_unlock(&store_lock);
+
+	return count;
+}
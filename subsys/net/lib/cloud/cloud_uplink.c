@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/slist.h>
+#include <net/cloud.h>
+#include <net/cloud_uplink.h>
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(cloud_uplink, CONFIG_CLOUD_UPLINK_LOG_LEVEL);
+
+struct pending_msg {
+	sys_snode_t node;
+	s64_t deadline;
+	enum cloud_qos qos;
+	enum cloud_endpoint_type ep_type;
+	char *ep_str;
+	size_t ep_len;
+	size_t len;
+	/* Message payload followed by the endpoint string, if any. */
+	char data[];
+};
+
+static const struct cloud_backend *uplink_backend;
+static sys_slist_t pending_list;
+static size_t pending_count;
+static s64_t next_deadline;
+static bool rrc_connected;
+static bool flushing;
+static struct k_work_q *uplink_work_q;
+static struct k_delayed_work deadline_work;
+static struct k_work flush_work;
+
+static K_MUTEX_DEFINE(pending_lock);
+
+static int msg_send(struct pending_msg *entry)
+{
+	struct cloud_msg msg = {
+		.buf = entry->data,
+		.len = entry->len,
+		.qos = entry->qos,
+		.endpoint = {
+			.type = entry->ep_type,
+			.str = entry->ep_str,
+			.len = entry->ep_len,
+		},
+	};
+
+	return cloud_send(uplink_backend, &msg);
+}
+
+static void deadline_schedule(s64_t deadline)
+{
+	s64_t delay;
+
+	if ((next_deadline != 0) && (next_deadline <= deadline)) {
+		/* An earlier flush is already scheduled. */
+		return;
+	}
+
+	next_deadline = deadline;
+	delay = MAX(deadline - k_uptime_get(), 0);
+
+	k_delayed_work_cancel(&deadline_work);
+	k_delayed_work_submit_to_queue(uplink_work_q, &deadline_work,
+				       (s32_t)delay);
+}
+
+/**@brief Put the messages of a burst that were not sent back in front of
+ *	  the pending messages, so that they are sent first on the next
+ *	  flush.
+ */
+static void pending_restore(sys_slist_t *burst, size_t count)
+{
+	sys_snode_t *node;
+
+	while ((node = sys_slist_get(&pending_list)) != NULL) {
+		sys_slist_append(burst, node);
+	}
+
+	pending_list = *burst;
+	pending_count += count;
+}
+
+/**@brief Send the pending messages in one burst.
+ *	  Must be called with the pending list locked. The lock is released
+ *	  while sending, so that new messages can be queued meanwhile. They
+ *	  are sent by the same call after the burst, so only one flush sends
+ *	  at a time and the messages stay in order. A flush that is called
+ *	  while another one is in progress leaves its messages to that one.
+ *	  If a message cannot be sent, it and the messages after it are kept,
+ *	  and sent again on the next flush.
+ */
+static int pending_flush(void)
+{
+	int err = 0;
+
+	if (flushing) {
+		return 0;
+	}
+
+	flushing = true;
+
+	while (!sys_slist_is_empty(&pending_list) && (err == 0)) {
+		sys_slist_t burst = pending_list;
+		size_t count = pending_count;
+		sys_snode_t *node;
+
+		sys_slist_init(&pending_list);
+		pending_count = 0;
+
+		k_mutex_unlock(&pending_lock);
+
+		LOG_DBG("Sending %d deferred messages", count);
+
+		while ((node = sys_slist_peek_head(&burst)) != NULL) {
+			struct pending_msg *entry =
+				CONTAINER_OF(node, struct pending_msg, node);
+
+			err = msg_send(entry);
+			if (err) {
+				break;
+			}
+
+			(void)sys_slist_get(&burst);
+			k_free(entry);
+			count--;
+		}
+
+		k_mutex_lock(&pending_lock, K_FOREVER);
+
+		if (err) {
+			pending_restore(&burst, count);
+		}
+	}
+
+	next_deadline = 0;
+	k_delayed_work_cancel(&deadline_work);
+	flushing = false;
+
+	if (err) {
+		LOG_WRN("Deferred message not sent, error: %d, %d kept", err,
+			pending_count);
+		deadline_schedule(k_uptime_get() +
+				  CONFIG_CLOUD_UPLINK_RETRY_INTERVAL);
+	}
+
+	return err;
+}
+
+static void deadline_work_fn(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	LOG_DBG("Deadline reached, flushing");
+
+	k_mutex_lock(&pending_lock, K_FOREVER);
+	(void)pending_flush();
+	k_mutex_unlock(&pending_lock);
+}
+
+static void flush_work_fn(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	LOG_DBG("RRC connected, releasing deferred messages");
+
+	k_mutex_lock(&pending_lock, K_FOREVER);
+	(void)pending_flush();
+	k_mutex_unlock(&pending_lock);
+}
+
+static struct pending_msg *pending_msg_create(const struct cloud_msg *msg)
+{
+	struct pending_msg *entry;
+	size_t ep_len = (msg->endpoint.str != NULL) ? msg->endpoint.len : 0;
+
+	entry = k_malloc(sizeof(*entry) + msg->len + ep_len + 1);
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	memcpy(entry->data, msg->buf, msg->len);
+	entry->len = msg->len;
+	entry->qos = msg->qos;
+	entry->ep_type = msg->endpoint.type;
+	entry->ep_len = ep_len;
+
+	if (msg->endpoint.str != NULL) {
+		entry->ep_str = entry->data + msg->len;
+		memcpy(entry->ep_str, msg->endpoint.str, ep_len);
+		entry->ep_str[ep_len] = '\0';
+	} else {
+		entry->ep_str = NULL;
+	}
+
+	return entry;
+}
+
+int cloud_uplink_init(const struct cloud_backend *const backend,
+		      struct k_work_q *work_q)
+{
+	if ((backend == NULL) || (work_q == NULL)) {
+		return -EINVAL;
+	}
+
+	uplink_backend = backend;
+	uplink_work_q = work_q;
+	sys_slist_init(&pending_list);
+	pending_count = 0;
+	next_deadline = 0;
+	rrc_connected = false;
+	flushing = false;
+	k_delayed_work_init(&deadline_work, deadline_work_fn);
+	k_work_init(&flush_work, flush_work_fn);
+
+	return 0;
+}
+
+int cloud_uplink_send(const struct cloud_msg *const msg, u32_t deadline_ms)
+{
+	struct pending_msg *entry;
+
+	if (uplink_backend == NULL) {
+		return -ENOENT;
+	}
+
+	if ((msg == NULL) || (msg->buf == NULL)) {
+		return -EINVAL;
+	}
+
+	entry = pending_msg_create(msg);
+	if (entry == NULL) {
+		LOG_ERR("Could not allocate deferred message");
+		return -ENOMEM;
+	}
+
+	entry->deadline = k_uptime_get() + deadline_ms;
+
+	k_mutex_lock(&pending_lock, K_FOREVER);
+
+	/* The list is only full here if messages could not be sent */
+	if ((pending_count >= CONFIG_CLOUD_UPLINK_MAX_PENDING) &&
+	    (pending_flush() != 0)) {
+		k_mutex_unlock(&pending_lock);
+		k_free(entry);
+		return -ENOBUFS;
+	}
+
+	sys_slist_append(&pending_list, &entry->node);
+	pending_count++;
+
+	/* The message goes out together with everything that is pending
+	 * if the link is already active, if a connection has to be set up
+	 * for it anyway, or if there is no room for more messages. If
+	 * sending fails, the message is kept and sent again later.
+	 */
+	if (rrc_connected || (deadline_ms == CLOUD_UPLINK_DEADLINE_NOW) ||
+	    (pending_count >= CONFIG_CLOUD_UPLINK_MAX_PENDING)) {
+		(void)pending_flush();
+	} else {
+		deadline_schedule(entry->deadline);
+	}
+
+	k_mutex_unlock(&pending_lock);
+
+	return 0;
+}
+
+int cloud_uplink_flush(void)
+{
+	int err;
+
+	if (uplink_backend == NULL) {
+		return -ENOENT;
+	}
+
+	k_mutex_lock(&pending_lock, K_FOREVER);
+	err = pending_flush();
+	k_mutex_unlock(&pending_lock);
+
+	return err;
+}
+
+void cloud_uplink_rrc_update(bool connected)
+{
+	bool flush;
+
+	if (uplink_backend == NULL) {
+		return;
+	}
+
+	k_mutex_lock(&pending_lock, K_FOREVER);
+	rrc_connected = connected;
+	flush = connected && (pending_count > 0);
+	k_mutex_unlock(&pending_lock);
+
+	/* Sending blocks, so it is done from the work queue */
+	if (flush) {
+		k_work_submit_to_queue(uplink_work_q, &flush_work);
+	}
+}
+
+size_t cloud_uplink_pending_count(void)
+{
+	size_t count;
+
+	k_mutex_lock(&pending_lock, K_FOREVER);
+	count = pending_count;
+	k_mutex_unlock(&pending_lock);
+
+	return count;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef DOWNLOAD_CLIENT_TRANSPORT_H__
+#define DOWNLOAD_CLIENT_TRANSPORT_H__
+
+#include <zephyr.h>
+#include <zephyr/types.h>
+#include <net/download_client.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@brief Protocol used to download a file. */
+struct download_client_transport {
+	/** URI scheme selecting this transport, or NULL for the default. */
+	const char *scheme;
+	/** Socket type. */
+	int type;
+	/** Socket protocol without and with security. */
+	int proto;
+	int proto_sec;
+	/** Default port without and with security. */
+	u16_t port;
+	u16_t port_sec;
+	/** Socket receive timeout in milliseconds, or -1 to disable. */
+	s32_t recv_timeout_ms;
+
+	/**@brief Prepare a new download, optional.
+	 *
+	 * @param client Client instance.
+	 */
+	void (*start)(struct download_client *client);
+
+	/**@brief Request the data from the current progress on.
+	 *
+	 * @param client Client instance.
+	 * @param resend True if the previous requests may have been lost.
+	 *
+	 * @return 0 or a negative error code.
+	 */
+	int (*request)(struct download_client *client, bool resend);
+
+	/**@brief Parse the data received at the end of the buffer.
+	 *
+	 * Sets @c body to the first unsent payload byte in the buffer, and
+	 * @c response_remaining when a new response starts.
+	 *
+	 * @param client Client instance.
+	 * @param len Number of bytes received.
+	 *
+	 * @return Number of payload bytes received, -EAGAIN if there is
+	 *	   no payload yet, or another negative error code if the
+	 *	   response is invalid.
+	 */
+	int (*parse)(struct download_client *client, size_t len);
+
+	/**@brief Handle a receive timeout, optional.
+	 *
+	 * @param client Client instance.
+	 *
+	 * @return 0 if the download can continue, a negative error code
+	 *	   otherwise.
+	 */
+	int (*timeout)(struct download_client *client);
+};
+
+extern const struct download_client_transport download_client_transport_http;
+extern const struct download_client_transport download_client_transport_coap;
+
+/**@brief Send @p len bytes from the client buffer. */
+int download_client_socket_send(const struct download_client *client,
+				size_t len);
+
+/**@brief Set the socket receive timeout, -1 to disable. */
+int download_client_socket_timeout_set(int fd, s32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DOWNLOAD_CLIENT_TRANSPORT_H__ */
@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <string.h>
+#include <zephyr.h>
+#include <zephyr/types.h>
+#include <toolchain/common.h>
+#include <random/rand32.h>
+#include <net/socket.h>
+#include <net/coap.h>
+#include <net/download_client.h>
+#include <logging/log.h>
+#include "download_client_transport.h"
+
+LOG_MODULE_DECLARE(download_client, CONFIG_DOWNLOAD_CLIENT_LOG_LEVEL);
+
+#define COAP_PROTOCOL_VERSION 1
+
+/* Space for the header, token and options of a response */
+#define COAP_RESPONSE_OVERHEAD 64
+
+#define BLOCK_SIZE CONFIG_DOWNLOAD_CLIENT_COAP_BLOCK_SIZE
+
+BUILD_ASSERT_MSG((BLOCK_SIZE & (BLOCK_SIZE - 1)) == 0,
+		 "The CoAP block size must be a power of two");
+
+BUILD_ASSERT_MSG(BLOCK_SIZE + COAP_RESPONSE_OVERHEAD <=
+		 CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE,
+		 "The response buffer must accommodate for a full CoAP block");
+
+/* Block2 option value, RFC 7959 section 2.2 */
+#define BLOCK2_NUM(val) ((u32_t)(val) >> 4)
+#define BLOCK2_MORE(val) (((val) & 0x08) != 0)
+#define BLOCK2_SZX(val) ((val) & 0x07)
+#define BLOCK2_VALUE(num, szx) (((num) << 4) | (szx))
+
+static size_t block_size(const struct download_client *client)
+{
+	return 1 << (client->coap.szx + 4);
+}
+
+static u8_t szx_get(size_t size)
+{
+	u8_t szx = 0;
+
+	while ((16 << szx) < size) {
+		szx++;
+	}
+
+	return szx;
+}
+
+static int block_request_send(struct download_client *client, u32_t num)
+{
+	int err;
+	const char *seg;
+	const char *end;
+	struct coap_packet request;
+
+	err = coap_packet_init(&request, (u8_t *)client->buf,
+			       CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE,
+			       COAP_PROTOCOL_VERSION, COAP_TYPE_CON,
+			       sizeof(client->coap.token),
+			       (u8_t *)&client->coap.token,
+			       COAP_METHOD_GET, coap_next_id());
+	if (err < 0) {
+		return err;
+	}
+
+	/* One Uri-Path option per path segment */
+	for (seg = client->file; *seg != '\0'; seg = end) {
+		end = strchr(seg, '/');
+		if (end == NULL) {
+			end = seg + strlen(seg);
+		}
+
+		if (end != seg) {
+			err = coap_packet_append_option(&request,
+							COAP_OPTION_URI_PATH,
+							(u8_t *)seg, end - seg);
+			if (err < 0) {
+				return err;
+			}
+		}
+
+		if (*end == '/') {
+			end++;
+		}
+	}
+
+	err = coap_append_option_int(&request, COAP_OPTION_BLOCK2,
+				     BLOCK2_VALUE(num, client->coap.szx));
+	if (err < 0) {
+		return err;
+	}
+
+	if (client->file_size == 0) {
+		/* Ask for the size of the file, RFC 7959 section 4 */
+		err = coap_append_option_int(&request, COAP_OPTION_SIZE2, 0);
+		if (err < 0) {
+			return err;
+		}
+	}
+
+	LOG_DBG("Requesting block %u", num);
+
+	return download_client_socket_send(client, request.offset);
+}
+
+static void coap_start(struct download_client *client)
+{
+	/* The server may choose a smaller block size in its first response,
+	 * which is then used for the rest of the download.
+	 */
+	client->coap.szx = szx_get(BLOCK_SIZE);
+
+	if (client->coap.retransmits > 0) {
+		client->coap.retransmits = 0;
+		(void)download_client_socket_timeout_set(client->fd,
+			CONFIG_DOWNLOAD_CLIENT_COAP_ACK_TIMEOUT_MS);
+	}
+}
+
+/* Fill the window of requests in flight. With resend, the window is
+ * requested again from the current progress on.
+ */
+static int coap_request(struct download_client *client, bool resend)
+{
+	int err;
+	u32_t first;
+	u32_t window;
+
+	if (resend) {
+		/* A new token makes responses to the lost requests
+		 * distinguishable from the new ones.
+		 */
+		client->coap.token = sys_rand32_get();
+		client->coap.next_block = client->progress / block_size(client);
+	}
+
+	first = client->progress / block_size(client);
+
+	/* Blocks past the end of the file would be rejected by the server,
+	 * so only request one block at a time while the size is unknown.
+	 */
+	window = (client->file_size != 0) ?
+		 CONFIG_DOWNLOAD_CLIENT_COAP_NSTART : 1;
+
+	while (client->coap.next_block < first + window) {
+		if ((client->file_size != 0) &&
+		    (client->coap.next_block * block_size(client) >=
+		     client->file_size)) {
+			break;
+		}
+
+		err = block_request_send(client, client->coap.next_block);
+		if (err) {
+			LOG_ERR("Failed to send CoAP request, err %d", err);
+			return err;
+		}
+
+		client->coap.next_block++;
+	}
+
+	return 0;
+}
+
+static void ack_send(struct download_client *client, u16_t id)
+{
+	int err;
+	u8_t buf[4];
+	struct coap_packet ack;
+
+	err = coap_packet_init(&ack, buf, sizeof(buf), COAP_PROTOCOL_VERSION,
+			       COAP_TYPE_ACK, 0, NULL, COAP_CODE_EMPTY, id);
+	if (err < 0) {
+		return;
+	}
+
+	if (send(client->fd, ack.data, ack.offset, 0) < 0) {
+		LOG_WRN("Failed to acknowledge response, errno %d", errno);
+	}
+}
+
+static int coap_parse(struct download_client *client, size_t len)
+{
+	int err;
+	int block2;
+	int size2;
+	bool resized;
+	u8_t code;
+	u8_t token[8];
+	u16_t payload_len;
+	size_t block_off;
+	const u8_t *payload;
+	struct coap_packet response;
+
+	ARG_UNUSED(len);
+
+	/* Each datagram is a complete message */
+	err = coap_packet_parse(&response, (u8_t *)client->buf, client->offset,
+				NULL, 0);
+	if (err < 0) {
+		LOG_WRN("Discarding invalid CoAP message");
+		goto discard;
+	}
+
+	code = coap_header_get_code(&response);
+
+	if (coap_header_get_type(&response) == COAP_TYPE_RESET) {
+		LOG_ERR("CoAP request rejected by server");
+		return -EBADMSG;
+	}
+
+	if (coap_header_get_type(&response) == COAP_TYPE_CON) {
+		/* Separate response */
+		ack_send(client, coap_header_get_id(&response));
+	}
+
+	if (code == COAP_CODE_EMPTY) {
+		/* Acknowledgment, the response follows separately */
+		goto discard;
+	}
+
+	if ((coap_header_get_token(&response, token) !=
+	     sizeof(client->coap.token)) ||
+	    (memcmp(token, &client->coap.token,
+		    sizeof(client->coap.token)) != 0)) {
+		LOG_DBG("Discarding response to an earlier download");
+		goto discard;
+	}
+
+	if (code != COAP_RESPONSE_CODE_CONTENT) {
+		LOG_ERR("Unexpected CoAP response %d.%02d",
+			code >> 5, code & 0x1f);
+		return -EBADMSG;
+	}
+
+	block2 = coap_get_option_int(&response, COAP_OPTION_BLOCK2);
+	if (block2 < 0) {
+		/* The whole file fits in one response */
+		if (client->progress != 0) {
+			LOG_ERR("Server does not support block-wise transfer");
+			return -EBADMSG;
+		}
+
+		block2 = BLOCK2_VALUE(0, client->coap.szx);
+	}
+
+	payload = coap_packet_get_payload(&response, &payload_len);
+	if (payload == NULL) {
+		payload_len = 0;
+		payload = (u8_t *)client->buf + client->offset;
+	}
+
+	resized = (BLOCK2_SZX(block2) < client->coap.szx);
+	if (resized) {
+		/* The server may use a smaller block size than requested */
+		LOG_INF("Server uses %d byte blocks",
+			1 << (BLOCK2_SZX(block2) + 4));
+		client->coap.szx = BLOCK2_SZX(block2);
+		client->coap.next_block = BLOCK2_NUM(block2) + 1;
+	}
+
+	/* The download may resume from within a block */
+	block_off = BLOCK2_NUM(block2) << (BLOCK2_SZX(block2) + 4);
+	if ((block_off > client->progress) ||
+	    (block_off + payload_len < client->progress) ||
+	    ((block_off + payload_len == client->progress) &&
+	     BLOCK2_MORE(block2))) {
+		if (resized) {
+			/* The block does not contain the current progress
+			 * in the new block size, request the right one.
+			 */
+			client->offset = 0;
+			err = coap_request(client, true);
+			if (err) {
+				return err;
+			}
+		}
+
+		/* Duplicate, or follows a lost block that will be requested
+		 * again.
+		 */
+		LOG_DBG("Discarding block %u", BLOCK2_NUM(block2));
+		goto discard;
+	}
+
+	size2 = coap_get_option_int(&response, COAP_OPTION_SIZE2);
+	if ((size2 > 0) && (client->file_size == 0)) {
+		client->file_size = size2;
+		LOG_DBG("File size = %d", client->file_size);
+	}
+
+	if (!BLOCK2_MORE(block2)) {
+		/* Last block */
+		client->file_size = block_off + payload_len;
+	}
+
+	/* Skip the bytes that have been received already */
+	payload += client->progress - block_off;
+	payload_len -= client->progress - block_off;
+
+	if (client->coap.retransmits > 0) {
+		client->coap.retransmits = 0;
+		(void)download_client_socket_timeout_set(client->fd,
+			CONFIG_DOWNLOAD_CLIENT_COAP_ACK_TIMEOUT_MS);
+	}
+
+	client->has_header = true;
+	client->body = payload - (u8_t *)client->buf;
+	client->response_remaining = payload_len;
+
+	return payload_len;
+
+discard:
+	client->offset = 0;
+	return -EAGAIN;
+}
+
+static int coap_timeout(struct download_client *client)
+{
+	if (client->coap.retransmits >=
+	    CONFIG_DOWNLOAD_CLIENT_COAP_MAX_RETRANSMIT) {
+		LOG_ERR("No response from CoAP server");
+		return -ETIMEDOUT;
+	}
+
+	client->coap.retransmits++;
+
+	LOG_WRN("Retransmitting CoAP request (%d)",
+		client->coap.retransmits);
+
+	/* Exponential back-off, RFC 7252 section 4.2 */
+	(void)download_client_socket_timeout_set(client->fd,
+		CONFIG_DOWNLOAD_CLIENT_COAP_ACK_TIMEOUT_MS <<
+		client->coap.retransmits);
+
+	client->offset = 0;
+
+	return coap_request(client, true);
+}
+
+const struct download_client_transport download_client_transport_coap = {
+	.scheme = "coap://",
+	.type = SOCK_DGRAM,
+	.proto = IPPROTO_UDP,
+	.proto_sec = IPPROTO_DTLS_1_2,
+	.port = 5683,
+	.port_sec = 5684,
+	.recv_timeout_ms = CONFIG_DOWNLOAD_CLIENT_COAP_ACK_TIMEOUT_MS,
+	.start = coap_start,
+	.request = coap_request,
+	.parse = coap_parse,
+	.timeout = coap_timeout,
+};
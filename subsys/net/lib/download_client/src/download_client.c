@@ -4,7 +4,6 @@
  * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
  */
 
-#include <stdio.h>
 #include <string.h>
 #include <zephyr.h>
 #include <zephyr/types.h>
@@ -13,16 +12,10 @@
 #include <net/tls_credentials.h>
 #include <net/download_client.h>
 #include <logging/log.h>
+#include "download_client_transport.h"
 
 LOG_MODULE_REGISTER(download_client, CONFIG_DOWNLOAD_CLIENT_LOG_LEVEL);
 
-#define GET_TEMPLATE                                                           \
-	"GET /%s HTTP/1.1\r\n"                                                 \
-	"Host: %s\r\n"                                                         \
-	"Connection: keep-alive\r\n"                                           \
-	"Range: bytes=%u-%u\r\n"                                               \
-	"\r\n"
-
 BUILD_ASSERT_MSG(CONFIG_DOWNLOAD_CLIENT_MAX_FRAGMENT_SIZE <=
 		 CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE,
 		 "The response buffer must accommodate for a full non-TLS fragment");
@@ -37,16 +30,14 @@ BUILD_ASSERT_MSG(CONFIG_LOG_BUFFER_SIZE >= 2048,
 		 "Please increase log buffer sizer");
 #endif
 
-static int socket_timeout_set(int fd)
+int download_client_socket_timeout_set(int fd, s32_t timeout_ms)
 {
 	int err;
 
-	if (CONFIG_DOWNLOAD_CLIENT_SOCK_TIMEOUT_MS == K_FOREVER) {
+	if (timeout_ms == K_FOREVER) {
 		return 0;
 	}
 
-	const u32_t timeout_ms = CONFIG_DOWNLOAD_CLIENT_SOCK_TIMEOUT_MS;
-
 	struct timeval timeo = {
 		.tv_sec = (timeout_ms / 1000),
 		.tv_usec = (timeout_ms % 1000) * 1000,
@@ -118,7 +109,8 @@ static int socket_apn_set(int fd, const char *apn)
 }
 
 static int resolve_and_connect(int family, const char *host,
-			       const struct download_client_cfg *cfg)
+		const struct download_client_cfg *cfg,
+		const struct download_client_transport *transport)
 {
 	int fd;
 	int err;
@@ -132,19 +124,19 @@ static int resolve_and_connect(int family, const char *host,
 
 	/* Set up port and protocol */
 	if (cfg->sec_tag == -1) {
-		proto = IPPROTO_TCP;
+		proto = transport->proto;
 		port = (cfg->port != 0) ? htons(cfg->port) :
-					  htons(80); /* HTTP, port 80 */
+					  htons(transport->port);
 	} else {
-		proto = IPPROTO_TLS_1_2;
+		proto = transport->proto_sec;
 		port = (cfg->port != 0) ? htons(cfg->port) :
-					  htons(443); /* HTTPS, port 443 */
+					  htons(transport->port_sec);
 	}
 
 	/* Lookup host */
 	struct addrinfo hints = {
 		.ai_family = family,
-		.ai_socktype = SOCK_STREAM,
+		.ai_socktype = transport->type,
 		.ai_protocol = proto,
 		/* Either a valid, NULL-terminated access point name or NULL. */
 		.ai_canonname = (char *)cfg->apn
@@ -160,7 +152,7 @@ static int resolve_and_connect(int family, const char *host,
 	LOG_INF("Attempting to connect over %s",
 		family == AF_INET ? log_strdup("IPv4") : log_strdup("IPv6"));
 
-	fd = socket(family, SOCK_STREAM, proto);
+	fd = socket(family, transport->type, proto);
 	if (fd < 0) {
 		LOG_ERR("Failed to create socket, errno %d", errno);
 		goto cleanup;
@@ -174,7 +166,7 @@ static int resolve_and_connect(int family, const char *host,
 		}
 	}
 
-	if (proto == IPPROTO_TLS_1_2) {
+	if (cfg->sec_tag != -1) {
 		LOG_INF("Setting up TLS credentials");
 		err = socket_sectag_set(fd, cfg->sec_tag);
 		if (err) {
@@ -219,7 +211,8 @@ cleanup:
 	return fd;
 }
 
-static int socket_send(const struct download_client *client, size_t len)
+int download_client_socket_send(const struct download_client *client,
+				size_t len)
 {
 	int sent;
 	size_t off = 0;
@@ -237,145 +230,181 @@ static int socket_send(const struct download_client *client, size_t len)
 	return 0;
 }
 
-static int get_request_send(struct download_client *client)
+static void response_reset(struct download_client *client)
 {
-	int err;
-	int len;
-	size_t off;
-
-	__ASSERT_NO_MSG(client);
-	__ASSERT_NO_MSG(client->host);
-	__ASSERT_NO_MSG(client->file);
-
-	/* Offset of last byte in range (Content-Range) */
-	off = client->progress + client->fragment_size - 1;
+	client->offset = 0;
+	client->body = 0;
+	client->has_header = false;
+	client->hdr_line = 0;
+	client->hdr_scan = 0;
+	client->http_status = 0;
+	client->has_content_length = false;
+	client->response_remaining = 0;
+}
 
-	if (client->file_size != 0) {
-		/* Don't request bytes past the end of file */
-		off = MIN(off, client->file_size);
-	}
+#if defined(CONFIG_DOWNLOAD_CLIENT_DOUBLE_BUFFER)
+static void frag_thread(void *client, void *a, void *b)
+{
+	struct download_client *const dl = client;
+	struct download_client_frag_msg msg;
 
-	len = snprintf(client->buf, CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE,
-		       GET_TEMPLATE, client->file, client->host,
-		       client->progress, off);
+	while (true) {
+		k_msgq_get(&dl->frag_q, &msg, K_FOREVER);
 
-	if (len < 0 || len > CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE) {
-		LOG_ERR("Cannot create GET request, buffer too small");
-		return -ENOMEM;
-	}
+		/* Discard the remaining fragments once one is refused */
+		if ((msg.buf != NULL) && !dl->stopped) {
+			const struct download_client_evt evt = {
+				.id = DOWNLOAD_CLIENT_EVT_FRAGMENT,
+				.fragment = {
+					.buf = msg.buf,
+					.len = msg.len,
+				}
+			};
 
-	if (IS_ENABLED(CONFIG_DOWNLOAD_CLIENT_LOG_HEADERS)) {
-		LOG_HEXDUMP_DBG(client->buf, len, "HTTP request");
-	}
+			if (dl->callback(&evt)) {
+				dl->stopped = true;
+			}
+		}
 
-	LOG_DBG("Sending HTTP request");
-	err = socket_send(client, len);
-	if (err) {
-		LOG_ERR("Failed to send HTTP request, errno %d", errno);
-		return err;
+		if (msg.release >= 0) {
+			k_sem_give(&dl->buf_free[msg.release]);
+		}
 	}
-
-	return 0;
 }
 
-/* Returns:
- *  1 while the header is being received
- *  0 if the header has been fully received
- * -1 on error
+/* Hand the active buffer over to the fragment thread
+ * and continue receiving into the other buffer once it is free.
  */
-static int header_parse(struct download_client *client)
+static void buffer_switch(struct download_client *dl)
 {
-	char *p;
-	size_t hdr;
-
-	p = strstr(client->buf, "\r\n\r\n");
-	if (!p) {
-		/* Awaiting full GET response */
-		LOG_DBG("Awaiting full header in response");
-		return 1;
-	}
-
-	/* Offset of the end of the HTTP header in the buffer */
-	hdr = p + strlen("\r\n\r\n") - client->buf;
-
-	__ASSERT(hdr < sizeof(client->buf), "Buffer overflow");
-
-	LOG_DBG("GET header size: %u", hdr);
+	const struct download_client_frag_msg msg = {
+		.buf = NULL,
+		.release = dl->active,
+	};
 
-	if (IS_ENABLED(CONFIG_DOWNLOAD_CLIENT_LOG_HEADERS)) {
-		LOG_HEXDUMP_DBG(client->buf, hdr, "GET");
-	}
+	k_msgq_put(&dl->frag_q, &msg, K_FOREVER);
 
-	/* If file size is not known, read it from the header */
-	if (client->file_size == 0) {
-		p = strstr(client->buf, "Content-Range: bytes");
-		if (!p) {
-			/* Cannot continue */
-			LOG_ERR("Server did not send "
-				"\"Content-Range\" in response");
-			return -1;
-		}
-		p = strstr(p, "/");
-		if (!p) {
-			/* Cannot continue */
-			LOG_ERR("Server did not send file size in response");
-			return -1;
-		}
+	dl->active = !dl->active;
 
-		client->file_size = atoi(p + 1);
+	/* Wait for the application to catch up */
+	k_sem_take(&dl->buf_free[dl->active], K_FOREVER);
 
-		LOG_DBG("File size = %d", client->file_size);
-	}
+	dl->buf = dl->bufs[dl->active];
+}
 
-	p = strstr(client->buf, "Connection: close");
-	if (p) {
-		LOG_WRN("Peer closed connection, will attempt to re-connect");
-		client->connection_close = true;
-	}
+/* Wait until all queued fragments have been sent to the application. */
+static int fragments_flush(struct download_client *dl)
+{
+	const struct download_client_frag_msg msg = {
+		.buf = NULL,
+		.release = dl->active,
+	};
 
-	if (client->offset != hdr) {
-		/* The current buffer contains some payload bytes.
-		 * Copy them at the beginning of the buffer
-		 * then update the offset.
-		 */
-		LOG_WRN("Copying %u payload bytes", client->offset - hdr);
-		memcpy(client->buf, client->buf + hdr, client->offset - hdr);
+	k_msgq_put(&dl->frag_q, &msg, K_FOREVER);
+	k_sem_take(&dl->buf_free[dl->active], K_FOREVER);
 
-		client->offset -= hdr;
-	} else {
-		/* Reset the offset.
-		 * The payload is received in an empty buffer.
-		 */
-		client->offset = 0;
-	}
+	return dl->stopped ? -ECANCELED : 0;
+}
+#else
+static void buffer_switch(struct download_client *dl)
+{
+}
 
+static int fragments_flush(struct download_client *dl)
+{
 	return 0;
 }
+#endif /* CONFIG_DOWNLOAD_CLIENT_DOUBLE_BUFFER */
 
-static int fragment_evt_send(const struct download_client *client)
+static int fragment_evt_send(struct download_client *client,
+			     const char *buf, size_t len)
 {
-	__ASSERT(client->offset <= client->fragment_size,
-		 "Fragment overflow!");
+	__ASSERT(len <= client->fragment_size, "Fragment overflow!");
 
-	__ASSERT(client->offset <= CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE,
+	__ASSERT(buf + len <= client->buf +
+			      CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE,
 		 "Buffer overflow!");
 
+#if defined(CONFIG_DOWNLOAD_CLIENT_DOUBLE_BUFFER)
+	const struct download_client_frag_msg msg = {
+		.buf = buf,
+		.len = len,
+		.release = -1,
+	};
+
+	if (client->stopped) {
+		return -ECANCELED;
+	}
+
+	return k_msgq_put(&client->frag_q, &msg, K_FOREVER);
+#else
 	const struct download_client_evt evt = {
 		.id = DOWNLOAD_CLIENT_EVT_FRAGMENT,
 		.fragment = {
-			.buf = client->buf,
-			.len = client->offset,
+			.buf = buf,
+			.len = len,
 		}
 	};
 
 	return client->callback(&evt);
+#endif
+}
+
+/* Send the received payload to the application, directly from the buffer.
+ * Fragments are sent as soon as they are complete. The last bytes are sent
+ * when the response has been received completely or the buffer is full.
+ */
+static int fragments_send(struct download_client *client)
+{
+	int rc;
+	size_t len;
+
+	while (client->offset > client->body) {
+		len = MIN(client->offset - client->body,
+			  client->fragment_size);
+
+		if ((len < client->fragment_size) &&
+		    (client->response_remaining > 0) &&
+		    (client->offset <
+		     CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE)) {
+			LOG_DBG("Awaiting full fragment (%u)", len);
+			break;
+		}
+
+		LOG_INF("Downloaded %u/%u bytes (%d%%)", client->progress,
+			client->file_size, (client->file_size == 0) ? 0 :
+			(client->progress * 100) / client->file_size);
+
+		rc = fragment_evt_send(client, client->buf + client->body,
+				       len);
+		if (rc) {
+			return rc;
+		}
+
+		client->body += len;
+	}
+
+	if (client->body == client->offset) {
+		/* All sent, receive into an empty buffer */
+		if (client->offset > 0) {
+			buffer_switch(client);
+		}
+
+		client->offset = 0;
+		client->body = 0;
+	}
+
+	return 0;
 }
 
-static int error_evt_send(const struct download_client *dl, int error)
+static int error_evt_send(struct download_client *dl, int error)
 {
 	/* Error will be sent as negative. */
 	__ASSERT_NO_MSG(error > 0);
 
+	/* Deliver the pending fragments first */
+	(void)fragments_flush(dl);
+
 	const struct download_client_evt evt = {
 		.id = DOWNLOAD_CLIENT_EVT_ERROR,
 		.error = -error
@@ -406,19 +435,30 @@ void download_thread(void *client, void *a, void *b)
 {
 	int rc;
 	size_t len;
+	bool resend;
 	struct download_client *const dl = client;
+	const size_t buf_size = CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE;
 
 restart_and_suspend:
 	k_thread_suspend(dl->tid);
 
 	while (true) {
-		__ASSERT(dl->offset < sizeof(dl->buf), "Buffer overflow");
+		__ASSERT(dl->offset < buf_size, "Buffer overflow");
 
 		LOG_DBG("Receiving up to %d bytes at %p...",
-			(sizeof(dl->buf) - dl->offset), (dl->buf + dl->offset));
+			(buf_size - dl->offset), (dl->buf + dl->offset));
 
 		len = recv(dl->fd, dl->buf + dl->offset,
-			   sizeof(dl->buf) - dl->offset, 0);
+			   buf_size - dl->offset, 0);
+
+		if ((len == -1) && (errno == EAGAIN) &&
+		    (dl->transport->timeout != NULL)) {
+			/* Let the transport retransmit its requests */
+			rc = dl->transport->timeout(dl);
+			if (rc == 0) {
+				continue;
+			}
+		}
 
 		if ((len == 0) || (len == -1)) {
 			/* We just had an unexpected socket error or closure */
@@ -427,8 +467,12 @@ restart_and_suspend:
 			 * and it has been accounted in our progress, we have
 			 * to hand it to the application before discarding it.
 			 */
-			if ((dl->offset > 0) && (dl->has_header)) {
-				rc = fragment_evt_send(dl);
+			if ((dl->offset > dl->body) && (dl->has_header)) {
+				rc = fragment_evt_send(dl, dl->buf + dl->body,
+						       dl->offset - dl->body);
+				if (rc == 0) {
+					rc = fragments_flush(dl);
+				}
 				if (rc) {
 					/* Restart and suspend */
 					LOG_INF("Fragment refused, download "
@@ -452,6 +496,7 @@ restart_and_suspend:
 				break;
 			}
 			reconnect(dl);
+			resend = true;
 			goto send_again;
 		}
 
@@ -460,50 +505,27 @@ restart_and_suspend:
 		/* Accumulate buffer offset */
 		dl->offset += len;
 
-		if (!dl->has_header) {
-			rc = header_parse(dl);
-			if (rc > 0) {
-				/* Wait for payload */
-				continue;
-			}
-			if (rc < 0) {
-				/* Something was wrong with the header.
-				 * Restart and suspend, no point in retrying.
-				 */
-				error_evt_send(dl, EBADMSG);
-				break;
-			}
-
-			dl->has_header = true;
-		}
-
-		/* Accumulate overall file progress.
-		 *
-		 * If the last recv() call read an HTTP header,
-		 * the offset has been moved to the end of the header in
-		 * header_parse(). Thus, we accumulate the offset
-		 * to the progress.
-		 *
-		 * If the last recv() call received only a HTTP message body,
-		 * then we accumulate 'len'.
-		 *
-		 */
-		dl->progress += MIN(dl->offset, len);
-
-		/* Have we received a whole fragment or the whole file? */
-		if ((dl->offset < dl->fragment_size) &&
-		    (dl->progress != dl->file_size)) {
-			LOG_DBG("Awaiting full fragment (%u)", dl->offset);
+		rc = dl->transport->parse(dl, len);
+		if (rc == -EAGAIN) {
+			/* Wait for payload */
 			continue;
 		}
+		if (rc < 0) {
+			/* Something was wrong with the response.
+			 * Restart and suspend, no point in retrying.
+			 */
+			error_evt_send(dl, EBADMSG);
+			break;
+		}
 
-		LOG_INF("Downloaded %u/%u bytes (%d%%)", dl->progress,
-			dl->file_size, (dl->progress * 100) / dl->file_size);
+		/* Accumulate overall file progress */
+		dl->progress += rc;
+		dl->response_remaining -= rc;
 
-		/* Send fragment to application.
+		/* Send fragments to application.
 		 * If the application callback returns non-zero, stop.
 		 */
-		rc = fragment_evt_send(dl);
+		rc = fragments_send(dl);
 		if (rc) {
 			/* Restart and suspend */
 			LOG_INF("Fragment refused, download stopped.");
@@ -511,6 +533,12 @@ restart_and_suspend:
 		}
 
 		if (dl->progress == dl->file_size) {
+			rc = fragments_flush(dl);
+			if (rc) {
+				LOG_INF("Fragment refused, download stopped.");
+				break;
+			}
+
 			LOG_INF("Download complete");
 			const struct download_client_evt evt = {
 				.id = DOWNLOAD_CLIENT_EVT_DONE,
@@ -520,19 +548,25 @@ restart_and_suspend:
 			break;
 		}
 
+		if (dl->response_remaining > 0) {
+			/* More payload follows in this response */
+			continue;
+		}
+
+		resend = false;
+
 		/* Attempt to reconnect if the connection was closed */
 		if (dl->connection_close) {
 			dl->connection_close = false;
 			reconnect(dl);
+			resend = true;
 		}
 
 		/* Request next fragment */
-		/* Send a GET request for the next bytes */
 send_again:
-		dl->offset = 0;
-		dl->has_header = false;
+		response_reset(dl);
 
-		rc = get_request_send(dl);
+		rc = dl->transport->request(dl, resend);
 		if (rc) {
 			rc = error_evt_send(dl, ECONNRESET);
 			if (rc) {
@@ -540,10 +574,16 @@ send_again:
 				break;
 			}
 			reconnect(dl);
+			resend = true;
 			goto send_again;
 		}
 	}
 
+	/* Let the application finish with the fragments before the
+	 * download can be restarted.
+	 */
+	(void)fragments_flush(dl);
+
 	/* Do not let the thread return, since it can't be restarted */
 	goto restart_and_suspend;
 }
@@ -558,6 +598,25 @@ int download_client_init(struct download_client *const client,
 	client->fd = -1;
 	client->callback = callback;
 
+#if defined(CONFIG_DOWNLOAD_CLIENT_DOUBLE_BUFFER)
+	client->active = 0;
+	client->buf = client->bufs[0];
+	client->stopped = false;
+
+	/* The download thread owns the first buffer */
+	k_sem_init(&client->buf_free[0], 0, 1);
+	k_sem_init(&client->buf_free[1], 1, 1);
+
+	k_msgq_init(&client->frag_q, client->frag_q_buf,
+		    sizeof(struct download_client_frag_msg),
+		    CONFIG_DOWNLOAD_CLIENT_FRAGMENT_QUEUE_SIZE);
+
+	k_thread_create(&client->frag_thread, client->frag_thread_stack,
+			K_THREAD_STACK_SIZEOF(client->frag_thread_stack),
+			frag_thread, client, NULL, NULL,
+			K_LOWEST_APPLICATION_THREAD_PRIO, 0, K_NO_WAIT);
+#endif
+
 	/* The thread is spawned now, but it will suspend itself;
 	 * it is resumed when the download is started via the API.
 	 */
@@ -570,10 +629,33 @@ int download_client_init(struct download_client *const client,
 	return 0;
 }
 
+static const struct download_client_transport *transport_get(
+	const char **host)
+{
+	const struct download_client_transport *transport =
+		&download_client_transport_http;
+
+#if defined(CONFIG_DOWNLOAD_CLIENT_COAP)
+	if (strncmp(*host, download_client_transport_coap.scheme,
+		    strlen(download_client_transport_coap.scheme)) == 0) {
+		transport = &download_client_transport_coap;
+	}
+#endif
+
+	if (transport->scheme != NULL) {
+		/* Strip the scheme from the host name */
+		*host += strlen(transport->scheme);
+	}
+
+	return transport;
+}
+
 int download_client_connect(struct download_client *client, const char *host,
 			    const struct download_client_cfg *config)
 {
 	int err;
+	const char *hostname = host;
+	const struct download_client_transport *transport;
 
 	if (client == NULL || host == NULL || config == NULL) {
 		return -EINVAL;
@@ -598,14 +680,16 @@ int download_client_connect(struct download_client *client, const char *host,
 		return 0;
 	}
 
+	transport = transport_get(&hostname);
+
 	/* Attempt IPv6 connection if configured, fallback to IPv4 */
 	if (IS_ENABLED(CONFIG_DOWNLOAD_CLIENT_IPV6)) {
-		client->fd =
-			resolve_and_connect(AF_INET6, host, config);
+		client->fd = resolve_and_connect(AF_INET6, hostname, config,
+						 transport);
 	}
 	if (client->fd < 0) {
-		client->fd =
-			resolve_and_connect(AF_INET, host, config);
+		client->fd = resolve_and_connect(AF_INET, hostname, config,
+						 transport);
 	}
 
 	if (client->fd < 0) {
@@ -614,11 +698,13 @@ int download_client_connect(struct download_client *client, const char *host,
 
 	client->host = host;
 	client->config = *config;
+	client->transport = transport;
 
 	LOG_INF("Connected to %s", log_strdup(host));
 
 	/* Set socket timeout, if configured */
-	err = socket_timeout_set(client->fd);
+	err = download_client_socket_timeout_set(client->fd,
+						 transport->recv_timeout_ms);
 	if (err) {
 		return err;
 	}
@@ -658,13 +744,20 @@ int download_client_start(struct download_client *client, const char *file,
 	client->file_size = 0;
 	client->progress = from;
 
-	client->offset = 0;
-	client->has_header = false;
+	response_reset(client);
+
+#if defined(CONFIG_DOWNLOAD_CLIENT_DOUBLE_BUFFER)
+	client->stopped = false;
+#endif
 
 	LOG_INF("Downloading: %s [%u]", log_strdup(client->file),
 		client->progress);
 
-	err = get_request_send(client);
+	if (client->transport->start != NULL) {
+		client->transport->start(client);
+	}
+
+	err = client->transport->request(client, true);
 	if (err) {
 		return err;
 	}
@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2019 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <zephyr.h>
+#include <zephyr/types.h>
+#include <net/socket.h>
+#include <net/download_client.h>
+#include <logging/log.h>
+#include "download_client_transport.h"
+
+LOG_MODULE_DECLARE(download_client, CONFIG_DOWNLOAD_CLIENT_LOG_LEVEL);
+
+#define GET_TEMPLATE                                                           \
+	"GET /%s HTTP/1.1\r\n"                                                 \
+	"Host: %s\r\n"                                                         \
+	"Connection: keep-alive\r\n"                                           \
+	"Range: bytes=%u-%u\r\n"                                               \
+	"\r\n"
+
+#define GET_TEMPLATE_STREAM                                                    \
+	"GET /%s HTTP/1.1\r\n"                                                 \
+	"Host: %s\r\n"                                                         \
+	"Connection: keep-alive\r\n"                                           \
+	"Range: bytes=%u-\r\n"                                                 \
+	"\r\n"
+
+static int http_request(struct download_client *client, bool resend)
+{
+	int err;
+	int len;
+	size_t off;
+
+	ARG_UNUSED(resend);
+
+	__ASSERT_NO_MSG(client);
+	__ASSERT_NO_MSG(client->host);
+	__ASSERT_NO_MSG(client->file);
+
+	/* Offset of last byte in range (Content-Range) */
+	off = client->progress + client->fragment_size - 1;
+
+	if (client->file_size != 0) {
+		/* Don't request bytes past the end of file */
+		off = MIN(off, client->file_size);
+	}
+
+	if (IS_ENABLED(CONFIG_DOWNLOAD_CLIENT_STREAM)) {
+		/* Request the rest of the file at once */
+		len = snprintf(client->buf,
+			       CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE,
+			       GET_TEMPLATE_STREAM, client->file, client->host,
+			       client->progress);
+	} else {
+		len = snprintf(client->buf,
+			       CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE,
+			       GET_TEMPLATE, client->file, client->host,
+			       client->progress, off);
+	}
+
+	if (len < 0 || len > CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE) {
+		LOG_ERR("Cannot create GET request, buffer too small");
+		return -ENOMEM;
+	}
+
+	if (IS_ENABLED(CONFIG_DOWNLOAD_CLIENT_LOG_HEADERS)) {
+		LOG_HEXDUMP_DBG(client->buf, len, "HTTP request");
+	}
+
+	LOG_DBG("Sending HTTP request");
+	err = download_client_socket_send(client, len);
+	if (err) {
+		LOG_ERR("Failed to send HTTP request, errno %d", errno);
+		return err;
+	}
+
+	return 0;
+}
+
+static bool str_eq_nocase(const char *a, const char *b)
+{
+	while ((*a != '\0') && (tolower((int)*a) == tolower((int)*b))) {
+		a++;
+		b++;
+	}
+
+	return tolower((int)*a) == tolower((int)*b);
+}
+
+static int status_line_parse(struct download_client *client, const char *line)
+{
+	const char *p;
+
+	/* e.g. "HTTP/1.1 206 Partial Content" */
+	if (strncmp(line, "HTTP/", strlen("HTTP/")) != 0) {
+		LOG_ERR("Invalid HTTP status line");
+		return -1;
+	}
+
+	p = strchr(line, ' ');
+	if (!p) {
+		LOG_ERR("Invalid HTTP status line");
+		return -1;
+	}
+
+	client->http_status = strtoul(p + 1, NULL, 10);
+
+	LOG_DBG("HTTP status %d", client->http_status);
+
+	return 0;
+}
+
+static int content_range_parse(struct download_client *client, const char *p)
+{
+	char *end;
+	size_t start;
+
+	/* e.g. "bytes 4096-8191/123456" */
+	if (strncmp(p, "bytes ", strlen("bytes ")) != 0) {
+		LOG_ERR("Unsupported \"Content-Range\" unit");
+		return -1;
+	}
+
+	start = strtoul(p + strlen("bytes "), &end, 10);
+	if (start != client->progress) {
+		LOG_ERR("Server sent range from %u, expected %u",
+			start, client->progress);
+		return -1;
+	}
+
+	p = strchr(end, '/');
+	if (!p) {
+		/* Cannot continue */
+		LOG_ERR("Server did not send file size in response");
+		return -1;
+	}
+
+	/* If file size is not known, read it from the header */
+	if (client->file_size == 0) {
+		client->file_size = strtoul(p + 1, NULL, 10);
+		LOG_DBG("File size = %d", client->file_size);
+	}
+
+	return 0;
+}
+
+static int header_line_parse(struct download_client *client, char *line)
+{
+	char *value;
+
+	if (IS_ENABLED(CONFIG_DOWNLOAD_CLIENT_LOG_HEADERS)) {
+		LOG_DBG("%s", log_strdup(line));
+	}
+
+	if (client->http_status == 0) {
+		return status_line_parse(client, line);
+	}
+
+	value = strchr(line, ':');
+	if (!value) {
+		/* Not a header field, ignore */
+		return 0;
+	}
+
+	/* Split the line into name and value */
+	*value++ = '\0';
+	while ((*value == ' ') || (*value == '\t')) {
+		value++;
+	}
+
+	if (str_eq_nocase(line, "Content-Length")) {
+		client->response_remaining = strtoul(value, NULL, 10);
+		client->has_content_length = true;
+	} else if (str_eq_nocase(line, "Content-Range")) {
+		return content_range_parse(client, value);
+	} else if (str_eq_nocase(line, "Transfer-Encoding")) {
+		if (!str_eq_nocase(value, "identity")) {
+			LOG_ERR("Unsupported transfer encoding");
+			return -1;
+		}
+	} else if (str_eq_nocase(line, "Connection")) {
+		if (str_eq_nocase(value, "close")) {
+			LOG_WRN("Peer closed connection, "
+				"will attempt to re-connect");
+			client->connection_close = true;
+		}
+	}
+
+	return 0;
+}
+
+static int header_check(struct download_client *client)
+{
+	if ((client->http_status != 200) && (client->http_status != 206)) {
+		LOG_ERR("Unexpected HTTP response %d", client->http_status);
+		return -1;
+	}
+
+	if (!client->has_content_length) {
+		LOG_ERR("Server did not send \"Content-Length\" in response");
+		return -1;
+	}
+
+	if (client->http_status == 200) {
+		/* The server ignored the range and sends the whole file */
+		if (client->progress != 0) {
+			LOG_ERR("Server does not support range requests");
+			return -1;
+		}
+
+		if (client->file_size == 0) {
+			client->file_size = client->response_remaining;
+		}
+	}
+
+	if (client->file_size == 0) {
+		/* Cannot continue */
+		LOG_ERR("Server did not send \"Content-Range\" in response");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Parse the header lines received since the last call.
+ * Header lines are parsed in place and are not kept in the buffer,
+ * the body starts right after the header at offset 'body'.
+ *
+ * Returns:
+ *  1 while the header is being received
+ *  0 if the header has been fully received
+ * -1 on error
+ */
+static int header_parse(struct download_client *client)
+{
+	int rc;
+	char *eol;
+	char *line;
+	size_t len;
+
+	while (true) {
+		eol = memchr(client->buf + client->hdr_scan, '\n',
+			     client->offset - client->hdr_scan);
+		if (!eol) {
+			client->hdr_scan = client->offset;
+
+			if (client->offset ==
+			    CONFIG_DOWNLOAD_CLIENT_MAX_RESPONSE_SIZE) {
+				LOG_ERR("HTTP header does not fit in buffer");
+				return -1;
+			}
+
+			/* Awaiting full GET response */
+			LOG_DBG("Awaiting full header in response");
+			return 1;
+		}
+
+		line = client->buf + client->hdr_line;
+		len = eol - line;
+
+		/* Resume after this line on the next call */
+		client->hdr_line = eol + 1 - client->buf;
+		client->hdr_scan = client->hdr_line;
+
+		if ((len > 0) && (line[len - 1] == '\r')) {
+			len--;
+		}
+
+		line[len] = '\0';
+
+		if (len == 0) {
+			/* Empty line, end of the header */
+			break;
+		}
+
+		rc = header_line_parse(client, line);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	LOG_DBG("GET header size: %u", client->hdr_line);
+
+	rc = header_check(client);
+	if (rc) {
+		return rc;
+	}
+
+	client->body = client->hdr_line;
+
+	return 0;
+}
+
+static int http_parse(struct download_client *client, size_t len)
+{
+	int rc;
+
+	if (!client->has_header) {
+		rc = header_parse(client);
+		if (rc > 0) {
+			/* Wait for payload */
+			return -EAGAIN;
+		}
+		if (rc < 0) {
+			return -EBADMSG;
+		}
+
+		client->has_header = true;
+
+		/* Payload bytes received together with the header */
+		len = client->offset - client->body;
+	}
+
+	if (len > client->response_remaining) {
+		LOG_WRN("Discarding %u bytes past the response body",
+			len - client->response_remaining);
+		client->offset -= len - client->response_remaining;
+		len = client->response_remaining;
+	}
+
+	return len;
+}
+
+const struct download_client_transport download_client_transport_http = {
+	.type = SOCK_STREAM,
+	.proto = IPPROTO_TCP,
+	.proto_sec = IPPROTO_TLS_1_2,
+	.port = 80,
+	.port_sec = 443,
+	.recv_timeout_ms = CONFIG_DOWNLOAD_CLIENT_SOCK_TIMEOUT_MS,
+	.request = http_request,
+	.parse = http_parse,
+};
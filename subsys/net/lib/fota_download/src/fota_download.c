@@ -11,6 +11,16 @@
 #include <dfu/dfu_target.h>
 #include <pm_config.h>
 
+#ifdef CONFIG_FOTA_DOWNLOAD_HASH_VERIFY
+#include <string.h>
+#include <tinycrypt/constants.h>
+#include <tinycrypt/sha256.h>
+#endif
+
+#ifdef CONFIG_FOTA_DOWNLOAD_HASH_SAVE
+#include <settings/settings.h>
+#endif
+
 #ifdef PM_S1_ADDRESS
 /* MCUBoot support is required */
 #include <fw_info.h>
@@ -24,6 +34,309 @@ static fota_download_callback_t callback;
 static struct download_client   dlc;
 static struct k_delayed_work    dlc_with_offset_work;
 static int socket_retries_left;
+static bool first_fragment = true;
+static size_t file_size;
+/* Offset to restart the download from in dlc_with_offset_work */
+static size_t restart_offset;
+/* Size of the file according to the DFU target context, if the download
+ * was resumed from an offset with the first request.
+ */
+static size_t resume_file_size;
+static bool resumed;
+/* Image type of the DFU target initialized before connecting, or 0 */
+static int prepared_img_type;
+
+#ifdef CONFIG_FOTA_DOWNLOAD_HASH_VERIFY
+/* Hash of the data written so far, and the hash it must have when the
+ * download is complete.
+ */
+static struct tc_sha256_state_struct hash_state;
+static u8_t expected_hash[FOTA_DOWNLOAD_HASH_SIZE];
+static bool hash_verify;
+/* Number of bytes of the file in the hash */
+static size_t hash_len;
+/* The data before this offset of the file was written to the DFU target by
+ * an interrupted download. It is only added to the hash.
+ */
+static size_t hash_skip_until;
+
+/* Hash state after the given number of bytes of a file, to resume the hash
+ * of an interrupted download from.
+ */
+struct hash_snapshot {
+	u8_t expected_hash[FOTA_DOWNLOAD_HASH_SIZE];
+	size_t len;
+	struct tc_sha256_state_struct state;
+};
+
+/* Two snapshots, so that the older one can be used if the DFU target
+ * stored its offset before the newer one was taken.
+ */
+static struct hash_snapshot snapshots[2];
+
+#ifdef CONFIG_FOTA_DOWNLOAD_HASH_SAVE
+#define MODULE "fota_download"
+#define FILE_HASH "hash"
+
+/**
+ * @brief Function used by settings_load() to restore the hash snapshots.
+ *	  See the Zephyr documentation of the settings subsystem for more
+ *	  information.
+ */
+static int settings_set(const char *key, size_t len_rd,
+			settings_read_cb read_cb, void *cb_arg)
+{
+	for (int i = 0; i < ARRAY_SIZE(snapshots); i++) {
+		char name[sizeof(FILE_HASH) + 1] = FILE_HASH;
+
+		name[sizeof(FILE_HASH) - 1] = '0' + i;
+		if (strcmp(key, name) != 0) {
+			continue;
+		}
+
+		ssize_t len = read_cb(cb_arg, &snapshots[i],
+				      sizeof(snapshots[i]));
+
+		if (len != sizeof(snapshots[i])) {
+			LOG_ERR("Can't read hash state from storage");
+			snapshots[i].len = 0;
+			return len;
+		}
+	}
+
+	return 0;
+}
+
+static void snapshots_load(void)
+{
+	static bool loaded;
+	static struct settings_handler sh = {
+		.name = MODULE,
+		.h_set = settings_set,
+	};
+	int err;
+
+	if (loaded) {
+		return;
+	}
+
+	/* settings_subsys_init is idempotent so this is safe to do. */
+	err = settings_subsys_init();
+	if (err) {
+		LOG_ERR("settings_subsys_init failed (err %d)", err);
+		return;
+	}
+
+	err = settings_register(&sh);
+	if (err) {
+		LOG_ERR("Cannot register settings (err %d)", err);
+		return;
+	}
+
+	err = settings_load();
+	if (err) {
+		LOG_ERR("Cannot load settings (err %d)", err);
+		return;
+	}
+
+	loaded = true;
+}
+
+static void snapshot_store(int i)
+{
+	char key[] = MODULE "/" FILE_HASH "0";
+	int err;
+
+	key[sizeof(key) - 2] += i;
+	err = settings_save_one(key, &snapshots[i], sizeof(snapshots[i]));
+	if (err) {
+		/* An interrupted download is downloaded from an older
+		 * snapshot, or from the start.
+		 */
+		LOG_WRN("Unable to store hash state: %d", err);
+	}
+}
+#else
+static inline void snapshots_load(void) {}
+static inline void snapshot_store(int i) {}
+#endif /* CONFIG_FOTA_DOWNLOAD_HASH_SAVE */
+
+static bool snapshot_of_file(const struct hash_snapshot *snapshot)
+{
+	return (snapshot->len != 0) &&
+	       (memcmp(snapshot->expected_hash, expected_hash,
+		       sizeof(expected_hash)) == 0);
+}
+
+/**@brief Take a snapshot of the hash state, once
+ *	  CONFIG_FOTA_DOWNLOAD_HASH_SAVE_INTERVAL bytes have been added to the
+ *	  hash since the latest snapshot of the file. The latest snapshot is
+ *	  kept, and the other one is replaced.
+ */
+static void snapshot_take(void)
+{
+	int keep = -1;
+	int replace;
+	size_t last = 0;
+
+	for (int i = 0; i < ARRAY_SIZE(snapshots); i++) {
+		if (snapshot_of_file(&snapshots[i]) &&
+		    (snapshots[i].len <= hash_len) &&
+		    ((keep < 0) || (snapshots[i].len > last))) {
+			keep = i;
+			last = snapshots[i].len;
+		}
+	}
+
+	if (hash_len - last < CONFIG_FOTA_DOWNLOAD_HASH_SAVE_INTERVAL) {
+		return;
+	}
+
+	replace = (keep == 0) ? 1 : 0;
+	memcpy(snapshots[replace].expected_hash, expected_hash,
+	       sizeof(expected_hash));
+	snapshots[replace].len = hash_len;
+	snapshots[replace].state = hash_state;
+	snapshot_store(replace);
+}
+
+static void hash_start(const u8_t *hash)
+{
+	hash_verify = (hash != NULL);
+	hash_len = 0;
+	hash_skip_until = 0;
+	if (hash_verify) {
+		memcpy(expected_hash, hash, sizeof(expected_hash));
+		(void)tc_sha256_init(&hash_state);
+	}
+}
+
+/**@brief Start the hash again, when the file is downloaded from the start
+ *	  once more.
+ */
+static void hash_restart(void)
+{
+	hash_len = 0;
+	hash_skip_until = 0;
+	if (hash_verify) {
+		(void)tc_sha256_init(&hash_state);
+	}
+}
+
+/**@brief Check if the file must be verified. The data written before the
+ *	  offset of a resumed download is not part of the hash, so the hash
+ *	  must be resumed with hash_resume().
+ */
+static bool hash_required(void)
+{
+	return hash_verify;
+}
+
+/**@brief Continue the hash from the latest snapshot of the file at or
+ *	  before the given offset. The data from the snapshot to the offset is
+ *	  downloaded again, and only added to the hash.
+ *
+ * @param offset Offset of the file stored by the DFU target.
+ *
+ * @return Offset to download the file from, or 0 if there is no snapshot
+ *	   and the file must be downloaded from the start.
+ */
+static size_t hash_resume(size_t offset)
+{
+	const struct hash_snapshot *found = NULL;
+
+	snapshots_load();
+
+	for (int i = 0; i < ARRAY_SIZE(snapshots); i++) {
+		if (snapshot_of_file(&snapshots[i]) &&
+		    (snapshots[i].len <= offset) &&
+		    ((found == NULL) || (snapshots[i].len > found->len))) {
+			found = &snapshots[i];
+		}
+	}
+
+	if (found == NULL) {
+		hash_restart();
+		return 0;
+	}
+
+	hash_state = found->state;
+	hash_len = found->len;
+	hash_skip_until = offset;
+	LOG_INF("Hash resumed from offset: 0x%x", hash_len);
+
+	return hash_len;
+}
+
+static void hash_update(const void *buf, size_t len)
+{
+	if (hash_verify) {
+		(void)tc_sha256_update(&hash_state, buf, len);
+		hash_len += len;
+		snapshot_take();
+	}
+}
+
+/**@brief Add the data of a fragment that was written to the DFU target
+ *	  before the download was resumed to the hash.
+ *
+ * @return Number of bytes at the start of the fragment not to write.
+ */
+static size_t hash_skip(const void *buf, size_t len)
+{
+	size_t skip;
+
+	if (!hash_verify || (hash_len >= hash_skip_until)) {
+		return 0;
+	}
+
+	skip = MIN(len, hash_skip_until - hash_len);
+	hash_update(buf, skip);
+
+	return skip;
+}
+
+static int hash_check(void)
+{
+	u8_t hash[TC_SHA256_DIGEST_SIZE];
+
+	if (!hash_verify) {
+		return 0;
+	}
+
+	(void)tc_sha256_final(hash, &hash_state);
+	hash_verify = false;
+
+	if (memcmp(hash, expected_hash, sizeof(hash)) != 0) {
+		LOG_ERR("Hash of the downloaded file does not match");
+		return -EBADMSG;
+	}
+
+	LOG_INF("Hash of the downloaded file verified");
+
+	return 0;
+}
+#else
+static inline void hash_start(const u8_t *hash) {}
+static inline void hash_restart(void) {}
+static inline bool hash_required(void)
+{
+	return false;
+}
+static inline size_t hash_resume(size_t offset)
+{
+	return offset;
+}
+static inline void hash_update(const void *buf, size_t len) {}
+static inline size_t hash_skip(const void *buf, size_t len)
+{
+	return 0;
+}
+static inline int hash_check(void)
+{
+	return 0;
+}
+#endif /* CONFIG_FOTA_DOWNLOAD_HASH_VERIFY */
 
 static void send_evt(enum fota_download_evt_id id)
 {
@@ -57,10 +370,33 @@ static void dfu_target_callback_handler(enum dfu_target_evt_id evt)
 	}
 }
 
+/**@brief Check that the file being downloaded is the one whose download was
+ *	  resumed. If not, discard what was written and start from the start.
+ *
+ * @return 0 if the download can continue, or a negative error code if the
+ *	   fragment has to be refused.
+ */
+static int resumed_file_check(void)
+{
+	if (file_size == resume_file_size) {
+		return 0;
+	}
+
+	LOG_WRN("File size changed from %d to %d, restart download",
+		resume_file_size, file_size);
+
+	(void) dfu_target_done(false);
+	prepared_img_type = 0;
+	resumed = false;
+	first_fragment = true;
+	restart_offset = 0;
+	k_delayed_work_submit(&dlc_with_offset_work, K_SECONDS(1));
+
+	return -ECANCELED;
+}
+
 static int download_client_callback(const struct download_client_evt *event)
 {
-	static bool first_fragment = true;
-	static size_t file_size;
 	size_t offset;
 	int err;
 
@@ -70,6 +406,9 @@ static int download_client_callback(const struct download_client_evt *event)
 
 	switch (event->id) {
 	case DOWNLOAD_CLIENT_EVT_FRAGMENT: {
+		const u8_t *fragment = event->fragment.buf;
+		size_t skip;
+
 		if (first_fragment) {
 			err = download_client_file_size_get(&dlc, &file_size);
 			if (err != 0) {
@@ -79,8 +418,31 @@ static int download_client_callback(const struct download_client_evt *event)
 				return err;
 			}
 			first_fragment = false;
+
+			if (resumed) {
+				/* The DFU target was initialized from its
+				 * context, and this fragment is not the start
+				 * of the image.
+				 */
+				err = resumed_file_check();
+				if (err != 0) {
+					return err;
+				}
+				goto write;
+			}
+
 			int img_type = dfu_target_img_type(event->fragment.buf,
 							event->fragment.len);
+
+			if ((prepared_img_type != 0) &&
+			    (img_type != prepared_img_type)) {
+				/* Release the target prepared for a different
+				 * type of image.
+				 */
+				(void) dfu_target_done(false);
+			}
+			prepared_img_type = 0;
+
 			err = dfu_target_init(img_type, file_size,
 					      dfu_target_callback_handler);
 			if ((err < 0) && (err != -EBUSY)) {
@@ -95,10 +457,32 @@ static int download_client_callback(const struct download_client_evt *event)
 				send_evt(FOTA_DOWNLOAD_EVT_ERROR);
 			}
 
+			if ((offset != 0) && hash_required()) {
+				restart_offset = hash_resume(offset);
+				if (restart_offset == 0) {
+					/* Discard what was written, so that
+					 * the hash covers the whole file.
+					 */
+					LOG_INF("Refuse fragment, restart from "
+						"start");
+					(void) dfu_target_done(false);
+					first_fragment = true;
+				} else {
+					LOG_INF("Refuse fragment, restart with "
+						"hash offset");
+				}
+
+				k_delayed_work_submit(&dlc_with_offset_work,
+						K_SECONDS(1));
+
+				return -ECANCELED;
+			}
+
 			if (offset != 0) {
 				/* Abort current download procedure, and
 				 * schedule new download from offset.
 				 */
+				restart_offset = offset;
 				k_delayed_work_submit(&dlc_with_offset_work,
 						K_SECONDS(1));
 				LOG_INF("Refuse fragment, restart with offset");
@@ -107,8 +491,14 @@ static int download_client_callback(const struct download_client_evt *event)
 			}
 		}
 
-		err = dfu_target_write(event->fragment.buf,
-				       event->fragment.len);
+write:
+		skip = hash_skip(event->fragment.buf, event->fragment.len);
+		if (skip == event->fragment.len) {
+			break;
+		}
+
+		err = dfu_target_write(&fragment[skip],
+				       event->fragment.len - skip);
 		if (err != 0) {
 			LOG_ERR("dfu_target_write error %d", err);
 			(void) download_client_disconnect(&dlc);
@@ -116,6 +506,8 @@ static int download_client_callback(const struct download_client_evt *event)
 			return err;
 		}
 
+		hash_update(&fragment[skip], event->fragment.len - skip);
+
 		if (IS_ENABLED(CONFIG_FOTA_DOWNLOAD_PROGRESS_EVT) &&
 		    !first_fragment) {
 			err = dfu_target_offset_get(&offset);
@@ -131,6 +523,16 @@ static int download_client_callback(const struct download_client_evt *event)
 	}
 
 	case DOWNLOAD_CLIENT_EVT_DONE:
+		err = hash_check();
+		if (err != 0) {
+			/* Discard the image instead of tagging it */
+			(void) dfu_target_done(false);
+			(void) download_client_disconnect(&dlc);
+			first_fragment = true;
+			send_evt(FOTA_DOWNLOAD_EVT_ERROR);
+			return err;
+		}
+
 		err = dfu_target_done(true);
 		if (err != 0) {
 			LOG_ERR("dfu_target_done error: %d", err);
@@ -184,20 +586,73 @@ static int download_client_callback(const struct download_client_evt *event)
 
 static void download_with_offset(struct k_work *unused)
 {
-	int offset;
-	int err = dfu_target_offset_get(&offset);
+	int err;
 
-	err = download_client_start(&dlc, dlc.file, offset);
+	if (restart_offset == 0) {
+		hash_restart();
+	}
+
+	err = download_client_start(&dlc, dlc.file, restart_offset);
 
-	LOG_INF("Downloading from offset: 0x%x", offset);
+	LOG_INF("Downloading from offset: 0x%x", restart_offset);
 	if (err != 0) {
 		LOG_ERR("%s failed with error %d", __func__, err);
 	}
 }
 
-int fota_download_start(const char *host, const char *file)
+/**@brief Initialize the DFU target of an interrupted download from the DFU
+ *	  target context, and get the offset to resume the download from.
+ *
+ * @return Offset to resume from, or 0 to download the file from the start.
+ */
+static size_t resume_offset_get(void)
+{
+	int err;
+	int img_type;
+	size_t offset;
+
+	prepared_img_type = 0;
+
+	err = dfu_target_context_get(&img_type, &resume_file_size);
+	if (err != 0) {
+		return 0;
+	}
+
+	err = dfu_target_init(img_type, resume_file_size,
+			      dfu_target_callback_handler);
+	if ((err < 0) && (err != -EBUSY)) {
+		LOG_WRN("Unable to resume download, dfu_target_init error %d",
+			err);
+		return 0;
+	}
+
+	err = dfu_target_offset_get(&offset);
+	if ((err == 0) && (offset == 0) &&
+	    (img_type == DFU_TARGET_IMAGE_TYPE_MODEM_DELTA)) {
+		/* The modem target erases the previous firmware patch in the
+		 * background, let it continue while connecting.
+		 */
+		prepared_img_type = img_type;
+		return 0;
+	}
+
+	if ((err != 0) || (offset == 0)) {
+		/* Nothing to resume, the image type is identified from the
+		 * first fragment instead.
+		 */
+		(void) dfu_target_done(false);
+		return 0;
+	}
+
+	prepared_img_type = img_type;
+	return offset;
+}
+
+static int download_start(const char *host, const char *file,
+			  const u8_t *hash)
 {
 	int err = -1;
+	size_t offset;
 
 	struct download_client_cfg config = {
 		.sec_tag = -1, /* HTTP */
@@ -241,13 +696,37 @@ int fota_download_start(const char *host, const char *file)
 	}
 #endif /* PM_S1_ADDRESS */
 
+	/* Continue an interrupted download from its offset right away,
+	 * instead of refusing the first fragment and reconnecting. The DFU
+	 * target is initialized before connecting, so that any preparation
+	 * it does, like erasing, overlaps with the connection setup.
+	 */
+	first_fragment = true;
+	hash_start(hash);
+	offset = resume_offset_get();
+
+	if ((offset != 0) && hash_required()) {
+		offset = hash_resume(offset);
+		if (offset == 0) {
+			LOG_INF("No hash state, download the file from the "
+				"start");
+			(void) dfu_target_done(false);
+			prepared_img_type = 0;
+		}
+	}
+
+	resumed = (offset != 0);
+
 	err = download_client_connect(&dlc, host, &config);
 	if (err != 0) {
 		return err;
 	}
 
+	if (resumed) {
+		LOG_INF("Resuming download from offset: 0x%x", offset);
+	}
 
-	err = download_client_start(&dlc, file, 0);
+	err = download_client_start(&dlc, file, offset);
 	if (err != 0) {
 		download_client_disconnect(&dlc);
 		return err;
@@ -256,6 +735,25 @@ int fota_download_start(const char *host, const char *file)
 	return 0;
 }
 
+int fota_download_start(const char *host, const char *file)
+{
+	return download_start(host, file, NULL);
+}
+
+int fota_download_start_with_hash(const char *host, const char *file,
+				  const u8_t *hash)
+{
+	if (!IS_ENABLED(CONFIG_FOTA_DOWNLOAD_HASH_VERIFY)) {
+		return -ENOTSUP;
+	}
+
+	if (hash == NULL) {
+		return -EINVAL;
+	}
+
+	return download_start(host, file, hash);
+}
+
 int fota_download_init(fota_download_callback_t client_callback)
 {
 	if (client_callback == NULL) {
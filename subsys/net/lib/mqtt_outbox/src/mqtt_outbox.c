@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <errno.h>
+#include <string.h>
+#include <net/mqtt.h>
+#include <net/mqtt_outbox.h>
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(mqtt_outbox, CONFIG_MQTT_OUTBOX_LOG_LEVEL);
+
+static struct mqtt_outbox_entry *entry_find(struct mqtt_outbox *outbox,
+					    u16_t message_id)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(outbox->entries); i++) {
+		if (outbox->entries[i].message_id == message_id) {
+			return &outbox->entries[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Must be called with the outbox locked */
+static u16_t message_id_next(struct mqtt_outbox *outbox)
+{
+	/* The window is smaller than the ID space, so this terminates */
+	do {
+		outbox->last_id++;
+	} while ((outbox->last_id == 0) ||
+		 (entry_find(outbox, outbox->last_id) != NULL));
+
+	return outbox->last_id;
+}
+
+static int entry_publish(struct mqtt_outbox *outbox,
+			 const struct mqtt_outbox_entry *entry, bool dup)
+{
+	const struct mqtt_publish_param param = {
+		.message = entry->message,
+		.message_id = entry->message_id,
+		.dup_flag = dup,
+		.retain_flag = 0,
+	};
+
+	return mqtt_publish(outbox->client, &param);
+}
+
+/* The topic and the payload share one allocation, the payload first */
+static int entry_fill(struct mqtt_outbox_entry *entry,
+		      const struct mqtt_publish_message *message)
+{
+	size_t topic_len = message->topic.topic.size;
+	size_t payload_len = message->payload.len;
+	u8_t *buf;
+
+	buf = k_malloc(payload_len + topic_len);
+	if (buf == NULL) {
+		return -ENOMEM;
+	}
+
+	if (payload_len > 0) {
+		memcpy(buf, message->payload.data, payload_len);
+	}
+
+	memcpy(buf + payload_len, message->topic.topic.utf8, topic_len);
+
+	entry->message = *message;
+	entry->message.payload.data = buf;
+	entry->message.topic.topic.utf8 = buf + payload_len;
+
+	return 0;
+}
+
+int mqtt_outbox_init(struct mqtt_outbox *outbox, struct mqtt_client *client,
+		     mqtt_outbox_ack_cb_t ack_cb)
+{
+	if ((outbox == NULL) || (client == NULL)) {
+		return -EINVAL;
+	}
+
+	memset(outbox->entries, 0, sizeof(outbox->entries));
+	outbox->client = client;
+	outbox->ack_cb = ack_cb;
+	outbox->last_seq = 0;
+	outbox->last_id = 0;
+	k_mutex_init(&outbox->lock);
+
+	return 0;
+}
+
+int mqtt_outbox_publish(struct mqtt_outbox *outbox,
+			const struct mqtt_publish_message *message, u32_t tag)
+{
+	int err;
+	struct mqtt_outbox_entry *entry;
+
+	if ((outbox == NULL) || (message == NULL)) {
+		return -EINVAL;
+	}
+
+	if (message->topic.qos == MQTT_QOS_0_AT_MOST_ONCE) {
+		const struct mqtt_publish_param param = {
+			.message = *message,
+		};
+
+		return mqtt_publish(outbox->client, &param);
+	}
+
+	if (message->topic.qos != MQTT_QOS_1_AT_LEAST_ONCE) {
+		return -ENOTSUP;
+	}
+
+	k_mutex_lock(&outbox->lock, K_FOREVER);
+
+	entry = entry_find(outbox, 0);
+	if (entry == NULL) {
+		err = -EAGAIN;
+		goto exit;
+	}
+
+	err = entry_fill(entry, message);
+	if (err) {
+		LOG_ERR("Could not allocate message of %d bytes",
+			message->payload.len);
+		goto exit;
+	}
+
+	entry->tag = tag;
+	entry->seq = ++outbox->last_seq;
+	entry->message_id = message_id_next(outbox);
+
+	err = entry_publish(outbox, entry, false);
+	if (err) {
+		/* The publisher gets the error, so the message is not kept */
+		k_free(entry->message.payload.data);
+		entry->message_id = 0;
+		goto exit;
+	}
+
+	LOG_DBG("Published id %d, tag %d", entry->message_id, tag);
+
+	err = entry->message_id;
+
+exit:
+	k_mutex_unlock(&outbox->lock);
+
+	return err;
+}
+
+int mqtt_outbox_puback(struct mqtt_outbox *outbox,
+		       const struct mqtt_puback_param *ack)
+{
+	struct mqtt_outbox_entry *entry;
+	struct mqtt_outbox_entry acked;
+
+	if ((outbox == NULL) || (ack == NULL) || (ack->message_id == 0)) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&outbox->lock, K_FOREVER);
+
+	entry = entry_find(outbox, ack->message_id);
+	if (entry == NULL) {
+		k_mutex_unlock(&outbox->lock);
+		return -ENOENT;
+	}
+
+	acked = *entry;
+	entry->message_id = 0;
+
+	k_mutex_unlock(&outbox->lock);
+
+	LOG_DBG("Acknowledged id %d, tag %d", acked.message_id, acked.tag);
+
+	/* The handler may publish, so the outbox is not locked meanwhile */
+	if (outbox->ack_cb != NULL) {
+		outbox->ack_cb(outbox, &acked.message, acked.tag, 0);
+	}
+
+	k_free(acked.message.payload.data);
+
+	return 0;
+}
+
+int mqtt_outbox_resend(struct mqtt_outbox *outbox)
+{
+	int err = 0;
+	/* The messages are sent in the order they were published in, the
+	 * IDs do not tell that after they wrap around.
+	 */
+	u32_t sent_seq = 0;
+
+	if (outbox == NULL) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&outbox->lock, K_FOREVER);
+
+	for (;;) {
+		struct mqtt_outbox_entry *next = NULL;
+		int ret;
+
+		for (size_t i = 0; i < ARRAY_SIZE(outbox->entries); i++) {
+			struct mqtt_outbox_entry *entry = &outbox->entries[i];
+
+			if ((entry->message_id != 0) &&
+			    (entry->seq > sent_seq) &&
+			    ((next == NULL) || (entry->seq < next->seq))) {
+				next = entry;
+			}
+		}
+
+		if (next == NULL) {
+			break;
+		}
+
+		sent_seq = next->seq;
+
+		ret = entry_publish(outbox, next, true);
+		LOG_DBG("Resent id %d, error: %d", next->message_id, ret);
+		err = err ? err : ret;
+	}
+
+	k_mutex_unlock(&outbox->lock);
+
+	return err;
+}
+
+void mqtt_outbox_clear(struct mqtt_outbox *outbox)
+{
+	if (outbox == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(outbox->entries); i++) {
+		struct mqtt_outbox_entry dropped;
+
+		k_mutex_lock(&outbox->lock, K_FOREVER);
+		dropped = outbox->entries[i];
+		outbox->entries[i].message_id = 0;
+		k_mutex_unlock(&outbox->lock);
+
+		if (dropped.message_id == 0) {
+			continue;
+		}
+
+		if (outbox->ack_cb != NULL) {
+			outbox->ack_cb(outbox, &dropped.message, dropped.tag,
+				       -ECANCELED);
+		}
+
+		k_free(dropped.message.payload.data);
+	}
+}
+
+u16_t mqtt_outbox_message_id_get(struct mqtt_outbox *outbox)
+{
+	u16_t id;
+
+	k_mutex_lock(&outbox->lock, K_FOREVER);
+	id = message_id_next(outbox);
+	k_mutex_unlock(&outbox->lock);
+
+	return id;
+}
+
+size_t mqtt_outbox_count(struct mqtt_outbox *outbox)
+{
+	size_t count = 0;
+
+	k_mutex_lock(&outbox->lock, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(outbox->entries); i++) {
+		if (outbox->entries[i].message_id != 0) {
+			count++;
+		}
+	}
+
+	k_mutex_unlock(&outbox->lock);
+
+	return count;
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <errno.h>
+#include <string.h>
+#include <net/mqtt_topic_trie.h>
+
+/* Node indexes are stored plus one, so that 0 means no node */
+#define NODE_NONE 0
+
+struct match_ctx {
+	void **data;
+	size_t max;
+	size_t count;
+};
+
+static struct mqtt_topic_trie_node *node_get(
+	const struct mqtt_topic_trie *trie, u16_t index)
+{
+	return &trie->nodes[index - 1];
+}
+
+static size_t level_len_get(const char *topic, size_t len)
+{
+	const char *sep = memchr(topic, '/', len);
+
+	return (sep != NULL) ? (size_t)(sep - topic) : len;
+}
+
+static bool level_is(const struct mqtt_topic_trie_node *node,
+		     const char *level, size_t len)
+{
+	return (node->level_len == len) &&
+	       (memcmp(node->level, level, len) == 0);
+}
+
+/* A '+' or '#' must be the whole level, and '#' must be the last level */
+static bool level_valid(const char *level, size_t level_len, bool last)
+{
+	for (size_t i = 0; i < level_len; i++) {
+		if ((level[i] != '+') && (level[i] != '#')) {
+			continue;
+		}
+
+		if (level_len != 1) {
+			return false;
+		}
+
+		if ((level[i] == '#') && !last) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void match_add(struct match_ctx *ctx, void *data)
+{
+	if (data == NULL) {
+		return;
+	}
+
+	if (ctx->count < ctx->max) {
+		ctx->data[ctx->count] = data;
+	}
+
+	ctx->count++;
+}
+
+/* The '#' child of a node also matches the level of the node itself */
+static void hash_child_match(const struct mqtt_topic_trie *trie,
+			     const struct mqtt_topic_trie_node *node,
+			     struct match_ctx *ctx)
+{
+	for (u16_t i = node->child; i != NODE_NONE;
+	     i = node_get(trie, i)->sibling) {
+		if (level_is(node_get(trie, i), "#", 1)) {
+			match_add(ctx, node_get(trie, i)->data);
+			return;
+		}
+	}
+}
+
+static void level_match(const struct mqtt_topic_trie *trie, u16_t first,
+			const char *topic, size_t len, bool first_level,
+			struct match_ctx *ctx)
+{
+	size_t level_len = level_len_get(topic, len);
+	bool last = (level_len == len);
+	/* Wildcards at the first level do not match topics starting with
+	 * '$', such as the topics of the broker.
+	 */
+	bool wildcards = !(first_level && (len > 0) && (topic[0] == '$'));
+	const struct mqtt_topic_trie_node *next[2] = { NULL, NULL };
+	const struct mqtt_topic_trie_node *hash = NULL;
+
+	/* A level has at most one exact, one '+' and one '#' child, which
+	 * are matched in this order.
+	 */
+	for (u16_t i = first; i != NODE_NONE; i = node_get(trie, i)->sibling) {
+		const struct mqtt_topic_trie_node *node = node_get(trie, i);
+
+		if (level_is(node, topic, level_len)) {
+			next[0] = node;
+		} else if (wildcards && level_is(node, "+", 1)) {
+			next[1] = node;
+		} else if (wildcards && level_is(node, "#", 1)) {
+			hash = node;
+		}
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(next); i++) {
+		if (next[i] == NULL) {
+			continue;
+		}
+
+		if (last) {
+			match_add(ctx, next[i]->data);
+			hash_child_match(trie, next[i], ctx);
+		} else if (next[i]->child != NODE_NONE) {
+			level_match(trie, next[i]->child, topic + level_len + 1,
+				    len - level_len - 1, false, ctx);
+		}
+	}
+
+	if (hash != NULL) {
+		match_add(ctx, hash->data);
+	}
+}
+
+void mqtt_topic_trie_init(struct mqtt_topic_trie *trie,
+			  struct mqtt_topic_trie_node *nodes,
+			  size_t node_count)
+{
+	trie->nodes = nodes;
+	trie->node_count = MIN(node_count, UINT16_MAX);
+	trie->used = 0;
+}
+
+void mqtt_topic_trie_clear(struct mqtt_topic_trie *trie)
+{
+	trie->used = 0;
+}
+
+int mqtt_topic_trie_add(struct mqtt_topic_trie *trie, const char *filter,
+			size_t len, void *data)
+{
+	/* The children of the root are the nodes with index 1 and their
+	 * siblings.
+	 */
+	u16_t parent = NODE_NONE;
+	size_t offset = 0;
+
+	if ((trie == NULL) || (filter == NULL) || (len == 0) ||
+	    (data == NULL)) {
+		return -EINVAL;
+	}
+
+	for (;;) {
+		const char *level = filter + offset;
+		size_t level_len = level_len_get(level, len - offset);
+		bool last = (offset + level_len == len);
+		u16_t *link;
+		u16_t index;
+
+		if (!level_valid(level, level_len, last) ||
+		    (level_len > UINT16_MAX)) {
+			return -EINVAL;
+		}
+
+		if (parent == NODE_NONE) {
+			link = (trie->used > 0) ? &node_get(trie, 1)->sibling :
+						  NULL;
+			index = (trie->used > 0) ? 1 : NODE_NONE;
+		} else {
+			link = &node_get(trie, parent)->child;
+			index = *link;
+		}
+
+		/* Find the level among the children, or append it */
+		while ((index != NODE_NONE) &&
+		       !level_is(node_get(trie, index), level, level_len)) {
+			link = &node_get(trie, index)->sibling;
+			index = *link;
+		}
+
+		if (index == NODE_NONE) {
+			struct mqtt_topic_trie_node *node;
+
+			if (trie->used >= trie->node_count) {
+				return -ENOMEM;
+			}
+
+			index = ++trie->used;
+			node = node_get(trie, index);
+			node->level = level;
+			node->level_len = level_len;
+			node->data = NULL;
+			node->child = NODE_NONE;
+			node->sibling = NODE_NONE;
+
+			if (link != NULL) {
+				*link = index;
+			}
+		}
+
+		if (last) {
+			struct mqtt_topic_trie_node *node =
+				node_get(trie, index);
+
+			if (node->data != NULL) {
+				return -EALREADY;
+			}
+
+			node->data = data;
+
+			return 0;
+		}
+
+		parent = index;
+		offset += level_len + 1;
+	}
+}
+
+size_t mqtt_topic_trie_match(const struct mqtt_topic_trie *trie,
+			     const char *topic, size_t len, void **data,
+			     size_t max)
+{
+	struct match_ctx ctx = {
+		.data = data,
+		.max = (data != NULL) ? max : 0,
+		.count = 0,
+	};
+
+	if ((trie == NULL) || (topic == NULL) || (len == 0) ||
+	    (trie->used == 0)) {
+		return 0;
+	}
+
+	level_match(trie, 1, topic, len, true, &ctx);
+
+	return ctx.count;
+}
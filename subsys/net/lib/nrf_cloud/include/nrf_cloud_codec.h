@@ -23,10 +23,20 @@ int nrf_codec_init(void);
 int nrf_cloud_encode_sensor_data(const struct nrf_cloud_sensor_data *input,
 				 struct nrf_cloud_data *output);
 
-/**@brief Encode the sensor data to be sent to the device shadow. */
+/**@brief Encode the sensor data to be sent to the device shadow.
+ *
+ * The data of the sensor is a cJSON item, which is deleted.
+ */
 int nrf_cloud_encode_shadow_data(const struct nrf_cloud_sensor_data *sensor,
 				 struct nrf_cloud_data *output);
 
+/**@brief Encode the sensor data to be sent to the device shadow.
+ *
+ * The data of the sensor is JSON text. It is validated, and inserted as is.
+ */
+int nrf_cloud_encode_shadow_json(const struct nrf_cloud_sensor_data *sensor,
+				 struct nrf_cloud_data *output);
+
 /**@brief Encode the user association data based on the indicated type. */
 int nrf_cloud_decode_requested_state(const struct nrf_cloud_data *payload,
 				     enum nfsm_state *requested_state);
@@ -20,6 +20,7 @@ enum nct_evt_type {
 	NCT_EVT_CC_RX_DATA,
 	NCT_EVT_CC_TX_DATA_ACK,
 	NCT_EVT_DC_RX_DATA,
+	NCT_EVT_DC_RX_DATA_FRAGMENT,
 	NCT_EVT_DC_TX_DATA_ACK,
 	NCT_EVT_CC_DISCONNECTED,
 	NCT_EVT_DC_DISCONNECTED,
@@ -32,11 +33,16 @@ enum nct_cc_opcode {
 	NCT_CC_OPCODE_UPDATE_REQ,
 	NCT_CC_OPCODE_UPDATE_REJECT_RSP,
 	NCT_CC_OPCODE_UPDATE_ACCEPT_RSP,
+	/* The cloud rejected a shadow update. */
+	NCT_CC_OPCODE_UPDATE_FAILED_RSP,
 };
 
 struct nct_dc_data {
 	struct nrf_cloud_data data;
 	u32_t id;
+	/* Offset and length of the whole message, for fragments. */
+	size_t offset;
+	size_t total_len;
 };
 
 struct nct_cc_data {
@@ -117,6 +123,9 @@ void nct_process(void);
  */
 int nct_keepalive_time_left(void);
 
+/**@brief Time in milliseconds that the last connection took to establish. */
+u32_t nct_connect_time_get(void);
+
 /**@brief Input from the cloud module. */
 int nct_input(const struct nct_evt *evt);
 
@@ -91,6 +91,11 @@ int nrf_cloud_connect(const struct nrf_cloud_connect_param *param)
 	return nct_connect();
 }
 
+u32_t nrf_cloud_connect_time_get(void)
+{
+	return nct_connect_time_get();
+}
+
 int nrf_cloud_disconnect(void)
 {
 	if (NOT_VALID_STATE(STATE_DC_CONNECTED) &&
@@ -100,12 +105,12 @@ int nrf_cloud_disconnect(void)
 	return nct_disconnect();
 }
 
-int nrf_cloud_shadow_update(const struct nrf_cloud_sensor_data *param)
+static int shadow_update(const struct nrf_cloud_sensor_data *param,
+			 bool json)
 {
 	int err;
 	struct nct_cc_data sensor_data = {
 		.opcode = NCT_CC_OPCODE_UPDATE_REQ,
-		.id = param->tag
 	};
 
 	if (NOT_VALID_STATE(STATE_DC_CONNECTED)) {
@@ -116,7 +121,14 @@ int nrf_cloud_shadow_update(const struct nrf_cloud_sensor_data *param)
 		return -EINVAL;
 	}
 
-	err = nrf_cloud_encode_shadow_data(param, &sensor_data.data);
+	sensor_data.id = param->tag;
+
+	if (json) {
+		err = nrf_cloud_encode_shadow_json(param, &sensor_data.data);
+	} else {
+		err = nrf_cloud_encode_shadow_data(param, &sensor_data.data);
+	}
+
 	if (err) {
 		return err;
 	}
@@ -127,6 +139,16 @@ int nrf_cloud_shadow_update(const struct nrf_cloud_sensor_data *param)
 	return err;
 }
 
+int nrf_cloud_shadow_update(const struct nrf_cloud_sensor_data *param)
+{
+	return shadow_update(param, false);
+}
+
+int nrf_cloud_shadow_update_json(const struct nrf_cloud_sensor_data *param)
+{
+	return shadow_update(param, true);
+}
+
 int nrf_cloud_sensor_attach(const struct nrf_cloud_sa_param *param)
 {
 	if (NOT_VALID_STATE(STATE_DC_CONNECTED)) {
@@ -283,6 +305,27 @@ static void event_handler(const struct nrf_cloud_evt *nrf_cloud_evt)
 		evt.data.msg.buf = (char *)nrf_cloud_evt->data.ptr;
 		evt.data.msg.len = nrf_cloud_evt->data.len;
 
+		cloud_notify_event(nrf_cloud_backend, &evt, config->user_data);
+		break;
+	case NRF_CLOUD_EVT_RX_DATA_FRAGMENT:
+		LOG_DBG("NRF_CLOUD_EVT_RX_DATA_FRAGMENT");
+
+		evt.type = CLOUD_EVT_DATA_RECEIVED_FRAGMENT;
+		evt.data.fragment.buf = (char *)nrf_cloud_evt->data.ptr;
+		evt.data.fragment.len = nrf_cloud_evt->data.len;
+		evt.data.fragment.offset = nrf_cloud_evt->offset;
+		evt.data.fragment.total_len = nrf_cloud_evt->total_len;
+
+		cloud_notify_event(nrf_cloud_backend, &evt, config->user_data);
+		break;
+	case NRF_CLOUD_EVT_STATE_REJECTED:
+		LOG_DBG("NRF_CLOUD_EVT_STATE_REJECTED");
+
+		evt.type = CLOUD_EVT_STATE_REJECTED;
+		evt.data.msg.buf = (char *)nrf_cloud_evt->data.ptr;
+		evt.data.msg.len = nrf_cloud_evt->data.len;
+		evt.data.msg.endpoint.type = CLOUD_EP_TOPIC_STATE;
+
 		cloud_notify_event(nrf_cloud_backend, &evt, config->user_data);
 		break;
 	case NRF_CLOUD_EVT_FOTA_DONE:
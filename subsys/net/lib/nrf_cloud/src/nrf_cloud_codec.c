@@ -11,6 +11,8 @@
 #include <string.h>
 #include <zephyr.h>
 #include <logging/log.h>
+#include <json_writer.h>
+#include <json_tokenizer.h>
 #include "cJSON.h"
 #include "cJSON_os.h"
 
@@ -32,84 +34,107 @@ static const char *const sensor_type_str[] = {
 	[NRF_CLOUD_DEVICE_INFO] = "DEVICE",
 };
 
-/* --- A few wrappers for cJSON APIs --- */
+/* Writes a document with the JSON writer. */
+typedef void (*json_encode_t)(struct json_writer *w, const void *ctx);
 
-static int json_add_obj(cJSON *parent, const char *str, cJSON *item)
+/**@brief Encode a document into a buffer allocated to fit it.
+ *
+ * The document is written twice, first without a buffer to get its length.
+ * The buffer is freed with nrf_cloud_free.
+ */
+static int json_encode_alloc(json_encode_t encode, const void *ctx,
+			     struct nrf_cloud_data *output)
 {
-	cJSON_AddItemToObject(parent, str, item);
-
-	return 0;
-}
+	int len;
+	char *buffer;
+	struct json_writer w;
 
-static int json_add_str(cJSON *parent, const char *str, const char *item)
-{
-	cJSON *json_str;
+	json_writer_init(&w, NULL, 0);
+	encode(&w, ctx);
+	len = json_writer_finish(&w);
+	if (len < 0) {
+		return len;
+	}
 
-	json_str = cJSON_CreateString(item);
-	if (json_str == NULL) {
+	buffer = nrf_cloud_malloc(len + 1);
+	if (buffer == NULL) {
 		return -ENOMEM;
 	}
 
-	return json_add_obj(parent, str, json_str);
+	json_writer_init(&w, buffer, len + 1);
+	encode(&w, ctx);
+	len = json_writer_finish(&w);
+	if (len < 0) {
+		nrf_cloud_free(buffer);
+		return len;
+	}
+
+	output->ptr = buffer;
+	output->len = len;
+
+	return 0;
 }
 
-static int json_add_null(cJSON *parent, const char *str)
+/* Tokens of the document being decoded, only used by the nRF Cloud thread */
+static struct json_tok toks[CONFIG_NRF_CLOUD_JSON_TOKENS];
+
+static int json_tokenize_input(const struct nrf_cloud_data *input)
 {
-	cJSON *json_null;
+	int ret = json_tokenize(input->ptr, input->len, toks, ARRAY_SIZE(toks));
 
-	json_null = cJSON_CreateNull();
-	if (json_null == NULL) {
-		return -ENOMEM;
+	if (ret == -ENOMEM) {
+		LOG_ERR("Message has more than %d tokens, "
+			"increase NRF_CLOUD_JSON_TOKENS", ARRAY_SIZE(toks));
+	} else if (ret < 0) {
+		LOG_ERR("json_tokenize failed: %d", ret);
 	}
 
-	return json_add_obj(parent, str, json_null);
+	return ret;
 }
 
-static cJSON *json_object_decode(cJSON *obj, const char *str)
+static int json_decode_and_alloc(const char *json, int tok,
+				 struct nrf_cloud_data *data)
 {
-	return obj ? cJSON_GetObjectItem(obj, str) : NULL;
-}
+	int len;
 
-static int json_decode_and_alloc(cJSON *obj, struct nrf_cloud_data *data)
-{
-	if (obj == NULL || (obj->type != cJSON_String)) {
+	if ((tok < 0) || (toks[tok].type != JSON_TOK_STRING)) {
 		data->ptr = NULL;
 		return -ENOENT;
 	}
 
-	data->len = strlen(obj->valuestring);
-	data->ptr = nrf_cloud_malloc(data->len + 1);
+	/* The unescaped string is never longer than the token */
+	len = toks[tok].end - toks[tok].start;
+	data->ptr = nrf_cloud_malloc(len + 1);
 
 	if (data->ptr == NULL) {
 		return -ENOMEM;
 	}
 
-	strncpy((char *)data->ptr, obj->valuestring, data->len + 1);
+	len = json_tok_str_copy(json, &toks[tok], (char *)data->ptr, len + 1);
+	if (len < 0) {
+		nrf_cloud_free((void *)data->ptr);
+		data->ptr = NULL;
+		return len;
+	}
+
+	data->len = len;
 
 	return 0;
 }
 
-static bool compare(const char *s1, const char *s2)
+static int nrf_cloud_decode_desired_obj(const char *json)
 {
-	return !strncmp(s1, s2, strlen(s2));
-}
+	int desired_obj;
 
-static void nrf_cloud_decode_desired_obj(cJSON *const root_obj,
-					 cJSON **desired_obj)
-{
-	cJSON *state_obj;
-
-	if ((root_obj != NULL) && (desired_obj != NULL)) {
-		/* On initial pairing, a shadow delta event is sent */
-		/* which does not include the "desired" JSON key, */
-		/* "state" is used instead */
-		state_obj = json_object_decode(root_obj, "state");
-		if (state_obj == NULL) {
-			*desired_obj = json_object_decode(root_obj, "desired");
-		} else {
-			*desired_obj = state_obj;
-		}
+	/* On initial pairing, a shadow delta event is sent */
+	/* which does not include the "desired" JSON key, */
+	/* "state" is used instead */
+	desired_obj = json_tok_get(json, toks, 0, "state");
+	if (desired_obj < 0) {
+		desired_obj = json_tok_get(json, toks, 0, "desired");
 	}
+
+	return desired_obj;
 }
 
 int nrf_codec_init(void)
@@ -119,82 +144,118 @@ int nrf_codec_init(void)
 	return 0;
 }
 
+/* Reported value of a sensor in the shadow, as JSON text */
+struct shadow_data {
+	enum nrf_cloud_sensor type;
+	const char *json;
+	size_t len;
+};
+
+static void shadow_data_encode(struct json_writer *w, const void *ctx)
+{
+	const struct shadow_data *data = ctx;
+
+	json_writer_obj_start(w, NULL);
+	json_writer_obj_start(w, "state");
+	json_writer_obj_start(w, "reported");
+	json_writer_raw(w, sensor_type_str[data->type], data->json, data->len);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+}
+
 int nrf_cloud_encode_shadow_data(const struct nrf_cloud_sensor_data *sensor,
 				 struct nrf_cloud_data *output)
 {
-	int ret;
-	char *buffer;
+	int err;
+	char *json;
+	struct shadow_data data;
 
 	__ASSERT_NO_MSG(sensor != NULL);
 	__ASSERT_NO_MSG(sensor->data.ptr != NULL);
 	__ASSERT_NO_MSG(sensor->data.len != 0);
 	__ASSERT_NO_MSG(output != NULL);
 
-	cJSON *root_obj = cJSON_CreateObject();
-	cJSON *state_obj = cJSON_CreateObject();
-	cJSON *reported_obj = cJSON_CreateObject();
-
-	if (root_obj == NULL || state_obj == NULL || reported_obj == NULL) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(reported_obj);
+	/* The item is deleted here, as it was when it was added to the
+	 * cJSON tree of the message.
+	 */
+	json = cJSON_PrintUnformatted((cJSON *)sensor->data.ptr);
+	cJSON_Delete((cJSON *)sensor->data.ptr);
+	if (json == NULL) {
 		return -ENOMEM;
 	}
 
-	ret = json_add_obj(reported_obj, sensor_type_str[sensor->type],
-			   (cJSON *)sensor->data.ptr);
-	ret += json_add_obj(state_obj, "reported", reported_obj);
-	ret += json_add_obj(root_obj, "state", state_obj);
-
-	if (ret != 0) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(reported_obj);
-	}
+	data.type = sensor->type;
+	data.json = json;
+	data.len = strlen(json);
 
-	buffer = cJSON_PrintUnformatted(root_obj);
-	cJSON_Delete(root_obj);
+	err = json_encode_alloc(shadow_data_encode, &data, output);
+	cJSON_FreeString(json);
 
-	output->ptr = buffer;
-	output->len = strlen(buffer);
-
-	return 0;
+	return err;
 }
 
-int nrf_cloud_encode_sensor_data(const struct nrf_cloud_sensor_data *sensor,
+/* Tokens of the shadow data to validate. The application may send it from
+ * any thread, so it does not use the tokens of the nRF Cloud thread.
+ */
+static struct json_tok shadow_toks[CONFIG_NRF_CLOUD_SHADOW_JSON_TOKENS];
+static K_MUTEX_DEFINE(shadow_toks_lock);
+
+int nrf_cloud_encode_shadow_json(const struct nrf_cloud_sensor_data *sensor,
 				 struct nrf_cloud_data *output)
 {
 	int ret;
+	struct shadow_data data;
 
 	__ASSERT_NO_MSG(sensor != NULL);
-	__ASSERT_NO_MSG(sensor->data.ptr != NULL);
-	__ASSERT_NO_MSG(sensor->data.len != 0);
 	__ASSERT_NO_MSG(output != NULL);
 
-	cJSON *root_obj = cJSON_CreateObject();
-
-	if (root_obj == NULL) {
-		return -ENOMEM;
+	if ((sensor->data.ptr == NULL) || (sensor->data.len == 0)) {
+		return -EINVAL;
 	}
 
-	ret = json_add_str(root_obj, "appId", sensor_type_str[sensor->type]);
-	ret += json_add_str(root_obj, "data", sensor->data.ptr);
-	ret += json_add_str(root_obj, "messageType", "DATA");
+	data.type = sensor->type;
+	data.json = sensor->data.ptr;
+	data.len = strnlen(data.json, sensor->data.len);
 
-	if (ret != 0) {
-		cJSON_Delete(root_obj);
-		return -ENOMEM;
+	k_mutex_lock(&shadow_toks_lock, K_FOREVER);
+	ret = json_tokenize(data.json, data.len, shadow_toks,
+			    ARRAY_SIZE(shadow_toks));
+	k_mutex_unlock(&shadow_toks_lock);
+
+	if (ret == -ENOMEM) {
+		LOG_ERR("Shadow data has more than %d tokens, "
+			"increase NRF_CLOUD_SHADOW_JSON_TOKENS",
+			ARRAY_SIZE(shadow_toks));
+		return ret;
+	} else if (ret < 0) {
+		LOG_ERR("Shadow data is not valid JSON: %d", ret);
+		return -EINVAL;
 	}
 
-	char *buffer;
+	return json_encode_alloc(shadow_data_encode, &data, output);
+}
 
-	buffer = cJSON_PrintUnformatted(root_obj);
-	cJSON_Delete(root_obj);
+static void sensor_data_encode(struct json_writer *w, const void *ctx)
+{
+	const struct nrf_cloud_sensor_data *sensor = ctx;
 
-	output->ptr = buffer;
-	output->len = strlen(buffer);
+	json_writer_obj_start(w, NULL);
+	json_writer_str(w, "appId", sensor_type_str[sensor->type]);
+	json_writer_str(w, "data", sensor->data.ptr);
+	json_writer_str(w, "messageType", "DATA");
+	json_writer_obj_end(w);
+}
 
-	return 0;
+int nrf_cloud_encode_sensor_data(const struct nrf_cloud_sensor_data *sensor,
+				 struct nrf_cloud_data *output)
+{
+	__ASSERT_NO_MSG(sensor != NULL);
+	__ASSERT_NO_MSG(sensor->data.ptr != NULL);
+	__ASSERT_NO_MSG(sensor->data.len != 0);
+	__ASSERT_NO_MSG(output != NULL);
+
+	return json_encode_alloc(sensor_data_encode, sensor, output);
 }
 
 int nrf_cloud_decode_requested_state(const struct nrf_cloud_data *input,
@@ -205,55 +266,70 @@ int nrf_cloud_decode_requested_state(const struct nrf_cloud_data *input,
 	__ASSERT_NO_MSG(input->ptr != NULL);
 	__ASSERT_NO_MSG(input->len != 0);
 
-	cJSON *root_obj;
-	cJSON *desired_obj;
-	cJSON *pairing_obj;
-	cJSON *pairing_state_obj;
-	cJSON *topic_prefix_obj;
+	const char *json = input->ptr;
+	int desired_obj;
+	int pairing_state_obj;
 
-	root_obj = cJSON_Parse(input->ptr);
-	if (root_obj == NULL) {
-		LOG_ERR("cJSON_Parse failed: %s",
-			log_strdup((char *)input->ptr));
+	if (json_tokenize_input(input) < 0) {
 		return -ENOENT;
 	}
 
-	nrf_cloud_decode_desired_obj(root_obj, &desired_obj);
+	desired_obj = nrf_cloud_decode_desired_obj(json);
 
-	topic_prefix_obj =
-		json_object_decode(desired_obj, "nrfcloud_mqtt_topic_prefix");
-	if (topic_prefix_obj != NULL) {
+	if (json_tok_get(json, toks, desired_obj,
+			 "nrfcloud_mqtt_topic_prefix") >= 0) {
 		(*requested_state) = STATE_UA_PIN_COMPLETE;
-		cJSON_Delete(root_obj);
 		return 0;
 	}
 
-	pairing_obj = json_object_decode(desired_obj, "pairing");
-	pairing_state_obj = json_object_decode(pairing_obj, "state");
+	pairing_state_obj = json_tok_find(json, toks, desired_obj,
+					  "pairing.state");
 
-	if (!pairing_state_obj || pairing_state_obj->type != cJSON_String) {
-		if (cJSON_HasObjectItem(desired_obj, "config") == false) {
+	if ((pairing_state_obj < 0) ||
+	    (toks[pairing_state_obj].type != JSON_TOK_STRING)) {
+		if (json_tok_get(json, toks, desired_obj, "config") < 0) {
 			LOG_DBG("No valid state found!");
 		}
-		cJSON_Delete(root_obj);
 		return -ENOENT;
 	}
 
-	const char *state_str = pairing_state_obj->valuestring;
-
-	if (compare(state_str, DUA_PIN_STR)) {
+	if (json_tok_str_eq(json, &toks[pairing_state_obj], DUA_PIN_STR)) {
 		(*requested_state) = STATE_UA_PIN_WAIT;
 	} else {
 		LOG_ERR("Deprecated state. Delete device from nrfCloud and update device with JITP certificates.");
-		cJSON_Delete(root_obj);
 		return -ENOTSUP;
 	}
 
-	cJSON_Delete(root_obj);
-
 	return 0;
 }
 
+struct config_response_ctx {
+	const char *json;
+	const struct json_tok *config;
+};
+
+static void config_response_encode(struct json_writer *w, const void *ctx)
+{
+	const struct config_response_ctx *resp = ctx;
+
+	json_writer_obj_start(w, NULL);
+	json_writer_obj_start(w, "state");
+
+	/* Add delta config to reported */
+	json_writer_obj_start(w, "reported");
+	json_writer_raw(w, "config", &resp->json[resp->config->start],
+			resp->config->end - resp->config->start);
+	json_writer_obj_end(w);
+
+	/* Add a null config to desired */
+	json_writer_obj_start(w, "desired");
+	json_writer_null(w, "config");
+	json_writer_obj_end(w);
+
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+}
+
 int nrf_cloud_encode_config_response(struct nrf_cloud_data const *const input,
 				     struct nrf_cloud_data *const output,
 				     bool *const has_config)
@@ -261,185 +337,112 @@ int nrf_cloud_encode_config_response(struct nrf_cloud_data const *const input,
 	__ASSERT_NO_MSG(output != NULL);
 	__ASSERT_NO_MSG(input != NULL);
 
-	char *buffer = NULL;
-	cJSON *root_obj = NULL;
-	cJSON *desired_obj = NULL;
-	cJSON *null_obj = NULL;
-	cJSON *reported_obj = NULL;
-	cJSON *state_obj = NULL;
-	cJSON *config_obj = NULL;
-	cJSON *input_obj = input ? cJSON_Parse(input->ptr) : NULL;
+	struct config_response_ctx ctx = {
+		.json = input->ptr,
+	};
+	int state_obj;
+	int config_obj;
 
-	if (input_obj == NULL) {
+	if ((input->ptr == NULL) || (json_tokenize_input(input) < 0)) {
 		return -ESRCH; /* invalid input or no JSON parsed */
 	}
 
 	/* A delta update will have the config inside of state */
-	state_obj = cJSON_DetachItemFromObject(input_obj, "state");
-	config_obj = cJSON_DetachItemFromObject(
-		state_obj ? state_obj : input_obj, "config");
-	cJSON_Delete(input_obj);
+	state_obj = json_tok_get(ctx.json, toks, 0, "state");
+	config_obj = json_tok_get(ctx.json, toks,
+				  (state_obj >= 0) ? state_obj : 0, "config");
 
 	if (has_config) {
-		*has_config = (config_obj != NULL);
+		*has_config = (config_obj >= 0);
 	}
 
 	/* If this is not a delta update, no response data is required */
-	if ((state_obj == NULL) || (config_obj == NULL)) {
-		cJSON_Delete(state_obj);
-		cJSON_Delete(config_obj);
-
+	if ((state_obj < 0) || (config_obj < 0)) {
 		output->ptr = NULL;
 		output->len = 0;
 		return 0;
 	}
 
-	/* Prepare JSON response for the delta */
-	root_obj = cJSON_CreateObject();
-	desired_obj = cJSON_CreateObject();
-	null_obj = cJSON_CreateNull();
-	reported_obj = cJSON_CreateObject();
-
-	if ((root_obj == NULL) || (desired_obj == NULL) || (null_obj == NULL) ||
-		(reported_obj == NULL)) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(desired_obj);
-		cJSON_Delete(null_obj);
-		cJSON_Delete(reported_obj);
-		cJSON_Delete(config_obj);
-		cJSON_Delete(state_obj);
-		return -ENOMEM;
-	}
+	/* The config is copied into the response as it was received */
+	ctx.config = &toks[config_obj];
 
-	/* Add delta config to reported */
-	(void)json_add_obj(reported_obj, "config", config_obj);
-	(void)json_add_obj(root_obj, "reported", reported_obj);
+	return json_encode_alloc(config_response_encode, &ctx, output);
+}
 
-	/* Add a null config to desired */
-	(void)json_add_obj(desired_obj, "config", null_obj);
-	(void)json_add_obj(root_obj, "desired", desired_obj);
+struct state_encode_ctx {
+	u32_t state;
+	struct nrf_cloud_data tx_endp;
+	struct nrf_cloud_data rx_endp;
+	struct nrf_cloud_data m_endp;
+};
 
-	/* Cleanup received state obj and re-use for the response */
-	cJSON_Delete(state_obj);
-	state_obj = cJSON_CreateObject();
-	(void)json_add_obj(state_obj, "state", root_obj);
-	buffer = cJSON_PrintUnformatted(state_obj);
-	cJSON_Delete(state_obj);
+static void state_encode(struct json_writer *w, const void *ctx)
+{
+	const struct state_encode_ctx *state = ctx;
 
-	if (buffer == NULL) {
-		return -ENOMEM;
-	}
+	json_writer_obj_start(w, NULL);
+	json_writer_obj_start(w, "state");
+	json_writer_obj_start(w, "reported");
 
-	output->ptr = buffer;
-	output->len = strlen(buffer);
+	if (state->state == STATE_UA_PIN_WAIT) {
+		json_writer_null(w, "stage");
+		json_writer_null(w, "nrfcloud_mqtt_topic_prefix");
 
-	return 0;
+		json_writer_obj_start(w, "pairing");
+		json_writer_str(w, "state", DUA_PIN_STR);
+		json_writer_null(w, "topics");
+		json_writer_null(w, "config");
+		json_writer_obj_end(w);
+	} else {
+		json_writer_strn(w, "nrfcloud_mqtt_topic_prefix",
+				 state->m_endp.ptr, state->m_endp.len);
+
+		/* Clear pairing config and pairingStatus fields. */
+		json_writer_null(w, "pairingStatus");
+
+		json_writer_obj_start(w, "pairing");
+		json_writer_str(w, "state", PAIRED_STR);
+		json_writer_null(w, "config");
+
+		/* Report pairing topics. */
+		json_writer_obj_start(w, "topics");
+		json_writer_strn(w, "d2c", state->tx_endp.ptr,
+				 state->tx_endp.len);
+		json_writer_strn(w, "c2d", state->rx_endp.ptr,
+				 state->rx_endp.len);
+		json_writer_obj_end(w);
+		json_writer_obj_end(w);
+	}
+
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
 }
 
 int nrf_cloud_encode_state(u32_t reported_state, struct nrf_cloud_data *output)
 {
-	int ret;
+	struct state_encode_ctx ctx = {
+		.state = reported_state,
+	};
 
 	__ASSERT_NO_MSG(output != NULL);
 
-	cJSON *root_obj = cJSON_CreateObject();
-	cJSON *state_obj = cJSON_CreateObject();
-	cJSON *reported_obj = cJSON_CreateObject();
-	cJSON *pairing_obj = cJSON_CreateObject();
-
-	if ((root_obj == NULL) || (state_obj == NULL) ||
-	    (reported_obj == NULL) || (pairing_obj == NULL)) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(reported_obj);
-		cJSON_Delete(pairing_obj);
-
-		return -ENOMEM;
-	}
-
-	ret = 0;
-
 	switch (reported_state) {
-	case STATE_UA_PIN_WAIT: {
-		ret += json_add_str(pairing_obj, "state", DUA_PIN_STR);
-		ret += json_add_null(pairing_obj, "topics");
-		ret += json_add_null(pairing_obj, "config");
-		ret += json_add_null(reported_obj, "stage");
-		ret += json_add_null(reported_obj,
-				     "nrfcloud_mqtt_topic_prefix");
+	case STATE_UA_PIN_WAIT:
 		break;
-	}
-	case STATE_UA_PIN_COMPLETE: {
-		struct nrf_cloud_data rx_endp;
-		struct nrf_cloud_data tx_endp;
-		struct nrf_cloud_data m_endp;
-
+	case STATE_UA_PIN_COMPLETE:
 		/* Get the endpoint information. */
-		nct_dc_endpoint_get(&tx_endp, &rx_endp, &m_endp);
-		ret += json_add_str(reported_obj, "nrfcloud_mqtt_topic_prefix",
-				    m_endp.ptr);
-
-		/* Clear pairing config and pairingStatus fields. */
-		ret += json_add_str(pairing_obj, "state", PAIRED_STR);
-		ret += json_add_null(pairing_obj, "config");
-		ret += json_add_null(reported_obj, "pairingStatus");
-
-		/* Report pairing topics. */
-		cJSON *topics_obj = cJSON_CreateObject();
-
-		if (topics_obj == NULL) {
-			cJSON_Delete(root_obj);
-			cJSON_Delete(state_obj);
-			cJSON_Delete(reported_obj);
-			cJSON_Delete(pairing_obj);
-
-			return -ENOMEM;
-		}
-
-		ret += json_add_str(topics_obj, "d2c", tx_endp.ptr);
-		ret += json_add_str(topics_obj, "c2d", rx_endp.ptr);
-		ret += json_add_obj(pairing_obj, "topics", topics_obj);
-
-		if (ret != 0) {
-			cJSON_Delete(topics_obj);
+		nct_dc_endpoint_get(&ctx.tx_endp, &ctx.rx_endp, &ctx.m_endp);
+		if ((ctx.tx_endp.ptr == NULL) || (ctx.rx_endp.ptr == NULL) ||
+		    (ctx.m_endp.ptr == NULL)) {
+			return -EINVAL;
 		}
 		break;
-	}
-	default: {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(reported_obj);
-		cJSON_Delete(pairing_obj);
+	default:
 		return -ENOTSUP;
 	}
-	}
-
-	ret += json_add_obj(reported_obj, "pairing", pairing_obj);
-	ret += json_add_obj(state_obj, "reported", reported_obj);
-	ret += json_add_obj(root_obj, "state", state_obj);
-
-	if (ret != 0) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(reported_obj);
-		cJSON_Delete(pairing_obj);
-
-		return -ENOMEM;
-	}
-
-	char *buffer;
-
-	buffer = cJSON_PrintUnformatted(root_obj);
-	cJSON_Delete(root_obj);
-
-	if (buffer == NULL) {
-		return -ENOMEM;
-	}
 
-	output->ptr = buffer;
-	output->len = strlen(buffer);
-
-	return 0;
+	return json_encode_alloc(state_encode, &ctx, output);
 }
 
 /**
@@ -461,64 +464,48 @@ int nrf_cloud_decode_data_endpoint(const struct nrf_cloud_data *input,
 	__ASSERT_NO_MSG(rx_endpoint != NULL);
 
 	int err;
-	cJSON *root_obj;
-	cJSON *m_endpoint_obj = NULL;
-	cJSON *desired_obj = NULL;
-
-	root_obj = cJSON_Parse(input->ptr);
-	if (root_obj == NULL) {
-		return -ENOENT;
-	}
-
-	nrf_cloud_decode_desired_obj(root_obj, &desired_obj);
-
-	if (m_endpoint != NULL) {
-		m_endpoint_obj = json_object_decode(
-			desired_obj, "nrfcloud_mqtt_topic_prefix");
-	}
-
-	cJSON *pairing_obj = json_object_decode(desired_obj, "pairing");
-	cJSON *pairing_state_obj = json_object_decode(pairing_obj, "state");
-	cJSON *topic_obj = json_object_decode(pairing_obj, "topics");
+	const char *json = input->ptr;
+	int desired_obj;
+	int pairing_state_obj;
+	int topic_obj;
 
-	if ((pairing_state_obj == NULL) || (topic_obj == NULL) ||
-	    (pairing_state_obj->type != cJSON_String)) {
-		cJSON_Delete(root_obj);
+	if (json_tokenize_input(input) < 0) {
 		return -ENOENT;
 	}
 
-	const char *state_str = pairing_state_obj->valuestring;
+	desired_obj = nrf_cloud_decode_desired_obj(json);
+	pairing_state_obj = json_tok_find(json, toks, desired_obj,
+					  "pairing.state");
+	topic_obj = json_tok_find(json, toks, desired_obj, "pairing.topics");
 
-	if (!compare(state_str, PAIRED_STR)) {
-		cJSON_Delete(root_obj);
+	if ((pairing_state_obj < 0) || (topic_obj < 0) ||
+	    !json_tok_str_eq(json, &toks[pairing_state_obj], PAIRED_STR)) {
 		return -ENOENT;
 	}
 
-	if (m_endpoint_obj != NULL) {
-		err = json_decode_and_alloc(m_endpoint_obj, m_endpoint);
-		if (err) {
-			cJSON_Delete(root_obj);
-			return err;
+	if (m_endpoint != NULL) {
+		int m_endpoint_obj = json_tok_get(json, toks, desired_obj,
+						  "nrfcloud_mqtt_topic_prefix");
+
+		if (m_endpoint_obj >= 0) {
+			err = json_decode_and_alloc(json, m_endpoint_obj,
+						    m_endpoint);
+			if (err) {
+				return err;
+			}
 		}
 	}
 
-	cJSON *tx_obj = json_object_decode(topic_obj, "d2c");
-
-	err = json_decode_and_alloc(tx_obj, tx_endpoint);
-	if (err) {
-		cJSON_Delete(root_obj);
-		return err;
-	}
-
-	cJSON *rx_obj = json_object_decode(topic_obj, "c2d");
-
-	err = json_decode_and_alloc(rx_obj, rx_endpoint);
+	err = json_decode_and_alloc(json,
+				    json_tok_get(json, toks, topic_obj, "d2c"),
+				    tx_endpoint);
 	if (err) {
-		cJSON_Delete(root_obj);
 		return err;
 	}
 
-	cJSON_Delete(root_obj);
+	err = json_decode_and_alloc(json,
+				    json_tok_get(json, toks, topic_obj, "c2d"),
+				    rx_endpoint);
 
 	return err;
 }
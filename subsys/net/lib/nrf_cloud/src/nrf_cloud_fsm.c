@@ -39,6 +39,7 @@ static int cc_tx_ack_in_state_requested_handler(const struct nct_evt *nct_evt);
 static int cc_disconnection_handler(const struct nct_evt *nct_evt);
 static int dc_connection_handler(const struct nct_evt *nct_evt);
 static int dc_rx_data_handler(const struct nct_evt *nct_evt);
+static int dc_rx_fragment_handler(const struct nct_evt *nct_evt);
 static int dc_tx_ack_handler(const struct nct_evt *nct_evt);
 static int dc_disconnection_handler(const struct nct_evt *nct_evt);
 static int cc_rx_data_handler(const struct nct_evt *nct_evt);
@@ -94,6 +95,7 @@ static const fsm_transition dc_connected_fsm_transition[NCT_EVT_TOTAL] = {
 	[NCT_EVT_CC_RX_DATA] = cc_rx_data_handler,
 	[NCT_EVT_CC_TX_DATA_ACK] = cc_tx_ack_handler,
 	[NCT_EVT_DC_RX_DATA] = dc_rx_data_handler,
+	[NCT_EVT_DC_RX_DATA_FRAGMENT] = dc_rx_fragment_handler,
 	[NCT_EVT_DC_TX_DATA_ACK] = dc_tx_ack_handler,
 	[NCT_EVT_CC_DISCONNECTED] = cc_disconnection_handler,
 	[NCT_EVT_DC_DISCONNECTED] = dc_disconnection_handler,
@@ -370,6 +372,20 @@ static int cc_rx_data_handler(const struct nct_evt *nct_evt)
 	bool config_found = false;
 	const enum nfsm_state current_state = nfsm_get_current_state();
 
+	if (nct_evt->param.cc->opcode == NCT_CC_OPCODE_UPDATE_FAILED_RSP) {
+		/* The error document is passed on as it is, the application
+		 * knows which update it sent.
+		 */
+		struct nrf_cloud_evt cloud_evt = {
+			.type = NRF_CLOUD_EVT_STATE_REJECTED,
+			.data = *payload,
+		};
+
+		LOG_WRN("Shadow update rejected");
+		nfsm_set_current_state_and_notify(current_state, &cloud_evt);
+		return 0;
+	}
+
 	handle_device_config_update(nct_evt, &config_found);
 
 	err = nrf_cloud_decode_requested_state(payload, &new_state);
@@ -471,9 +487,30 @@ static int dc_rx_data_handler(const struct nct_evt *nct_evt)
 	return 0;
 }
 
+static int dc_rx_fragment_handler(const struct nct_evt *nct_evt)
+{
+	struct nrf_cloud_evt cloud_evt = {
+		.type = NRF_CLOUD_EVT_RX_DATA_FRAGMENT,
+		.data = nct_evt->param.dc->data,
+		.offset = nct_evt->param.dc->offset,
+		.total_len = nct_evt->param.dc->total_len,
+	};
+
+	nfsm_set_current_state_and_notify(nfsm_get_current_state(), &cloud_evt);
+
+	return 0;
+}
+
 static int dc_tx_ack_handler(const struct nct_evt *nct_evt)
 {
-	return 0; /* Nothing to do */
+	const struct nrf_cloud_evt evt = {
+		.type = NRF_CLOUD_EVT_SENSOR_DATA_ACK,
+		.status = nct_evt->param.data_id
+	};
+
+	nfsm_set_current_state_and_notify(nfsm_get_current_state(), &evt);
+
+	return 0;
 }
 
 static int dc_disconnection_handler(const struct nct_evt *nct_evt)
@@ -10,6 +10,7 @@
 #include <zephyr.h>
 #include <stdio.h>
 #include <net/mqtt.h>
+#include <net/mqtt_outbox.h>
 #include <net/socket.h>
 #include <net/cloud.h>
 #include <logging/log.h>
@@ -72,6 +73,9 @@ LOG_MODULE_REGISTER(nrf_cloud_transport, CONFIG_NRF_CLOUD_LOG_LEVEL);
 #define NCT_UPDATE_DELTA_TOPIC AWS "%s/shadow/update/delta"
 #define NCT_UPDATE_DELTA_TOPIC_LEN (AWS_LEN + NRF_CLOUD_CLIENT_ID_LEN + 20)
 
+#define NCT_UPDATE_REJECTED_TOPIC AWS "%s/shadow/update/rejected"
+#define NCT_UPDATE_REJECTED_TOPIC_LEN (AWS_LEN + NRF_CLOUD_CLIENT_ID_LEN + 23)
+
 #define NCT_UPDATE_TOPIC AWS "%s/shadow/update"
 #define NCT_UPDATE_TOPIC_LEN (AWS_LEN + NRF_CLOUD_CLIENT_ID_LEN + 14)
 
@@ -85,12 +89,10 @@ static char shadow_base_topic[NCT_SHADOW_BASE_TOPIC_LEN + 1];
 static char accepted_topic[NCT_ACCEPTED_TOPIC_LEN + 1];
 static char rejected_topic[NCT_REJECTED_TOPIC_LEN + 1];
 static char update_delta_topic[NCT_UPDATE_DELTA_TOPIC_LEN + 1];
+static char update_rejected_topic[NCT_UPDATE_REJECTED_TOPIC_LEN + 1];
 static char update_topic[NCT_UPDATE_TOPIC_LEN + 1];
 static char shadow_get_topic[NCT_SHADOW_GET_LEN + 1];
 
-#define NCT_CC_SUBSCRIBE_ID 1234
-#define NCT_DC_SUBSCRIBE_ID 8765
-
 #define NCT_RX_LIST 0
 #define NCT_TX_LIST 1
 
@@ -106,7 +108,18 @@ static struct nct {
 	struct mqtt_utf8 dc_tx_endp;
 	struct mqtt_utf8 dc_rx_endp;
 	struct mqtt_utf8 dc_m_endp;
-	u32_t message_id;
+	struct mqtt_outbox outbox;
+	/* Message IDs of the last (un)subscribe requests of the control and
+	 * data channels, taken from the outbox so that they are not used by
+	 * a message in flight.
+	 */
+	u16_t cc_subscribe_id;
+	u16_t dc_subscribe_id;
+	/* Uptime when the last connection was started, and the time it took
+	 * until the broker acknowledged it.
+	 */
+	s64_t connect_start;
+	u32_t connect_time;
 	u8_t rx_buf[CONFIG_NRF_CLOUD_MQTT_MESSAGE_BUFFER_LEN];
 	u8_t tx_buf[CONFIG_NRF_CLOUD_MQTT_MESSAGE_BUFFER_LEN];
 	u8_t payload_buf[CONFIG_NRF_CLOUD_MQTT_PAYLOAD_BUFFER_LEN];
@@ -133,6 +146,13 @@ static const struct mqtt_topic nct_cc_rx_list[] = {
 			.size = NCT_UPDATE_DELTA_TOPIC_LEN
 		},
 		.qos = MQTT_QOS_1_AT_LEAST_ONCE
+	},
+	{
+		.topic = {
+			.utf8 = update_rejected_topic,
+			.size = NCT_UPDATE_REJECTED_TOPIC_LEN
+		},
+		.qos = MQTT_QOS_1_AT_LEAST_ONCE
 	}
 };
 
@@ -156,7 +176,8 @@ static const struct mqtt_topic nct_cc_tx_list[] = {
 static u32_t const nct_cc_rx_opcode_map[] = {
 	NCT_CC_OPCODE_UPDATE_REQ,
 	NCT_CC_OPCODE_UPDATE_REJECT_RSP,
-	NCT_CC_OPCODE_UPDATE_ACCEPT_RSP
+	NCT_CC_OPCODE_UPDATE_ACCEPT_RSP,
+	NCT_CC_OPCODE_UPDATE_FAILED_RSP
 };
 
 /* Internal routine to reset data endpoint information. */
@@ -172,18 +193,6 @@ static void dc_endpoint_reset(void)
 	nct.dc_m_endp.size = 0;
 }
 
-/* Get the next unused message id. */
-static u32_t dc_get_next_message_id(void)
-{
-	nct.message_id++;
-
-	if ((u16_t)nct.message_id == 0) {
-		nct.message_id++;
-	}
-
-	return nct.message_id;
-}
-
 /* Free memory allocated for the data endpoint and reset the endpoint. */
 static void dc_endpoint_free(void)
 {
@@ -201,6 +210,8 @@ static void dc_endpoint_free(void)
 
 static u32_t dc_send(const struct nct_dc_data *dc_data, u8_t qos)
 {
+	int err;
+
 	if (dc_data == NULL) {
 		return -EINVAL;
 	}
@@ -217,13 +228,10 @@ static u32_t dc_send(const struct nct_dc_data *dc_data, u8_t qos)
 		publish.message.payload.len = dc_data->data.len;
 	}
 
-	if (dc_data->id != 0) {
-		publish.message_id = dc_data->id;
-	} else {
-		publish.message_id = dc_get_next_message_id();
-	}
+	/* The data ID is reported back when the message is acknowledged */
+	err = mqtt_outbox_publish(&nct.outbox, &publish.message, dc_data->id);
 
-	return mqtt_publish(&nct.client, &publish);
+	return (err < 0) ? err : 0;
 }
 
 static bool strings_compare(const char *s1, const char *s2, u32_t s1_len,
@@ -335,6 +343,14 @@ static int nct_topics_populate(void)
 	}
 	LOG_DBG("update_delta_topic: %s", log_strdup(update_delta_topic));
 
+	ret = snprintf(update_rejected_topic, sizeof(update_rejected_topic),
+		       NCT_UPDATE_REJECTED_TOPIC, client_id_buf);
+	if (ret != NCT_UPDATE_REJECTED_TOPIC_LEN) {
+		return -ENOMEM;
+	}
+	LOG_DBG("update_rejected_topic: %s",
+		log_strdup(update_rejected_topic));
+
 	ret = snprintf(update_topic, sizeof(update_topic), NCT_UPDATE_TOPIC,
 		       client_id_buf);
 	if (ret != NCT_UPDATE_TOPIC_LEN) {
@@ -509,6 +525,8 @@ int nct_mqtt_connect(void)
 		return -ENOEXEC;
 	}
 #endif /* defined(CONFIG_AWS_FOTA) */
+	nct.connect_start = k_uptime_get();
+
 	err = mqtt_connect(&nct.client);
 	if (err != 0) {
 		LOG_DBG("mqtt_connect failed %d", err);
@@ -516,13 +534,107 @@ int nct_mqtt_connect(void)
 	return err;
 }
 
-static int publish_get_payload(struct mqtt_client *client, size_t length)
+/* Read the payload of a received message and notify it. A message that does
+ * not fit in the payload buffer is read in fragments of the size of the
+ * buffer. The fragments of a data channel message are notified, if enabled.
+ * Control channel messages are discarded, because the JSON tokenizer that
+ * decodes them points into the whole document. Returns -EMSGSIZE if the
+ * message was discarded.
+ */
+static int publish_get_payload(struct mqtt_client *client,
+			       const struct mqtt_publish_param *p)
 {
-	if (length > sizeof(nct.payload_buf)) {
-		return -EMSGSIZE;
+	int err;
+	size_t length = p->message.payload.len;
+	size_t offset = 0;
+	bool fragmented = (length > sizeof(nct.payload_buf));
+	bool deliver;
+	struct nct_evt evt = { .status = 0 };
+	struct nct_cc_data cc = { .id = p->message_id };
+	struct nct_dc_data dc = {
+		.id = p->message_id,
+		.total_len = length
+	};
+
+	/* If the data arrives on one of the subscribed control channel
+	 * topic. Then we notify the same.
+	 */
+	if (control_channel_topic_match(NCT_RX_LIST, &p->message.topic,
+					&cc.opcode)) {
+		evt.type = NCT_EVT_CC_RX_DATA;
+		evt.param.cc = &cc;
+		deliver = !fragmented;
+	} else {
+		evt.type = fragmented ? NCT_EVT_DC_RX_DATA_FRAGMENT :
+					NCT_EVT_DC_RX_DATA;
+		evt.param.dc = &dc;
+		deliver = !fragmented ||
+			  IS_ENABLED(CONFIG_NRF_CLOUD_MQTT_PAYLOAD_FRAGMENTS);
+	}
+
+	if (!deliver) {
+		LOG_ERR("Incoming %s message of %d bytes discarded, "
+			"NRF_CLOUD_MQTT_PAYLOAD_BUFFER_LEN is %d",
+			(evt.type == NCT_EVT_CC_RX_DATA) ? "control" : "data",
+			length, sizeof(nct.payload_buf));
+	}
+
+	/* The payload is read even if it is discarded, otherwise the client
+	 * can not receive further packets.
+	 */
+	do {
+		size_t chunk = MIN(length - offset, sizeof(nct.payload_buf));
+
+		err = mqtt_readall_publish_payload(client, nct.payload_buf,
+						   chunk);
+		if (err) {
+			return err;
+		}
+
+		if (deliver) {
+			cc.data.ptr = nct.payload_buf;
+			cc.data.len = chunk;
+			dc.data.ptr = nct.payload_buf;
+			dc.data.len = chunk;
+			dc.offset = offset;
+
+			err = nct_input(&evt);
+			if (err != 0) {
+				LOG_ERR("nct_input: failed %d", err);
+			}
+		}
+
+		offset += chunk;
+	} while (offset < length);
+
+	return deliver ? 0 : -EMSGSIZE;
+}
+
+/* Notify acknowledged messages with the ID they were sent with. */
+static void nct_outbox_ack_handler(struct mqtt_outbox *outbox,
+				   const struct mqtt_publish_message *message,
+				   u32_t tag, int result)
+{
+	int err;
+	struct nct_evt evt = {
+		.type = NCT_EVT_CC_TX_DATA_ACK,
+		.param.data_id = tag
+	};
+
+	if (result) {
+		return;
 	}
 
-	return mqtt_readall_publish_payload(client, nct.payload_buf, length);
+	if (strings_compare(message->topic.topic.utf8, nct.dc_tx_endp.utf8,
+			    message->topic.topic.size, nct.dc_tx_endp.size) &&
+	    (message->topic.topic.size == nct.dc_tx_endp.size)) {
+		evt.type = NCT_EVT_DC_TX_DATA_ACK;
+	}
+
+	err = nct_input(&evt);
+	if (err != 0) {
+		LOG_ERR("nct_input: failed %d", err);
+	}
 }
 
 /* Handle MQTT events. */
@@ -531,8 +643,6 @@ static void nct_mqtt_evt_handler(struct mqtt_client *const mqtt_client,
 {
 	int err;
 	struct nct_evt evt = { .status = _mqtt_evt->result };
-	struct nct_cc_data cc;
-	struct nct_dc_data dc;
 	bool event_notify = false;
 
 #if defined(CONFIG_AWS_FOTA)
@@ -555,6 +665,17 @@ static void nct_mqtt_evt_handler(struct mqtt_client *const mqtt_client,
 	case MQTT_EVT_CONNACK: {
 		LOG_DBG("MQTT_EVT_CONNACK");
 
+		nct.connect_time = (u32_t)(k_uptime_get() - nct.connect_start);
+		LOG_INF("Connected in %d ms", nct.connect_time);
+
+		/* Messages that were not acknowledged before the connection
+		 * was lost are sent again.
+		 */
+		err = mqtt_outbox_resend(&nct.outbox);
+		if (err) {
+			LOG_ERR("mqtt_outbox_resend: failed %d", err);
+		}
+
 		evt.type = NCT_EVT_CONNECTED;
 		event_notify = true;
 		break;
@@ -566,39 +687,25 @@ static void nct_mqtt_evt_handler(struct mqtt_client *const mqtt_client,
 			p->message_id,
 			p->message.payload.len);
 
-		int err = publish_get_payload(mqtt_client,
-					      p->message.payload.len);
-
-		if (err < 0) {
+		/* The payload is notified while it is read */
+		int err = publish_get_payload(mqtt_client, p);
+
+		if (err == -EMSGSIZE) {
+			/* A discarded message is not acknowledged, so that it
+			 * is not lost. The connection is closed instead of
+			 * running without it, and the message is sent again
+			 * when the client reconnects.
+			 */
+			LOG_ERR("Disconnecting, message %d not received",
+				p->message_id);
+			mqtt_disconnect(mqtt_client);
+			break;
+		} else if (err < 0) {
 			LOG_ERR("publish_get_payload: failed %d", err);
 			mqtt_disconnect(mqtt_client);
-			event_notify = false;
 			break;
 		}
 
-		/* If the data arrives on one of the subscribed control channel
-		 * topic. Then we notify the same.
-		 */
-		if (control_channel_topic_match(NCT_RX_LIST, &p->message.topic,
-						&cc.opcode)) {
-			cc.id = p->message_id;
-			cc.data.ptr = nct.payload_buf;
-			cc.data.len = p->message.payload.len;
-
-			evt.type = NCT_EVT_CC_RX_DATA;
-			evt.param.cc = &cc;
-			event_notify = true;
-		} else {
-			/* Try to match it with one of the data topics. */
-			dc.id = p->message_id;
-			dc.data.ptr = nct.payload_buf;
-			dc.data.len = p->message.payload.len;
-
-			evt.type = NCT_EVT_DC_RX_DATA;
-			evt.param.dc = &dc;
-			event_notify = true;
-		}
-
 		if (p->message.topic.qos == MQTT_QOS_1_AT_LEAST_ONCE) {
 			const struct mqtt_puback_param ack = {
 				.message_id = p->message_id
@@ -613,11 +720,11 @@ static void nct_mqtt_evt_handler(struct mqtt_client *const mqtt_client,
 		LOG_DBG("MQTT_EVT_SUBACK: id = %d result = %d",
 			_mqtt_evt->param.suback.message_id, _mqtt_evt->result);
 
-		if (_mqtt_evt->param.suback.message_id == NCT_CC_SUBSCRIBE_ID) {
+		if (_mqtt_evt->param.suback.message_id == nct.cc_subscribe_id) {
 			evt.type = NCT_EVT_CC_CONNECTED;
 			event_notify = true;
 		}
-		if (_mqtt_evt->param.suback.message_id == NCT_DC_SUBSCRIBE_ID) {
+		if (_mqtt_evt->param.suback.message_id == nct.dc_subscribe_id) {
 			evt.type = NCT_EVT_DC_CONNECTED;
 			event_notify = true;
 		}
@@ -626,7 +733,8 @@ static void nct_mqtt_evt_handler(struct mqtt_client *const mqtt_client,
 	case MQTT_EVT_UNSUBACK: {
 		LOG_DBG("MQTT_EVT_UNSUBACK");
 
-		if (_mqtt_evt->param.suback.message_id == NCT_CC_SUBSCRIBE_ID) {
+		if (_mqtt_evt->param.unsuback.message_id ==
+		    nct.cc_subscribe_id) {
 			evt.type = NCT_EVT_CC_DISCONNECTED;
 			event_notify = true;
 		}
@@ -636,9 +744,9 @@ static void nct_mqtt_evt_handler(struct mqtt_client *const mqtt_client,
 		LOG_DBG("MQTT_EVT_PUBACK: id = %d result = %d",
 			_mqtt_evt->param.puback.message_id, _mqtt_evt->result);
 
-		evt.type = NCT_EVT_CC_TX_DATA_ACK;
-		evt.param.data_id = _mqtt_evt->param.puback.message_id;
-		event_notify = true;
+		/* The outbox notifies the acknowledgment */
+		(void)mqtt_outbox_puback(&nct.outbox,
+					 &_mqtt_evt->param.puback);
 		break;
 	}
 	case MQTT_EVT_DISCONNECT: {
@@ -667,6 +775,12 @@ int nct_init(void)
 
 	dc_endpoint_reset();
 
+	err = mqtt_outbox_init(&nct.outbox, &nct.client,
+			       nct_outbox_ack_handler);
+	if (err) {
+		return err;
+	}
+
 	err = nct_topics_populate();
 	if (err) {
 		return err;
@@ -766,10 +880,12 @@ int nct_cc_connect(void)
 {
 	LOG_DBG("nct_cc_connect");
 
+	nct.cc_subscribe_id = mqtt_outbox_message_id_get(&nct.outbox);
+
 	const struct mqtt_subscription_list subscription_list = {
 		.list = (struct mqtt_topic *)&nct_cc_rx_list,
 		.list_count = ARRAY_SIZE(nct_cc_rx_list),
-		.message_id = NCT_CC_SUBSCRIBE_ID
+		.message_id = nct.cc_subscribe_id
 	};
 
 	return mqtt_subscribe(&nct.client, &subscription_list);
@@ -777,8 +893,6 @@ int nct_cc_connect(void)
 
 int nct_cc_send(const struct nct_cc_data *cc_data)
 {
-	static u32_t msg_id;
-
 	if (cc_data == NULL) {
 		LOG_ERR("cc_data == NULL");
 		return -EINVAL;
@@ -803,28 +917,30 @@ int nct_cc_send(const struct nct_cc_data *cc_data)
 		publish.message.payload.len = cc_data->data.len;
 	}
 
-	publish.message_id = cc_data->id ? cc_data->id : ++msg_id;
-
-	LOG_DBG("mqtt_publish: id = %d opcode = %d len = %d", publish.message_id,
-		cc_data->opcode, cc_data->data.len);
-
-	int err = mqtt_publish(&nct.client, &publish);
+	int err = mqtt_outbox_publish(&nct.outbox, &publish.message,
+				      cc_data->id);
 
-	if (err) {
-		LOG_ERR("mqtt_publish failed %d", err);
+	if (err < 0) {
+		LOG_ERR("mqtt_outbox_publish failed %d", err);
+		return err;
 	}
 
-	return err;
+	LOG_DBG("mqtt_publish: id = %d opcode = %d len = %d", err,
+		cc_data->opcode, cc_data->data.len);
+
+	return 0;
 }
 
 int nct_cc_disconnect(void)
 {
 	LOG_DBG("nct_cc_disconnect");
 
-	static const struct mqtt_subscription_list subscription_list = {
+	nct.cc_subscribe_id = mqtt_outbox_message_id_get(&nct.outbox);
+
+	const struct mqtt_subscription_list subscription_list = {
 		.list = (struct mqtt_topic *)nct_cc_rx_list,
 		.list_count = ARRAY_SIZE(nct_cc_rx_list),
-		.message_id = NCT_CC_SUBSCRIBE_ID
+		.message_id = nct.cc_subscribe_id
 	};
 
 	return mqtt_unsubscribe(&nct.client, &subscription_list);
@@ -883,10 +999,12 @@ int nct_dc_connect(void)
 		.qos = MQTT_QOS_1_AT_LEAST_ONCE
 	};
 
+	nct.dc_subscribe_id = mqtt_outbox_message_id_get(&nct.outbox);
+
 	const struct mqtt_subscription_list subscription_list = {
 		.list = &subscribe_topic,
 		.list_count = 1,
-		.message_id = NCT_DC_SUBSCRIBE_ID
+		.message_id = nct.dc_subscribe_id
 	};
 
 	return mqtt_subscribe(&nct.client, &subscription_list);
@@ -906,10 +1024,12 @@ int nct_dc_disconnect(void)
 {
 	LOG_DBG("nct_dc_disconnect");
 
+	nct.dc_subscribe_id = mqtt_outbox_message_id_get(&nct.outbox);
+
 	const struct mqtt_subscription_list subscription_list = {
 		.list = (struct mqtt_topic *)&nct.dc_rx_endp,
 		.list_count = 1,
-		.message_id = NCT_DC_SUBSCRIBE_ID
+		.message_id = nct.dc_subscribe_id
 	};
 
 	return mqtt_unsubscribe(&nct.client, &subscription_list);
@@ -934,6 +1054,11 @@ int nct_keepalive_time_left(void)
 	return (int)mqtt_keepalive_time_left(&nct.client);
 }
 
+u32_t nct_connect_time_get(void)
+{
+	return nct.connect_time;
+}
+
 int nct_socket_get(void)
 {
 	return nct.client.transport.tls.sock;
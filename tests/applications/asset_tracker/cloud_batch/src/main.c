@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <json_tokenizer.h>
+#include "cloud_batch.h"
+
+#define MSG_JSON "{\"appId\":\"TEMP\",\"data\":\"21.5\",\"uptime\":1200}"
+/* {"appId": "TEMP", "data": 21} */
+#define MSG_CBOR "\xa2\x65" "appId" "\x64" "TEMP" "\x64" "data" "\x15"
+
+static struct k_work_q work_q;
+K_THREAD_STACK_DEFINE(work_q_stack, 2048);
+
+static bool cbor;
+static u8_t sent[2048];
+static size_t sent_len;
+static int sent_count;
+static int send_err;
+
+static struct k_work sync_work;
+static K_SEM_DEFINE(sync_sem, 0, 1);
+
+static struct json_tok toks[512];
+
+bool cloud_codec_cbor(void)
+{
+	return cbor;
+}
+
+static int batch_send(struct cloud_msg *msg)
+{
+	zassert_true(msg->len <= sizeof(sent), "Batch too long");
+
+	sent_count++;
+
+	if (send_err) {
+		return send_err;
+	}
+
+	memcpy(sent, msg->buf, msg->len);
+	sent_len = msg->len;
+
+	return 0;
+}
+
+static void sync_work_fn(struct k_work *work)
+{
+	k_sem_give(&sync_sem);
+}
+
+/* Wait until the work queue has handled the work submitted so far */
+static void work_q_sync(void)
+{
+	k_work_submit_to_queue(&work_q, &sync_work);
+	zassert_equal(k_sem_take(&sync_sem, K_SECONDS(1)), 0, NULL);
+}
+
+static void msg_add(enum cloud_channel channel, const char *data, size_t len)
+{
+	struct cloud_msg msg = {
+		.buf = k_malloc(len),
+		.len = len,
+	};
+
+	zassert_not_null(msg.buf, NULL);
+	memcpy(msg.buf, data, len);
+	zassert_equal(cloud_batch_add(channel, &msg, false), 0, NULL);
+	zassert_is_null(msg.buf, "Buffer not taken over");
+}
+
+static double number_get(int tok)
+{
+	double value = -1;
+	int err;
+
+	zassert_true(tok >= 0, "Key not found");
+
+	if (cbor) {
+		err = json_tok_cbor_double(sent, &toks[tok], &value);
+	} else {
+		err = json_tok_double(sent, &toks[tok], &value);
+	}
+
+	zassert_equal(err, 0, "Not a number");
+
+	return value;
+}
+
+/* Check the batch that was sent, and return the index of its data array */
+static int batch_check(u32_t *boot, s64_t *uptime, size_t count,
+		       const char *msg, size_t msg_len)
+{
+	int ret;
+	int data;
+	int tok;
+
+	if (cbor) {
+		ret = json_tokenize_cbor(sent, sent_len, toks, ARRAY_SIZE(toks));
+	} else {
+		ret = json_tokenize(sent, sent_len, toks, ARRAY_SIZE(toks));
+	}
+
+	zassert_true(ret > 0, "Invalid batch: %d", ret);
+	zassert_equal(toks[0].type, JSON_TOK_OBJECT, NULL);
+	zassert_equal(toks[0].size, 3, NULL);
+
+	*boot = number_get(json_tok_get(sent, toks, 0, "boot"));
+	*uptime = number_get(json_tok_get(sent, toks, 0, "uptime"));
+
+	data = json_tok_get(sent, toks, 0, "data");
+	zassert_true(data >= 0, "No data");
+	zassert_equal(toks[data].type, JSON_TOK_ARRAY, NULL);
+	zassert_equal(toks[data].size, count, "Wrong number of messages");
+
+	/* The messages are copied as they are */
+	tok = data + 1;
+	for (size_t i = 0; i < count; i++) {
+		zassert_equal(toks[tok].end - toks[tok].start, msg_len, NULL);
+		zassert_mem_equal(&sent[toks[tok].start], msg, msg_len,
+				  "Message %d changed", i);
+		tok = toks[tok].next;
+	}
+
+	return data;
+}
+
+static void setup(void)
+{
+	sent_len = 0;
+	sent_count = 0;
+	send_err = 0;
+}
+
+static void batch_test(const char *msg, size_t msg_len)
+{
+	u32_t boot, first_boot;
+	s64_t uptime, first_uptime;
+	s64_t before;
+
+	setup();
+
+	/* Messages of different channels are sent together */
+	msg_add(CLOUD_CHANNEL_TEMP, msg, msg_len);
+	msg_add(CLOUD_CHANNEL_HUMID, msg, msg_len);
+	msg_add(CLOUD_CHANNEL_TEMP, msg, msg_len);
+
+	before = k_uptime_get();
+	zassert_equal(cloud_batch_flush(), 0, NULL);
+	zassert_equal(sent_count, 1, NULL);
+
+	batch_check(&first_boot, &first_uptime, 3, msg, msg_len);
+	zassert_true(first_uptime >= before, "Uptime before the flush");
+	zassert_true(first_uptime <= k_uptime_get(), "Uptime after the flush");
+
+	/* An empty batch is not sent */
+	zassert_equal(cloud_batch_flush(), 0, NULL);
+	zassert_equal(sent_count, 1, NULL);
+
+	/* Later batches of the same boot have the same ID */
+	k_sleep(K_MSEC(10));
+	msg_add(CLOUD_CHANNEL_GPS, msg, msg_len);
+	zassert_equal(cloud_batch_flush(), 0, NULL);
+
+	batch_check(&boot, &uptime, 1, msg, msg_len);
+	zassert_equal(boot, first_boot, "Boot ID changed");
+	zassert_true(uptime >= first_uptime + 10, "Uptime did not advance");
+}
+
+static void test_cloud_batch_json(void)
+{
+	cbor = false;
+	batch_test(MSG_JSON, strlen(MSG_JSON));
+}
+
+static void test_cloud_batch_cbor(void)
+{
+	cbor = true;
+	batch_test(MSG_CBOR, sizeof(MSG_CBOR) - 1);
+}
+
+static void test_cloud_batch_cbor_long(void)
+{
+	u32_t boot;
+	s64_t uptime;
+	size_t count = 0;
+
+	setup();
+	cbor = true;
+
+	/* More messages than fit in the head of a CBOR array */
+	for (enum cloud_channel ch = 0; ch < CLOUD_CHANNEL__TOTAL; ch++) {
+		for (int i = 0; i < CONFIG_CLOUD_BATCH_CHANNEL_DEPTH - 1; i++) {
+			msg_add(ch, MSG_CBOR, sizeof(MSG_CBOR) - 1);
+			count++;
+		}
+	}
+
+	zassert_true(count > 23, "Too few channels for the test");
+	zassert_equal(cloud_batch_flush(), 0, NULL);
+	batch_check(&boot, &uptime, count, MSG_CBOR, sizeof(MSG_CBOR) - 1);
+}
+
+static void test_cloud_batch_send_error(void)
+{
+	u32_t boot;
+	s64_t uptime;
+
+	setup();
+	cbor = false;
+
+	/* The messages are kept when the batch is not sent */
+	msg_add(CLOUD_CHANNEL_TEMP, MSG_JSON, strlen(MSG_JSON));
+	send_err = -EIO;
+	zassert_equal(cloud_batch_flush(), -EIO, NULL);
+
+	msg_add(CLOUD_CHANNEL_TEMP, MSG_JSON, strlen(MSG_JSON));
+	send_err = 0;
+	zassert_equal(cloud_batch_flush(), 0, NULL);
+	zassert_equal(sent_count, 2, NULL);
+	batch_check(&boot, &uptime, 2, MSG_JSON, strlen(MSG_JSON));
+}
+
+static void test_cloud_batch_channel_full(void)
+{
+	u32_t boot;
+	s64_t uptime;
+
+	setup();
+	cbor = false;
+
+	/* A full channel sends the batch from the work queue */
+	for (int i = 0; i < CONFIG_CLOUD_BATCH_CHANNEL_DEPTH; i++) {
+		msg_add(CLOUD_CHANNEL_LTE_LINK_RSRP, MSG_JSON,
+			strlen(MSG_JSON));
+	}
+
+	work_q_sync();
+	zassert_equal(sent_count, 1, "Not sent");
+	batch_check(&boot, &uptime, CONFIG_CLOUD_BATCH_CHANNEL_DEPTH,
+		    MSG_JSON, strlen(MSG_JSON));
+
+	/* When it cannot be sent, the oldest message is dropped */
+	send_err = -EIO;
+	for (int i = 0; i <= CONFIG_CLOUD_BATCH_CHANNEL_DEPTH; i++) {
+		msg_add(CLOUD_CHANNEL_LTE_LINK_RSRP, MSG_JSON,
+			strlen(MSG_JSON));
+	}
+
+	work_q_sync();
+	zassert_equal(sent_count, 2, "Not sent");
+
+	send_err = 0;
+	zassert_equal(cloud_batch_flush(), 0, NULL);
+	batch_check(&boot, &uptime, CONFIG_CLOUD_BATCH_CHANNEL_DEPTH,
+		    MSG_JSON, strlen(MSG_JSON));
+}
+
+void test_main(void)
+{
+	k_work_q_start(&work_q, work_q_stack,
+		       K_THREAD_STACK_SIZEOF(work_q_stack),
+		       K_LOWEST_APPLICATION_THREAD_PRIO);
+
+	k_work_init(&sync_work, sync_work_fn);
+
+	zassert_equal(cloud_batch_init(&work_q, batch_send), 0, NULL);
+
+	ztest_test_suite(cloud_batch,
+		ztest_unit_test(test_cloud_batch_json),
+		ztest_unit_test(test_cloud_batch_cbor),
+		ztest_unit_test(test_cloud_batch_cbor_long),
+		ztest_unit_test(test_cloud_batch_send_error),
+		ztest_unit_test(test_cloud_batch_channel_full)
+	);
+
+	ztest_run_test_suite(cloud_batch);
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <cJSON.h>
+#include "cloud_shadow.h"
+
+#define STATE "{\"a\":1,\"n\":{\"x\":1,\"y\":2},\"arr\":[1,2]}"
+
+/* Get the delta of the given state, and check it against the expected
+ * delta. Objects are compared regardless of the order of their keys.
+ */
+static void delta_check(const char *state, const char *expected,
+			bool expected_full)
+{
+	cJSON *delta = NULL;
+	cJSON *expected_delta = cJSON_Parse(expected);
+	bool full;
+	int err;
+
+	zassert_not_null(expected_delta, "Invalid expected delta");
+
+	err = cloud_shadow_delta_get(cJSON_Parse(state), &delta, &full);
+	zassert_equal(err, 0, "Delta failed: %d", err);
+	zassert_not_null(delta, NULL);
+	zassert_equal(full, expected_full, "Wrong full state flag");
+	zassert_true(cJSON_Compare(delta, expected_delta, true),
+		     "Unexpected delta: %s", cJSON_PrintUnformatted(delta));
+
+	cJSON_Delete(delta);
+	cJSON_Delete(expected_delta);
+}
+
+static void unchanged_check(const char *state)
+{
+	cJSON *delta = NULL;
+	bool full;
+
+	zassert_equal(cloud_shadow_delta_get(cJSON_Parse(state), &delta, &full),
+		      -ENODATA, "Delta of an unchanged state");
+	zassert_is_null(delta, NULL);
+}
+
+static void setup(void)
+{
+	cloud_shadow_reset();
+}
+
+static void test_cloud_shadow_invalid(void)
+{
+	cJSON *delta;
+	bool full;
+
+	zassert_equal(cloud_shadow_delta_get(NULL, &delta, &full), -EINVAL,
+		      NULL);
+	zassert_equal(cloud_shadow_delta_get(cJSON_Parse(STATE), NULL, &full),
+		      -EINVAL, NULL);
+	zassert_equal(cloud_shadow_delta_get(cJSON_Parse(STATE), &delta, NULL),
+		      -EINVAL, NULL);
+}
+
+static void test_cloud_shadow_first_full(void)
+{
+	delta_check(STATE, STATE, true);
+	cloud_shadow_state_sent();
+
+	unchanged_check(STATE);
+}
+
+static void test_cloud_shadow_changed_keys(void)
+{
+	delta_check(STATE, STATE, true);
+	cloud_shadow_state_sent();
+
+	/* Nested objects are compared key by key, arrays as a whole */
+	delta_check("{\"a\":2,\"n\":{\"x\":1,\"y\":3},\"arr\":[1,2]}",
+		    "{\"a\":2,\"n\":{\"y\":3}}", false);
+	cloud_shadow_state_sent();
+
+	delta_check("{\"a\":2,\"n\":{\"x\":1,\"y\":3},\"arr\":[1,3]}",
+		    "{\"arr\":[1,3]}", false);
+	cloud_shadow_state_sent();
+
+	/* Values that change type are reported as a whole */
+	delta_check("{\"a\":2,\"n\":5,\"arr\":[1,3]}", "{\"n\":5}", false);
+	cloud_shadow_state_sent();
+
+	delta_check("{\"a\":2,\"n\":{\"z\":true},\"arr\":[1,3]}",
+		    "{\"n\":{\"z\":true}}", false);
+}
+
+static void test_cloud_shadow_added_removed(void)
+{
+	delta_check(STATE, STATE, true);
+	cloud_shadow_state_sent();
+
+	/* Removed keys are reported as null, which deletes them */
+	delta_check("{\"a\":1,\"n\":{\"x\":1},\"b\":\"new\"}",
+		    "{\"n\":{\"y\":null},\"arr\":null,\"b\":\"new\"}", false);
+	cloud_shadow_state_sent();
+
+	unchanged_check("{\"a\":1,\"n\":{\"x\":1},\"b\":\"new\"}");
+}
+
+static void test_cloud_shadow_not_sent(void)
+{
+	delta_check(STATE, STATE, true);
+
+	/* Until the state is sent, deltas are against the reported state,
+	 * which is none yet.
+	 */
+	delta_check(STATE, STATE, true);
+	cloud_shadow_state_sent();
+
+	delta_check("{\"a\":2,\"n\":{\"x\":1,\"y\":2},\"arr\":[1,2]}",
+		    "{\"a\":2}", false);
+
+	/* The pending state is replaced by the newer one */
+	delta_check("{\"a\":3,\"n\":{\"x\":1,\"y\":2},\"arr\":[1,2]}",
+		    "{\"a\":3}", false);
+	cloud_shadow_state_sent();
+
+	unchanged_check("{\"a\":3,\"n\":{\"x\":1,\"y\":2},\"arr\":[1,2]}");
+}
+
+static void test_cloud_shadow_reset(void)
+{
+	delta_check(STATE, STATE, true);
+	cloud_shadow_state_sent();
+
+	/* After a reset, for example when an update was rejected, the full
+	 * state is reported again.
+	 */
+	cloud_shadow_reset();
+	delta_check(STATE, STATE, true);
+
+	/* A pending state is forgotten too */
+	cloud_shadow_reset();
+	cloud_shadow_state_sent();
+	delta_check(STATE, STATE, true);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(cloud_shadow,
+		ztest_unit_test(test_cloud_shadow_invalid),
+		ztest_unit_test_setup_teardown(test_cloud_shadow_first_full,
+					       setup, unit_test_noop),
+		ztest_unit_test_setup_teardown(test_cloud_shadow_changed_keys,
+					       setup, unit_test_noop),
+		ztest_unit_test_setup_teardown(test_cloud_shadow_added_removed,
+					       setup, unit_test_noop),
+		ztest_unit_test_setup_teardown(test_cloud_shadow_not_sent,
+					       setup, unit_test_noop),
+		ztest_unit_test_setup_teardown(test_cloud_shadow_reset,
+					       setup, unit_test_noop)
+	);
+
+	ztest_run_test_suite(cloud_shadow);
+}
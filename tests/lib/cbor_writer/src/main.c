@@ -0,0 +1,525 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <math.h>
+#include <kernel.h>
+
+#include <cbor_writer.h>
+#include <json_writer.h>
+#include <json_tokenizer.h>
+
+#define BENCHMARK_ITERATIONS 1000
+
+static u8_t buf[256];
+static struct json_tok toks[64];
+
+#define VECTOR(...) ((const u8_t[]){ __VA_ARGS__ }), \
+		    sizeof((const u8_t[]){ __VA_ARGS__ })
+
+static void expect(struct cbor_writer *w, const u8_t *bytes, size_t len)
+{
+	int ret = cbor_writer_finish(w);
+
+	zassert_equal(ret, len, "Length %d, expected %u", ret, len);
+	zassert_mem_equal(buf, bytes, len, "Unexpected encoding");
+}
+
+static void int_check(s64_t value, const u8_t *bytes, size_t len)
+{
+	struct cbor_writer w;
+
+	cbor_writer_init(&w, buf, sizeof(buf));
+	zassert_equal(cbor_writer_int(&w, NULL, value), 0, NULL);
+	expect(&w, bytes, len);
+}
+
+static void double_check(double value, const u8_t *bytes, size_t len)
+{
+	struct cbor_writer w;
+
+	cbor_writer_init(&w, buf, sizeof(buf));
+	zassert_equal(cbor_writer_double(&w, NULL, value), 0, NULL);
+	expect(&w, bytes, len);
+}
+
+/* Examples from RFC 7049, appendix A */
+static void test_cbor_writer_ints(void)
+{
+	int_check(0, VECTOR(0x00));
+	int_check(23, VECTOR(0x17));
+	int_check(24, VECTOR(0x18, 0x18));
+	int_check(100, VECTOR(0x18, 0x64));
+	int_check(1000, VECTOR(0x19, 0x03, 0xe8));
+	int_check(1000000, VECTOR(0x1a, 0x00, 0x0f, 0x42, 0x40));
+	int_check(1000000000000, VECTOR(0x1b, 0x00, 0x00, 0x00, 0xe8, 0xd4,
+					0xa5, 0x10, 0x00));
+	int_check(-1, VECTOR(0x20));
+	int_check(-10, VECTOR(0x29));
+	int_check(-100, VECTOR(0x38, 0x63));
+	int_check(-1000, VECTOR(0x39, 0x03, 0xe7));
+	int_check(INT64_MIN, VECTOR(0x3b, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff,
+				    0xff, 0xff));
+}
+
+static void test_cbor_writer_doubles(void)
+{
+	/* Integral values are written as integers */
+	double_check(0.0, VECTOR(0x00));
+	double_check(-0.0, VECTOR(0x00));
+	double_check(65504.0, VECTOR(0x19, 0xff, 0xe0));
+	double_check(-4.0, VECTOR(0x23));
+
+	double_check(1.5, VECTOR(0xf9, 0x3e, 0x00));
+	double_check(5.960464477539063e-8, VECTOR(0xf9, 0x00, 0x01));
+	double_check(0.00006103515625, VECTOR(0xf9, 0x04, 0x00));
+	double_check(3.4028234663852886e+38, VECTOR(0xfa, 0x7f, 0x7f, 0xff,
+						    0xff));
+	double_check(1.1, VECTOR(0xfb, 0x3f, 0xf1, 0x99, 0x99, 0x99, 0x99,
+				 0x99, 0x9a));
+	double_check(-4.1, VECTOR(0xfb, 0xc0, 0x10, 0x66, 0x66, 0x66, 0x66,
+				  0x66, 0x66));
+	double_check(1.0e+300, VECTOR(0xfb, 0x7e, 0x37, 0xe4, 0x3c, 0x88,
+				      0x00, 0x75, 0x9c));
+
+	/* Like the JSON writer, values that are not finite are null */
+	double_check(NAN, VECTOR(0xf6));
+	double_check(INFINITY, VECTOR(0xf6));
+}
+
+static void test_cbor_writer_values(void)
+{
+	struct cbor_writer w;
+
+	cbor_writer_init(&w, buf, sizeof(buf));
+	cbor_writer_str(&w, NULL, "");
+	expect(&w, VECTOR(0x60));
+
+	cbor_writer_init(&w, buf, sizeof(buf));
+	cbor_writer_str(&w, NULL, "IETF");
+	expect(&w, VECTOR(0x64, 0x49, 0x45, 0x54, 0x46));
+
+	cbor_writer_init(&w, buf, sizeof(buf));
+	cbor_writer_strn(&w, NULL, "abc", 2);
+	expect(&w, VECTOR(0x62, 0x61, 0x62));
+
+	cbor_writer_init(&w, buf, sizeof(buf));
+	cbor_writer_bool(&w, NULL, false);
+	expect(&w, VECTOR(0xf4));
+
+	cbor_writer_init(&w, buf, sizeof(buf));
+	cbor_writer_bool(&w, NULL, true);
+	expect(&w, VECTOR(0xf5));
+
+	cbor_writer_init(&w, buf, sizeof(buf));
+	cbor_writer_null(&w, NULL);
+	expect(&w, VECTOR(0xf6));
+
+	/* A string longer than 23 bytes has a one-byte length */
+	cbor_writer_init(&w, buf, sizeof(buf));
+	cbor_writer_str(&w, NULL, "abcdefghijklmnopqrstuvwxyz");
+	zassert_equal(cbor_writer_finish(&w), 28, NULL);
+	zassert_equal(buf[0], 0x78, NULL);
+	zassert_equal(buf[1], 26, NULL);
+}
+
+static void test_cbor_writer_containers(void)
+{
+	struct cbor_writer w;
+
+	cbor_writer_init(&w, buf, sizeof(buf));
+	cbor_writer_arr_start(&w, NULL);
+	cbor_writer_arr_end(&w);
+	expect(&w, VECTOR(0x80));
+
+	cbor_writer_init(&w, buf, sizeof(buf));
+	cbor_writer_map_start(&w, NULL);
+	cbor_writer_map_end(&w);
+	expect(&w, VECTOR(0xa0));
+
+	/* [1, [2, 3], [4, 5]] */
+	cbor_writer_init(&w, buf, sizeof(buf));
+	cbor_writer_arr_start(&w, NULL);
+	cbor_writer_int(&w, NULL, 1);
+	cbor_writer_arr_start(&w, NULL);
+	cbor_writer_int(&w, NULL, 2);
+	cbor_writer_int(&w, NULL, 3);
+	cbor_writer_arr_end(&w);
+	cbor_writer_arr_start(&w, NULL);
+	cbor_writer_int(&w, NULL, 4);
+	cbor_writer_int(&w, NULL, 5);
+	cbor_writer_arr_end(&w);
+	cbor_writer_arr_end(&w);
+	expect(&w, VECTOR(0x83, 0x01, 0x82, 0x02, 0x03, 0x82, 0x04, 0x05));
+
+	/* {"a": 1, "b": [2, 3]} */
+	cbor_writer_init(&w, buf, sizeof(buf));
+	cbor_writer_map_start(&w, NULL);
+	cbor_writer_int(&w, "a", 1);
+	cbor_writer_arr_start(&w, "b");
+	cbor_writer_int(&w, NULL, 2);
+	cbor_writer_int(&w, NULL, 3);
+	cbor_writer_arr_end(&w);
+	cbor_writer_map_end(&w);
+	expect(&w, VECTOR(0xa2, 0x61, 0x61, 0x01, 0x61, 0x62, 0x82, 0x02,
+			  0x03));
+
+	/* Arrays with more than 23 values have an indefinite length */
+	cbor_writer_init(&w, buf, sizeof(buf));
+	cbor_writer_arr_start(&w, NULL);
+	for (int i = 1; i <= 25; i++) {
+		cbor_writer_int(&w, NULL, i);
+	}
+	cbor_writer_arr_end(&w);
+	zassert_equal(cbor_writer_finish(&w), 29, NULL);
+	zassert_equal(buf[0], 0x9f, NULL);
+	zassert_equal(buf[1], 0x01, NULL);
+	zassert_equal(buf[24], 0x18, NULL);
+	zassert_equal(buf[25], 0x18, NULL);
+	zassert_equal(buf[26], 0x18, NULL);
+	zassert_equal(buf[27], 0x19, NULL);
+	zassert_equal(buf[28], 0xff, NULL);
+}
+
+static void sensor_data_cbor(struct cbor_writer *w)
+{
+	cbor_writer_map_start(w, NULL);
+	cbor_writer_str(w, "appId", "TEMP");
+	cbor_writer_str(w, "data", "23.4");
+	cbor_writer_str(w, "messageType", "DATA");
+	cbor_writer_map_end(w);
+}
+
+static void test_cbor_writer_length(void)
+{
+	struct cbor_writer w;
+	int len;
+	int needed;
+
+	/* Compute the length without a buffer */
+	cbor_writer_init(&w, NULL, 0);
+	sensor_data_cbor(&w);
+	needed = cbor_writer_finish(&w);
+	zassert_true(needed > 0, NULL);
+
+	/* One byte short, the header must not be patched past the buffer */
+	memset(buf, 0xaa, sizeof(buf));
+	cbor_writer_init(&w, buf, needed - 1);
+	sensor_data_cbor(&w);
+	len = cbor_writer_finish(&w);
+	zassert_equal(len, -ENOMEM, NULL);
+	zassert_equal(buf[needed - 1], 0xaa, "Written past the buffer");
+
+	/* Exact fit, no terminating NUL character */
+	cbor_writer_init(&w, buf, needed);
+	sensor_data_cbor(&w);
+	len = cbor_writer_finish(&w);
+	zassert_equal(len, needed, NULL);
+	zassert_equal(buf[0], 0xa3, NULL);
+	zassert_equal(buf[needed], 0xaa, "Written past the buffer");
+}
+
+static void test_cbor_writer_misuse(void)
+{
+	struct cbor_writer w;
+
+	/* Key in an array */
+	cbor_writer_init(&w, NULL, 0);
+	cbor_writer_arr_start(&w, NULL);
+	zassert_equal(cbor_writer_int(&w, "key", 1), -EINVAL, NULL);
+	zassert_equal(cbor_writer_finish(&w), -EINVAL, NULL);
+
+	/* No key in a map */
+	cbor_writer_init(&w, NULL, 0);
+	cbor_writer_map_start(&w, NULL);
+	zassert_equal(cbor_writer_null(&w, NULL), -EINVAL, NULL);
+
+	/* Key at the top level */
+	cbor_writer_init(&w, NULL, 0);
+	zassert_equal(cbor_writer_map_start(&w, "key"), -EINVAL, NULL);
+
+	/* Mismatched end */
+	cbor_writer_init(&w, NULL, 0);
+	cbor_writer_map_start(&w, NULL);
+	zassert_equal(cbor_writer_arr_end(&w), -EINVAL, NULL);
+
+	/* Two values at the top level */
+	cbor_writer_init(&w, NULL, 0);
+	cbor_writer_int(&w, NULL, 1);
+	zassert_equal(cbor_writer_int(&w, NULL, 2), -EINVAL, NULL);
+
+	/* Unterminated map */
+	cbor_writer_init(&w, NULL, 0);
+	cbor_writer_map_start(&w, NULL);
+	zassert_equal(cbor_writer_finish(&w), -EINVAL, NULL);
+
+	/* Empty document */
+	cbor_writer_init(&w, NULL, 0);
+	zassert_equal(cbor_writer_finish(&w), -EINVAL, NULL);
+
+	/* Too deep */
+	cbor_writer_init(&w, NULL, 0);
+	for (int i = 0; i < CBOR_WRITER_MAX_DEPTH; i++) {
+		zassert_equal(cbor_writer_arr_start(&w, NULL), 0, NULL);
+	}
+	zassert_equal(cbor_writer_arr_start(&w, NULL), -E2BIG, NULL);
+	zassert_equal(cbor_writer_finish(&w), -E2BIG, NULL);
+}
+
+/* A configuration update as the asset tracker receives it */
+static void config_cbor(struct cbor_writer *w)
+{
+	cbor_writer_map_start(w, NULL);
+	cbor_writer_map_start(w, "state");
+	cbor_writer_map_start(w, "config");
+	cbor_writer_map_start(w, "TEMP");
+	cbor_writer_bool(w, "enable", true);
+	cbor_writer_double(w, "thresh_hi", 30.5);
+	cbor_writer_double(w, "thresh_lo", -1.1);
+	cbor_writer_null(w, "interval");
+	cbor_writer_map_end(w);
+	cbor_writer_map_start(w, "GPS");
+	cbor_writer_int(w, "interval", 100000);
+	cbor_writer_map_end(w);
+	cbor_writer_map_end(w);
+	cbor_writer_map_end(w);
+	cbor_writer_arr_start(w, "list");
+	for (int i = 0; i < 30; i++) {
+		cbor_writer_int(w, NULL, -i);
+	}
+	cbor_writer_arr_end(w);
+	cbor_writer_str(w, "messageType", "CFG_SET");
+	cbor_writer_map_end(w);
+}
+
+static void test_cbor_writer_round_trip(void)
+{
+	const char *cbor = (const char *)buf;
+	struct cbor_writer w;
+	char str[16];
+	double value;
+	int len;
+	int ret;
+	int tok;
+
+	cbor_writer_init(&w, buf, sizeof(buf));
+	config_cbor(&w);
+	len = cbor_writer_finish(&w);
+	zassert_true(len > 0, NULL);
+
+	ret = json_tokenize_cbor(buf, len, toks, ARRAY_SIZE(toks));
+	zassert_true(ret > 0, "Tokenizing failed, error %d", ret);
+	zassert_equal(toks[0].type, JSON_TOK_OBJECT, NULL);
+	zassert_equal(toks[0].size, 3, NULL);
+	zassert_equal(toks[0].end, len, NULL);
+	zassert_equal(toks[0].next, ret, NULL);
+
+	tok = json_tok_find(cbor, toks, 0, "state.config.TEMP.enable");
+	zassert_true(tok > 0, NULL);
+	zassert_equal(toks[tok].type, JSON_TOK_TRUE, NULL);
+
+	tok = json_tok_find(cbor, toks, 0, "state.config.TEMP.thresh_hi");
+	zassert_equal(json_tok_cbor_double(buf, &toks[tok], &value), 0, NULL);
+	zassert_equal(value, 30.5, NULL);
+
+	tok = json_tok_find(cbor, toks, 0, "state.config.TEMP.thresh_lo");
+	zassert_equal(json_tok_cbor_double(buf, &toks[tok], &value), 0, NULL);
+	zassert_equal(value, -1.1, NULL);
+
+	tok = json_tok_find(cbor, toks, 0, "state.config.TEMP.interval");
+	zassert_equal(toks[tok].type, JSON_TOK_NULL, NULL);
+
+	tok = json_tok_find(cbor, toks, 0, "state.config.GPS.interval");
+	zassert_equal(json_tok_cbor_double(buf, &toks[tok], &value), 0, NULL);
+	zassert_equal(value, 100000, NULL);
+
+	/* The indefinite array is skipped by lookups after it */
+	tok = json_tok_get(cbor, toks, 0, "list");
+	zassert_equal(toks[tok].type, JSON_TOK_ARRAY, NULL);
+	zassert_equal(toks[tok].size, 30, NULL);
+	zassert_equal(json_tok_cbor_double(buf, &toks[toks[tok].next - 1],
+					   &value), 0, NULL);
+	zassert_equal(value, -29, NULL);
+
+	tok = json_tok_get(cbor, toks, 0, "messageType");
+	zassert_true(json_tok_str_eq(cbor, &toks[tok], "CFG_SET"), NULL);
+	zassert_equal(json_tok_cbor_str_copy(buf, &toks[tok], str,
+					     sizeof(str)), 7, NULL);
+	zassert_equal(strcmp(str, "CFG_SET"), 0, NULL);
+	zassert_equal(json_tok_cbor_str_copy(buf, &toks[tok], str, 7),
+		      -ENOMEM, NULL);
+
+	/* Every prefix of the document is incomplete */
+	for (int i = 0; i < len; i++) {
+		zassert_equal(json_tokenize_cbor(buf, i, toks,
+						 ARRAY_SIZE(toks)),
+			      -EINVAL, "Prefix of %d bytes accepted", i);
+	}
+
+	zassert_equal(json_tokenize_cbor(buf, len, toks, 8), -ENOMEM, NULL);
+}
+
+static void test_cbor_tokenizer_input(void)
+{
+	double value;
+
+	/* Definite length, tags and half precision floats */
+	static const u8_t tagged[] = {
+		0xc1, 0xa2, 0x61, 0x61, 0xc0, 0xf9, 0x3c, 0x00,
+		0x61, 0x62, 0x98, 0x01, 0xf9, 0x80, 0x01,
+	};
+
+	zassert_equal(json_tokenize_cbor(tagged, sizeof(tagged), toks,
+					 ARRAY_SIZE(toks)), 6, NULL);
+	zassert_equal(toks[0].size, 2, NULL);
+	zassert_equal(toks[2].type, JSON_TOK_NUMBER, NULL);
+	zassert_equal(json_tok_cbor_double(tagged, &toks[2], &value), 0, NULL);
+	zassert_equal(value, 1.0, NULL);
+	zassert_equal(toks[4].type, JSON_TOK_ARRAY, NULL);
+	zassert_equal(toks[4].size, 1, NULL);
+	zassert_equal(json_tok_cbor_double(tagged, &toks[5], &value), 0, NULL);
+	zassert_equal(value, -5.960464477539063e-8, NULL);
+
+	/* Invalid or not supported */
+	zassert_equal(json_tokenize_cbor(VECTOR(0xa1, 0x01, 0x02), toks,
+					 ARRAY_SIZE(toks)), -EINVAL,
+		      "Key that is not a string");
+	zassert_equal(json_tokenize_cbor(VECTOR(0x7f, 0x61, 0x61, 0xff), toks,
+					 ARRAY_SIZE(toks)), -EINVAL,
+		      "Indefinite string");
+	zassert_equal(json_tokenize_cbor(VECTOR(0xbf, 0x61, 0x61, 0xff), toks,
+					 ARRAY_SIZE(toks)), -EINVAL,
+		      "Key without a value");
+	zassert_equal(json_tokenize_cbor(VECTOR(0x81, 0x01, 0xff), toks,
+					 ARRAY_SIZE(toks)), -EINVAL,
+		      "Break in a definite array");
+	zassert_equal(json_tokenize_cbor(VECTOR(0x01, 0x02), toks,
+					 ARRAY_SIZE(toks)), -EINVAL,
+		      "Data after the top level value");
+	zassert_equal(json_tokenize_cbor(VECTOR(0x9a, 0xff, 0xff, 0xff, 0xff),
+					 toks, ARRAY_SIZE(toks)), -EINVAL,
+		      "Array longer than the document");
+	zassert_equal(json_tokenize_cbor(VECTOR(0x1c), toks,
+					 ARRAY_SIZE(toks)), -EINVAL,
+		      "Reserved additional information");
+}
+
+/* The data messages of the asset tracker, as it encodes them */
+struct message {
+	const char *channel;
+	const char *data;
+	const char *group;
+};
+
+static const struct message messages[] = {
+	{ "GPS", "$GPGGA,181908.00,3404.7041778,N,07044.3966270,W,4,13,1.00,"
+		 "495.144,M,29.200,M,0.10,0000*40", "DATA" },
+	{ "TEMP", "23.4", "DATA" },
+	{ "HUMID", "41.0", "DATA" },
+	{ "AIR_PRESS", "101.3", "DATA" },
+	{ "AIR_QUAL", "25.0", "DATA" },
+	{ "FLIP", "NORMAL", "DATA" },
+	{ "BUTTON", "1", "DATA" },
+	{ "LIGHT", "120 340 56 780", "DATA" },
+	{ "MODEM", "OK\r\n", "CMD" },
+};
+
+static void message_json(struct json_writer *w, const struct message *msg)
+{
+	json_writer_obj_start(w, NULL);
+	json_writer_str(w, "appId", msg->channel);
+	json_writer_str(w, "data", msg->data);
+	json_writer_str(w, "messageType", msg->group);
+	json_writer_obj_end(w);
+}
+
+static void message_cbor(struct cbor_writer *w, const struct message *msg)
+{
+	cbor_writer_map_start(w, NULL);
+	cbor_writer_str(w, "appId", msg->channel);
+	cbor_writer_str(w, "data", msg->data);
+	cbor_writer_str(w, "messageType", msg->group);
+	cbor_writer_map_end(w);
+}
+
+static void benchmark_print(const char *name, u32_t cycles, size_t bytes)
+{
+	u64_t ns = SYS_CLOCK_HW_CYCLES_TO_NS64(cycles);
+
+	TC_PRINT("%s: %u bytes in %u cycles, %u ns per message\n", name,
+		 bytes, cycles, (u32_t)(ns / BENCHMARK_ITERATIONS));
+}
+
+static void test_cbor_writer_benchmark(void)
+{
+	static char json[256];
+	struct json_writer jw;
+	struct cbor_writer cw;
+	u32_t start, cycles;
+	size_t json_bytes = 0;
+	size_t cbor_bytes = 0;
+
+	/* Each message is encoded twice, to compute the length and then into
+	 * a buffer of that size, as the asset tracker does.
+	 */
+	start = k_cycle_get_32();
+
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		const struct message *msg = &messages[i % ARRAY_SIZE(messages)];
+		int len;
+
+		json_writer_init(&jw, NULL, 0);
+		message_json(&jw, msg);
+		len = json_writer_finish(&jw);
+
+		json_writer_init(&jw, json, len + 1);
+		message_json(&jw, msg);
+		json_bytes += json_writer_finish(&jw);
+	}
+
+	cycles = k_cycle_get_32() - start;
+	benchmark_print("JSON", cycles, json_bytes);
+
+	start = k_cycle_get_32();
+
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		const struct message *msg = &messages[i % ARRAY_SIZE(messages)];
+		int len;
+
+		cbor_writer_init(&cw, NULL, 0);
+		message_cbor(&cw, msg);
+		len = cbor_writer_finish(&cw);
+
+		cbor_writer_init(&cw, buf, len);
+		message_cbor(&cw, msg);
+		cbor_bytes += cbor_writer_finish(&cw);
+	}
+
+	cycles = k_cycle_get_32() - start;
+	benchmark_print("CBOR", cycles, cbor_bytes);
+
+	TC_PRINT("CBOR is %u%% of the JSON size\n",
+		 (u32_t)(cbor_bytes * 100 / json_bytes));
+	zassert_true(cbor_bytes < json_bytes, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(cbor_writer,
+			 ztest_unit_test(test_cbor_writer_ints),
+			 ztest_unit_test(test_cbor_writer_doubles),
+			 ztest_unit_test(test_cbor_writer_values),
+			 ztest_unit_test(test_cbor_writer_containers),
+			 ztest_unit_test(test_cbor_writer_length),
+			 ztest_unit_test(test_cbor_writer_misuse),
+			 ztest_unit_test(test_cbor_writer_round_trip),
+			 ztest_unit_test(test_cbor_tokenizer_input),
+			 ztest_unit_test(test_cbor_writer_benchmark)
+			 );
+
+	ztest_run_test_suite(cbor_writer);
+}
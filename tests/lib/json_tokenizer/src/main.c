@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <stdlib.h>
+#include <kernel.h>
+
+#include <json_tokenizer.h>
+#include <cJSON.h>
+
+#define BENCHMARK_ITERATIONS 1000
+
+/* A shadow delta with a pairing update and a configuration */
+static const char delta[] =
+	"{\"version\":42,\"timestamp\":1580000000,"
+	"\"state\":{"
+		"\"pairing\":{\"state\":\"paired\","
+			"\"topics\":{"
+				"\"d2c\":\"prod/a0b1c2d3/m/d/nrf-352656100000000/d2c\","
+				"\"c2d\":\"prod/a0b1c2d3/m/d/nrf-352656100000000/c2d\"}},"
+		"\"nrfcloud_mqtt_topic_prefix\":\"prod/a0b1c2d3/\","
+		"\"config\":{"
+			"\"GPS\":{\"enable\":true,\"interval\":120},"
+			"\"TEMP\":{\"enable\":false,\"thresh_lo\":-5.5,"
+				  "\"thresh_hi\":3.1e1},"
+			"\"HUMID\":{\"enable\":null},"
+			"\"LED\":{\"color\":\"ff00ff\"}},"
+		"\"list\":[1,[2,3],{\"a\":[]},\"x\"]},"
+	"\"metadata\":{\"state\":{\"pairing\":{\"timestamp\":1580000000}}}}";
+
+static struct json_tok toks[128];
+
+/* A full shadow of the asset tracker, as received when the shadow is
+ * requested: the desired and reported state, and the metadata of each value.
+ */
+static const char full_shadow[] = {
+#include "full_shadow.inc"
+};
+
+/* Default of CONFIG_NRF_CLOUD_JSON_TOKENS and CONFIG_CLOUD_CODEC_JSON_TOKENS */
+#define SHADOW_TOKENS 512
+
+static void test_json_tokenizer_structure(void)
+{
+	static const char json[] = " {\"a\" : [1, {\"b\":null}], \"c\":\"d\"} ";
+	int n;
+
+	n = json_tokenize(json, strlen(json), toks, ARRAY_SIZE(toks));
+	zassert_equal(n, 9, "Wrong number of tokens: %d", n);
+
+	zassert_equal(toks[0].type, JSON_TOK_OBJECT, NULL);
+	zassert_equal(toks[0].size, 2, NULL);
+	zassert_equal(toks[0].start, 1, NULL);
+	zassert_equal(toks[0].end, strlen(json) - 1, NULL);
+	zassert_equal(toks[0].next, 9, NULL);
+
+	zassert_equal(toks[1].type, JSON_TOK_STRING, NULL);
+	zassert_equal(toks[1].next, 2, "Key does not lead to its value");
+
+	zassert_equal(toks[2].type, JSON_TOK_ARRAY, NULL);
+	zassert_equal(toks[2].size, 2, NULL);
+	zassert_equal(toks[2].next, 7, NULL);
+
+	zassert_equal(toks[3].type, JSON_TOK_NUMBER, NULL);
+	zassert_equal(toks[4].type, JSON_TOK_OBJECT, NULL);
+	zassert_equal(toks[4].size, 1, NULL);
+	zassert_equal(toks[6].type, JSON_TOK_NULL, NULL);
+
+	zassert_true(json_tok_str_eq(json, &toks[7], "c"), NULL);
+	zassert_true(json_tok_str_eq(json, &toks[8], "d"), NULL);
+
+	/* Top level values other than objects */
+	zassert_equal(json_tokenize("true", 4, toks, ARRAY_SIZE(toks)), 1,
+		      NULL);
+	zassert_equal(toks[0].type, JSON_TOK_TRUE, NULL);
+	zassert_equal(json_tokenize("[]", 2, toks, ARRAY_SIZE(toks)), 1,
+		      NULL);
+	zassert_equal(toks[0].size, 0, NULL);
+
+	/* Parsing stops at the end given and at a NUL character */
+	zassert_equal(json_tokenize("[1]]", 3, toks, ARRAY_SIZE(toks)), 2,
+		      NULL);
+	zassert_equal(json_tokenize("[1]", 100, toks, ARRAY_SIZE(toks)), 2,
+		      NULL);
+}
+
+static void test_json_tokenizer_lookup(void)
+{
+	double value;
+	int n;
+	int i;
+
+	n = json_tokenize(delta, strlen(delta), toks, ARRAY_SIZE(toks));
+	zassert_true(n > 0, "Tokenizing failed: %d", n);
+
+	i = json_tok_find(delta, toks, 0, "state.pairing.state");
+	zassert_true(i > 0, NULL);
+	zassert_true(json_tok_str_eq(delta, &toks[i], "paired"), NULL);
+	zassert_false(json_tok_str_eq(delta, &toks[i], "pair"), NULL);
+	zassert_false(json_tok_str_eq(delta, &toks[i], "paired2"), NULL);
+
+	i = json_tok_find(delta, toks, 0, "state.pairing.topics.c2d");
+	zassert_true(i > 0, NULL);
+	zassert_true(json_tok_str_eq(delta, &toks[i],
+			"prod/a0b1c2d3/m/d/nrf-352656100000000/c2d"), NULL);
+
+	/* Lookups continue from an earlier result */
+	i = json_tok_find(delta, toks, 0, "state.config");
+	zassert_equal(toks[i].type, JSON_TOK_OBJECT, NULL);
+	i = json_tok_find(delta, toks, json_tok_get(delta, toks, i, "TEMP"),
+			  "thresh_hi");
+	zassert_equal(json_tok_double(delta, &toks[i], &value), 0, NULL);
+	zassert_within(value, 31.0, 0.0001, NULL);
+
+	i = json_tok_find(delta, toks, 0, "state.config.TEMP.thresh_lo");
+	zassert_equal(json_tok_double(delta, &toks[i], &value), 0, NULL);
+	zassert_within(value, -5.5, 0.0001, NULL);
+	zassert_equal(toks[json_tok_find(delta, toks, 0,
+					 "state.config.GPS.enable")].type,
+		      JSON_TOK_TRUE, NULL);
+
+	/* Keys after nested containers are found */
+	zassert_true(json_tok_get(delta, toks, 0, "metadata") > 0, NULL);
+	zassert_true(json_tok_find(delta, toks, 0, "state.list") > 0, NULL);
+
+	/* Missing keys, partial keys and non-objects */
+	zassert_equal(json_tok_get(delta, toks, 0, "stat"), -ENOENT, NULL);
+	zassert_equal(json_tok_find(delta, toks, 0, "state.pairing.topics.x"),
+		      -ENOENT, NULL);
+	zassert_equal(json_tok_find(delta, toks, 0, "version.x"), -ENOENT,
+		      NULL);
+	zassert_equal(json_tok_find(delta, toks, -ENOENT, "state"), -ENOENT,
+		      NULL);
+	zassert_equal(json_tok_get(delta, toks,
+				   json_tok_find(delta, toks, 0, "state.list"),
+				   "a"),
+		      -ENOENT, NULL);
+
+	/* Only strings are strings and only numbers are numbers */
+	i = json_tok_get(delta, toks, 0, "version");
+	zassert_false(json_tok_str_eq(delta, &toks[i], "42"), NULL);
+	i = json_tok_find(delta, toks, 0, "state.config.LED.color");
+	zassert_equal(json_tok_double(delta, &toks[i], &value), -EINVAL, NULL);
+}
+
+static void test_json_tokenizer_strings(void)
+{
+	static const char json[] =
+		"[\"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t\", \"\\u00e9\\u20ac\","
+		"\"\\ud83d\\ude00\", \"\\ud83d\"]";
+	static const char expected[] = "a\"b\\c/d\b\f\n\r\t";
+	char doc[sizeof(json)];
+	char buf[32];
+	char *str;
+	int n;
+
+	n = json_tokenize(json, strlen(json), toks, ARRAY_SIZE(toks));
+	zassert_equal(n, 5, NULL);
+
+	n = json_tok_str_copy(json, &toks[1], buf, sizeof(buf));
+	zassert_equal(n, strlen(expected), NULL);
+	zassert_mem_equal(buf, expected, sizeof(expected), NULL);
+
+	/* Buffers of the unescaped length plus one are large enough */
+	zassert_equal(json_tok_str_copy(json, &toks[1], buf, n + 1), n, NULL);
+	zassert_equal(json_tok_str_copy(json, &toks[1], buf, n), -ENOMEM,
+		      NULL);
+
+	zassert_equal(json_tok_str_copy(json, &toks[2], buf, sizeof(buf)), 5,
+		      NULL);
+	zassert_equal(strcmp(buf, "\xc3\xa9\xe2\x82\xac"), 0, NULL);
+	zassert_equal(json_tok_str_copy(json, &toks[3], buf, sizeof(buf)), 4,
+		      NULL);
+	zassert_equal(strcmp(buf, "\xf0\x9f\x98\x80"), 0, NULL);
+
+	/* Unpaired surrogates are not valid */
+	zassert_equal(json_tok_str_copy(json, &toks[4], buf, sizeof(buf)),
+		      -EINVAL, NULL);
+	zassert_equal(json_tok_str_copy(json, &toks[0], buf, sizeof(buf)),
+		      -EINVAL, NULL);
+
+	/* In place, in a writable copy of the document */
+	memcpy(doc, json, sizeof(json));
+
+	str = json_tok_str_get(doc, &toks[1]);
+	zassert_not_null(str, NULL);
+	zassert_equal(strcmp(str, expected), 0, NULL);
+	zassert_equal(toks[1].end - toks[1].start, strlen(expected), NULL);
+	zassert_true(json_tok_str_eq(doc, &toks[1], expected), NULL);
+
+	/* The next string is not affected */
+	str = json_tok_str_get(doc, &toks[3]);
+	zassert_equal(strcmp(str, "\xf0\x9f\x98\x80"), 0, NULL);
+	zassert_is_null(json_tok_str_get(doc, &toks[0]), NULL);
+}
+
+static void test_json_tokenizer_numbers(void)
+{
+	static const char json[] = "[0, -0, 1.5, -12e3, 2E-2, 1e+2, "
+				   "123456789012]";
+	static const double expected[] = {
+		0, 0, 1.5, -12000, 0.02, 100, 123456789012.0
+	};
+	double value;
+	int n;
+
+	n = json_tokenize(json, strlen(json), toks, ARRAY_SIZE(toks));
+	zassert_equal(n, 1 + ARRAY_SIZE(expected), NULL);
+
+	for (size_t i = 0; i < ARRAY_SIZE(expected); i++) {
+		zassert_equal(toks[i + 1].type, JSON_TOK_NUMBER, NULL);
+		zassert_equal(json_tok_double(json, &toks[i + 1], &value), 0,
+			      NULL);
+		zassert_within(value, expected[i], 0.0001, "Number %d", i);
+	}
+}
+
+static void test_json_tokenizer_invalid(void)
+{
+	static const char *const invalid[] = {
+		"", " ", "{", "}", "[", "]", "{]", "[}", "{\"a\"}",
+		"{\"a\":}", "{\"a\":1,}", "[1,]", "[,1]", "{,}", "{1:2}",
+		"[1 2]", "{\"a\":1 \"b\":2}", "[1]]", "[1] x", "1 2",
+		"tru", "nul", "True", "[truex]", "01", "-", "1.", ".5",
+		"1e", "+1", "0x10", "\"abc", "\"a\\x\"", "\"\\u12\"",
+		"\"\\u12g4\"", "\"a\nb\"", "[\"a\":1]", "{\"a\"::1}",
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(invalid); i++) {
+		int n = json_tokenize(invalid[i], strlen(invalid[i]), toks,
+				      ARRAY_SIZE(toks));
+
+		zassert_equal(n, -EINVAL, "Accepted \"%s\": %d", invalid[i], n);
+	}
+}
+
+static void test_json_tokenizer_limits(void)
+{
+	static const char json[] = "{\"a\":[1,2,3]}";
+	static char big[JSON_TOK_MAX_LEN + 2];
+
+	/* Six tokens */
+	zassert_equal(json_tokenize(json, strlen(json), toks, 6), 6, NULL);
+	zassert_equal(json_tokenize(json, strlen(json), toks, 5), -ENOMEM,
+		      NULL);
+	zassert_equal(json_tokenize(json, strlen(json), toks, 0), -ENOMEM,
+		      NULL);
+
+	/* A string as long as allowed, and one character longer */
+	memset(big, 'a', sizeof(big));
+	big[0] = '"';
+	big[JSON_TOK_MAX_LEN - 1] = '"';
+	zassert_equal(json_tokenize(big, JSON_TOK_MAX_LEN, toks, 1), 1, NULL);
+	zassert_equal(toks[0].end, JSON_TOK_MAX_LEN - 1, NULL);
+	big[JSON_TOK_MAX_LEN - 1] = 'a';
+	big[JSON_TOK_MAX_LEN] = '"';
+	zassert_equal(json_tokenize(big, JSON_TOK_MAX_LEN + 1, toks, 1),
+		      -E2BIG, NULL);
+
+	zassert_equal(json_tokenize(NULL, 0, toks, 1), -EINVAL, NULL);
+}
+
+static void test_json_tokenizer_full_shadow(void)
+{
+	static struct json_tok shadow_toks[SHADOW_TOKENS];
+	double value;
+	int n;
+	int i;
+
+	n = json_tokenize(full_shadow, sizeof(full_shadow), shadow_toks,
+			  ARRAY_SIZE(shadow_toks));
+	zassert_true(n > 0, "Full shadow not tokenized: %d", n);
+
+	/* Leave room for more sensors and configuration */
+	zassert_true(n <= SHADOW_TOKENS * 4 / 5, "Full shadow has %d tokens",
+		     n);
+	TC_PRINT("Full shadow: %u bytes, %d tokens\n", sizeof(full_shadow), n);
+
+	/* Values are found before and after the metadata */
+	i = json_tok_find(full_shadow, shadow_toks, 0,
+			  "state.desired.pairing.topics.d2c");
+	zassert_true(i > 0, NULL);
+	zassert_true(json_tok_str_eq(full_shadow, &shadow_toks[i],
+		"prod/a0b1c2d3-e4f5-6789-abcd-ef0123456789/m/d/"
+		"nrf-352656100123456/d2c"), NULL);
+
+	i = json_tok_find(full_shadow, shadow_toks, 0,
+			  "state.reported.config.TEMP.thresh_lo");
+	zassert_equal(json_tok_double(full_shadow, &shadow_toks[i], &value), 0,
+		      NULL);
+	zassert_within(value, -5.5, 0.0001, NULL);
+
+	i = json_tok_find(full_shadow, shadow_toks, 0,
+			  "metadata.reported.device.serviceInfo.ui");
+	zassert_true(i > 0, NULL);
+	zassert_equal(shadow_toks[i].size, 9, NULL);
+
+	i = json_tok_get(full_shadow, shadow_toks, 0, "version");
+	zassert_equal(json_tok_double(full_shadow, &shadow_toks[i], &value), 0,
+		      NULL);
+	zassert_within(value, 1234, 0.0001, NULL);
+
+	/* The earlier default of 256 tokens was too small */
+	zassert_equal(json_tokenize(full_shadow, sizeof(full_shadow),
+				    shadow_toks, 256),
+		      -ENOMEM, NULL);
+}
+
+/* Heap use of cJSON, through its hooks */
+static size_t heap_used;
+static size_t heap_peak;
+
+static void *counting_malloc(size_t size)
+{
+	size_t *p = malloc(sizeof(size_t) + size);
+
+	if (p == NULL) {
+		return NULL;
+	}
+
+	*p = size;
+	heap_used += size;
+	heap_peak = MAX(heap_peak, heap_used);
+
+	return p + 1;
+}
+
+static void counting_free(void *ptr)
+{
+	size_t *p = ptr;
+
+	if (p == NULL) {
+		return;
+	}
+
+	heap_used -= p[-1];
+	free(p - 1);
+}
+
+static void benchmark_print(const char *name, u32_t cycles, size_t ram)
+{
+	u64_t ns = SYS_CLOCK_HW_CYCLES_TO_NS64(cycles);
+
+	TC_PRINT("%s: %u decodes in %u cycles, %u bytes of RAM per decode\n",
+		 name, BENCHMARK_ITERATIONS, cycles, ram);
+
+	if (ns > 0) {
+		TC_PRINT("%s: %u ns per decode\n", name,
+			 (u32_t)(ns / BENCHMARK_ITERATIONS));
+	}
+}
+
+/* Decode the pairing state, the topics and a configuration value, as the
+ * nRF Cloud and asset tracker decoders do for a shadow delta.
+ */
+static void test_json_tokenizer_benchmark(void)
+{
+	static cJSON_Hooks hooks = {
+		.malloc_fn = counting_malloc,
+		.free_fn = counting_free,
+	};
+	u32_t start, cycles;
+	size_t found = 0;
+
+	cJSON_InitHooks(&hooks);
+	heap_peak = 0;
+	start = k_cycle_get_32();
+
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		cJSON *root = cJSON_Parse(delta);
+		cJSON *state = cJSON_GetObjectItem(root, "state");
+		cJSON *pairing = cJSON_GetObjectItem(state, "pairing");
+		cJSON *topics = cJSON_GetObjectItem(pairing, "topics");
+		cJSON *config = cJSON_GetObjectItem(state, "config");
+		cJSON *temp = cJSON_GetObjectItem(config, "TEMP");
+
+		found += (cJSON_GetStringValue(
+			cJSON_GetObjectItem(pairing, "state")) != NULL);
+		found += (cJSON_GetStringValue(
+			cJSON_GetObjectItem(topics, "d2c")) != NULL);
+		found += cJSON_IsNumber(cJSON_GetObjectItem(temp, "thresh_lo"));
+
+		cJSON_Delete(root);
+	}
+
+	cycles = k_cycle_get_32() - start;
+	benchmark_print("cJSON", cycles, heap_peak);
+	zassert_equal(found, 3 * BENCHMARK_ITERATIONS, NULL);
+
+	found = 0;
+	start = k_cycle_get_32();
+
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		int n = json_tokenize(delta, sizeof(delta) - 1, toks,
+				      ARRAY_SIZE(toks));
+		int state = json_tok_get(delta, toks, 0, "state");
+		int topics = json_tok_find(delta, toks, state,
+					   "pairing.topics");
+		int temp = json_tok_find(delta, toks, state, "config.TEMP");
+
+		zassert_true(n > 0, NULL);
+		found += (json_tok_find(delta, toks, state,
+					"pairing.state") > 0);
+		found += (json_tok_get(delta, toks, topics, "d2c") > 0);
+		found += (json_tok_get(delta, toks, temp, "thresh_lo") > 0);
+	}
+
+	cycles = k_cycle_get_32() - start;
+	benchmark_print("json_tokenizer", cycles,
+			json_tokenize(delta, sizeof(delta) - 1, toks,
+				      ARRAY_SIZE(toks)) *
+			sizeof(struct json_tok));
+	zassert_equal(found, 3 * BENCHMARK_ITERATIONS, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(json_tokenizer,
+			 ztest_unit_test(test_json_tokenizer_structure),
+			 ztest_unit_test(test_json_tokenizer_lookup),
+			 ztest_unit_test(test_json_tokenizer_strings),
+			 ztest_unit_test(test_json_tokenizer_numbers),
+			 ztest_unit_test(test_json_tokenizer_invalid),
+			 ztest_unit_test(test_json_tokenizer_limits),
+			 ztest_unit_test(test_json_tokenizer_full_shadow),
+			 ztest_unit_test(test_json_tokenizer_benchmark)
+			 );
+
+	ztest_run_test_suite(json_tokenizer);
+}
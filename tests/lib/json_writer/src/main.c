@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <kernel.h>
+
+#include <json_writer.h>
+#include <cJSON.h>
+
+#define BENCHMARK_ITERATIONS 1000
+
+static const char nmea[] =
+	"$GPGGA,181908.00,3404.7041778,N,07044.3966270,W,4,13,1.00,495.144,M,"
+	"29.200,M,0.10,0000*40";
+
+static const char topic_prefix[] = "prod/a0b1c2d3-e4f5-4789-abcd-ef0123456789";
+static const char d2c[] = "prod/a0b1c2d3-e4f5-4789-abcd-ef0123456789/m/d/"
+			  "nrf-352656100000000/d2c";
+static const char c2d[] = "prod/a0b1c2d3-e4f5-4789-abcd-ef0123456789/m/d/"
+			  "nrf-352656100000000/c2d";
+
+/* Heap use of cJSON, through its hooks */
+static size_t heap_used;
+static size_t heap_peak;
+static size_t heap_allocs;
+
+static void *counting_malloc(size_t size)
+{
+	size_t *p = malloc(sizeof(size_t) + size);
+
+	if (p == NULL) {
+		return NULL;
+	}
+
+	*p = size;
+	heap_used += size;
+	heap_allocs++;
+	heap_peak = MAX(heap_peak, heap_used);
+
+	return p + 1;
+}
+
+static void counting_free(void *ptr)
+{
+	size_t *p = ptr;
+
+	if (p == NULL) {
+		return;
+	}
+
+	heap_used -= p[-1];
+	free(p - 1);
+}
+
+static void heap_reset(void)
+{
+	heap_used = 0;
+	heap_peak = 0;
+	heap_allocs = 0;
+}
+
+/* The messages sent by the nRF Cloud library, encoded with cJSON as the
+ * library did before, and with the writer.
+ */
+static char *sensor_data_cjson(void)
+{
+	char *out;
+	cJSON *root = cJSON_CreateObject();
+
+	cJSON_AddItemToObject(root, "appId", cJSON_CreateString("GPS"));
+	cJSON_AddItemToObject(root, "data", cJSON_CreateString(nmea));
+	cJSON_AddItemToObject(root, "messageType", cJSON_CreateString("DATA"));
+	out = cJSON_PrintUnformatted(root);
+	cJSON_Delete(root);
+
+	return out;
+}
+
+static void sensor_data_write(struct json_writer *w)
+{
+	json_writer_obj_start(w, NULL);
+	json_writer_str(w, "appId", "GPS");
+	json_writer_str(w, "data", nmea);
+	json_writer_str(w, "messageType", "DATA");
+	json_writer_obj_end(w);
+}
+
+static char *state_cjson(void)
+{
+	char *out;
+	cJSON *root = cJSON_CreateObject();
+	cJSON *state = cJSON_CreateObject();
+	cJSON *reported = cJSON_CreateObject();
+	cJSON *pairing = cJSON_CreateObject();
+	cJSON *topics = cJSON_CreateObject();
+
+	cJSON_AddItemToObject(reported, "nrfcloud_mqtt_topic_prefix",
+			      cJSON_CreateString(topic_prefix));
+	cJSON_AddItemToObject(pairing, "state", cJSON_CreateString("paired"));
+	cJSON_AddItemToObject(pairing, "config", cJSON_CreateNull());
+	cJSON_AddItemToObject(reported, "pairingStatus", cJSON_CreateNull());
+	cJSON_AddItemToObject(topics, "d2c", cJSON_CreateString(d2c));
+	cJSON_AddItemToObject(topics, "c2d", cJSON_CreateString(c2d));
+	cJSON_AddItemToObject(pairing, "topics", topics);
+	cJSON_AddItemToObject(reported, "pairing", pairing);
+	cJSON_AddItemToObject(state, "reported", reported);
+	cJSON_AddItemToObject(root, "state", state);
+	out = cJSON_PrintUnformatted(root);
+	cJSON_Delete(root);
+
+	return out;
+}
+
+static void state_write(struct json_writer *w)
+{
+	json_writer_obj_start(w, NULL);
+	json_writer_obj_start(w, "state");
+	json_writer_obj_start(w, "reported");
+	json_writer_str(w, "nrfcloud_mqtt_topic_prefix", topic_prefix);
+	json_writer_null(w, "pairingStatus");
+	json_writer_obj_start(w, "pairing");
+	json_writer_str(w, "state", "paired");
+	json_writer_null(w, "config");
+	json_writer_obj_start(w, "topics");
+	json_writer_str(w, "d2c", d2c);
+	json_writer_str(w, "c2d", c2d);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+}
+
+static char *shadow_data_cjson(void)
+{
+	char *out;
+	cJSON *root = cJSON_CreateObject();
+	cJSON *state = cJSON_CreateObject();
+	cJSON *reported = cJSON_CreateObject();
+	cJSON *device = cJSON_CreateObject();
+	cJSON *network = cJSON_CreateObject();
+
+	cJSON_AddItemToObject(network, "currentBand", cJSON_CreateNumber(20));
+	cJSON_AddItemToObject(network, "rsrp", cJSON_CreateNumber(-97));
+	cJSON_AddItemToObject(network, "areaCode", cJSON_CreateNumber(30401));
+	cJSON_AddItemToObject(network, "ipAddress",
+			      cJSON_CreateString("10.160.33.51"));
+	cJSON_AddItemToObject(device, "networkInfo", network);
+	cJSON_AddItemToObject(device, "batteryVoltage",
+			      cJSON_CreateNumber(3.712));
+	cJSON_AddItemToObject(device, "gpsFix", cJSON_CreateFalse());
+	cJSON_AddItemToObject(reported, "device", device);
+	cJSON_AddItemToObject(state, "reported", reported);
+	cJSON_AddItemToObject(root, "state", state);
+	out = cJSON_PrintUnformatted(root);
+	cJSON_Delete(root);
+
+	return out;
+}
+
+static void shadow_data_write(struct json_writer *w)
+{
+	json_writer_obj_start(w, NULL);
+	json_writer_obj_start(w, "state");
+	json_writer_obj_start(w, "reported");
+	json_writer_obj_start(w, "device");
+	json_writer_obj_start(w, "networkInfo");
+	json_writer_int(w, "currentBand", 20);
+	json_writer_int(w, "rsrp", -97);
+	json_writer_int(w, "areaCode", 30401);
+	json_writer_str(w, "ipAddress", "10.160.33.51");
+	json_writer_obj_end(w);
+	json_writer_double(w, "batteryVoltage", 3.712);
+	json_writer_bool(w, "gpsFix", false);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+	json_writer_obj_end(w);
+}
+
+struct message {
+	const char *name;
+	char *(*cjson)(void);
+	void (*write)(struct json_writer *w);
+};
+
+static const struct message messages[] = {
+	{ "sensor data", sensor_data_cjson, sensor_data_write },
+	{ "pairing state", state_cjson, state_write },
+	{ "shadow update", shadow_data_cjson, shadow_data_write },
+};
+
+static void message_check(const struct message *msg)
+{
+	static char buf[512];
+	struct json_writer w;
+	char *expected = msg->cjson();
+	int len;
+
+	zassert_not_null(expected, NULL);
+
+	json_writer_init(&w, buf, sizeof(buf));
+	msg->write(&w);
+	len = json_writer_finish(&w);
+
+	zassert_equal(len, strlen(expected), "Wrong length of %s", msg->name);
+	zassert_mem_equal(buf, expected, len + 1, "Wrong %s: %s", msg->name,
+			  buf);
+
+	cJSON_free(expected);
+}
+
+static void test_json_writer_messages(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(messages); i++) {
+		message_check(&messages[i]);
+	}
+}
+
+static void test_json_writer_escape(void)
+{
+	static const char str[] = "a\"b\\c/d\b\f\n\r\t\x01\x1f\x7f\xc3\xa6";
+	char buf[64];
+	char *expected;
+	cJSON *item = cJSON_CreateString(str);
+	struct json_writer w;
+	int len;
+
+	expected = cJSON_PrintUnformatted(item);
+	cJSON_Delete(item);
+
+	json_writer_init(&w, buf, sizeof(buf));
+	json_writer_str(&w, NULL, str);
+	len = json_writer_finish(&w);
+
+	zassert_equal(len, strlen(expected), NULL);
+	zassert_mem_equal(buf, expected, len + 1, "Wrong escape: %s", buf);
+	cJSON_free(expected);
+
+	/* Length limited strings do not need to be NUL-terminated */
+	json_writer_init(&w, buf, sizeof(buf));
+	json_writer_arr_start(&w, NULL);
+	json_writer_strn(&w, NULL, "abc\n", 4);
+	json_writer_strn(&w, NULL, "xyz", 0);
+	json_writer_arr_end(&w);
+	len = json_writer_finish(&w);
+
+	zassert_equal(len, strlen("[\"abc\\n\",\"\"]"), NULL);
+	zassert_mem_equal(buf, "[\"abc\\n\",\"\"]", len + 1, NULL);
+}
+
+static void test_json_writer_numbers(void)
+{
+	static const double doubles[] = {
+		0, -0.5, 23.5, 0.1, 1.0 / 3, 3.712, 1e300, -2.5e-10,
+		123456789012345678.0, NAN, INFINITY,
+	};
+	char buf[64];
+	char *expected;
+	struct json_writer w;
+	int len;
+
+	for (size_t i = 0; i < ARRAY_SIZE(doubles); i++) {
+		cJSON *item = cJSON_CreateNumber(doubles[i]);
+
+		expected = cJSON_PrintUnformatted(item);
+		cJSON_Delete(item);
+
+		json_writer_init(&w, buf, sizeof(buf));
+		json_writer_double(&w, NULL, doubles[i]);
+		len = json_writer_finish(&w);
+
+		zassert_equal(len, strlen(expected), NULL);
+		zassert_mem_equal(buf, expected, len + 1, "%s != %s", buf,
+				  expected);
+		cJSON_free(expected);
+	}
+
+	json_writer_init(&w, buf, sizeof(buf));
+	json_writer_arr_start(&w, NULL);
+	json_writer_int(&w, NULL, 0);
+	json_writer_int(&w, NULL, -1);
+	json_writer_int(&w, NULL, 4294967296);
+	json_writer_int(&w, NULL, INT64_MIN);
+	json_writer_bool(&w, NULL, true);
+	json_writer_raw(&w, NULL, "{}", 2);
+	json_writer_arr_end(&w);
+	len = json_writer_finish(&w);
+
+	zassert_true(len > 0, NULL);
+	zassert_equal(strcmp(buf, "[0,-1,4294967296,-9223372036854775808,"
+				  "true,{}]"), 0, "Wrong numbers: %s", buf);
+}
+
+static void test_json_writer_length(void)
+{
+	char buf[512];
+	struct json_writer w;
+	int len;
+	int needed;
+
+	/* Compute the length without a buffer */
+	json_writer_init(&w, NULL, 0);
+	state_write(&w);
+	needed = json_writer_finish(&w);
+	zassert_true(needed > 0, NULL);
+	zassert_true(needed < sizeof(buf) - 1, NULL);
+
+	/* No room for the terminating NUL character */
+	memset(buf, 0xaa, sizeof(buf));
+	json_writer_init(&w, buf, needed);
+	state_write(&w);
+	len = json_writer_finish(&w);
+	zassert_equal(len, -ENOMEM, NULL);
+	zassert_equal((u8_t)buf[needed], 0xaa, "Written past the buffer");
+
+	/* Exact fit */
+	json_writer_init(&w, buf, needed + 1);
+	state_write(&w);
+	len = json_writer_finish(&w);
+	zassert_equal(len, needed, NULL);
+	zassert_equal(strlen(buf), needed, NULL);
+	zassert_equal((u8_t)buf[needed + 1], 0xaa, "Written past the buffer");
+}
+
+static void test_json_writer_misuse(void)
+{
+	struct json_writer w;
+
+	/* Key in an array */
+	json_writer_init(&w, NULL, 0);
+	json_writer_arr_start(&w, NULL);
+	zassert_equal(json_writer_int(&w, "key", 1), -EINVAL, NULL);
+	zassert_equal(json_writer_finish(&w), -EINVAL, NULL);
+
+	/* No key in an object */
+	json_writer_init(&w, NULL, 0);
+	json_writer_obj_start(&w, NULL);
+	zassert_equal(json_writer_null(&w, NULL), -EINVAL, NULL);
+
+	/* Key at the top level */
+	json_writer_init(&w, NULL, 0);
+	zassert_equal(json_writer_obj_start(&w, "key"), -EINVAL, NULL);
+
+	/* Mismatched end */
+	json_writer_init(&w, NULL, 0);
+	json_writer_obj_start(&w, NULL);
+	zassert_equal(json_writer_arr_end(&w), -EINVAL, NULL);
+
+	/* Two values at the top level */
+	json_writer_init(&w, NULL, 0);
+	json_writer_obj_start(&w, NULL);
+	json_writer_obj_end(&w);
+	zassert_equal(json_writer_obj_start(&w, NULL), -EINVAL, NULL);
+
+	/* Unterminated object */
+	json_writer_init(&w, NULL, 0);
+	json_writer_obj_start(&w, NULL);
+	zassert_equal(json_writer_finish(&w), -EINVAL, NULL);
+
+	/* Empty document */
+	json_writer_init(&w, NULL, 0);
+	zassert_equal(json_writer_finish(&w), -EINVAL, NULL);
+
+	/* Too deep */
+	json_writer_init(&w, NULL, 0);
+	for (int i = 0; i < JSON_WRITER_MAX_DEPTH; i++) {
+		zassert_equal(json_writer_arr_start(&w, NULL), 0, NULL);
+	}
+	zassert_equal(json_writer_arr_start(&w, NULL), -E2BIG, NULL);
+	zassert_equal(json_writer_finish(&w), -E2BIG, NULL);
+}
+
+static void benchmark_print(const char *name, u32_t cycles, size_t bytes,
+			    size_t peak, size_t allocs)
+{
+	u64_t ns = SYS_CLOCK_HW_CYCLES_TO_NS64(cycles);
+
+	TC_PRINT("%s: %u bytes in %u cycles, peak heap %u bytes in %u "
+		 "allocations per message\n", name, bytes, cycles, peak,
+		 allocs / BENCHMARK_ITERATIONS);
+
+	if (ns > 0) {
+		TC_PRINT("%s: %u bytes/s\n", name,
+			 (u32_t)((u64_t)bytes * NSEC_PER_SEC / ns));
+	}
+}
+
+static void test_json_writer_benchmark(void)
+{
+	static char buf[512];
+	struct json_writer w;
+	u32_t start, cycles;
+	size_t bytes = 0;
+	size_t peak = 0;
+	size_t allocs = 0;
+
+	/* cJSON: build a tree and print it into a new buffer */
+	start = k_cycle_get_32();
+
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		const struct message *msg = &messages[i % ARRAY_SIZE(messages)];
+		char *out;
+
+		heap_reset();
+		out = msg->cjson();
+		bytes += strlen(out);
+		cJSON_free(out);
+		peak = MAX(peak, heap_peak);
+		allocs += heap_allocs;
+	}
+
+	cycles = k_cycle_get_32() - start;
+	benchmark_print("cJSON", cycles, bytes, peak, allocs);
+
+	/* Writer: compute the length, then write into a buffer of that size,
+	 * as the nRF Cloud library does. The buffer is static here.
+	 */
+	bytes = 0;
+	heap_reset();
+	start = k_cycle_get_32();
+
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		const struct message *msg = &messages[i % ARRAY_SIZE(messages)];
+		int len;
+
+		json_writer_init(&w, NULL, 0);
+		msg->write(&w);
+		len = json_writer_finish(&w);
+
+		json_writer_init(&w, buf, len + 1);
+		msg->write(&w);
+		bytes += json_writer_finish(&w);
+	}
+
+	cycles = k_cycle_get_32() - start;
+	benchmark_print("json_writer", cycles, bytes, heap_peak, heap_allocs);
+	zassert_equal(heap_allocs, 0, "Writer allocated memory");
+}
+
+void test_main(void)
+{
+	static cJSON_Hooks hooks = {
+		.malloc_fn = counting_malloc,
+		.free_fn = counting_free,
+	};
+
+	cJSON_InitHooks(&hooks);
+
+	ztest_test_suite(json_writer,
+			 ztest_unit_test(test_json_writer_messages),
+			 ztest_unit_test(test_json_writer_escape),
+			 ztest_unit_test(test_json_writer_numbers),
+			 ztest_unit_test(test_json_writer_length),
+			 ztest_unit_test(test_json_writer_misuse),
+			 ztest_unit_test(test_json_writer_benchmark)
+			 );
+
+	ztest_run_test_suite(json_writer);
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <stdio.h>
+#include <lte_lc.h>
+#include <at_cmd.h>
+#include <at_notif.h>
+#include <pdn_management.h>
+
+/* Notification handler that the library registered */
+static at_notif_handler_t notif_handler;
+
+static struct lte_lc_evt last_evt;
+static int evt_count;
+
+/* Registration status last reported to the PDN manager */
+static bool pdn_registered;
+static int pdn_update_count;
+
+int at_cmd_write(const char *const cmd, char *buf, size_t buf_len,
+		 enum at_cmd_state *state)
+{
+	if (state != NULL) {
+		*state = AT_CMD_OK;
+	}
+
+	return 0;
+}
+
+int at_notif_register_handler(void *context, at_notif_handler_t handler)
+{
+	notif_handler = handler;
+	return 0;
+}
+
+void pdn_manager_nw_reg_update(bool registered)
+{
+	pdn_registered = registered;
+	pdn_update_count++;
+}
+
+static void evt_handler(const struct lte_lc_evt *const evt)
+{
+	last_evt = *evt;
+	evt_count++;
+}
+
+static void setup(void)
+{
+	memset(&last_evt, 0, sizeof(last_evt));
+	evt_count = 0;
+	pdn_registered = false;
+	pdn_update_count = 0;
+
+	zassert_equal(lte_lc_init(), 0, NULL);
+	zassert_not_null(notif_handler, "Notifications not registered");
+	lte_lc_register_handler(evt_handler);
+}
+
+/* Send a +CEDRXP notification with the given access technology, network
+ * provided eDRX value and paging time window, and check the event.
+ */
+static void edrx_check(int actt, const char *edrx, const char *ptw,
+		       enum lte_lc_lte_mode mode, u32_t edrx_ms, u32_t ptw_ms)
+{
+	char notif[64];
+
+	snprintf(notif, sizeof(notif), "+CEDRXP: %d,\"0101\",\"%s\",\"%s\"\r\n",
+		 actt, edrx, ptw);
+
+	evt_count = 0;
+	notif_handler(NULL, notif);
+
+	zassert_equal(evt_count, 1, "No event for %s", notif);
+	zassert_equal(last_evt.type, LTE_LC_EVT_EDRX_UPDATE, NULL);
+	zassert_equal(last_evt.edrx_cfg.mode, mode, NULL);
+	zassert_equal(last_evt.edrx_cfg.edrx, edrx_ms,
+		      "Wrong eDRX for %s: %d", notif, last_evt.edrx_cfg.edrx);
+	zassert_equal(last_evt.edrx_cfg.ptw, ptw_ms,
+		      "Wrong PTW for %s: %d", notif, last_evt.edrx_cfg.ptw);
+}
+
+static void test_lte_lc_edrx_ltem(void)
+{
+	setup();
+
+	edrx_check(4, "0000", "0000", LTE_LC_LTE_MODE_LTEM, 5120, 1280);
+	edrx_check(4, "0101", "0011", LTE_LC_LTE_MODE_LTEM, 81920, 5120);
+	edrx_check(4, "1001", "0111", LTE_LC_LTE_MODE_LTEM, 163840, 10240);
+	edrx_check(4, "1101", "1111", LTE_LC_LTE_MODE_LTEM, 2621440, 20480);
+}
+
+static void test_lte_lc_edrx_nbiot(void)
+{
+	setup();
+
+	edrx_check(5, "0010", "0000", LTE_LC_LTE_MODE_NBIOT, 20480, 2560);
+	edrx_check(5, "0011", "0011", LTE_LC_LTE_MODE_NBIOT, 40960, 10240);
+	edrx_check(5, "1001", "0111", LTE_LC_LTE_MODE_NBIOT, 163840, 20480);
+	edrx_check(5, "1110", "1111", LTE_LC_LTE_MODE_NBIOT, 5242880, 40960);
+	edrx_check(5, "1111", "1111", LTE_LC_LTE_MODE_NBIOT, 10485760,
+		   40960);
+}
+
+static void test_lte_lc_edrx_nbiot_reserved(void)
+{
+	/* Interpreted as 0010, 20.48 seconds, by 3GPP TS 24.008 */
+	static const char *const reserved[] = {
+		"0000", "0001", "0100", "0110", "0111", "1000"
+	};
+
+	setup();
+
+	for (size_t i = 0; i < ARRAY_SIZE(reserved); i++) {
+		edrx_check(5, reserved[i], "0000", LTE_LC_LTE_MODE_NBIOT,
+			   20480, 2560);
+	}
+}
+
+static void test_lte_lc_edrx_not_used(void)
+{
+	setup();
+
+	evt_count = 0;
+	notif_handler(NULL, "+CEDRXP: 0\r\n");
+
+	zassert_equal(evt_count, 1, NULL);
+	zassert_equal(last_evt.type, LTE_LC_EVT_EDRX_UPDATE, NULL);
+	zassert_equal(last_evt.edrx_cfg.mode, LTE_LC_LTE_MODE_NONE, NULL);
+	zassert_equal(last_evt.edrx_cfg.edrx, 0, NULL);
+}
+
+/* Send a +CEREG notification, and check the status reported to the
+ * application and to the PDN manager.
+ */
+static void nw_reg_check(const char *notif, enum lte_lc_nw_reg_status status,
+			 bool registered)
+{
+	evt_count = 0;
+	pdn_update_count = 0;
+	notif_handler(NULL, notif);
+
+	zassert_equal(evt_count, 1, "No event for %s", notif);
+	zassert_equal(last_evt.type, LTE_LC_EVT_NW_REG_STATUS, NULL);
+	zassert_equal(last_evt.nw_reg_status, status, NULL);
+	zassert_equal(pdn_update_count, 1, "PDN manager not updated");
+	zassert_equal(pdn_registered, registered, "Wrong status for %s",
+		      notif);
+}
+
+static void test_lte_lc_nw_reg_pdn_manager(void)
+{
+	setup();
+
+	nw_reg_check("+CEREG: 2,\"0A0B\",\"01020304\",7\r\n",
+		     LTE_LC_NW_REG_SEARCHING, false);
+
+	nw_reg_check("+CEREG: 1,\"0A0B\",\"01020304\",7\r\n",
+		     LTE_LC_NW_REG_REGISTERED_HOME, true);
+	nw_reg_check("+CEREG: 4\r\n", LTE_LC_NW_REG_UNKNOWN, false);
+	nw_reg_check("+CEREG: 5,\"0A0B\",\"01020304\",7\r\n",
+		     LTE_LC_NW_REG_REGISTERED_ROAMING, true);
+	nw_reg_check("+CEREG: 0\r\n", LTE_LC_NW_REG_NOT_REGISTERED, false);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(lte_lc,
+		ztest_unit_test(test_lte_lc_edrx_ltem),
+		ztest_unit_test(test_lte_lc_edrx_nbiot),
+		ztest_unit_test(test_lte_lc_edrx_nbiot_reserved),
+		ztest_unit_test(test_lte_lc_edrx_not_used),
+		ztest_unit_test(test_lte_lc_nw_reg_pdn_manager)
+	);
+
+	ztest_run_test_suite(lte_lc);
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* PDN socket API, implemented by the test instead of the modem */
+#ifndef NET_SOCKET_H__
+#define NET_SOCKET_H__
+
+#include <zephyr/types.h>
+
+#define AF_LTE 102
+#define SOCK_MGMT 4
+#define NPROTO_PDN 514
+
+#define POLLOUT 0x4
+#define POLLERR 0x8
+#define POLLHUP 0x10
+#define POLLNVAL 0x20
+
+struct sockaddr;
+
+struct pollfd {
+	int fd;
+	short events;
+	short revents;
+};
+
+int pdn_socket(int family, int type, int protocol);
+int pdn_connect(int fd, const struct sockaddr *addr, int addrlen);
+int pdn_close(int fd);
+int pdn_fcntl(int fd, int cmd, int flags);
+int pdn_poll(struct pollfd *fds, int nfds, int timeout);
+
+#define socket pdn_socket
+#define connect pdn_connect
+#define close pdn_close
+#define fcntl pdn_fcntl
+#define poll pdn_poll
+
+#endif /* NET_SOCKET_H__ */
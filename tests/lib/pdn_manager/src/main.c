@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <errno.h>
+#include <net/socket.h>
+#include <lte_lc.h>
+#include <pdn_management.h>
+
+#define RETRY_INTERVAL_MS K_SECONDS(CONFIG_PDN_MANAGER_RETRY_INTERVAL)
+#define FD_BASE 10
+#define SOCKETS_MAX 32
+
+struct test_evt {
+	int id;
+	enum pdn_evt evt;
+	int fd;
+};
+
+K_MSGQ_DEFINE(evt_queue, sizeof(struct test_evt), 8, 4);
+
+/* Sockets created by the PDN manager, never reused */
+static struct {
+	bool open;
+	bool connecting;
+	/* The network deactivated the PDN */
+	bool hangup;
+	char apn[CONFIG_PDN_MANAGER_APN_MAX_LEN + 1];
+} sockets[SOCKETS_MAX];
+static int sockets_created;
+
+/* Result of the next connects: 0, or an errno */
+static int connect_result;
+/* Connects in progress complete */
+static bool connect_complete;
+
+static enum lte_lc_nw_reg_status nw_reg_status =
+	LTE_LC_NW_REG_REGISTERED_HOME;
+
+int lte_lc_nw_reg_status_get(enum lte_lc_nw_reg_status *status)
+{
+	*status = nw_reg_status;
+	return 0;
+}
+
+int pdn_socket(int family, int type, int protocol)
+{
+	zassert_equal(family, AF_LTE, NULL);
+	zassert_equal(type, SOCK_MGMT, NULL);
+	zassert_equal(protocol, NPROTO_PDN, NULL);
+	zassert_true(sockets_created < SOCKETS_MAX, "Too many sockets");
+
+	sockets[sockets_created].open = true;
+	return FD_BASE + sockets_created++;
+}
+
+int pdn_connect(int fd, const struct sockaddr *addr, int addrlen)
+{
+	int i = fd - FD_BASE;
+
+	zassert_true(sockets[i].open, "Connect on a closed socket");
+	zassert_true(addrlen < sizeof(sockets[i].apn), NULL);
+	memcpy(sockets[i].apn, addr, addrlen);
+	sockets[i].apn[addrlen] = '\0';
+
+	if (connect_result != 0) {
+		sockets[i].connecting = (connect_result == EINPROGRESS);
+		errno = connect_result;
+		return -1;
+	}
+
+	return 0;
+}
+
+int pdn_close(int fd)
+{
+	int i = fd - FD_BASE;
+
+	zassert_true(sockets[i].open, "Socket closed twice");
+	sockets[i].open = false;
+	return 0;
+}
+
+int pdn_fcntl(int fd, int cmd, int flags)
+{
+	return 0;
+}
+
+int pdn_poll(struct pollfd *fds, int nfds, int timeout)
+{
+	s64_t end = k_uptime_get() + timeout;
+
+	do {
+		int ready = 0;
+
+		for (int n = 0; n < nfds; n++) {
+			int i = fds[n].fd - FD_BASE;
+
+			fds[n].revents = 0;
+
+			if (!sockets[i].open) {
+				fds[n].revents = POLLNVAL;
+			} else if (sockets[i].hangup) {
+				fds[n].revents = POLLHUP;
+			} else if (sockets[i].connecting && connect_complete) {
+				sockets[i].connecting = false;
+			}
+
+			if (!sockets[i].connecting) {
+				fds[n].revents |= fds[n].events & POLLOUT;
+			}
+
+			if (fds[n].revents) {
+				ready++;
+			}
+		}
+
+		if (ready > 0) {
+			return ready;
+		}
+
+		k_sleep(10);
+	} while (k_uptime_get() < end);
+
+	return 0;
+}
+
+static void pdn_evt_handler(int id, enum pdn_evt evt, int fd)
+{
+	struct test_evt test_evt = { .id = id, .evt = evt, .fd = fd };
+
+	zassert_equal(k_msgq_put(&evt_queue, &test_evt, K_NO_WAIT), 0,
+		      "Event queue full");
+}
+
+/* Wait for the next event, and check it */
+static int evt_wait(int id, enum pdn_evt evt, s32_t timeout)
+{
+	struct test_evt test_evt;
+
+	zassert_equal(k_msgq_get(&evt_queue, &test_evt, timeout), 0,
+		      "No event %d", evt);
+	zassert_equal(test_evt.id, id, NULL);
+	zassert_equal(test_evt.evt, evt, "Unexpected event");
+
+	return test_evt.fd;
+}
+
+static void no_evt_check(s32_t timeout)
+{
+	struct test_evt test_evt;
+
+	zassert_not_equal(k_msgq_get(&evt_queue, &test_evt, timeout), 0,
+			  "Unexpected event %d", test_evt.evt);
+}
+
+static void setup(void)
+{
+	connect_result = 0;
+	connect_complete = false;
+	k_msgq_purge(&evt_queue);
+}
+
+static void ctx_remove(int id, int fd)
+{
+	zassert_equal(pdn_ctx_remove(id), 0, NULL);
+	zassert_false(sockets[fd - FD_BASE].open, "Socket not closed");
+	zassert_equal(pdn_ctx_fd_get(id), -ENOTCONN, NULL);
+	zassert_equal(pdn_ctx_remove(id), -ENOENT, NULL);
+}
+
+static void test_pdn_manager_init(void)
+{
+	zassert_equal(pdn_ctx_add("internet", pdn_evt_handler), -EPERM,
+		      "Context added before init");
+
+	/* The network is registered already */
+	zassert_equal(pdn_manager_init(), 0, NULL);
+	zassert_equal(pdn_manager_init(), 0, NULL);
+}
+
+static void test_pdn_manager_invalid(void)
+{
+	zassert_equal(pdn_ctx_add(NULL, pdn_evt_handler), -EINVAL, NULL);
+	zassert_equal(pdn_ctx_add("apn.longer.than.allowed", pdn_evt_handler),
+		      -EINVAL, NULL);
+	zassert_equal(pdn_ctx_remove(CONFIG_PDN_MANAGER_MAX_CONTEXTS), -EINVAL,
+		      NULL);
+	zassert_equal(pdn_ctx_fd_get(-1), -EINVAL, NULL);
+}
+
+static void test_pdn_manager_activate(void)
+{
+	int id;
+	int fd;
+
+	setup();
+
+	id = pdn_ctx_add("internet", pdn_evt_handler);
+	zassert_true(id >= 0, "Context not added");
+
+	fd = evt_wait(id, PDN_EVT_ACTIVATED, K_SECONDS(1));
+	zassert_true(sockets[fd - FD_BASE].open, NULL);
+	zassert_equal(strcmp(sockets[fd - FD_BASE].apn, "internet"), 0,
+		      "Wrong APN");
+	zassert_equal(pdn_ctx_fd_get(id), fd, NULL);
+
+	ctx_remove(id, fd);
+}
+
+static void test_pdn_manager_parallel(void)
+{
+	int id[2];
+	int fd[2];
+	int created = sockets_created;
+
+	setup();
+	connect_result = EINPROGRESS;
+
+	id[0] = pdn_ctx_add("ims", pdn_evt_handler);
+	id[1] = pdn_ctx_add("internet", pdn_evt_handler);
+	zassert_true((id[0] >= 0) && (id[1] >= 0), "Contexts not added");
+	zassert_equal(pdn_ctx_add("mms", pdn_evt_handler), -ENOMEM,
+		      "Too many contexts added");
+
+	/* Both contexts are activated without waiting for each other */
+	no_evt_check(300);
+	zassert_equal(sockets_created, created + 2, "Activation not started");
+	zassert_equal(pdn_ctx_fd_get(id[0]), -ENOTCONN, NULL);
+
+	connect_complete = true;
+	fd[0] = evt_wait(id[0], PDN_EVT_ACTIVATED, K_SECONDS(1));
+	fd[1] = evt_wait(id[1], PDN_EVT_ACTIVATED, K_SECONDS(1));
+	zassert_equal(pdn_ctx_fd_get(id[1]), fd[1], NULL);
+
+	ctx_remove(id[0], fd[0]);
+	ctx_remove(id[1], fd[1]);
+}
+
+static void test_pdn_manager_not_registered(void)
+{
+	int id;
+	int fd;
+	int created = sockets_created;
+
+	setup();
+
+	pdn_manager_nw_reg_update(false);
+
+	id = pdn_ctx_add("internet", pdn_evt_handler);
+	zassert_true(id >= 0, "Context not added");
+
+	no_evt_check(300);
+	zassert_equal(sockets_created, created, "Activated while unregistered");
+
+	pdn_manager_nw_reg_update(true);
+	fd = evt_wait(id, PDN_EVT_ACTIVATED, K_SECONDS(1));
+
+	ctx_remove(id, fd);
+}
+
+static void test_pdn_manager_reactivate(void)
+{
+	int id;
+	int fd;
+	int new_fd;
+
+	setup();
+
+	id = pdn_ctx_add("internet", pdn_evt_handler);
+	zassert_true(id >= 0, "Context not added");
+	fd = evt_wait(id, PDN_EVT_ACTIVATED, K_SECONDS(1));
+
+	/* The network deactivates the PDN */
+	sockets[fd - FD_BASE].hangup = true;
+
+	zassert_equal(evt_wait(id, PDN_EVT_DEACTIVATED, K_SECONDS(1)),
+		      -ENETDOWN, NULL);
+	zassert_false(sockets[fd - FD_BASE].open, "Socket not closed");
+
+	/* It is re-established right away, with a new socket */
+	new_fd = evt_wait(id, PDN_EVT_ACTIVATED, K_SECONDS(1));
+	zassert_not_equal(new_fd, fd, NULL);
+	zassert_equal(pdn_ctx_fd_get(id), new_fd, NULL);
+
+	ctx_remove(id, new_fd);
+}
+
+static void test_pdn_manager_retry(void)
+{
+	int id;
+	int fd;
+	s64_t start;
+
+	setup();
+	connect_result = ECONNREFUSED;
+
+	id = pdn_ctx_add("internet", pdn_evt_handler);
+	zassert_true(id >= 0, "Context not added");
+	zassert_equal(evt_wait(id, PDN_EVT_ERROR, K_SECONDS(1)),
+		      -ECONNREFUSED, NULL);
+
+	/* Activation is retried after the retry interval */
+	start = k_uptime_get();
+	connect_result = 0;
+	fd = evt_wait(id, PDN_EVT_ACTIVATED, RETRY_INTERVAL_MS + 500);
+	zassert_true(k_uptime_get() - start > RETRY_INTERVAL_MS / 2,
+		     "Retried too early");
+
+	ctx_remove(id, fd);
+}
+
+static void test_pdn_manager_retry_on_registration(void)
+{
+	int id;
+	int fd;
+
+	setup();
+	connect_result = ECONNREFUSED;
+
+	id = pdn_ctx_add("internet", pdn_evt_handler);
+	zassert_true(id >= 0, "Context not added");
+	zassert_equal(evt_wait(id, PDN_EVT_ERROR, K_SECONDS(1)),
+		      -ECONNREFUSED, NULL);
+
+	/* Activation is retried as soon as the network is registered again,
+	 * without waiting for the retry interval.
+	 */
+	connect_result = 0;
+	pdn_manager_nw_reg_update(false);
+	pdn_manager_nw_reg_update(true);
+	fd = evt_wait(id, PDN_EVT_ACTIVATED, RETRY_INTERVAL_MS / 2);
+
+	ctx_remove(id, fd);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(pdn_manager,
+		ztest_unit_test(test_pdn_manager_init),
+		ztest_unit_test(test_pdn_manager_invalid),
+		ztest_unit_test(test_pdn_manager_activate),
+		ztest_unit_test(test_pdn_manager_parallel),
+		ztest_unit_test(test_pdn_manager_not_registered),
+		ztest_unit_test(test_pdn_manager_reactivate),
+		ztest_unit_test(test_pdn_manager_retry),
+		ztest_unit_test(test_pdn_manager_retry_on_registration)
+	);
+
+	ztest_run_test_suite(pdn_manager);
+}
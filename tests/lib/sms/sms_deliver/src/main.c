@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <kernel.h>
+
+#include <sms_deliver.h>
+
+#define BENCHMARK_ITERATIONS 1000
+
+/* 7-bit "hellohello" with SMSC address and national originating address. */
+static const char pdu_gsm7[] =
+	"07917283010010F5040BC87238880900F10000993092516195800AE8329BFD4697D9"
+	"EC37";
+
+/* UCS2 "Hel€!" from an international address. */
+static const char pdu_ucs2[] =
+	"00040B911234567890F0000802105021000000"
+	"0A00480065006C20AC0021";
+
+/* First part of a concatenated 7-bit message, with extension characters. */
+static const char pdu_gsm7_concat[] =
+	"00440B911234567890F0000002105021000000160500032A0201906536FB0DDAA0"
+	"EE6F399BBC4901";
+
+/* Two parts of a concatenated UCS2 message, "AB" and "C". */
+static const char pdu_ucs2_part1[] =
+	"00440B911234567890F0000802105021000000"
+	"0A050003AA020100410042";
+static const char pdu_ucs2_part2[] =
+	"00440B911234567890F0000802105021000000"
+	"08050003AA02020043";
+
+/* 160 character 7-bit message. */
+static const char pdu_gsm7_long[] =
+	"0791447779070652040B914477681209F5000002105021000000A0C32651372D"
+	"52416937BD2CB787D93D1B6C376C1275C7221534A787E9F5F96ED824EAA6452A"
+	"28EDA697E5F630BB6783ED864DA2EE58A482E6F430BD3EDF0D9B44DDB44805A5"
+	"DDF4B2DC1E66F76CB0DDB049D41D8B54D09C1EA6D7E7BB6193A89B16A9A0B49B"
+	"5E96DBC3EC9E0DB61B3689BA63910A9AD3C3F4FA7C376C1275D322159476D3CB"
+	"727B98DDB3C176";
+
+static struct sms_deliver deliver;
+static struct sms_deliver_reassembly reassembly;
+
+static void test_decode_gsm7(void)
+{
+	int err = sms_deliver_decode(pdu_gsm7, strlen(pdu_gsm7), &deliver);
+
+	zassert_equal(err, 0, "Decoding failed");
+	zassert_equal(deliver.alphabet, SMS_DELIVER_ALPHABET_GSM7,
+		      "Wrong alphabet");
+	zassert_true(strcmp(deliver.address, "27838890001") == 0,
+		     "Wrong address");
+	zassert_equal(deliver.text_len, 10, "Wrong text length");
+	zassert_true(strcmp((char *)deliver.text, "hellohello") == 0,
+		     "Wrong text");
+	zassert_false(deliver.concat.present, "Unexpected concatenation");
+}
+
+static void test_decode_timestamp(void)
+{
+	int err = sms_deliver_decode(pdu_gsm7, strlen(pdu_gsm7), &deliver);
+
+	zassert_equal(err, 0, "Decoding failed");
+	zassert_equal(deliver.time.year, 99, "Wrong year");
+	zassert_equal(deliver.time.month, 3, "Wrong month");
+	zassert_equal(deliver.time.day, 29, "Wrong day");
+	zassert_equal(deliver.time.hour, 15, "Wrong hour");
+	zassert_equal(deliver.time.minute, 16, "Wrong minute");
+	zassert_equal(deliver.time.second, 59, "Wrong second");
+	zassert_equal(deliver.time.timezone, 8, "Wrong time zone");
+}
+
+static void test_decode_ucs2(void)
+{
+	int err = sms_deliver_decode(pdu_ucs2, strlen(pdu_ucs2), &deliver);
+
+	zassert_equal(err, 0, "Decoding failed");
+	zassert_equal(deliver.alphabet, SMS_DELIVER_ALPHABET_UCS2,
+		      "Wrong alphabet");
+	zassert_true(strcmp(deliver.address, "+21436587090") == 0,
+		     "Wrong address");
+	zassert_true(strcmp((char *)deliver.text, "Hel\xE2\x82\xAC!") == 0,
+		     "Wrong text");
+}
+
+static void test_decode_gsm7_udh(void)
+{
+	int err = sms_deliver_decode(pdu_gsm7_concat, strlen(pdu_gsm7_concat),
+				     &deliver);
+
+	zassert_equal(err, 0, "Decoding failed");
+	zassert_true(deliver.concat.present, "Concatenation not detected");
+	zassert_equal(deliver.concat.ref, 0x2A, "Wrong reference");
+	zassert_equal(deliver.concat.total, 2, "Wrong total");
+	zassert_equal(deliver.concat.seq, 1, "Wrong sequence number");
+	zassert_true(strcmp((char *)deliver.text, "Hello {world}") == 0,
+		     "Wrong text");
+}
+
+static void test_decode_invalid(void)
+{
+	char pdu[sizeof(pdu_gsm7)];
+	int err;
+
+	zassert_equal(sms_deliver_decode(pdu_gsm7, strlen(pdu_gsm7) - 2,
+					 &deliver),
+		      -EINVAL, "Truncated PDU accepted");
+	zassert_equal(sms_deliver_decode(pdu_gsm7, strlen(pdu_gsm7) - 1,
+					 &deliver),
+		      -EINVAL, "Odd length PDU accepted");
+
+	memcpy(pdu, pdu_gsm7, sizeof(pdu));
+	pdu[20] = 'x';
+	err = sms_deliver_decode(pdu, strlen(pdu), &deliver);
+	zassert_equal(err, -EINVAL, "Invalid hex accepted");
+
+	/* SMS-SUBMIT */
+	memcpy(pdu, pdu_gsm7, sizeof(pdu));
+	pdu[17] = '1';
+	err = sms_deliver_decode(pdu, strlen(pdu), &deliver);
+	zassert_equal(err, -ENOTSUP, "SMS-SUBMIT accepted");
+}
+
+static void test_reassembly(void)
+{
+	u8_t text[16];
+	int err;
+
+	sms_deliver_reassembly_reset(&reassembly);
+
+	/* Parts arrive out of order. */
+	err = sms_deliver_decode(pdu_ucs2_part2, strlen(pdu_ucs2_part2),
+				 &deliver);
+	zassert_equal(err, 0, "Decoding failed");
+	err = sms_deliver_reassembly_add(&reassembly, &deliver);
+	zassert_equal(err, 0, "Message complete too early");
+	err = sms_deliver_reassembly_get(&reassembly, text, sizeof(text));
+	zassert_equal(err, -EAGAIN, "Incomplete message returned");
+
+	/* A duplicate does not complete the message. */
+	err = sms_deliver_reassembly_add(&reassembly, &deliver);
+	zassert_equal(err, 0, "Duplicate part completed message");
+
+	err = sms_deliver_decode(pdu_ucs2_part1, strlen(pdu_ucs2_part1),
+				 &deliver);
+	zassert_equal(err, 0, "Decoding failed");
+	err = sms_deliver_reassembly_add(&reassembly, &deliver);
+	zassert_equal(err, 1, "Message not complete");
+
+	err = sms_deliver_reassembly_get(&reassembly, text, sizeof(text));
+	zassert_equal(err, 3, "Wrong length");
+	zassert_true(strcmp((char *)text, "ABC") == 0, "Wrong text");
+
+	/* A single part message can not be reassembled. */
+	err = sms_deliver_decode(pdu_gsm7, strlen(pdu_gsm7), &deliver);
+	zassert_equal(err, 0, "Decoding failed");
+	err = sms_deliver_reassembly_add(&reassembly, &deliver);
+	zassert_equal(err, -EINVAL, "Single part message accepted");
+}
+
+static void test_decode_throughput(void)
+{
+	size_t pdu_len = strlen(pdu_gsm7_long);
+	u32_t start, cycles;
+	u64_t ns;
+	int err;
+
+	err = sms_deliver_decode(pdu_gsm7_long, pdu_len, &deliver);
+	zassert_equal(err, 0, "Decoding failed");
+	zassert_equal(deliver.text_len, 160, "Wrong text length");
+
+	start = k_cycle_get_32();
+
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		(void)sms_deliver_decode(pdu_gsm7_long, pdu_len, &deliver);
+	}
+
+	cycles = k_cycle_get_32() - start;
+	ns = SYS_CLOCK_HW_CYCLES_TO_NS64(cycles);
+
+	TC_PRINT("Decoded %d 160 character PDUs in %u cycles\n",
+		 BENCHMARK_ITERATIONS, cycles);
+
+	if (ns > 0) {
+		TC_PRINT("Throughput: %u PDUs/s\n",
+			 (u32_t)((u64_t)BENCHMARK_ITERATIONS *
+				 NSEC_PER_SEC / ns));
+	}
+}
+
+void test_main(void)
+{
+	ztest_test_suite(sms_deliver_test,
+			 ztest_unit_test(test_decode_gsm7),
+			 ztest_unit_test(test_decode_timestamp),
+			 ztest_unit_test(test_decode_ucs2),
+			 ztest_unit_test(test_decode_gsm7_udh),
+			 ztest_unit_test(test_decode_invalid),
+			 ztest_unit_test(test_reassembly),
+			 ztest_unit_test(test_decode_throughput)
+			 );
+
+	ztest_run_test_suite(sms_deliver_test);
+}
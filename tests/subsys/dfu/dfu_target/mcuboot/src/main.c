@@ -25,7 +25,7 @@ bool dfu_target_mcuboot_identify(const void *const buf)
 	return identify_retval;
 }
 
-int dfu_target_mcuboot_init(size_t file_size)
+int dfu_target_mcuboot_init(size_t file_size, dfu_target_callback_t cb)
 {
 	return init_retval;
 }
@@ -60,7 +60,7 @@ static void init(void)
 
 	zassert_true(ret > 0, "Valid type not recognized");
 
-	err = dfu_target_init(ret, FILE_SIZE);
+	err = dfu_target_init(ret, FILE_SIZE, NULL);
 	zassert_equal(err, 0, NULL);
 }
 
@@ -82,10 +82,10 @@ static void test_init(void)
 	ret = dfu_target_img_type(0, 0);
 	zassert_true(ret > 0, "Valid type not recognized");
 
-	err = dfu_target_init(ret, FILE_SIZE);
+	err = dfu_target_init(ret, FILE_SIZE, NULL);
 	zassert_equal(err, 0, NULL);
 
-	err = dfu_target_init(ret, FILE_SIZE);
+	err = dfu_target_init(ret, FILE_SIZE, NULL);
 	zassert_equal(err, 0, "Re-initialization should pass");
 
 	err = dfu_target_done(true);
@@ -94,17 +94,17 @@ static void test_init(void)
 	/* Now clean up and try invalid types */
 	done();
 
-	err = dfu_target_init(0, FILE_SIZE);
+	err = dfu_target_init(0, FILE_SIZE, NULL);
 	zassert_true(err < 0, "Did not fail when invalid type is used");
 
 	done();
 
-	err = dfu_target_init(2, FILE_SIZE);
+	err = dfu_target_init(2, FILE_SIZE, NULL);
 	zassert_true(err < 0, "Did not fail when invalid type is used");
 
 	init_retval = -42;
 
-	err = dfu_target_init(ret, FILE_SIZE);
+	err = dfu_target_init(ret, FILE_SIZE, NULL);
 	zassert_equal(err, -42, "Did not return error code from target");
 
 	done();
@@ -164,6 +164,36 @@ static void test_offset_get(void)
 	zassert_true(err < 0, "Expected negative error code");
 }
 
+static void test_context_get(void)
+{
+	int err;
+	int img_type;
+	size_t file_size;
+
+	init_retval = 0;
+	done_retval = 0;
+	done();
+	err = dfu_target_context_get(&img_type, &file_size);
+	zassert_equal(err, -ENOENT, "Context without a download");
+
+	init();
+	err = dfu_target_context_get(&img_type, &file_size);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(img_type, DFU_TARGET_IMAGE_TYPE_MCUBOOT, NULL);
+	zassert_equal(file_size, FILE_SIZE, NULL);
+
+	/* Aborted download can still be resumed */
+	err = dfu_target_done(false);
+	zassert_equal(err, 0, NULL);
+	err = dfu_target_context_get(&img_type, &file_size);
+	zassert_equal(err, 0, NULL);
+
+	/* Completed download is not resumed */
+	done();
+	err = dfu_target_context_get(&img_type, &file_size);
+	zassert_equal(err, -ENOENT, NULL);
+}
+
 static void test_write(void)
 {
 	int err;
@@ -185,6 +215,7 @@ void test_main(void)
 			 ztest_unit_test(test_write),
 			 ztest_unit_test(test_offset_get),
 			 ztest_unit_test(test_done),
+			 ztest_unit_test(test_context_get),
 			 ztest_unit_test(test_init)
 			 );
 
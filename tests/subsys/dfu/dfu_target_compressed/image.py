@@ -0,0 +1,38 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+
+"""Create an image for the compressed DFU target test.
+
+The image consists of repeated code-like sequences with some variation, so
+that it is compressible, and a part of random data, which is not.
+"""
+
+import random
+import sys
+
+IMAGE_SIZE = 24 * 1024
+
+
+def main():
+    rand = random.Random(0)
+    snippets = []
+    for _ in range(32):
+        length = rand.randrange(4, 64)
+        snippets.append(bytes(rand.getrandbits(8) for _ in range(length)))
+
+    image = bytearray()
+    while len(image) < IMAGE_SIZE:
+        image += rand.choice(snippets)
+        image += bytes(rand.getrandbits(8) for _ in range(rand.randrange(4)))
+
+    image += bytes(rand.getrandbits(8) for _ in range(2000))
+
+    with open(sys.argv[1], "wb") as f:
+        f.write(image)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <sys/crc.h>
+#include <sys/byteorder.h>
+#include <dfu/dfu_target.h>
+#include <dfu_target_mcuboot.h>
+#include <dfu_target_compressed.h>
+
+#define WINDOW_BITS CONFIG_DFU_TARGET_COMPRESSED_WINDOW_BITS
+#define WINDOW_SIZE BIT(WINDOW_BITS)
+#define LENGTH_BITS 4
+#define HEADER_SIZE 16
+
+/* Image and its compressed versions, created by the host tool */
+static const u8_t image[] = {
+#include "image.bin.inc"
+};
+
+static const u8_t compressed[] = {
+#include "image.lz.inc"
+};
+
+/* Compressed with a larger window than the target is configured for */
+static const u8_t compressed_w12[] = {
+#include "image_w12.lz.inc"
+};
+
+/* Stream built by the tests, and the image it decompresses to */
+static u8_t stream[2048];
+static size_t stream_bits;
+static u8_t expected[4 * WINDOW_SIZE];
+static size_t expected_len;
+
+/* Image written to the secondary slot through the MCUboot DFU target */
+static u8_t secondary[sizeof(image)];
+static size_t secondary_len;
+static int mcuboot_init_calls;
+static int mcuboot_done_calls;
+static bool mcuboot_done_successful;
+/* Number of writes to the secondary slot before one fails, or -1 */
+static int writes_until_error;
+
+int dfu_target_mcuboot_init(size_t file_size, dfu_target_callback_t cb)
+{
+	zassert_true(file_size <= sizeof(secondary), "Image too big");
+	mcuboot_init_calls++;
+	secondary_len = 0;
+	return 0;
+}
+
+int dfu_target_mcuboot_offset_get(size_t *offset)
+{
+	*offset = secondary_len;
+	return 0;
+}
+
+int dfu_target_mcuboot_write(const void *const buf, size_t len)
+{
+	if (writes_until_error == 0) {
+		return -EIO;
+	} else if (writes_until_error > 0) {
+		writes_until_error--;
+	}
+
+	zassert_true(secondary_len + len <= sizeof(secondary),
+		     "Write past the end of the slot");
+	memcpy(&secondary[secondary_len], buf, len);
+	secondary_len += len;
+	return 0;
+}
+
+int dfu_target_mcuboot_done(bool successful)
+{
+	mcuboot_done_calls++;
+	mcuboot_done_successful = successful;
+	return 0;
+}
+
+static void setup(void)
+{
+	secondary_len = 0;
+	mcuboot_init_calls = 0;
+	mcuboot_done_calls = 0;
+	mcuboot_done_successful = false;
+	writes_until_error = -1;
+
+	memset(stream, 0, sizeof(stream));
+	stream_bits = 8 * HEADER_SIZE;
+	expected_len = 0;
+
+	zassert_equal(dfu_target_compressed_init(0, NULL), 0, NULL);
+}
+
+static void bits_put(u32_t value, u8_t count)
+{
+	zassert_true(stream_bits + count <= 8 * sizeof(stream),
+		     "Stream too long");
+
+	while (count--) {
+		if (value & BIT(count)) {
+			stream[stream_bits / 8] |= 0x80 >> (stream_bits % 8);
+		}
+		stream_bits++;
+	}
+}
+
+static void literal_put(u8_t byte)
+{
+	bits_put(1, 1);
+	bits_put(byte, 8);
+
+	expected[expected_len++] = byte;
+}
+
+/* Back-references are decoded byte by byte, so they may overlap the data
+ * they output.
+ */
+static void backref_put(u16_t distance, u16_t length)
+{
+	bits_put(0, 1);
+	bits_put(distance - 1, WINDOW_BITS);
+	bits_put(length - 1, LENGTH_BITS);
+
+	for (u16_t i = 0; i < length; i++) {
+		expected[expected_len] = expected[expected_len - distance];
+		expected_len++;
+	}
+}
+
+/* Write the header of the stream, and return its length in bytes */
+static size_t stream_finish(void)
+{
+	sys_put_le32(0x315a4c44, &stream[0]);
+	stream[4] = WINDOW_BITS;
+	stream[5] = LENGTH_BITS;
+	sys_put_le32(expected_len, &stream[8]);
+	sys_put_le32(crc32_ieee(expected, expected_len), &stream[12]);
+
+	return ceiling_fraction(stream_bits, 8);
+}
+
+/* Write data in fragments of the given size */
+static int data_write(const u8_t *data, size_t from, size_t to, size_t size)
+{
+	int err = 0;
+
+	while (from < to && err == 0) {
+		size_t len = MIN(size, to - from);
+
+		err = dfu_target_compressed_write(&data[from], len);
+		from += len;
+	}
+
+	return err;
+}
+
+static void image_check(const u8_t *image, size_t len)
+{
+	int err;
+
+	err = dfu_target_compressed_done(true);
+	zassert_equal(err, 0, "Image not accepted");
+	zassert_equal(mcuboot_done_calls, 1, NULL);
+	zassert_true(mcuboot_done_successful, "Upgrade not scheduled");
+	zassert_equal(secondary_len, len, NULL);
+	zassert_mem_equal(secondary, image, len, "Wrong image decompressed");
+}
+
+static void test_dfu_target_compressed_identify(void)
+{
+	zassert_true(dfu_target_compressed_identify(compressed), NULL);
+	zassert_false(dfu_target_compressed_identify(image), NULL);
+}
+
+static void test_dfu_target_compressed_image(void)
+{
+	int err;
+
+	zassert_true(sizeof(compressed) < sizeof(image) * 3 / 4,
+		     "Image not compressed");
+
+	/* Fragments are not aligned to the fields of the bit stream */
+	for (size_t size = 1; size < 32; size += 5) {
+		setup();
+
+		err = data_write(compressed, 0, sizeof(compressed), size);
+		zassert_equal(err, 0, "Image not decompressed");
+		zassert_equal(mcuboot_init_calls, 1, NULL);
+
+		image_check(image, sizeof(image));
+	}
+}
+
+static void test_dfu_target_compressed_window_wrap(void)
+{
+	int err;
+	size_t len;
+
+	setup();
+
+	/* Fill most of the window with data that does not repeat */
+	for (int i = 0; i < WINDOW_SIZE - 24; i++) {
+		literal_put(i * 7 + i / 256);
+	}
+
+	/* Back-references that end in the next window, start in the previous
+	 * one, and reach back the full window, to the slot being written.
+	 */
+	backref_put(WINDOW_SIZE - 24, BIT(LENGTH_BITS));
+	backref_put(WINDOW_SIZE - 24, BIT(LENGTH_BITS));
+	while (expected_len < 3 * WINDOW_SIZE) {
+		backref_put(WINDOW_SIZE, BIT(LENGTH_BITS) - 3);
+	}
+
+	/* A run, where the back-reference overlaps its own output */
+	literal_put(0xa5);
+	backref_put(1, BIT(LENGTH_BITS));
+
+	len = stream_finish();
+
+	err = data_write(stream, 0, len, 7);
+	zassert_equal(err, 0, NULL);
+
+	image_check(expected, expected_len);
+}
+
+static void test_dfu_target_compressed_write_error(void)
+{
+	int err;
+	size_t offset;
+	size_t last_offset = 0;
+
+	/* Fail each write of the image in turn, until it is complete */
+	for (int fail = 0; ; fail++) {
+		setup();
+		writes_until_error = fail;
+
+		err = data_write(compressed, 0, sizeof(compressed), 61);
+		if (err == 0) {
+			break;
+		}
+
+		zassert_equal(err, -EIO, NULL);
+
+		err = dfu_target_compressed_offset_get(&offset);
+		zassert_equal(err, 0, NULL);
+		zassert_true(offset >= last_offset, "Offset went back");
+		zassert_true(offset <= sizeof(compressed), NULL);
+		last_offset = offset;
+
+		/* Continue with the byte that failed, as after a retry. If all
+		 * of the image was decompressed, the rest of it is written to
+		 * flash when the download is done.
+		 */
+		writes_until_error = -1;
+		err = data_write(compressed, offset, sizeof(compressed), 61);
+		zassert_equal(err, 0, "Image not resumed at %d", offset);
+
+		image_check(image, sizeof(image));
+	}
+
+	zassert_true(last_offset > 0, "No error injected");
+}
+
+static void test_dfu_target_compressed_last_write_error(void)
+{
+	int err;
+
+	setup();
+
+	literal_put(0x01);
+	literal_put(0x02);
+	backref_put(2, 8);
+
+	/* The image is complete, but it was not all written to flash */
+	writes_until_error = 0;
+	err = data_write(stream, 0, stream_finish(), 64);
+	zassert_equal(err, -EIO, NULL);
+	zassert_equal(secondary_len, 0, NULL);
+
+	/* It is written when the download is done */
+	writes_until_error = -1;
+	image_check(expected, expected_len);
+}
+
+static void test_dfu_target_compressed_corrupt_distance(void)
+{
+	int err;
+
+	setup();
+
+	/* Back-reference before the start of the image */
+	literal_put(0x01);
+	literal_put(0x02);
+	literal_put(0x03);
+	bits_put(0, 1);
+	bits_put(4 - 1, WINDOW_BITS);
+	bits_put(2 - 1, LENGTH_BITS);
+	expected_len += 2;
+
+	err = data_write(stream, 0, stream_finish(), 64);
+	zassert_equal(err, -EINVAL, "Invalid distance accepted");
+
+	err = dfu_target_compressed_done(false);
+	zassert_equal(err, 0, NULL);
+	zassert_false(mcuboot_done_successful, "Upgrade scheduled");
+}
+
+static void test_dfu_target_compressed_corrupt_length(void)
+{
+	int err;
+
+	setup();
+
+	/* Back-reference past the end of the image */
+	literal_put(0x01);
+	literal_put(0x02);
+	backref_put(1, 8);
+	expected_len -= 2;
+
+	err = data_write(stream, 0, stream_finish(), 64);
+	zassert_equal(err, -EINVAL, "Invalid length accepted");
+
+	err = dfu_target_compressed_done(false);
+	zassert_equal(err, 0, NULL);
+	zassert_false(mcuboot_done_successful, "Upgrade scheduled");
+}
+
+static void test_dfu_target_compressed_window_too_large(void)
+{
+	int err;
+
+	setup();
+
+	err = data_write(compressed_w12, 0, sizeof(compressed_w12), 64);
+	zassert_equal(err, -ENOTSUP, "Too large window accepted");
+	zassert_equal(mcuboot_init_calls, 0, NULL);
+	zassert_equal(secondary_len, 0, "Secondary slot written");
+
+	err = dfu_target_compressed_done(false);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(mcuboot_done_calls, 0, NULL);
+}
+
+static void test_dfu_target_compressed_checksum_mismatch(void)
+{
+	int err;
+	static u8_t corrupt[sizeof(compressed)];
+
+	setup();
+
+	/* Flip a bit of the checksum in the header */
+	memcpy(corrupt, compressed, sizeof(compressed));
+	corrupt[12] ^= 0x01;
+
+	err = data_write(corrupt, 0, sizeof(corrupt), 64);
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_compressed_done(true);
+	zassert_equal(err, -EINVAL, "Checksum mismatch not detected");
+	zassert_equal(mcuboot_done_calls, 1, NULL);
+	zassert_false(mcuboot_done_successful, "Upgrade scheduled");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(dfu_target_compressed_test,
+		ztest_unit_test(test_dfu_target_compressed_identify),
+		ztest_unit_test(test_dfu_target_compressed_image),
+		ztest_unit_test(test_dfu_target_compressed_window_wrap),
+		ztest_unit_test(test_dfu_target_compressed_write_error),
+		ztest_unit_test(test_dfu_target_compressed_last_write_error),
+		ztest_unit_test(test_dfu_target_compressed_corrupt_distance),
+		ztest_unit_test(test_dfu_target_compressed_corrupt_length),
+		ztest_unit_test(test_dfu_target_compressed_window_too_large),
+		ztest_unit_test(test_dfu_target_compressed_checksum_mismatch)
+		);
+
+	ztest_run_test_suite(dfu_target_compressed_test);
+}
@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+
+"""Create two related images for the delta DFU target test.
+
+The new image has code inserted and removed, and the addresses following
+the changes are shifted, like in a firmware update.
+"""
+
+import os
+import random
+import struct
+import sys
+
+IMAGE_SIZE = 32 * 1024
+BASE_ADDRESS = 0x8000
+
+
+def image(code):
+    return b"".join(struct.pack("<I" if is_addr else "<H", value)
+                    for is_addr, value in code)
+
+
+def instructions(rand, count):
+    """Return random 16-bit instructions and 32-bit addresses."""
+    return [(True, BASE_ADDRESS + rand.randrange(IMAGE_SIZE))
+            if rand.random() < 0.05 else (False, rand.getrandbits(16))
+            for _ in range(count)]
+
+
+def main():
+    out_dir = sys.argv[1]
+    os.makedirs(out_dir, exist_ok=True)
+
+    rand = random.Random(0)
+    old = instructions(rand, IMAGE_SIZE // 2)
+
+    new = list(old)
+    new[1000:1000] = instructions(rand, 100)
+    del new[3000:3020]
+    new[5000] = (False, 0xbeef)
+    new += instructions(rand, 50)
+
+    # Addresses pointing past the insertion move
+    inserted_at = BASE_ADDRESS + len(image(old[:1000]))
+    inserted_len = len(image(new[1000:1100]))
+    new = [(is_addr, value + inserted_len)
+           if is_addr and value >= inserted_at else (is_addr, value)
+           for is_addr, value in new]
+
+    for name, code in (("old", old), ("new", new)):
+        with open(os.path.join(out_dir, name + ".bin"), "wb") as f:
+            f.write(image(code))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <storage/flash_map.h>
+#include <dfu/dfu_target.h>
+#include <dfu_target_mcuboot.h>
+#include <dfu_target_delta.h>
+
+/* Images and the patch between them, created by the host tool */
+static const u8_t old_image[] = {
+#include "delta_old.inc"
+};
+
+static const u8_t new_image[] = {
+#include "delta_new.inc"
+};
+
+static const u8_t patch[] = {
+#include "delta_patch.inc"
+};
+
+/* Mocked MCUboot primary slot, holding the running image */
+static u8_t primary[sizeof(old_image) + 1024];
+static struct flash_area primary_fa = {
+	.fa_size = sizeof(primary),
+};
+
+/* Image written to the secondary slot through the MCUboot DFU target */
+static u8_t secondary[sizeof(new_image)];
+static size_t secondary_len;
+static bool secondary_overflow;
+static int mcuboot_done_calls;
+static bool mcuboot_done_successful;
+/* Number of writes to the secondary slot before one fails, or -1 */
+static int writes_until_error;
+
+int flash_area_open(u8_t id, const struct flash_area **fa)
+{
+	*fa = &primary_fa;
+	return 0;
+}
+
+void flash_area_close(const struct flash_area *fa)
+{
+}
+
+int flash_area_read(const struct flash_area *fa, off_t off, void *dst,
+		    size_t len)
+{
+	zassert_true(off + len <= sizeof(primary), "Read outside the slot");
+	memcpy(dst, &primary[off], len);
+	return 0;
+}
+
+int dfu_target_mcuboot_init(size_t file_size, dfu_target_callback_t cb)
+{
+	secondary_len = 0;
+	secondary_overflow = false;
+	return 0;
+}
+
+int dfu_target_mcuboot_offset_get(size_t *offset)
+{
+	*offset = secondary_len;
+	return 0;
+}
+
+int dfu_target_mcuboot_write(const void *const buf, size_t len)
+{
+	if (writes_until_error == 0) {
+		return -EIO;
+	} else if (writes_until_error > 0) {
+		writes_until_error--;
+	}
+
+	if (secondary_len + len > sizeof(secondary)) {
+		secondary_overflow = true;
+		return -EFBIG;
+	}
+
+	memcpy(&secondary[secondary_len], buf, len);
+	secondary_len += len;
+	return 0;
+}
+
+int dfu_target_mcuboot_done(bool successful)
+{
+	mcuboot_done_calls++;
+	mcuboot_done_successful = successful;
+	return 0;
+}
+
+static void setup(void)
+{
+	memset(primary, 0xff, sizeof(primary));
+	memcpy(primary, old_image, sizeof(old_image));
+	secondary_len = 0;
+	secondary_overflow = false;
+	mcuboot_done_calls = 0;
+	mcuboot_done_successful = false;
+	writes_until_error = -1;
+
+	zassert_equal(dfu_target_delta_init(sizeof(patch), NULL), 0, NULL);
+}
+
+/* Write the patch in fragments of varying size */
+static int patch_write(size_t from, size_t to)
+{
+	static const size_t sizes[] = { 1, 15, 2, 512, 100, 1024, 3 };
+	int err = 0;
+
+	for (int i = 0; from < to && err == 0; i++) {
+		size_t len = MIN(sizes[i % ARRAY_SIZE(sizes)], to - from);
+
+		err = dfu_target_delta_write(&patch[from], len);
+		from += len;
+	}
+
+	return err;
+}
+
+static void test_dfu_target_delta_identify(void)
+{
+	zassert_true(dfu_target_delta_identify(patch), NULL);
+	zassert_false(dfu_target_delta_identify(new_image), NULL);
+}
+
+static void test_dfu_target_delta_round_trip(void)
+{
+	int err;
+
+	setup();
+
+	err = patch_write(0, sizeof(patch));
+	zassert_equal(err, 0, "Patch not applied");
+
+	err = dfu_target_delta_done(true);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(mcuboot_done_calls, 1, NULL);
+	zassert_true(mcuboot_done_successful, "Upgrade not scheduled");
+
+	zassert_equal(secondary_len, sizeof(new_image), NULL);
+	zassert_mem_equal(secondary, new_image, sizeof(new_image),
+			  "Wrong image reconstructed");
+	zassert_true(sizeof(patch) < sizeof(new_image) / 2,
+		     "Patch larger than expected");
+}
+
+static void test_dfu_target_delta_resume(void)
+{
+	int err;
+	size_t offset;
+
+	setup();
+
+	err = patch_write(0, sizeof(patch) / 2);
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_delta_offset_get(&offset);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(offset, sizeof(patch) / 2, NULL);
+
+	/* Continue from the offset, as after a reconnect */
+	err = patch_write(offset, sizeof(patch));
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_delta_done(true);
+	zassert_equal(err, 0, NULL);
+	zassert_mem_equal(secondary, new_image, sizeof(new_image), NULL);
+}
+
+static void test_dfu_target_delta_write_error(void)
+{
+	int err;
+	size_t offset;
+	size_t last_offset = 0;
+
+	/* Fail at different points of the patch, until it is complete */
+	for (int fail = 0; ; fail += 13) {
+		setup();
+		writes_until_error = fail;
+
+		err = patch_write(0, sizeof(patch));
+		if (err == 0) {
+			break;
+		}
+
+		zassert_equal(err, -EIO, NULL);
+
+		err = dfu_target_delta_offset_get(&offset);
+		zassert_equal(err, 0, NULL);
+		zassert_true(offset >= last_offset, "Offset went back");
+		zassert_true(offset < sizeof(patch), NULL);
+		last_offset = offset;
+
+		/* Continue with the byte that failed, as after a retry */
+		writes_until_error = -1;
+		err = patch_write(offset, sizeof(patch));
+		zassert_equal(err, 0, "Patch not resumed at %d", offset);
+
+		err = dfu_target_delta_done(true);
+		zassert_equal(err, 0, NULL);
+		zassert_equal(secondary_len, sizeof(new_image), NULL);
+		zassert_mem_equal(secondary, new_image, sizeof(new_image),
+				  "Wrong image after resuming at %d", offset);
+	}
+
+	zassert_true(last_offset > 0, "No error injected");
+}
+
+static void test_dfu_target_delta_wrong_base(void)
+{
+	int err;
+
+	setup();
+
+	/* Running image differs from the one the patch was created for */
+	primary[sizeof(old_image) / 2] ^= 0x01;
+
+	err = patch_write(0, sizeof(patch));
+	zassert_equal(err, -EINVAL, "Patch applied to the wrong image");
+	zassert_equal(secondary_len, 0, "Secondary slot written");
+
+	err = dfu_target_delta_done(false);
+	zassert_equal(err, 0, NULL);
+}
+
+static void test_dfu_target_delta_truncated(void)
+{
+	int err;
+
+	setup();
+
+	err = patch_write(0, sizeof(patch) - 1);
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_delta_done(true);
+	zassert_equal(err, -EINVAL, "Incomplete patch accepted");
+	zassert_equal(mcuboot_done_calls, 1, NULL);
+	zassert_false(mcuboot_done_successful, "Upgrade scheduled");
+}
+
+static void test_dfu_target_delta_trailing_data(void)
+{
+	int err;
+	u8_t trailing[2];
+
+	setup();
+
+	err = patch_write(0, sizeof(patch));
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_delta_write(trailing, sizeof(trailing));
+	zassert_equal(err, -EINVAL, "Data after the patch accepted");
+	zassert_false(secondary_overflow, NULL);
+
+	err = dfu_target_delta_done(false);
+	zassert_equal(err, 0, NULL);
+}
+
+static void test_dfu_target_delta_corrupt(void)
+{
+	int err;
+	static u8_t corrupt[sizeof(patch)];
+
+	setup();
+
+	/* An oversized length right after the header */
+	memcpy(corrupt, patch, sizeof(patch));
+	memset(&corrupt[16], 0xff, 4);
+	corrupt[20] = 0x0f;
+
+	err = dfu_target_delta_write(corrupt, sizeof(corrupt));
+	zassert_equal(err, -EINVAL, "Corrupt patch accepted");
+	zassert_false(secondary_overflow, NULL);
+
+	err = dfu_target_delta_done(false);
+	zassert_equal(err, 0, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(dfu_target_delta_test,
+			 ztest_unit_test(test_dfu_target_delta_identify),
+			 ztest_unit_test(test_dfu_target_delta_round_trip),
+			 ztest_unit_test(test_dfu_target_delta_resume),
+			 ztest_unit_test(test_dfu_target_delta_write_error),
+			 ztest_unit_test(test_dfu_target_delta_wrong_base),
+			 ztest_unit_test(test_dfu_target_delta_truncated),
+			 ztest_unit_test(test_dfu_target_delta_trailing_data),
+			 ztest_unit_test(test_dfu_target_delta_corrupt)
+			 );
+
+	ztest_run_test_suite(dfu_target_delta_test);
+}
@@ -7,7 +7,136 @@
 #include <zephyr/types.h>
 #include <stdbool.h>
 #include <ztest.h>
+#include <dfu/dfu_target.h>
+#include <dfu/mcuboot.h>
+#include <dfu/flash_img.h>
+#include <settings/settings.h>
 #include <dfu_target_mcuboot.h>
+#include <pm_config.h>
+
+#define FLASH_PAGE_SIZE 0x1000
+#define PROGRESS_KEY "dfu/mcuboot/progress"
+
+/* Number of bytes that have been programmed to the mocked flash, that is the
+ * data that would survive a power failure.
+ */
+static size_t flash_bytes;
+static u8_t settings_blob[64];
+static size_t settings_blob_len;
+static int settings_saves;
+static struct settings_handler *settings_handler;
+
+int flash_img_init(struct flash_img_context *ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->off_last = -1;
+	return 0;
+}
+
+static void flash_program(struct flash_img_context *ctx)
+{
+	ctx->bytes_written += ctx->buf_bytes;
+	ctx->buf_bytes = 0;
+	ctx->off_last = (ctx->bytes_written - 1) & ~(FLASH_PAGE_SIZE - 1);
+	flash_bytes = ctx->bytes_written;
+}
+
+int flash_img_buffered_write(struct flash_img_context *ctx, u8_t *data,
+			     size_t len, bool flush)
+{
+	while (len > 0) {
+		size_t chunk = MIN(len, CONFIG_IMG_BLOCK_BUF_SIZE -
+				   ctx->buf_bytes);
+
+		memcpy(ctx->buf + ctx->buf_bytes, data, chunk);
+		ctx->buf_bytes += chunk;
+		data += chunk;
+		len -= chunk;
+
+		if (ctx->buf_bytes == CONFIG_IMG_BLOCK_BUF_SIZE) {
+			flash_program(ctx);
+		}
+	}
+
+	if (flush && ctx->buf_bytes > 0) {
+		flash_program(ctx);
+	}
+
+	return 0;
+}
+
+size_t flash_img_bytes_written(struct flash_img_context *ctx)
+{
+	return ctx->bytes_written;
+}
+
+int boot_request_upgrade(int permanent)
+{
+	return 0;
+}
+
+int settings_subsys_init(void)
+{
+	return 0;
+}
+
+int settings_register(struct settings_handler *cf)
+{
+	settings_handler = cf;
+	return 0;
+}
+
+int settings_save_one(const char *name, const void *value, size_t val_len)
+{
+	zassert_true(strcmp(name, PROGRESS_KEY) == 0, "Unexpected key");
+	zassert_true(val_len <= sizeof(settings_blob), NULL);
+
+	memcpy(settings_blob, value, val_len);
+	settings_blob_len = val_len;
+	settings_saves++;
+
+	return 0;
+}
+
+static ssize_t settings_blob_read(void *cb_arg, void *data, size_t len)
+{
+	len = MIN(len, settings_blob_len);
+	memcpy(data, settings_blob, len);
+	return len;
+}
+
+int settings_load(void)
+{
+	if (settings_blob_len == 0) {
+		return 0;
+	}
+
+	/* Strip the "dfu/" prefix, as the settings subsystem does */
+	return settings_handler->h_set(PROGRESS_KEY + 4, settings_blob_len,
+				       settings_blob_read, NULL);
+}
+
+/* Offset a download would resume from after a power failure right now */
+static size_t offset_after_power_failure(void)
+{
+	int err;
+	size_t offset;
+
+	err = dfu_target_mcuboot_init(PM_MCUBOOT_SECONDARY_SIZE, NULL);
+	zassert_equal(err, 0, NULL);
+
+	err = dfu_target_mcuboot_offset_get(&offset);
+	zassert_equal(err, 0, NULL);
+
+	return offset;
+}
+
+static void progress_reset(void)
+{
+	flash_bytes = 0;
+	settings_blob_len = 0;
+	settings_saves = 0;
+}
 
 /* Create buffer which we will fill with strings to test with.
  * This is needed since 'dfu_ctx_Mcuboot_set_b1_file` will modify its
@@ -88,6 +217,89 @@ static void test_dfu_ctx_mcuboot_set_b1_file__empty(void)
 	zassert_true(update == NULL, "update should not be set");
 }
 
+static u8_t fragment[3000];
+static const size_t fragment_sizes[] = { 1, 512, 3000, 1024, 2048, 7, 1400 };
+
+static void test_dfu_target_mcuboot_progress_coalesced(void)
+{
+	int err;
+	int writes = 0;
+	size_t total = 0;
+
+	progress_reset();
+
+	err = dfu_target_mcuboot_init(PM_MCUBOOT_SECONDARY_SIZE, NULL);
+	zassert_equal(err, 0, NULL);
+
+	while (total < 0x20000) {
+		size_t len;
+
+		len = fragment_sizes[writes % ARRAY_SIZE(fragment_sizes)];
+
+		err = dfu_target_mcuboot_write(fragment, len);
+		zassert_equal(err, 0, NULL);
+		total += len;
+		writes++;
+	}
+
+	zassert_true(settings_saves > 0, "Progress was never stored");
+	zassert_true(settings_saves <= total /
+		     CONFIG_DFU_TARGET_MCUBOOT_SAVE_PROGRESS_INTERVAL,
+		     "Progress stored more often than configured");
+	zassert_true(settings_saves < writes, "Progress saves not coalesced");
+
+	err = dfu_target_mcuboot_done(false);
+	zassert_equal(err, 0, NULL);
+}
+
+/* Enough writes to fill the flash_img buffer at least once */
+#define POWER_FAILURE_WRITES 8
+
+static void test_dfu_target_mcuboot_progress_power_failure(void)
+{
+	int err;
+	size_t offset;
+	size_t total = 0;
+	size_t resumed = 0;
+
+	progress_reset();
+
+	err = dfu_target_mcuboot_init(PM_MCUBOOT_SECONDARY_SIZE, NULL);
+	zassert_equal(err, 0, NULL);
+
+	for (int i = 1; total < 0x10000; i++) {
+		size_t len = fragment_sizes[i % ARRAY_SIZE(fragment_sizes)];
+
+		err = dfu_target_mcuboot_write(fragment, len);
+		zassert_equal(err, 0, NULL);
+		total += len;
+
+		if (i % POWER_FAILURE_WRITES != 0) {
+			continue;
+		}
+
+		/* The resume offset must never point past what has been
+		 * programmed to flash.
+		 */
+		offset = offset_after_power_failure();
+		zassert_true(offset <= flash_bytes,
+			     "Resume offset past flash contents");
+		zassert_true(offset > resumed, "No progress stored");
+		resumed = offset;
+
+		/* Continue downloading from the restored offset */
+		total = offset;
+	}
+
+	zassert_true(resumed > 0, "Progress was never restored");
+
+	err = dfu_target_mcuboot_done(true);
+	zassert_equal(err, 0, NULL);
+
+	offset = offset_after_power_failure();
+	zassert_equal(offset, 0, "Progress not reset when done");
+}
+
 void test_main(void)
 {
 	ztest_test_suite(lib_dfu_target_mcuboot_test,
@@ -95,7 +307,9 @@ void test_main(void)
 	     ztest_unit_test(test_dfu_ctx_mcuboot_set_b1_file__null),
 	     ztest_unit_test(test_dfu_ctx_mcuboot_set_b1_file__not_terminated),
 	     ztest_unit_test(test_dfu_ctx_mcuboot_set_b1_file__empty),
-	     ztest_unit_test(test_dfu_ctx_mcuboot_set_b1_file)
+	     ztest_unit_test(test_dfu_ctx_mcuboot_set_b1_file),
+	     ztest_unit_test(test_dfu_target_mcuboot_progress_coalesced),
+	     ztest_unit_test(test_dfu_target_mcuboot_progress_power_failure)
 	 );
 
 	ztest_run_test_suite(lib_dfu_target_mcuboot_test);
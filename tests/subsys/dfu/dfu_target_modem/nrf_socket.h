@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* Modem DFU socket API, implemented by the test instead of the modem */
+#ifndef NRF_SOCKET_H__
+#define NRF_SOCKET_H__
+
+#include <zephyr/types.h>
+#include <net/socket.h>
+
+#ifndef AF_LOCAL
+#define AF_LOCAL 1
+#endif
+
+#define NPROTO_DFU 666
+#define SOL_DFU 515
+
+#define SO_DFU_FW_VERSION 1
+#define SO_DFU_RESOURCES 2
+#define SO_DFU_APPLY 4
+#define SO_DFU_BACKUP_DELETE 6
+#define SO_DFU_OFFSET 7
+#define SO_DFU_ERROR 20
+
+#define DFU_INVALID_UUID -4
+#define DFU_INVALID_FILE_OFFSET -8
+#define DFU_AREA_NOT_BLANK -17
+#define DFU_ERASE_PENDING -19
+
+int nrf_socket(int family, int type, int protocol);
+int nrf_close(int fd);
+ssize_t nrf_send(int fd, const void *buf, size_t len, int flags);
+int nrf_getsockopt(int fd, int level, int optname, void *optval,
+		   socklen_t *optlen);
+int nrf_setsockopt(int fd, int level, int optname, const void *optval,
+		   socklen_t optlen);
+
+#define socket nrf_socket
+#define close nrf_close
+#define send nrf_send
+#define getsockopt nrf_getsockopt
+#define setsockopt nrf_setsockopt
+
+#endif /* NRF_SOCKET_H__ */
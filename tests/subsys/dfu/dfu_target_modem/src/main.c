@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <errno.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <dfu/dfu_target.h>
+#include <dfu_target_modem.h>
+#include <nrf_socket.h>
+
+#define DIRTY_IMAGE 0x280000
+#define MODEM_FD 3
+/* Most bytes the modem accepts with one send */
+#define SEND_MAX 700
+
+static u8_t image[3000];
+static u8_t modem_image[sizeof(image)];
+
+/* State of the modem */
+static bool socket_open;
+static int modem_offset;
+static int modem_error;
+static bool erase_in_progress;
+/* Number of times the modem reports an erase as pending */
+static int erase_polls;
+static int erase_polls_left;
+static int backup_delete_calls;
+static bool applied;
+/* The area must be erased before data is accepted */
+static bool area_dirty;
+/* Error of the next sends, or 0 */
+static int send_error;
+static bool sent_while_erasing;
+static int erase_done_evts;
+
+int nrf_socket(int family, int type, int protocol)
+{
+	zassert_false(socket_open, "Socket opened twice");
+	zassert_equal(protocol, NPROTO_DFU, NULL);
+	socket_open = true;
+	return MODEM_FD;
+}
+
+int nrf_close(int fd)
+{
+	zassert_equal(fd, MODEM_FD, NULL);
+	socket_open = false;
+	return 0;
+}
+
+static int modem_fail(int err)
+{
+	modem_error = err;
+	errno = ENOEXEC;
+	return -1;
+}
+
+ssize_t nrf_send(int fd, const void *buf, size_t len, int flags)
+{
+	if (erase_in_progress) {
+		sent_while_erasing = true;
+		return modem_fail(DFU_ERASE_PENDING);
+	}
+
+	if (send_error != 0) {
+		return modem_fail(send_error);
+	}
+
+	if (area_dirty) {
+		return modem_fail(DFU_AREA_NOT_BLANK);
+	}
+
+	len = MIN(len, SEND_MAX);
+	zassert_true(modem_offset + len <= sizeof(modem_image), NULL);
+	memcpy(&modem_image[modem_offset], buf, len);
+	modem_offset += len;
+
+	return len;
+}
+
+int nrf_getsockopt(int fd, int level, int optname, void *optval,
+		   socklen_t *optlen)
+{
+	zassert_equal(fd, MODEM_FD, NULL);
+	zassert_equal(level, SOL_DFU, NULL);
+
+	switch (optname) {
+	case SO_DFU_FW_VERSION:
+		memset(optval, '1', *optlen);
+		return 0;
+	case SO_DFU_RESOURCES:
+		*(size_t *)optval = sizeof(modem_image);
+		return 0;
+	case SO_DFU_ERROR:
+		*(int *)optval = modem_error;
+		return 0;
+	case SO_DFU_OFFSET:
+		if (erase_in_progress && erase_polls_left > 0) {
+			erase_polls_left--;
+			return modem_fail(DFU_ERASE_PENDING);
+		}
+
+		erase_in_progress = false;
+		*(int *)optval = modem_offset;
+		return 0;
+	default:
+		zassert_unreachable("Unexpected option %d", optname);
+		return -1;
+	}
+}
+
+int nrf_setsockopt(int fd, int level, int optname, const void *optval,
+		   socklen_t optlen)
+{
+	zassert_equal(fd, MODEM_FD, NULL);
+	zassert_equal(level, SOL_DFU, NULL);
+
+	switch (optname) {
+	case SO_DFU_BACKUP_DELETE:
+		backup_delete_calls++;
+		erase_in_progress = true;
+		erase_polls_left = erase_polls;
+		modem_offset = 0;
+		area_dirty = false;
+		return 0;
+	case SO_DFU_OFFSET:
+		modem_offset = *(const int *)optval;
+		return 0;
+	case SO_DFU_APPLY:
+		applied = true;
+		return 0;
+	default:
+		zassert_unreachable("Unexpected option %d", optname);
+		return -1;
+	}
+}
+
+static void dfu_target_callback(enum dfu_target_evt_id evt)
+{
+	if (evt == DFU_TARGET_EVT_ERASE_DONE) {
+		erase_done_evts++;
+	}
+}
+
+static void setup(void)
+{
+	for (int i = 0; i < sizeof(image); i++) {
+		image[i] = i * 31 + i / 256;
+	}
+
+	memset(modem_image, 0, sizeof(modem_image));
+	socket_open = false;
+	modem_offset = 0;
+	modem_error = 0;
+	erase_in_progress = false;
+	erase_polls = 2;
+	erase_polls_left = 0;
+	backup_delete_calls = 0;
+	applied = false;
+	area_dirty = false;
+	send_error = 0;
+	sent_while_erasing = false;
+	erase_done_evts = 0;
+}
+
+/* Write data in fragments of the given size */
+static int data_write(size_t from, size_t to, size_t size)
+{
+	int err = 0;
+
+	while (from < to && err == 0) {
+		size_t len = MIN(size, to - from);
+
+		err = dfu_target_modem_write(&image[from], len);
+		from += len;
+	}
+
+	return err;
+}
+
+static void image_check(void)
+{
+	size_t offset;
+
+	zassert_equal(dfu_target_modem_done(true), 0, NULL);
+	zassert_true(applied, "Upgrade not scheduled");
+	zassert_false(socket_open, "Socket not closed");
+	zassert_false(sent_while_erasing, "Data sent while erasing");
+
+	zassert_equal(dfu_target_modem_offset_get(&offset), 0, NULL);
+	zassert_equal(offset, sizeof(image), NULL);
+	zassert_equal(modem_offset, sizeof(image), NULL);
+	zassert_mem_equal(modem_image, image, sizeof(image), "Wrong image");
+}
+
+static void test_dfu_target_modem_write(void)
+{
+	int err;
+
+	setup();
+
+	zassert_equal(dfu_target_modem_init(sizeof(image), NULL), 0, NULL);
+
+	/* The data does not fit in the queue, so writes wait for it to be
+	 * sent, in the order it was written.
+	 */
+	err = data_write(0, sizeof(image), 100);
+	zassert_equal(err, 0, NULL);
+
+	image_check();
+	zassert_equal(backup_delete_calls, 0, "Erased a blank area");
+}
+
+static void test_dfu_target_modem_resume(void)
+{
+	int err;
+
+	setup();
+
+	/* The modem has stored part of the image before */
+	memcpy(modem_image, image, 1000);
+	modem_offset = 1000;
+
+	zassert_equal(dfu_target_modem_init(sizeof(image), NULL), 0, NULL);
+
+	err = data_write(1000, sizeof(image), 256);
+	zassert_equal(err, 0, NULL);
+
+	image_check();
+}
+
+static void test_dfu_target_modem_erase(void)
+{
+	int err;
+
+	setup();
+	modem_offset = DIRTY_IMAGE;
+
+	err = dfu_target_modem_init(0, dfu_target_callback);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(backup_delete_calls, 1, "Erase not started by init");
+
+	/* Initializing again once the size of the file is known keeps the
+	 * erase going.
+	 */
+	err = dfu_target_modem_init(sizeof(image), dfu_target_callback);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(backup_delete_calls, 1, NULL);
+
+	/* Data is queued behind the erase */
+	err = data_write(0, sizeof(image), 512);
+	zassert_equal(err, 0, NULL);
+
+	image_check();
+	zassert_equal(erase_done_evts, 1, NULL);
+	zassert_equal(backup_delete_calls, 1, NULL);
+}
+
+static void test_dfu_target_modem_area_not_blank(void)
+{
+	int err;
+
+	setup();
+	area_dirty = true;
+
+	zassert_equal(dfu_target_modem_init(sizeof(image), NULL), 0, NULL);
+
+	/* The area is erased when the modem rejects the data, and the data
+	 * is sent again.
+	 */
+	err = data_write(0, sizeof(image), 300);
+	zassert_equal(err, 0, NULL);
+
+	image_check();
+	zassert_equal(backup_delete_calls, 1, NULL);
+}
+
+static void test_dfu_target_modem_send_error(void)
+{
+	int err;
+
+	setup();
+	send_error = DFU_INVALID_UUID;
+
+	zassert_equal(dfu_target_modem_init(sizeof(image), NULL), 0, NULL);
+
+	/* The error is reported by a later write, once the data that failed
+	 * has been sent.
+	 */
+	err = data_write(0, sizeof(image), 100);
+	zassert_equal(err, -EINVAL, "Send error not reported");
+
+	err = dfu_target_modem_done(true);
+	zassert_equal(err, -EINVAL, "Send error not reported");
+	zassert_false(applied, "Upgrade scheduled");
+	zassert_false(socket_open, "Socket not closed");
+}
+
+static void test_dfu_target_modem_done_while_erasing(void)
+{
+	int err;
+	s64_t start;
+
+	setup();
+	modem_offset = DIRTY_IMAGE;
+	erase_polls = 1000;
+
+	zassert_equal(dfu_target_modem_init(sizeof(image), NULL), 0, NULL);
+
+	err = data_write(0, 512, 100);
+	zassert_equal(err, 0, NULL);
+
+	/* The modem completes the erase on its own, without waiting */
+	start = k_uptime_get();
+	err = dfu_target_modem_done(false);
+	zassert_equal(err, 0, NULL);
+	zassert_true(k_uptime_get() - start < K_SECONDS(2), "Waited for erase");
+	zassert_false(applied, "Upgrade scheduled");
+	zassert_false(socket_open, "Socket not closed");
+	zassert_false(sent_while_erasing, "Data sent while erasing");
+	zassert_equal(modem_offset, 0, "Queued data sent");
+
+	/* The target can be initialized again */
+	erase_in_progress = false;
+	zassert_equal(dfu_target_modem_init(sizeof(image), NULL), 0, NULL);
+	err = data_write(0, sizeof(image), 100);
+	zassert_equal(err, 0, NULL);
+
+	image_check();
+}
+
+void test_main(void)
+{
+	ztest_test_suite(dfu_target_modem_test,
+		ztest_unit_test(test_dfu_target_modem_write),
+		ztest_unit_test(test_dfu_target_modem_resume),
+		ztest_unit_test(test_dfu_target_modem_erase),
+		ztest_unit_test(test_dfu_target_modem_area_not_blank),
+		ztest_unit_test(test_dfu_target_modem_send_error),
+		ztest_unit_test(test_dfu_target_modem_done_while_erasing)
+		);
+
+	ztest_run_test_suite(dfu_target_modem_test);
+}
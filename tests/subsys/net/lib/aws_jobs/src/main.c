@@ -9,10 +9,23 @@
 #include <ztest.h>
 #include <aws_jobs.h>
 #include <net/mqtt.h>
+#include <net/mqtt_outbox.h>
+
+/* Message IDs of the last requests */
+static u16_t subscribe_id;
+static u16_t publish_id;
 
 int mqtt_subscribe(struct mqtt_client *client,
 		   const struct mqtt_subscription_list *param)
 {
+	subscribe_id = param->message_id;
+	return 0;
+}
+
+int mqtt_publish(struct mqtt_client *client,
+		 const struct mqtt_publish_param *param)
+{
+	publish_id = param->message_id;
 	return 0;
 }
 
@@ -108,6 +121,66 @@ static void test_aws_jobs_subscribe_topic_get(void)
 	zassert_true(strcmp(expected, topic_buf) == 0, "Should be equal");
 }
 
+static void test_aws_jobs_suback_topic_get(void)
+{
+	char *client_id = "client_id_123";
+	struct mqtt_client client = {.client_id.utf8 = client_id};
+	char topic_buf[AWS_JOBS_TOPIC_MAX_LEN];
+
+	/* Without an outbox, the topic is the message ID */
+	zassert_equal(aws_jobs_subscribe_topic_notify_next(&client, topic_buf),
+		      0, NULL);
+	zassert_equal(subscribe_id, SUBSCRIBE_NOTIFY_NEXT, NULL);
+	zassert_equal(aws_jobs_suback_topic_get(SUBSCRIBE_NOTIFY_NEXT),
+		      SUBSCRIBE_NOTIFY_NEXT, NULL);
+	zassert_equal(aws_jobs_suback_topic_get(1234), -ENOENT, NULL);
+}
+
+static void test_aws_jobs_outbox(void)
+{
+	char *client_id = "client_id_123";
+	struct mqtt_client client = {.client_id.utf8 = client_id};
+	char topic_buf[AWS_JOBS_TOPIC_MAX_LEN];
+	struct mqtt_outbox outbox;
+	struct mqtt_publish_message message = {
+		.topic.qos = MQTT_QOS_1_AT_LEAST_ONCE,
+		.topic.topic.utf8 = "data",
+		.topic.topic.size = 4,
+	};
+	u16_t in_flight[2];
+
+	zassert_equal(mqtt_outbox_init(&outbox, &client, NULL), 0, NULL);
+	aws_jobs_outbox_set(&outbox);
+
+	/* Messages that wait for their acknowledgment */
+	for (size_t i = 0; i < ARRAY_SIZE(in_flight); i++) {
+		zassert_true(mqtt_outbox_publish(&outbox, &message, 0) > 0,
+			     NULL);
+		in_flight[i] = publish_id;
+	}
+
+	zassert_equal(aws_jobs_subscribe_topic_update(&client, "job_id",
+						      topic_buf), 0, NULL);
+	zassert_equal(aws_jobs_update_job_execution(&client, "job_id",
+						    AWS_JOBS_IN_PROGRESS, "{}",
+						    1, "", topic_buf), 0, NULL);
+
+	for (size_t i = 0; i < ARRAY_SIZE(in_flight); i++) {
+		zassert_not_equal(subscribe_id, in_flight[i],
+				  "Subscribe ID in flight");
+		zassert_not_equal(publish_id, in_flight[i],
+				  "Update ID in flight");
+	}
+
+	zassert_not_equal(subscribe_id, publish_id, NULL);
+	zassert_equal(aws_jobs_suback_topic_get(subscribe_id),
+		      SUBSCRIBE_JOB_ID_UPDATE, NULL);
+	zassert_equal(aws_jobs_suback_topic_get(in_flight[0]), -ENOENT, NULL);
+
+	aws_jobs_outbox_set(NULL);
+	mqtt_outbox_clear(&outbox);
+}
+
 void test_main(void)
 {
 	ztest_test_suite(aws_jobs_test,
@@ -116,7 +189,9 @@ void test_main(void)
 			 ztest_unit_test(test_aws_jobs_cmp__no_suffix),
 			 ztest_unit_test(test_aws_jobs_cmp__suffix),
 			 ztest_unit_test(test_aws_jobs_subscribe_topic_update),
-			 ztest_unit_test(test_aws_jobs_subscribe_topic_get)
+			 ztest_unit_test(test_aws_jobs_subscribe_topic_get),
+			 ztest_unit_test(test_aws_jobs_suback_topic_get),
+			 ztest_unit_test(test_aws_jobs_outbox)
 			 );
 	ztest_run_test_suite(aws_jobs_test);
 }
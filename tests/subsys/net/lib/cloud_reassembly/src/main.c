@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <net/cloud.h>
+
+#define BUF_SIZE 64
+
+static const char msg[] = "{\"appId\":\"CMD\",\"data\":\"AT+CFUN?\"}";
+static const char other_msg[] = "{\"appId\":\"TEMP\",\"data\":\"23.5\"}";
+
+/* The buffer is followed by a guard that must not be written */
+static char buf[BUF_SIZE + 4];
+static struct cloud_msg_reassembly reassembly;
+
+static void setup(void)
+{
+	memset(buf, 0xaa, sizeof(buf));
+	reassembly = (struct cloud_msg_reassembly){
+		.buf = buf,
+		.size = BUF_SIZE
+	};
+}
+
+/* Add the fragment of a message at the given offset and length, as a
+ * backend with a receive buffer of that length notifies it.
+ */
+static int fragment_add(const char *data, size_t total_len, size_t offset,
+			size_t len)
+{
+	const struct cloud_msg_fragment fragment = {
+		.buf = (char *)&data[offset],
+		.len = len,
+		.offset = offset,
+		.total_len = total_len
+	};
+
+	return cloud_msg_reassemble(&reassembly, &fragment);
+}
+
+/* Add all fragments of a message, and return the result of the last one */
+static int msg_add(const char *data, size_t total_len, size_t size)
+{
+	int err = -EAGAIN;
+
+	for (size_t offset = 0; offset < total_len; offset += size) {
+		zassert_equal(err, -EAGAIN, "Fragment at %d not expected",
+			      offset);
+		err = fragment_add(data, total_len, offset,
+				   MIN(size, total_len - offset));
+	}
+
+	return err;
+}
+
+static void guard_check(void)
+{
+	for (size_t i = BUF_SIZE; i < sizeof(buf); i++) {
+		zassert_equal((u8_t)buf[i], 0xaa, "Written past the buffer");
+	}
+}
+
+static void test_cloud_reassembly_in_order(void)
+{
+	static char full[BUF_SIZE];
+
+	setup();
+
+	/* Fragments of different sizes, the last one shorter */
+	for (size_t size = 1; size < sizeof(msg); size += 7) {
+		zassert_equal(msg_add(msg, strlen(msg), size), 0,
+			      "Not reassembled from %d byte fragments", size);
+		zassert_equal(reassembly.len, strlen(msg), NULL);
+		zassert_mem_equal(buf, msg, strlen(msg), NULL);
+	}
+
+	/* A message that fills the buffer */
+	memset(full, 'y', sizeof(full));
+	zassert_equal(msg_add(full, sizeof(full), 16), 0, NULL);
+	zassert_mem_equal(buf, full, sizeof(full), NULL);
+	guard_check();
+}
+
+static void test_cloud_reassembly_next_message(void)
+{
+	setup();
+
+	zassert_equal(msg_add(msg, strlen(msg), 10), 0, NULL);
+
+	/* Another fragment after the complete message is not accepted */
+	zassert_equal(fragment_add(msg, strlen(msg), strlen(msg) - 1, 1),
+		      -EINVAL, NULL);
+
+	zassert_equal(msg_add(other_msg, strlen(other_msg), 10), 0, NULL);
+	zassert_equal(reassembly.len, strlen(other_msg), NULL);
+	zassert_mem_equal(buf, other_msg, strlen(other_msg), NULL);
+}
+
+static void test_cloud_reassembly_restart(void)
+{
+	setup();
+
+	/* A message that is not complete is replaced by the next one */
+	zassert_equal(fragment_add(msg, strlen(msg), 0, 10), -EAGAIN, NULL);
+	zassert_equal(fragment_add(msg, strlen(msg), 10, 10), -EAGAIN, NULL);
+
+	zassert_equal(msg_add(other_msg, strlen(other_msg), 10), 0, NULL);
+	zassert_equal(reassembly.len, strlen(other_msg), NULL);
+	zassert_mem_equal(buf, other_msg, strlen(other_msg), NULL);
+}
+
+static void test_cloud_reassembly_lost_fragment(void)
+{
+	setup();
+
+	zassert_equal(fragment_add(msg, strlen(msg), 0, 10), -EAGAIN, NULL);
+
+	/* The fragment at offset 10 is lost */
+	zassert_equal(fragment_add(msg, strlen(msg), 20, 10), -EINVAL, NULL);
+	zassert_equal(fragment_add(msg, strlen(msg), 30, strlen(msg) - 30),
+		      -EINVAL, "Discarded message completed");
+
+	/* A fragment that does not start a message is not accepted */
+	setup();
+	zassert_equal(fragment_add(msg, strlen(msg), 10, 10), -EINVAL, NULL);
+}
+
+static void test_cloud_reassembly_wrong_length(void)
+{
+	setup();
+
+	/* Fragments with a different total length than the message */
+	zassert_equal(fragment_add(msg, strlen(msg), 0, 10), -EAGAIN, NULL);
+	zassert_equal(fragment_add(msg, strlen(msg) + 1, 10, 10), -EINVAL,
+		      NULL);
+
+	/* A fragment that is longer than the rest of the message */
+	zassert_equal(fragment_add(msg, 12, 0, 10), -EAGAIN, NULL);
+	zassert_equal(fragment_add(msg, 12, 10, 10), -EINVAL, NULL);
+	guard_check();
+}
+
+static void test_cloud_reassembly_too_large(void)
+{
+	static char large[2 * BUF_SIZE];
+
+	setup();
+	memset(large, 'x', sizeof(large));
+
+	/* Every fragment of a message that does not fit is ignored */
+	for (size_t offset = 0; offset < sizeof(large); offset += 16) {
+		zassert_equal(fragment_add(large, sizeof(large), offset, 16),
+			      -EMSGSIZE, NULL);
+	}
+	guard_check();
+
+	/* The next message is reassembled */
+	zassert_equal(msg_add(msg, strlen(msg), 10), 0, NULL);
+	zassert_mem_equal(buf, msg, strlen(msg), NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(cloud_reassembly,
+		ztest_unit_test(test_cloud_reassembly_in_order),
+		ztest_unit_test(test_cloud_reassembly_next_message),
+		ztest_unit_test(test_cloud_reassembly_restart),
+		ztest_unit_test(test_cloud_reassembly_lost_fragment),
+		ztest_unit_test(test_cloud_reassembly_wrong_length),
+		ztest_unit_test(test_cloud_reassembly_too_large)
+	);
+
+	ztest_run_test_suite(cloud_reassembly);
+}
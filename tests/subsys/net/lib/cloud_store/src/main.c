@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <stdio.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <storage/flash_map.h>
+#include <net/cloud.h>
+#include <net/cloud_store.h>
+
+#define SECTOR_SIZE 256
+#define SECTOR_COUNT 4
+#define WRITE_BLOCK_SIZE 4
+#define ERASED_VAL 0xff
+
+#define MSG_LEN 40
+#define ENDPOINT "a/b/c"
+
+/* Time for the store to send everything, in steps of
+ * CONFIG_CLOUD_STORE_DRAIN_BATCH messages.
+ */
+#define DRAIN_WAIT K_MSEC(CONFIG_CLOUD_STORE_DRAIN_INTERVAL * 40)
+
+/* Flash simulated in RAM. Like real flash, only erased bytes can be
+ * written, and only a whole sector can be erased.
+ */
+static u8_t flash[SECTOR_SIZE * SECTOR_COUNT];
+static int erase_count[SECTOR_COUNT];
+static bool write_error;
+
+static struct flash_area store_fa = {
+	.fa_id = 1,
+	.fa_off = 0,
+	.fa_size = sizeof(flash),
+};
+
+static int sent[64];
+static k_tid_t sent_thread[64];
+static size_t sent_count;
+static int send_err;
+
+static K_THREAD_STACK_DEFINE(work_q_stack, 1024);
+static struct k_work_q work_q;
+
+int flash_area_open(u8_t id, const struct flash_area **fa)
+{
+	zassert_equal(id, store_fa.fa_id, "Wrong flash area");
+	*fa = &store_fa;
+	return 0;
+}
+
+void flash_area_close(const struct flash_area *fa)
+{
+}
+
+int flash_area_read(const struct flash_area *fa, off_t off, void *dst,
+		    size_t len)
+{
+	zassert_true(off + len <= sizeof(flash), "Read out of the area");
+	memcpy(dst, &flash[off], len);
+	return 0;
+}
+
+int flash_area_write(const struct flash_area *fa, off_t off,
+		     const void *src, size_t len)
+{
+	zassert_true(off + len <= sizeof(flash), "Write out of the area");
+	zassert_equal(off % WRITE_BLOCK_SIZE, 0, "Unaligned write");
+
+	for (size_t i = 0; i < len; i++) {
+		zassert_equal(flash[off + i], ERASED_VAL,
+			      "Write to flash that is not erased");
+	}
+
+	if (write_error) {
+		return -EIO;
+	}
+
+	memcpy(&flash[off], src, len);
+	return 0;
+}
+
+int flash_area_erase(const struct flash_area *fa, off_t off, size_t len)
+{
+	zassert_equal(off % SECTOR_SIZE, 0, "Unaligned erase");
+	zassert_equal(len % SECTOR_SIZE, 0, "Partial sector erase");
+	zassert_true(off + len <= sizeof(flash), "Erase out of the area");
+
+	memset(&flash[off], ERASED_VAL, len);
+
+	for (size_t i = off / SECTOR_SIZE; i < (off + len) / SECTOR_SIZE; i++) {
+		erase_count[i]++;
+	}
+
+	return 0;
+}
+
+u8_t flash_area_align(const struct flash_area *fa)
+{
+	return WRITE_BLOCK_SIZE;
+}
+
+u8_t flash_area_erased_val(const struct flash_area *fa)
+{
+	return ERASED_VAL;
+}
+
+int flash_area_get_sectors(int idx, u32_t *cnt, struct flash_sector *ret)
+{
+	u32_t count = MIN(*cnt, SECTOR_COUNT);
+
+	zassert_equal(idx, store_fa.fa_id, "Wrong flash area");
+
+	for (u32_t i = 0; i < count; i++) {
+		ret[i].fs_off = i * SECTOR_SIZE;
+		ret[i].fs_size = SECTOR_SIZE;
+	}
+
+	*cnt = count;
+	return (count < SECTOR_COUNT) ? -ENOMEM : 0;
+}
+
+static int backend_send(const struct cloud_backend *const backend,
+			const struct cloud_msg *const msg)
+{
+	int num;
+
+	zassert_equal(msg->len, MSG_LEN, "Wrong message length");
+	zassert_equal(msg->endpoint.type, CLOUD_EP_TOPIC_MSG,
+		      "Wrong endpoint type");
+	zassert_equal(msg->endpoint.len, strlen(ENDPOINT),
+		      "Wrong endpoint length");
+	zassert_equal(strncmp(msg->endpoint.str, ENDPOINT, msg->endpoint.len),
+		      0, "Wrong endpoint");
+
+	if (send_err) {
+		return send_err;
+	}
+
+	zassert_true(sent_count < ARRAY_SIZE(sent), "Too many messages");
+	zassert_equal(sscanf(msg->buf, "msg %d", &num), 1, "Wrong message");
+
+	sent[sent_count] = num;
+	sent_thread[sent_count] = k_current_get();
+	sent_count++;
+
+	return 0;
+}
+
+static const struct cloud_api api = {
+	.send = backend_send,
+};
+
+static struct cloud_backend_config config;
+static const struct cloud_backend backend = {
+	.api = &api,
+	.config = &config,
+};
+
+static int store_send(int num)
+{
+	char buf[MSG_LEN];
+	struct cloud_msg msg = {
+		.buf = buf,
+		.len = sizeof(buf),
+		.qos = CLOUD_QOS_AT_LEAST_ONCE,
+		.endpoint = {
+			.type = CLOUD_EP_TOPIC_MSG,
+			.str = ENDPOINT,
+			.len = strlen(ENDPOINT),
+		},
+	};
+
+	memset(buf, 0, sizeof(buf));
+	snprintf(buf, sizeof(buf), "msg %d", num);
+
+	return cloud_store_send(&msg);
+}
+
+static void sent_check(int first, int last)
+{
+	zassert_equal(sent_count, last - first + 1,
+		      "Wrong number of messages sent: %d", sent_count);
+
+	for (size_t i = 0; i < sent_count; i++) {
+		zassert_equal(sent[i], first + i, "Message %d out of order",
+			      sent[i]);
+	}
+}
+
+static void setup(void)
+{
+	memset(flash, ERASED_VAL, sizeof(flash));
+	memset(erase_count, 0, sizeof(erase_count));
+	write_error = false;
+	sent_count = 0;
+	send_err = 0;
+
+	zassert_equal(cloud_store_init(&backend, &work_q), 0, "Init failed");
+}
+
+static void teardown(void)
+{
+	cloud_store_link_update(false);
+}
+
+static void test_cloud_store_init_invalid(void)
+{
+	zassert_equal(cloud_store_init(NULL, &work_q), -EINVAL,
+		      "NULL backend accepted");
+	zassert_equal(cloud_store_init(&backend, NULL), -EINVAL,
+		      "NULL work queue accepted");
+}
+
+static void test_cloud_store_send_direct(void)
+{
+	cloud_store_link_update(true);
+
+	zassert_equal(store_send(0), 0, "Send failed");
+	zassert_equal(store_send(1), 0, "Send failed");
+
+	sent_check(0, 1);
+	zassert_equal(sent_thread[0], k_current_get(),
+		      "Message not sent directly");
+	zassert_equal(cloud_store_count(), 0, "Message stored");
+}
+
+static void test_cloud_store_drain_order(void)
+{
+	for (int i = 0; i < 5; i++) {
+		zassert_equal(store_send(i), 0, "Store failed");
+	}
+
+	zassert_equal(sent_count, 0, "Message sent while link is down");
+	zassert_equal(cloud_store_count(), 5, "Messages not stored");
+
+	cloud_store_link_update(true);
+
+	/* Messages sent while draining go after the stored ones */
+	zassert_equal(store_send(5), 0, "Store failed");
+
+	k_sleep(DRAIN_WAIT);
+
+	sent_check(0, 5);
+	zassert_equal(cloud_store_count(), 0, "Messages left in store");
+
+	for (size_t i = 0; i < sent_count; i++) {
+		zassert_equal(sent_thread[i], &work_q.thread,
+			      "Stored message not sent from the work queue");
+	}
+}
+
+static void test_cloud_store_drain_retry(void)
+{
+	for (int i = 0; i < 3; i++) {
+		zassert_equal(store_send(i), 0, "Store failed");
+	}
+
+	send_err = -EIO;
+	cloud_store_link_update(true);
+	k_sleep(K_MSEC(CONFIG_CLOUD_STORE_DRAIN_INTERVAL * 3));
+
+	zassert_equal(sent_count, 0, "Message sent despite error");
+	zassert_equal(cloud_store_count(), 3, "Messages lost on error");
+
+	/* A message that cannot be sent directly is stored */
+	zassert_equal(store_send(3), 0, "Store failed");
+	zassert_equal(cloud_store_count(), 4, "Message not stored");
+
+	send_err = 0;
+	k_sleep(DRAIN_WAIT);
+
+	sent_check(0, 3);
+	zassert_equal(cloud_store_count(), 0, "Messages left in store");
+}
+
+static void test_cloud_store_link_down(void)
+{
+	for (int i = 0; i < 8; i++) {
+		zassert_equal(store_send(i), 0, "Store failed");
+	}
+
+	cloud_store_link_update(true);
+	k_sleep(K_MSEC(CONFIG_CLOUD_STORE_DRAIN_INTERVAL / 2));
+	cloud_store_link_update(false);
+	k_sleep(DRAIN_WAIT);
+
+	zassert_equal(sent_count, CONFIG_CLOUD_STORE_DRAIN_BATCH,
+		      "Drain did not stop when the link went down");
+
+	cloud_store_link_update(true);
+	k_sleep(DRAIN_WAIT);
+
+	sent_check(0, 7);
+}
+
+static void test_cloud_store_rotation(void)
+{
+	const int total = 40;
+	int min_erase;
+	int max_erase;
+	size_t stored;
+
+	for (int i = 0; i < total; i++) {
+		zassert_equal(store_send(i), 0, "Store failed");
+	}
+
+	/* The oldest messages were dropped to make room */
+	stored = cloud_store_count();
+	zassert_true(stored > 0, "No messages stored");
+	zassert_true(stored < total, "No messages dropped");
+
+	min_erase = erase_count[0];
+	max_erase = erase_count[0];
+
+	for (size_t i = 1; i < SECTOR_COUNT; i++) {
+		min_erase = MIN(min_erase, erase_count[i]);
+		max_erase = MAX(max_erase, erase_count[i]);
+	}
+
+	zassert_true(max_erase > 0, "No sector erased");
+	zassert_true(max_erase - min_erase <= 1, "Sectors not erased in turn");
+
+	cloud_store_link_update(true);
+	k_sleep(DRAIN_WAIT);
+
+	/* The newest messages are kept, in order */
+	sent_check(total - stored, total - 1);
+	zassert_equal(cloud_store_count(), 0, "Messages left in store");
+}
+
+static void test_cloud_store_reset(void)
+{
+	for (int i = 0; i < 3; i++) {
+		zassert_equal(store_send(i), 0, "Store failed");
+	}
+
+	/* Messages are kept in flash over a reset */
+	zassert_equal(cloud_store_init(&backend, &work_q), 0, "Init failed");
+	zassert_equal(cloud_store_count(), 3, "Stored messages lost");
+
+	cloud_store_link_update(true);
+	k_sleep(DRAIN_WAIT);
+
+	sent_check(0, 2);
+}
+
+static void test_cloud_store_write_error(void)
+{
+	write_error = true;
+	zassert_not_equal(store_send(0), 0, "Write error not reported");
+	write_error = false;
+
+	/* The unfinished entry is skipped */
+	zassert_equal(store_send(1), 0, "Store failed");
+
+	cloud_store_link_update(true);
+	k_sleep(DRAIN_WAIT);
+
+	sent_check(1, 1);
+}
+
+void test_main(void)
+{
+	k_work_q_start(&work_q, work_q_stack,
+		       K_THREAD_STACK_SIZEOF(work_q_stack),
+		       K_LOWEST_APPLICATION_THREAD_PRIO);
+
+	ztest_test_suite(cloud_store,
+		ztest_unit_test(test_cloud_store_init_invalid),
+		ztest_unit_test_setup_teardown(test_cloud_store_send_direct,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_cloud_store_drain_order,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_cloud_store_drain_retry,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_cloud_store_link_down,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_cloud_store_rotation,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_cloud_store_reset,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_cloud_store_write_error,
+					       setup, teardown)
+	);
+
+	ztest_run_test_suite(cloud_store);
+}
@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <net/cloud.h>
+#include <net/cloud_uplink.h>
+
+#define DEADLINE_LONG K_SECONDS(60)
+
+static char sent[16][8];
+static k_tid_t sent_thread[16];
+static size_t sent_count;
+static int send_err;
+
+/* Message that is queued from within the send of the first message, as if
+ * another thread queued it during a flush.
+ */
+static const char *nested_msg;
+
+static K_THREAD_STACK_DEFINE(work_q_stack, 1024);
+static struct k_work_q work_q;
+
+static int uplink_send(const char *str, u32_t deadline_ms)
+{
+	struct cloud_msg msg = {
+		.buf = (char *)str,
+		.len = strlen(str) + 1,
+		.qos = CLOUD_QOS_AT_MOST_ONCE,
+		.endpoint.type = CLOUD_EP_TOPIC_MSG
+	};
+
+	return cloud_uplink_send(&msg, deadline_ms);
+}
+
+static int backend_send(const struct cloud_backend *const backend,
+			const struct cloud_msg *const msg)
+{
+	zassert_true(sent_count < ARRAY_SIZE(sent), "Too many messages");
+	zassert_true(msg->len <= sizeof(sent[0]), "Message too long");
+
+	memcpy(sent[sent_count], msg->buf, msg->len);
+	sent_thread[sent_count] = k_current_get();
+	sent_count++;
+
+	if (nested_msg != NULL) {
+		const char *str = nested_msg;
+
+		nested_msg = NULL;
+		zassert_equal(uplink_send(str, CLOUD_UPLINK_DEADLINE_NOW), 0,
+			      "Nested send failed");
+	}
+
+	return send_err;
+}
+
+static const struct cloud_api api = {
+	.send = backend_send,
+};
+
+static struct cloud_backend_config config;
+static const struct cloud_backend backend = {
+	.api = &api,
+	.config = &config,
+};
+
+static void setup(void)
+{
+	memset(sent, 0, sizeof(sent));
+	sent_count = 0;
+	send_err = 0;
+	nested_msg = NULL;
+
+	zassert_equal(cloud_uplink_init(&backend, &work_q), 0, "Init failed");
+}
+
+static void teardown(void)
+{
+	send_err = 0;
+	nested_msg = NULL;
+	cloud_uplink_rrc_update(false);
+	(void)cloud_uplink_flush();
+}
+
+static void assert_sent(size_t index, const char *str)
+{
+	zassert_true(index < sent_count, "Message %d not sent", index);
+	zassert_true(strcmp(sent[index], str) == 0, "Expected %s, got %s",
+		     str, sent[index]);
+}
+
+static void test_init_invalid(void)
+{
+	zassert_equal(cloud_uplink_init(NULL, &work_q), -EINVAL, "");
+	zassert_equal(cloud_uplink_init(&backend, NULL), -EINVAL, "");
+}
+
+static void test_defer_and_flush(void)
+{
+	zassert_equal(uplink_send("a", DEADLINE_LONG), 0, "");
+	zassert_equal(uplink_send("b", DEADLINE_LONG), 0, "");
+
+	zassert_equal(sent_count, 0, "Deferred message was sent");
+	zassert_equal(cloud_uplink_pending_count(), 2, "");
+
+	zassert_equal(cloud_uplink_flush(), 0, "");
+	zassert_equal(sent_count, 2, "");
+	assert_sent(0, "a");
+	assert_sent(1, "b");
+	zassert_equal(cloud_uplink_pending_count(), 0, "");
+}
+
+static void test_send_now_releases_pending(void)
+{
+	zassert_equal(uplink_send("a", DEADLINE_LONG), 0, "");
+	zassert_equal(uplink_send("b", DEADLINE_LONG), 0, "");
+	zassert_equal(uplink_send("c", CLOUD_UPLINK_DEADLINE_NOW), 0, "");
+
+	zassert_equal(sent_count, 3, "");
+	assert_sent(0, "a");
+	assert_sent(1, "b");
+	assert_sent(2, "c");
+}
+
+static void test_max_pending(void)
+{
+	const char *msgs[] = { "a", "b", "c", "d" };
+
+	BUILD_ASSERT(ARRAY_SIZE(msgs) == CONFIG_CLOUD_UPLINK_MAX_PENDING);
+
+	for (size_t i = 0; i < ARRAY_SIZE(msgs); i++) {
+		zassert_equal(sent_count, 0, "Sent before the limit");
+		zassert_equal(uplink_send(msgs[i], DEADLINE_LONG), 0, "");
+	}
+
+	zassert_equal(sent_count, ARRAY_SIZE(msgs), "");
+	for (size_t i = 0; i < ARRAY_SIZE(msgs); i++) {
+		assert_sent(i, msgs[i]);
+	}
+}
+
+static void test_deadline(void)
+{
+	zassert_equal(uplink_send("a", K_MSEC(200)), 0, "");
+	zassert_equal(uplink_send("b", DEADLINE_LONG), 0, "");
+
+	k_sleep(K_MSEC(100));
+	zassert_equal(sent_count, 0, "Sent before the deadline");
+
+	k_sleep(K_MSEC(200));
+	zassert_equal(sent_count, 2, "Not sent at the deadline");
+	assert_sent(0, "a");
+	assert_sent(1, "b");
+	zassert_equal(sent_thread[0], &work_q.thread, "Not sent from work_q");
+}
+
+static void test_rrc_connected(void)
+{
+	zassert_equal(uplink_send("a", DEADLINE_LONG), 0, "");
+
+	/* The messages are sent from the work queue, not from the caller */
+	cloud_uplink_rrc_update(true);
+	zassert_equal(sent_count, 0, "Sent from the RRC update");
+
+	k_sleep(K_MSEC(50));
+	zassert_equal(sent_count, 1, "Not sent when RRC connected");
+	assert_sent(0, "a");
+	zassert_equal(sent_thread[0], &work_q.thread, "Not sent from work_q");
+
+	/* While connected, messages are sent right away */
+	zassert_equal(uplink_send("b", DEADLINE_LONG), 0, "");
+	zassert_equal(sent_count, 2, "Not sent while RRC connected");
+	assert_sent(1, "b");
+
+	cloud_uplink_rrc_update(false);
+	zassert_equal(uplink_send("c", DEADLINE_LONG), 0, "");
+	zassert_equal(sent_count, 2, "Sent while RRC idle");
+	zassert_equal(cloud_uplink_flush(), 0, "");
+}
+
+static void test_order_during_flush(void)
+{
+	zassert_equal(uplink_send("a", DEADLINE_LONG), 0, "");
+	zassert_equal(uplink_send("b", DEADLINE_LONG), 0, "");
+
+	/* A message that is sent during the flush goes after the burst */
+	nested_msg = "x";
+	zassert_equal(cloud_uplink_flush(), 0, "");
+
+	zassert_equal(sent_count, 3, "");
+	assert_sent(0, "a");
+	assert_sent(1, "b");
+	assert_sent(2, "x");
+	zassert_equal(cloud_uplink_pending_count(), 0, "");
+}
+
+static void test_send_error(void)
+{
+	zassert_equal(uplink_send("a", DEADLINE_LONG), 0, "");
+	zassert_equal(uplink_send("b", DEADLINE_LONG), 0, "");
+
+	/* The burst stops at the message that failed, and both are kept */
+	send_err = -ENOTCONN;
+	zassert_equal(cloud_uplink_flush(), -ENOTCONN, "");
+	zassert_equal(sent_count, 1, "Sent after a failure");
+	zassert_equal(cloud_uplink_pending_count(), 2, "Messages lost");
+
+	/* A message that must be sent now is sent after them */
+	send_err = 0;
+	sent_count = 0;
+	zassert_equal(uplink_send("c", CLOUD_UPLINK_DEADLINE_NOW), 0, "");
+	zassert_equal(sent_count, 3, "");
+	assert_sent(0, "a");
+	assert_sent(1, "b");
+	assert_sent(2, "c");
+	zassert_equal(cloud_uplink_pending_count(), 0, "");
+}
+
+static void test_send_error_retry_rrc(void)
+{
+	send_err = -ENOTCONN;
+	zassert_equal(uplink_send("a", CLOUD_UPLINK_DEADLINE_NOW), 0,
+		      "Kept message reported as failed");
+	zassert_equal(cloud_uplink_pending_count(), 1, "Message lost");
+
+	/* Sent again when the link is RRC connected */
+	send_err = 0;
+	sent_count = 0;
+	cloud_uplink_rrc_update(true);
+	k_sleep(K_MSEC(50));
+	zassert_equal(sent_count, 1, "Not sent again when RRC connected");
+	assert_sent(0, "a");
+	zassert_equal(cloud_uplink_pending_count(), 0, "");
+}
+
+static void test_send_error_retry_interval(void)
+{
+	send_err = -ENOTCONN;
+	zassert_equal(uplink_send("a", CLOUD_UPLINK_DEADLINE_NOW), 0, "");
+	zassert_equal(uplink_send("b", DEADLINE_LONG), 0, "");
+	zassert_equal(cloud_uplink_pending_count(), 2, "");
+
+	/* Sent again after the retry interval */
+	send_err = 0;
+	sent_count = 0;
+	k_sleep(K_MSEC(CONFIG_CLOUD_UPLINK_RETRY_INTERVAL / 2));
+	zassert_equal(sent_count, 0, "Sent again before the interval");
+
+	k_sleep(K_MSEC(CONFIG_CLOUD_UPLINK_RETRY_INTERVAL));
+	zassert_equal(sent_count, 2, "Not sent again after the interval");
+	assert_sent(0, "a");
+	assert_sent(1, "b");
+	zassert_equal(sent_thread[0], &work_q.thread, "Not sent from work_q");
+}
+
+static void test_send_error_full(void)
+{
+	const char *msgs[] = { "a", "b", "c", "d" };
+
+	send_err = -ENOTCONN;
+	for (size_t i = 0; i < ARRAY_SIZE(msgs); i++) {
+		zassert_equal(uplink_send(msgs[i], DEADLINE_LONG), 0, "");
+	}
+
+	/* No more messages are kept while the kept ones cannot be sent */
+	zassert_equal(uplink_send("e", DEADLINE_LONG), -ENOBUFS, "");
+	zassert_equal(cloud_uplink_pending_count(), ARRAY_SIZE(msgs), "");
+
+	/* Once they are sent, there is room again */
+	send_err = 0;
+	sent_count = 0;
+	zassert_equal(uplink_send("f", DEADLINE_LONG), 0, "");
+	zassert_equal(sent_count, ARRAY_SIZE(msgs), "");
+	for (size_t i = 0; i < ARRAY_SIZE(msgs); i++) {
+		assert_sent(i, msgs[i]);
+	}
+	zassert_equal(cloud_uplink_pending_count(), 1, "");
+}
+
+void test_main(void)
+{
+	k_work_q_start(&work_q, work_q_stack,
+		       K_THREAD_STACK_SIZEOF(work_q_stack),
+		       K_LOWEST_APPLICATION_THREAD_PRIO);
+
+	ztest_test_suite(cloud_uplink_test,
+		ztest_unit_test_setup_teardown(test_init_invalid,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_defer_and_flush,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_send_now_releases_pending,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_max_pending,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_deadline,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_rrc_connected,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_order_during_flush,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_send_error,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_send_error_retry_rrc,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_send_error_retry_interval,
+					       setup, teardown),
+		ztest_unit_test_setup_teardown(test_send_error_full,
+					       setup, teardown)
+		);
+
+	ztest_run_test_suite(cloud_uplink_test);
+}
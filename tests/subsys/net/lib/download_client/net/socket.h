@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* Socket API used by the download client, implemented by the test with a
+ * CoAP server instead of the network.
+ */
+#ifndef NET_SOCKET_H__
+#define NET_SOCKET_H__
+
+#include <sys/types.h>
+#include <zephyr/types.h>
+#include <net/net_ip.h>
+
+#define SOL_SOCKET 1
+#define SO_RCVTIMEO 20
+#define SO_BINDTODEVICE 25
+
+#define SOL_TLS 282
+#define TLS_SEC_TAG_LIST 1
+#define TLS_PEER_VERIFY 5
+
+#define IFNAMSIZ 64
+
+struct ifreq {
+	char ifr_name[IFNAMSIZ];
+};
+
+/* Unless the C library has it already */
+#if !defined(__timeval_defined) && !defined(_TIMEVAL_DEFINED)
+struct timeval {
+	long tv_sec;
+	long tv_usec;
+};
+#endif
+
+struct addrinfo {
+	struct addrinfo *ai_next;
+	int ai_flags;
+	int ai_family;
+	int ai_socktype;
+	int ai_protocol;
+	socklen_t ai_addrlen;
+	struct sockaddr *ai_addr;
+	char *ai_canonname;
+};
+
+int mock_socket(int family, int type, int proto);
+int mock_connect(int fd, const struct sockaddr *addr, socklen_t addrlen);
+int mock_close(int fd);
+ssize_t mock_send(int fd, const void *buf, size_t len, int flags);
+ssize_t mock_recv(int fd, void *buf, size_t max_len, int flags);
+int mock_setsockopt(int fd, int level, int optname, const void *optval,
+		    socklen_t optlen);
+int mock_getaddrinfo(const char *host, const char *service,
+		     const struct addrinfo *hints, struct addrinfo **res);
+void mock_freeaddrinfo(struct addrinfo *ai);
+
+#define socket mock_socket
+#define connect mock_connect
+#define close mock_close
+#define send mock_send
+#define recv mock_recv
+#define setsockopt mock_setsockopt
+#define getaddrinfo mock_getaddrinfo
+#define freeaddrinfo mock_freeaddrinfo
+
+#endif /* NET_SOCKET_H__ */
@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <errno.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <net/socket.h>
+#include <net/coap.h>
+#include <net/download_client.h>
+
+#define HOST "coap://fota.example.com"
+#define FILE_PATH "fw/app_update.bin"
+#define FILE_SIZE 1000
+#define BLOCK_SIZE CONFIG_DOWNLOAD_CLIENT_COAP_BLOCK_SIZE
+#define SERVER_FD 7
+#define NO_BLOCK -1
+
+/* Block2 option value, RFC 7959 section 2.2 */
+#define BLOCK2_NUM(val) ((u32_t)(val) >> 4)
+#define BLOCK2_SZX(val) ((val) & 0x07)
+#define BLOCK2_VALUE(num, more, szx) (((num) << 4) | ((more) << 3) | (szx))
+
+struct datagram {
+	size_t len;
+	u8_t data[BLOCK_SIZE + 64];
+};
+
+K_MSGQ_DEFINE(rx_queue, sizeof(struct datagram), 8, 4);
+static K_SEM_DEFINE(done_sem, 0, 1);
+
+static struct download_client client;
+static u8_t file[FILE_SIZE];
+
+/* State of the server */
+static bool socket_open;
+static s32_t recv_timeout;
+/* Block size exponent of the largest blocks the server sends */
+static u8_t server_szx;
+/* Block answered with an error, or NO_BLOCK */
+static int error_block;
+/* Block whose first response is lost, or NO_BLOCK */
+static int drop_block;
+/* Blocks requested by the client, in order */
+static u32_t requests[32];
+static size_t request_count;
+static bool size_requested;
+
+/* Data received by the application */
+static u8_t received[FILE_SIZE];
+static size_t received_off;
+static size_t received_len;
+static int download_err;
+static bool download_done;
+
+int mock_socket(int family, int type, int proto)
+{
+	zassert_false(socket_open, "Socket opened twice");
+	zassert_equal(type, SOCK_DGRAM, "Not a CoAP socket");
+	zassert_equal(proto, IPPROTO_UDP, NULL);
+
+	socket_open = true;
+	return SERVER_FD;
+}
+
+int mock_connect(int fd, const struct sockaddr *addr, socklen_t addrlen)
+{
+	zassert_equal(fd, SERVER_FD, NULL);
+	zassert_equal(ntohs(((const struct sockaddr_in *)addr)->sin_port),
+		      5683, "Wrong CoAP port");
+	return 0;
+}
+
+int mock_close(int fd)
+{
+	zassert_equal(fd, SERVER_FD, NULL);
+	socket_open = false;
+	return 0;
+}
+
+int mock_setsockopt(int fd, int level, int optname, const void *optval,
+		    socklen_t optlen)
+{
+	const struct timeval *timeo = optval;
+
+	zassert_equal(level, SOL_SOCKET, NULL);
+	zassert_equal(optname, SO_RCVTIMEO, NULL);
+
+	recv_timeout = timeo->tv_sec * MSEC_PER_SEC +
+		       timeo->tv_usec / USEC_PER_MSEC;
+	return 0;
+}
+
+int mock_getaddrinfo(const char *host, const char *service,
+		     const struct addrinfo *hints, struct addrinfo **res)
+{
+	static struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+	};
+	static struct addrinfo info = {
+		.ai_family = AF_INET,
+		.ai_socktype = SOCK_DGRAM,
+		.ai_addr = (struct sockaddr *)&addr,
+		.ai_addrlen = sizeof(addr),
+	};
+
+	zassert_equal(strcmp(host, HOST + strlen("coap://")), 0,
+		      "Scheme not stripped from %s", host);
+
+	*res = &info;
+	return 0;
+}
+
+void mock_freeaddrinfo(struct addrinfo *ai)
+{
+}
+
+ssize_t mock_recv(int fd, void *buf, size_t max_len, int flags)
+{
+	struct datagram dgram;
+
+	zassert_equal(fd, SERVER_FD, NULL);
+
+	if (k_msgq_get(&rx_queue, &dgram, recv_timeout) != 0) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	zassert_true(dgram.len <= max_len, "Response does not fit");
+	memcpy(buf, dgram.data, dgram.len);
+
+	return dgram.len;
+}
+
+/* Check that the Uri-Path options of the request make up the file path */
+static void path_check(struct coap_packet *request)
+{
+	struct coap_option options[4];
+	char path[sizeof(FILE_PATH)] = "";
+	int count;
+
+	count = coap_find_options(request, COAP_OPTION_URI_PATH, options,
+				  ARRAY_SIZE(options));
+	zassert_equal(count, 2, "Wrong number of path segments");
+
+	for (int i = 0; i < count; i++) {
+		if (i > 0) {
+			strcat(path, "/");
+		}
+		strncat(path, (char *)options[i].value, options[i].len);
+	}
+
+	zassert_equal(strcmp(path, FILE_PATH), 0, "Wrong path %s", path);
+}
+
+/* Answer a request for a block with a piggybacked response */
+ssize_t mock_send(int fd, const void *buf, size_t len, int flags)
+{
+	int err;
+	int block2;
+	u8_t token[8];
+	u8_t tkl;
+	u8_t szx;
+	u32_t num;
+	size_t off;
+	size_t size;
+	bool more;
+	struct datagram dgram;
+	struct coap_packet request;
+	struct coap_packet response;
+
+	zassert_equal(fd, SERVER_FD, NULL);
+
+	err = coap_packet_parse(&request, (u8_t *)buf, len, NULL, 0);
+	zassert_equal(err, 0, "Invalid request");
+	zassert_equal(coap_header_get_type(&request), COAP_TYPE_CON, NULL);
+	zassert_equal(coap_header_get_code(&request), COAP_METHOD_GET, NULL);
+	path_check(&request);
+
+	block2 = coap_get_option_int(&request, COAP_OPTION_BLOCK2);
+	zassert_true(block2 >= 0, "No Block2 option");
+
+	/* Answer with the block that holds the requested offset */
+	szx = MIN(BLOCK2_SZX(block2), server_szx);
+	off = BLOCK2_NUM(block2) << (BLOCK2_SZX(block2) + 4);
+	num = off >> (szx + 4);
+	off = num << (szx + 4);
+	zassert_true(off < FILE_SIZE, "Block past the end of the file");
+
+	zassert_true(request_count < ARRAY_SIZE(requests), NULL);
+	requests[request_count++] = off;
+
+	if (num == drop_block) {
+		drop_block = NO_BLOCK;
+		return len;
+	}
+
+	tkl = coap_header_get_token(&request, token);
+
+	if (num == error_block) {
+		err = coap_packet_init(&response, dgram.data,
+				       sizeof(dgram.data), 1, COAP_TYPE_ACK,
+				       tkl, token,
+				       COAP_RESPONSE_CODE_INTERNAL_ERROR,
+				       coap_header_get_id(&request));
+		zassert_equal(err, 0, NULL);
+		goto respond;
+	}
+
+	size = MIN(FILE_SIZE - off, 1 << (szx + 4));
+	more = (off + size < FILE_SIZE);
+
+	err = coap_packet_init(&response, dgram.data, sizeof(dgram.data), 1,
+			       COAP_TYPE_ACK, tkl, token,
+			       COAP_RESPONSE_CODE_CONTENT,
+			       coap_header_get_id(&request));
+	zassert_equal(err, 0, NULL);
+
+	err = coap_append_option_int(&response, COAP_OPTION_BLOCK2,
+				     BLOCK2_VALUE(num, more, szx));
+	zassert_equal(err, 0, NULL);
+
+	if (coap_get_option_int(&request, COAP_OPTION_SIZE2) >= 0) {
+		size_requested = true;
+		err = coap_append_option_int(&response, COAP_OPTION_SIZE2,
+					     FILE_SIZE);
+		zassert_equal(err, 0, NULL);
+	}
+
+	err = coap_packet_append_payload_marker(&response);
+	zassert_equal(err, 0, NULL);
+	err = coap_packet_append_payload(&response, &file[off], size);
+	zassert_equal(err, 0, NULL);
+
+respond:
+	dgram.len = response.offset;
+	zassert_equal(k_msgq_put(&rx_queue, &dgram, K_NO_WAIT), 0,
+		      "Too many requests in flight");
+
+	return len;
+}
+
+static int download_client_callback(const struct download_client_evt *evt)
+{
+	switch (evt->id) {
+	case DOWNLOAD_CLIENT_EVT_FRAGMENT:
+		zassert_true(received_off + received_len + evt->fragment.len <=
+			     sizeof(received), "Fragment past the end");
+		memcpy(&received[received_off + received_len],
+		       evt->fragment.buf, evt->fragment.len);
+		received_len += evt->fragment.len;
+		return 0;
+	case DOWNLOAD_CLIENT_EVT_DONE:
+		download_done = true;
+		k_sem_give(&done_sem);
+		return 0;
+	case DOWNLOAD_CLIENT_EVT_ERROR:
+		download_err = evt->error;
+		k_sem_give(&done_sem);
+		/* Stop the download */
+		return -1;
+	default:
+		zassert_unreachable("Unknown event %d", evt->id);
+		return -1;
+	}
+}
+
+static void setup(void)
+{
+	static bool initialized;
+	const struct download_client_cfg config = {
+		.sec_tag = -1,
+	};
+
+	for (int i = 0; i < sizeof(file); i++) {
+		file[i] = i * 7 + i / 256;
+	}
+
+	server_szx = 6;
+	error_block = NO_BLOCK;
+	drop_block = NO_BLOCK;
+	request_count = 0;
+	size_requested = false;
+
+	memset(received, 0, sizeof(received));
+	received_off = 0;
+	received_len = 0;
+	download_err = 0;
+	download_done = false;
+	k_sem_reset(&done_sem);
+	k_msgq_purge(&rx_queue);
+
+	if (!initialized) {
+		zassert_equal(download_client_init(&client,
+						   download_client_callback),
+			      0, NULL);
+		initialized = true;
+	}
+
+	zassert_equal(download_client_connect(&client, HOST, &config), 0,
+		      NULL);
+	zassert_true(socket_open, NULL);
+	zassert_equal(recv_timeout, CONFIG_DOWNLOAD_CLIENT_COAP_ACK_TIMEOUT_MS,
+		      "Receive timeout not set");
+}
+
+static void teardown(void)
+{
+	zassert_equal(download_client_disconnect(&client), 0, NULL);
+	zassert_false(socket_open, "Socket not closed");
+}
+
+/* Download from the given offset, and wait for the download to end */
+static void download(size_t from)
+{
+	received_off = from;
+
+	zassert_equal(download_client_start(&client, FILE_PATH, from), 0,
+		      NULL);
+	zassert_equal(k_sem_take(&done_sem, K_SECONDS(5)), 0,
+		      "Download did not end");
+}
+
+static void test_download_client_coap_blocks(void)
+{
+	size_t size;
+
+	setup();
+
+	download(0);
+
+	zassert_true(download_done, "Download failed: %d", download_err);
+	zassert_equal(received_len, FILE_SIZE, NULL);
+	zassert_mem_equal(received, file, FILE_SIZE, "Wrong data");
+	zassert_true(size_requested, "File size not requested");
+	zassert_equal(download_client_file_size_get(&client, &size), 0, NULL);
+	zassert_equal(size, FILE_SIZE, NULL);
+
+	/* Each block is requested once, in order */
+	zassert_equal(request_count, ceiling_fraction(FILE_SIZE, BLOCK_SIZE),
+		      NULL);
+	for (size_t i = 0; i < request_count; i++) {
+		zassert_equal(requests[i], i * BLOCK_SIZE, NULL);
+	}
+
+	teardown();
+}
+
+static void test_download_client_coap_resume(void)
+{
+	const size_t from = BLOCK_SIZE * 2 + 88;
+
+	setup();
+
+	/* The download resumes from within the block */
+	download(from);
+
+	zassert_true(download_done, "Download failed: %d", download_err);
+	zassert_equal(received_len, FILE_SIZE - from, NULL);
+	zassert_mem_equal(&received[from], &file[from], FILE_SIZE - from,
+			  "Wrong data");
+	zassert_equal(requests[0], BLOCK_SIZE * 2, "Resumed at wrong block");
+
+	teardown();
+}
+
+static void test_download_client_coap_small_blocks(void)
+{
+	setup();
+
+	/* The server sends smaller blocks than requested */
+	server_szx = 2;
+
+	download(0);
+
+	zassert_true(download_done, "Download failed: %d", download_err);
+	zassert_equal(received_len, FILE_SIZE, NULL);
+	zassert_mem_equal(received, file, FILE_SIZE, "Wrong data");
+	zassert_equal(request_count, ceiling_fraction(FILE_SIZE, 64),
+		      "Blocks requested more than once");
+
+	teardown();
+}
+
+static void test_download_client_coap_lost_response(void)
+{
+	setup();
+
+	drop_block = 1;
+
+	download(0);
+
+	zassert_true(download_done, "Download failed: %d", download_err);
+	zassert_equal(received_len, FILE_SIZE, NULL);
+	zassert_mem_equal(received, file, FILE_SIZE, "Wrong data");
+
+	teardown();
+}
+
+static void test_download_client_coap_server_error(void)
+{
+	setup();
+
+	error_block = 2;
+
+	download(0);
+
+	zassert_false(download_done, "Download completed");
+	zassert_equal(download_err, -EBADMSG, "Error not reported");
+
+	/* The blocks before the error are delivered */
+	zassert_equal(received_len, 2 * BLOCK_SIZE, NULL);
+	zassert_mem_equal(received, file, received_len, "Wrong data");
+
+	teardown();
+}
+
+void test_main(void)
+{
+	ztest_test_suite(download_client_coap,
+		ztest_unit_test(test_download_client_coap_blocks),
+		ztest_unit_test(test_download_client_coap_resume),
+		ztest_unit_test(test_download_client_coap_small_blocks),
+		ztest_unit_test(test_download_client_coap_lost_response),
+		ztest_unit_test(test_download_client_coap_server_error)
+	);
+
+	ztest_run_test_suite(download_client_coap);
+}
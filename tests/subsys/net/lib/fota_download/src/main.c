@@ -11,6 +11,8 @@
 #include <fw_info.h>
 #include <pm_config.h>
 #include <fota_download.h>
+#include <tinycrypt/constants.h>
+#include <tinycrypt/sha256.h>
 
 /* Create buffer which we will fill with strings to test with.
  * This is needed since 'dfu_ctx_Mcuboot_set_b1_file` will modify its
@@ -30,29 +32,68 @@ static u32_t s0_version;
 static u32_t s1_version;
 const char *download_client_start_file;
 char *dfu_ctx_mcuboot_set_b1_file__update;
+static download_client_callback_t download_client_callback;
+static int dfu_target_done_calls;
+static bool dfu_target_done_successful;
+static enum fota_download_evt_id last_evt_id;
+static int dfu_target_context_img_type;
+static size_t dfu_target_context_file_size;
+static size_t dfu_target_offset;
+static int dfu_target_init_img_type;
+static int dfu_target_img_type_calls;
+static int dfu_target_write_calls;
+static size_t download_client_start_from;
+static size_t download_client_file_size;
+static K_SEM_DEFINE(download_client_start_sem, 0, 1);
+/* Data written to the DFU target since it was last cleared */
+static u8_t dfu_target_data[1000];
+static size_t dfu_target_data_len;
 
 int dfu_target_init(int img_type, size_t file_size)
 {
+	dfu_target_init_img_type = img_type;
 	return 0;
 }
 
 int dfu_target_img_type(const void *const buf, size_t len)
 {
+	dfu_target_img_type_calls++;
 	return 0;
 }
 
 int dfu_target_offset_get(size_t *offset)
 {
+	*offset = dfu_target_offset;
 	return 0;
 }
 
 int dfu_target_write(const void *const buf, size_t len)
 {
+	dfu_target_write_calls++;
+
+	if (dfu_target_data_len + len <= sizeof(dfu_target_data)) {
+		memcpy(&dfu_target_data[dfu_target_data_len], buf, len);
+	}
+	dfu_target_data_len += len;
+
+	return 0;
+}
+
+int dfu_target_context_get(int *img_type, size_t *file_size)
+{
+	if (dfu_target_context_img_type == 0) {
+		return -ENOENT;
+	}
+
+	*img_type = dfu_target_context_img_type;
+	*file_size = dfu_target_context_file_size;
 	return 0;
 }
 
 int dfu_target_done(bool successful)
 {
+	dfu_target_done_calls++;
+	dfu_target_done_successful = successful;
 	return 0;
 }
 
@@ -65,17 +106,21 @@ int download_client_start(struct download_client *client, const char *file,
 			  size_t from)
 {
 	download_client_start_file = file;
+	download_client_start_from = from;
+	k_sem_give(&download_client_start_sem);
 	return 0;
 }
 
 int download_client_file_size_get(struct download_client *client, size_t *size)
 {
+	*size = download_client_file_size;
 	return 0;
 }
 
 int download_client_init(struct download_client *client,
 			 download_client_callback_t callback)
 {
+	download_client_callback = callback;
 	return 0;
 }
 
@@ -109,7 +154,10 @@ int dfu_ctx_mcuboot_set_b1_file(char *file, bool s0_active, char **update)
 
 /* END stubs and mocks */
 
-void client_callback(enum fota_download_evt_id evt_id) { }
+void client_callback(const struct fota_download_evt *evt)
+{
+	last_evt_id = evt->id;
+}
 
 static void init(void)
 {
@@ -164,10 +212,348 @@ static void test_fota_download_start(void)
 	zassert_true(strcmp(download_client_start_file, S1) == 0, NULL);
 }
 
+/* Download the file in fragments, with one byte changed if corrupt is set */
+static void download(const u8_t *file, size_t len, bool corrupt)
+{
+	static u8_t fragment[100];
+	struct download_client_evt evt = {
+		.id = DOWNLOAD_CLIENT_EVT_FRAGMENT,
+	};
+	int err;
+
+	dfu_target_done_calls = 0;
+	dfu_target_done_successful = false;
+
+	for (size_t off = 0; off < len; off += sizeof(fragment)) {
+		size_t n = MIN(sizeof(fragment), len - off);
+
+		memcpy(fragment, &file[off], n);
+		if (corrupt && off == 0) {
+			fragment[n / 2] ^= 0x01;
+		}
+
+		evt.fragment.buf = fragment;
+		evt.fragment.len = n;
+		err = download_client_callback(&evt);
+		zassert_equal(err, 0, NULL);
+	}
+
+	evt.id = DOWNLOAD_CLIENT_EVT_DONE;
+	(void)download_client_callback(&evt);
+}
+
+static void test_fota_download_hash(void)
+{
+	int err;
+	static u8_t file[1000];
+	u8_t hash[FOTA_DOWNLOAD_HASH_SIZE];
+	struct tc_sha256_state_struct sha;
+
+	for (size_t i = 0; i < sizeof(file); i++) {
+		file[i] = i * 7;
+	}
+
+	(void)tc_sha256_init(&sha);
+	(void)tc_sha256_update(&sha, file, sizeof(file));
+	(void)tc_sha256_final(hash, &sha);
+
+	init();
+	dfu_ctx_mcuboot_set_b1_file__update = NULL;
+	strcpy(buf, "file.bin");
+
+	err = fota_download_start_with_hash("something.com", buf, NULL);
+	zassert_equal(err, -EINVAL, NULL);
+
+	/* Intact file is tagged as an upgrade candidate */
+	err = fota_download_start_with_hash("something.com", buf, hash);
+	zassert_equal(err, 0, NULL);
+	download(file, sizeof(file), false);
+	zassert_equal(dfu_target_done_calls, 1, NULL);
+	zassert_true(dfu_target_done_successful, "Intact file rejected");
+	zassert_equal(last_evt_id, FOTA_DOWNLOAD_EVT_FINISHED, NULL);
+
+	/* Corrupted file is discarded */
+	err = fota_download_start_with_hash("something.com", buf, hash);
+	zassert_equal(err, 0, NULL);
+	download(file, sizeof(file), true);
+	zassert_equal(dfu_target_done_calls, 1, NULL);
+	zassert_false(dfu_target_done_successful, "Corrupted file accepted");
+	zassert_equal(last_evt_id, FOTA_DOWNLOAD_EVT_ERROR, NULL);
+
+	/* Without a hash, the file is not verified */
+	err = fota_download_start("something.com", buf);
+	zassert_equal(err, 0, NULL);
+	download(file, sizeof(file), true);
+	zassert_true(dfu_target_done_successful, NULL);
+	zassert_equal(last_evt_id, FOTA_DOWNLOAD_EVT_FINISHED, NULL);
+}
+
+static void test_fota_download_hash_resume(void)
+{
+	int err;
+	static u8_t file[1000];
+	u8_t hash[FOTA_DOWNLOAD_HASH_SIZE];
+	struct tc_sha256_state_struct sha;
+	struct download_client_evt evt = {
+		.id = DOWNLOAD_CLIENT_EVT_FRAGMENT,
+		.fragment = {
+			.buf = file,
+			.len = 100,
+		},
+	};
+
+	for (size_t i = 0; i < sizeof(file); i++) {
+		file[i] = i * 3;
+	}
+
+	(void)tc_sha256_init(&sha);
+	(void)tc_sha256_update(&sha, file, sizeof(file));
+	(void)tc_sha256_final(hash, &sha);
+
+	init();
+	dfu_ctx_mcuboot_set_b1_file__update = NULL;
+	strcpy(buf, "file.bin");
+	download_client_file_size = sizeof(file);
+
+	/* An interrupted download is discarded instead of resumed, as the
+	 * data written before its offset is not part of the hash.
+	 */
+	dfu_target_context_img_type = 1;
+	dfu_target_context_file_size = sizeof(file);
+	dfu_target_offset = 0x200;
+	dfu_target_done_calls = 0;
+
+	err = fota_download_start_with_hash("something.com", buf, hash);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(download_client_start_from, 0, "Download resumed");
+	zassert_equal(dfu_target_done_calls, 1, "Target not discarded");
+	zassert_false(dfu_target_done_successful, NULL);
+
+	dfu_target_context_img_type = 0;
+	dfu_target_offset = 0;
+	download(file, sizeof(file), false);
+	zassert_true(dfu_target_done_successful, "Intact file rejected");
+	zassert_equal(last_evt_id, FOTA_DOWNLOAD_EVT_FINISHED, NULL);
+
+	/* Data found in the target by the first fragment is discarded too */
+	dfu_target_offset = 0x200;
+	dfu_target_done_calls = 0;
+	dfu_target_write_calls = 0;
+
+	err = fota_download_start_with_hash("something.com", buf, hash);
+	zassert_equal(err, 0, NULL);
+	err = download_client_callback(&evt);
+	zassert_not_equal(err, 0, "Fragment written after old data");
+	zassert_equal(dfu_target_write_calls, 0, NULL);
+	zassert_equal(dfu_target_done_calls, 1, "Target not discarded");
+	zassert_false(dfu_target_done_successful, NULL);
+
+	/* The download restarts from the start, and the hash covers the
+	 * whole file.
+	 */
+	dfu_target_offset = 0;
+	k_sem_reset(&download_client_start_sem);
+	err = k_sem_take(&download_client_start_sem, K_SECONDS(5));
+	zassert_equal(err, 0, "Download not restarted");
+	zassert_equal(download_client_start_from, 0, NULL);
+
+	download(file, sizeof(file), false);
+	zassert_true(dfu_target_done_successful, "Intact file rejected");
+	zassert_equal(last_evt_id, FOTA_DOWNLOAD_EVT_FINISHED, NULL);
+}
+
+/* Send the fragments of the file from one offset to another */
+static void fragments_send(const u8_t *file, size_t from, size_t to)
+{
+	struct download_client_evt evt = {
+		.id = DOWNLOAD_CLIENT_EVT_FRAGMENT,
+	};
+	int err;
+
+	for (size_t off = from; off < to; off += 100) {
+		evt.fragment.buf = &file[off];
+		evt.fragment.len = MIN(100, to - off);
+		err = download_client_callback(&evt);
+		zassert_equal(err, 0, NULL);
+	}
+}
+
+static void test_fota_download_hash_snapshot(void)
+{
+	int err;
+	static u8_t file[1000];
+	u8_t hash[FOTA_DOWNLOAD_HASH_SIZE];
+	struct tc_sha256_state_struct sha;
+	struct download_client_evt evt = {
+		.id = DOWNLOAD_CLIENT_EVT_FRAGMENT,
+		.fragment = {
+			.buf = file,
+			.len = 100,
+		},
+	};
+
+	for (size_t i = 0; i < sizeof(file); i++) {
+		file[i] = i * 5;
+	}
+
+	(void)tc_sha256_init(&sha);
+	(void)tc_sha256_update(&sha, file, sizeof(file));
+	(void)tc_sha256_final(hash, &sha);
+
+	init();
+	dfu_ctx_mcuboot_set_b1_file__update = NULL;
+	strcpy(buf, "file.bin");
+	download_client_file_size = sizeof(file);
+	dfu_target_context_img_type = 0;
+	dfu_target_offset = 0;
+
+	/* Download part of the file, taking snapshots of the hash state
+	 * after 300 and 600 bytes.
+	 */
+	err = fota_download_start_with_hash("something.com", buf, hash);
+	zassert_equal(err, 0, NULL);
+	fragments_send(file, 0, 700);
+
+	/* The interrupted download is resumed from the latest snapshot
+	 * before the offset stored by the target, and the data up to that
+	 * offset is only added to the hash.
+	 */
+	dfu_target_context_img_type = 1;
+	dfu_target_context_file_size = sizeof(file);
+	dfu_target_offset = 650;
+	dfu_target_done_calls = 0;
+	dfu_target_data_len = 0;
+
+	err = fota_download_start_with_hash("something.com", buf, hash);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(download_client_start_from, 600, "Not resumed");
+	zassert_equal(dfu_target_done_calls, 0, "Target discarded");
+
+	dfu_target_offset = 0;
+	download(&file[600], sizeof(file) - 600, false);
+	zassert_equal(dfu_target_data_len, sizeof(file) - 650, NULL);
+	zassert_mem_equal(dfu_target_data, &file[650], sizeof(file) - 650,
+			  "Wrong data written");
+	zassert_true(dfu_target_done_successful, "Intact file rejected");
+	zassert_equal(last_evt_id, FOTA_DOWNLOAD_EVT_FINISHED, NULL);
+
+	/* The same, with the offset found by the first fragment */
+	dfu_target_context_img_type = 0;
+	dfu_target_offset = 0;
+	err = fota_download_start_with_hash("something.com", buf, hash);
+	zassert_equal(err, 0, NULL);
+	fragments_send(file, 0, 700);
+
+	dfu_target_offset = 650;
+	dfu_target_done_calls = 0;
+	dfu_target_data_len = 0;
+
+	err = fota_download_start_with_hash("something.com", buf, hash);
+	zassert_equal(err, 0, NULL);
+	k_sem_reset(&download_client_start_sem);
+	err = download_client_callback(&evt);
+	zassert_not_equal(err, 0, "Fragment written after old data");
+	zassert_equal(dfu_target_done_calls, 0, "Target discarded");
+
+	err = k_sem_take(&download_client_start_sem, K_SECONDS(5));
+	zassert_equal(err, 0, "Download not restarted");
+	zassert_equal(download_client_start_from, 600, "Not resumed");
+
+	download(&file[600], sizeof(file) - 600, false);
+	zassert_equal(dfu_target_data_len, sizeof(file) - 650, NULL);
+	zassert_true(dfu_target_done_successful, "Intact file rejected");
+
+	/* A snapshot after the offset is not used */
+	dfu_target_context_img_type = 1;
+	dfu_target_offset = 250;
+	dfu_target_done_calls = 0;
+
+	err = fota_download_start_with_hash("something.com", buf, hash);
+	zassert_equal(err, 0, NULL);
+	zassert_equal(download_client_start_from, 0, "Resumed");
+	zassert_equal(dfu_target_done_calls, 1, "Target not discarded");
+}
+
+/* Start a download and receive its first fragment */
+static int download_first_fragment(void)
+{
+	static u8_t fragment[100];
+	struct download_client_evt evt = {
+		.id = DOWNLOAD_CLIENT_EVT_FRAGMENT,
+	};
+	int err;
+
+	dfu_target_done_calls = 0;
+	dfu_target_img_type_calls = 0;
+	dfu_target_write_calls = 0;
+	dfu_target_init_img_type = 0;
+
+	err = fota_download_start("something.com", buf);
+	zassert_equal(err, 0, NULL);
+
+	evt.fragment.buf = fragment;
+	evt.fragment.len = sizeof(fragment);
+
+	return download_client_callback(&evt);
+}
+
+static void test_fota_download_resume(void)
+{
+	int err;
+
+	init();
+	dfu_ctx_mcuboot_set_b1_file__update = NULL;
+	strcpy(buf, "file.bin");
+
+	/* Interrupted download is resumed from the first request */
+	dfu_target_context_img_type = 1;
+	dfu_target_context_file_size = 0x1000;
+	dfu_target_offset = 0x200;
+	download_client_file_size = 0x1000;
+
+	err = download_first_fragment();
+	zassert_equal(err, 0, "Fragment refused");
+	zassert_equal(download_client_start_from, 0x200, "Not resumed");
+	zassert_equal(dfu_target_init_img_type, 1, "Wrong image type");
+	zassert_equal(dfu_target_img_type_calls, 0, "Fragment identified");
+	zassert_equal(dfu_target_write_calls, 1, NULL);
+
+	/* A different file is downloaded from the start */
+	download_client_file_size = 0x2000;
+
+	err = download_first_fragment();
+	zassert_not_equal(err, 0, "Fragment of another file accepted");
+	zassert_equal(dfu_target_write_calls, 0, NULL);
+	zassert_equal(dfu_target_done_calls, 1, NULL);
+	zassert_false(dfu_target_done_successful, NULL);
+
+	/* Nothing written yet, the image type is identified instead */
+	dfu_target_offset = 0;
+
+	err = download_first_fragment();
+	zassert_equal(err, 0, NULL);
+	zassert_equal(download_client_start_from, 0, NULL);
+	zassert_equal(dfu_target_img_type_calls, 1, NULL);
+	zassert_equal(dfu_target_write_calls, 1, NULL);
+
+	/* No interrupted download */
+	dfu_target_context_img_type = 0;
+
+	err = download_first_fragment();
+	zassert_equal(err, 0, NULL);
+	zassert_equal(download_client_start_from, 0, NULL);
+	zassert_equal(dfu_target_done_calls, 0, NULL);
+	zassert_equal(dfu_target_img_type_calls, 1, NULL);
+}
+
 void test_main(void)
 {
 	ztest_test_suite(lib_fota_download_test,
-	     ztest_unit_test(test_fota_download_start)
+	     ztest_unit_test(test_fota_download_start),
+	     ztest_unit_test(test_fota_download_hash),
+	     ztest_unit_test(test_fota_download_hash_resume),
+	     ztest_unit_test(test_fota_download_hash_snapshot),
+	     ztest_unit_test(test_fota_download_resume)
 	 );
 
 	ztest_run_test_suite(lib_fota_download_test);
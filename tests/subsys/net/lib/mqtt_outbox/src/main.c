@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <net/mqtt.h>
+#include <net/mqtt_outbox.h>
+
+#define TOPIC "devices/test/messages"
+
+static struct mqtt_client client;
+static struct mqtt_outbox outbox;
+
+static struct mqtt_publish_param published[16];
+static char published_payload[16][16];
+static size_t published_count;
+static int publish_err;
+
+static u32_t acked_tags[16];
+static int acked_results[16];
+static size_t acked_count;
+
+int mqtt_publish(struct mqtt_client *c, const struct mqtt_publish_param *param)
+{
+	zassert_equal_ptr(c, &client, "Wrong client");
+
+	if (publish_err) {
+		return publish_err;
+	}
+
+	zassert_true(published_count < ARRAY_SIZE(published), "Too many");
+	zassert_equal(param->message.topic.topic.size, strlen(TOPIC), "");
+	zassert_mem_equal(param->message.topic.topic.utf8, TOPIC,
+			  strlen(TOPIC), "Wrong topic");
+
+	published[published_count] = *param;
+	memcpy(published_payload[published_count], param->message.payload.data,
+	       param->message.payload.len);
+	published_count++;
+
+	return 0;
+}
+
+static void ack_handler(struct mqtt_outbox *o,
+			const struct mqtt_publish_message *message,
+			u32_t tag, int result)
+{
+	zassert_equal_ptr(o, &outbox, "Wrong outbox");
+	zassert_mem_equal(message->topic.topic.utf8, TOPIC, strlen(TOPIC),
+			  "Wrong topic");
+
+	acked_tags[acked_count] = tag;
+	acked_results[acked_count] = result;
+	acked_count++;
+}
+
+static int publish(const char *payload, enum mqtt_qos qos, u32_t tag)
+{
+	char topic[] = TOPIC;
+	char buf[16];
+	struct mqtt_publish_message message = {
+		.topic = {
+			.topic = {
+				.utf8 = (u8_t *)topic,
+				.size = strlen(topic)
+			},
+			.qos = qos
+		},
+		.payload = {
+			.data = (u8_t *)buf,
+			.len = strlen(payload)
+		}
+	};
+	int ret;
+
+	/* The outbox must keep its own copy of the message */
+	strcpy(buf, payload);
+	ret = mqtt_outbox_publish(&outbox, &message, tag);
+	memset(buf, 0, sizeof(buf));
+	memset(topic, 0, sizeof(topic));
+
+	return ret;
+}
+
+static int puback(u16_t message_id)
+{
+	const struct mqtt_puback_param ack = {
+		.message_id = message_id
+	};
+
+	return mqtt_outbox_puback(&outbox, &ack);
+}
+
+static void setup(void)
+{
+	published_count = 0;
+	publish_err = 0;
+	acked_count = 0;
+	zassert_equal(mqtt_outbox_init(&outbox, &client, ack_handler), 0, "");
+}
+
+static void teardown(void)
+{
+	mqtt_outbox_clear(&outbox);
+}
+
+static void test_monotonic_ids(void)
+{
+	int id1 = publish("a", MQTT_QOS_1_AT_LEAST_ONCE, 10);
+	int id2 = publish("b", MQTT_QOS_1_AT_LEAST_ONCE, 11);
+	u16_t sub_id = mqtt_outbox_message_id_get(&outbox);
+	int id3 = publish("c", MQTT_QOS_1_AT_LEAST_ONCE, 12);
+
+	zassert_equal(id1, 1, "");
+	zassert_equal(id2, 2, "");
+	zassert_equal(sub_id, 3, "");
+	zassert_equal(id3, 4, "");
+	zassert_equal(published_count, 3, "");
+	zassert_equal(published[1].message_id, 2, "");
+	zassert_false(published[1].dup_flag, "");
+	zassert_mem_equal(published_payload[1], "b", 1, "");
+	zassert_equal(mqtt_outbox_count(&outbox), 3, "");
+}
+
+static void test_qos0_not_tracked(void)
+{
+	zassert_equal(publish("a", MQTT_QOS_0_AT_MOST_ONCE, 1), 0, "");
+	zassert_equal(published_count, 1, "");
+	zassert_equal(mqtt_outbox_count(&outbox), 0, "");
+}
+
+static void test_window(void)
+{
+	for (int i = 0; i < CONFIG_MQTT_OUTBOX_WINDOW; i++) {
+		zassert_true(publish("a", MQTT_QOS_1_AT_LEAST_ONCE, i) > 0,
+			     "");
+	}
+
+	zassert_equal(publish("b", MQTT_QOS_1_AT_LEAST_ONCE, 99), -EAGAIN,
+		      "");
+	zassert_equal(published_count, CONFIG_MQTT_OUTBOX_WINDOW, "");
+
+	zassert_equal(puback(2), 0, "");
+	zassert_equal(acked_count, 1, "");
+	zassert_equal(acked_tags[0], 1, "");
+	zassert_equal(acked_results[0], 0, "");
+
+	zassert_equal(publish("b", MQTT_QOS_1_AT_LEAST_ONCE, 99),
+		      CONFIG_MQTT_OUTBOX_WINDOW + 1, "");
+}
+
+static void test_unknown_ack(void)
+{
+	zassert_true(publish("a", MQTT_QOS_1_AT_LEAST_ONCE, 1) > 0, "");
+	zassert_equal(puback(1234), -ENOENT, "");
+	zassert_equal(puback(1), 0, "");
+	zassert_equal(puback(1), -ENOENT, "Acknowledged twice");
+	zassert_equal(acked_count, 1, "");
+}
+
+static void test_publish_error(void)
+{
+	publish_err = -ENOTCONN;
+	zassert_equal(publish("a", MQTT_QOS_1_AT_LEAST_ONCE, 1), -ENOTCONN,
+		      "");
+	zassert_equal(mqtt_outbox_count(&outbox), 0, "");
+}
+
+static void test_resend_dup_in_order(void)
+{
+	zassert_true(publish("a", MQTT_QOS_1_AT_LEAST_ONCE, 1) > 0, "");
+	zassert_true(publish("b", MQTT_QOS_1_AT_LEAST_ONCE, 2) > 0, "");
+	zassert_true(publish("c", MQTT_QOS_1_AT_LEAST_ONCE, 3) > 0, "");
+	zassert_equal(puback(2), 0, "");
+
+	published_count = 0;
+	zassert_equal(mqtt_outbox_resend(&outbox), 0, "");
+
+	zassert_equal(published_count, 2, "");
+	zassert_equal(published[0].message_id, 1, "");
+	zassert_true(published[0].dup_flag, "");
+	zassert_mem_equal(published_payload[0], "a", 1, "");
+	zassert_equal(published[1].message_id, 3, "");
+	zassert_true(published[1].dup_flag, "");
+	zassert_mem_equal(published_payload[1], "c", 1, "");
+}
+
+static void test_id_wrap(void)
+{
+	/* Keep ID 1 in flight while the IDs wrap around */
+	zassert_equal(publish("a", MQTT_QOS_1_AT_LEAST_ONCE, 1), 1, "");
+
+	for (u32_t i = 0; i < UINT16_MAX - 2; i++) {
+		(void)mqtt_outbox_message_id_get(&outbox);
+	}
+
+	zassert_equal(publish("b", MQTT_QOS_1_AT_LEAST_ONCE, 2), UINT16_MAX,
+		      "");
+	/* 0 is not a valid ID and 1 is in flight */
+	zassert_equal(publish("c", MQTT_QOS_1_AT_LEAST_ONCE, 3), 2, "");
+
+	published_count = 0;
+	zassert_equal(mqtt_outbox_resend(&outbox), 0, "");
+	zassert_equal(published_count, 3, "");
+	zassert_equal(published[0].message_id, 1, "");
+	zassert_equal(published[1].message_id, UINT16_MAX, "");
+	zassert_equal(published[2].message_id, 2, "");
+}
+
+static void test_clear(void)
+{
+	zassert_true(publish("a", MQTT_QOS_1_AT_LEAST_ONCE, 7) > 0, "");
+	zassert_true(publish("b", MQTT_QOS_1_AT_LEAST_ONCE, 8) > 0, "");
+
+	mqtt_outbox_clear(&outbox);
+
+	zassert_equal(mqtt_outbox_count(&outbox), 0, "");
+	zassert_equal(acked_count, 2, "");
+	zassert_equal(acked_tags[0], 7, "");
+	zassert_equal(acked_results[0], -ECANCELED, "");
+	zassert_equal(acked_tags[1], 8, "");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(mqtt_outbox_test,
+			 ztest_unit_test_setup_teardown(test_monotonic_ids,
+							setup, teardown),
+			 ztest_unit_test_setup_teardown(test_qos0_not_tracked,
+							setup, teardown),
+			 ztest_unit_test_setup_teardown(test_window,
+							setup, teardown),
+			 ztest_unit_test_setup_teardown(test_unknown_ack,
+							setup, teardown),
+			 ztest_unit_test_setup_teardown(test_publish_error,
+							setup, teardown),
+			 ztest_unit_test_setup_teardown(test_resend_dup_in_order,
+							setup, teardown),
+			 ztest_unit_test_setup_teardown(test_id_wrap,
+							setup, teardown),
+			 ztest_unit_test_setup_teardown(test_clear,
+							setup, teardown)
+			 );
+	ztest_run_test_suite(mqtt_outbox_test);
+}
@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <stdio.h>
+#include <kernel.h>
+
+#include <net/mqtt_topic_trie.h>
+
+#define BENCHMARK_ITERATIONS 1000
+#define BENCHMARK_APP_TOPICS 32
+
+#define SHADOW "$aws/things/nrf-352656100000000/shadow/"
+
+static struct mqtt_topic_trie trie;
+static struct mqtt_topic_trie_node nodes[128];
+
+/* Values that the filters are added with */
+static int values[8];
+
+static void trie_reset(void)
+{
+	mqtt_topic_trie_init(&trie, nodes, ARRAY_SIZE(nodes));
+}
+
+static int add(const char *filter, int *value)
+{
+	return mqtt_topic_trie_add(&trie, filter, strlen(filter), value);
+}
+
+static size_t match(const char *topic, void **data, size_t max)
+{
+	return mqtt_topic_trie_match(&trie, topic, strlen(topic), data, max);
+}
+
+static int *match_one(const char *topic)
+{
+	void *data = NULL;
+
+	return (match(topic, &data, 1) > 0) ? data : NULL;
+}
+
+static void test_mqtt_topic_trie_exact(void)
+{
+	trie_reset();
+
+	zassert_equal(add(SHADOW "update/accepted", &values[0]), 0, NULL);
+	zassert_equal(add(SHADOW "update/rejected", &values[1]), 0, NULL);
+	zassert_equal(add(SHADOW "update/delta", &values[2]), 0, NULL);
+	zassert_equal(add(SHADOW "get/accepted", &values[3]), 0, NULL);
+	zassert_equal(add("a//b", &values[4]), 0, NULL);
+
+	zassert_equal_ptr(match_one(SHADOW "update/accepted"), &values[0],
+			  NULL);
+	zassert_equal_ptr(match_one(SHADOW "update/rejected"), &values[1],
+			  NULL);
+	zassert_equal_ptr(match_one(SHADOW "update/delta"), &values[2], NULL);
+	zassert_equal_ptr(match_one(SHADOW "get/accepted"), &values[3], NULL);
+	zassert_equal_ptr(match_one("a//b"), &values[4], NULL);
+
+	/* Prefixes and extensions of a filter do not match it */
+	zassert_is_null(match_one(SHADOW "update"), NULL);
+	zassert_is_null(match_one(SHADOW "update/"), NULL);
+	zassert_is_null(match_one(SHADOW "update/delt"), NULL);
+	zassert_is_null(match_one(SHADOW "update/delta/x"), NULL);
+	zassert_is_null(match_one("a/b"), NULL);
+	zassert_is_null(match_one(""), NULL);
+
+	/* The topic does not need to be null-terminated */
+	zassert_equal(mqtt_topic_trie_match(&trie, SHADOW "get/accepted/x",
+					    strlen(SHADOW "get/accepted"),
+					    NULL, 0), 1, NULL);
+
+	/* The shared levels are stored once */
+	zassert_equal(trie.used, 13, NULL);
+}
+
+static void test_mqtt_topic_trie_wildcards(void)
+{
+	void *data[8];
+
+	trie_reset();
+
+	zassert_equal(add("sport/tennis/+", &values[0]), 0, NULL);
+	zassert_equal(add("sport/#", &values[1]), 0, NULL);
+	zassert_equal(add("sport/tennis/player1", &values[2]), 0, NULL);
+	zassert_equal(add("+/+", &values[3]), 0, NULL);
+	zassert_equal(add("#", &values[4]), 0, NULL);
+	zassert_equal(add("+/tennis/#", &values[5]), 0, NULL);
+
+	/* Filters without wildcards come first */
+	zassert_equal(match("sport/tennis/player1", data, ARRAY_SIZE(data)),
+		      5, NULL);
+	zassert_equal_ptr(data[0], &values[2], NULL);
+	zassert_equal_ptr(data[1], &values[0], NULL);
+	zassert_equal_ptr(data[2], &values[1], NULL);
+	zassert_equal_ptr(data[3], &values[5], NULL);
+	zassert_equal_ptr(data[4], &values[4], NULL);
+
+	/* '#' also matches the parent level */
+	zassert_equal(match("sport", data, ARRAY_SIZE(data)), 2, NULL);
+	zassert_equal_ptr(data[0], &values[1], NULL);
+	zassert_equal_ptr(data[1], &values[4], NULL);
+
+	zassert_equal(match("sport/", data, ARRAY_SIZE(data)), 3, NULL);
+	zassert_equal_ptr(data[0], &values[1], NULL);
+	zassert_equal_ptr(data[1], &values[3], NULL);
+	zassert_equal_ptr(data[2], &values[4], NULL);
+
+	zassert_equal(match("golf/tennis", data, ARRAY_SIZE(data)), 3, NULL);
+	zassert_equal_ptr(data[0], &values[5], NULL);
+	zassert_equal_ptr(data[1], &values[3], NULL);
+	zassert_equal_ptr(data[2], &values[4], NULL);
+
+	/* Only max matches are stored, but all are counted */
+	zassert_equal(match("sport/tennis/player1", data, 1), 5, NULL);
+	zassert_equal_ptr(data[0], &values[2], NULL);
+}
+
+static void test_mqtt_topic_trie_dollar(void)
+{
+	void *data[4];
+
+	trie_reset();
+
+	zassert_equal(add("#", &values[0]), 0, NULL);
+	zassert_equal(add("+/monitor/Clients", &values[1]), 0, NULL);
+	zassert_equal(add("$SYS/#", &values[2]), 0, NULL);
+	zassert_equal(add("$SYS/monitor/+", &values[3]), 0, NULL);
+
+	/* Wildcards at the first level do not match topics starting with $ */
+	zassert_equal(match("$SYS/monitor/Clients", data, ARRAY_SIZE(data)),
+		      2, NULL);
+	zassert_equal_ptr(data[0], &values[3], NULL);
+	zassert_equal_ptr(data[1], &values[2], NULL);
+
+	zassert_equal(match("x/monitor/Clients", data, ARRAY_SIZE(data)), 2,
+		      NULL);
+	zassert_equal_ptr(data[0], &values[1], NULL);
+	zassert_equal_ptr(data[1], &values[0], NULL);
+}
+
+static void test_mqtt_topic_trie_invalid(void)
+{
+	trie_reset();
+
+	zassert_equal(add("a/#/b", &values[0]), -EINVAL, NULL);
+	zassert_equal(add("a/b#", &values[0]), -EINVAL, NULL);
+	zassert_equal(add("a/+b", &values[0]), -EINVAL, NULL);
+	zassert_equal(add("", &values[0]), -EINVAL, NULL);
+	zassert_equal(add("a", NULL), -EINVAL, NULL);
+
+	zassert_equal(add("a/+", &values[0]), 0, NULL);
+	zassert_equal(add("a/+", &values[1]), -EALREADY, NULL);
+	zassert_equal_ptr(match_one("a/b"), &values[0], NULL);
+
+	mqtt_topic_trie_clear(&trie);
+	zassert_is_null(match_one("a/b"), NULL);
+}
+
+static void test_mqtt_topic_trie_full(void)
+{
+	struct mqtt_topic_trie_node few[3];
+
+	mqtt_topic_trie_init(&trie, few, ARRAY_SIZE(few));
+
+	zassert_equal(add("a/b/c", &values[0]), 0, NULL);
+	zassert_equal(add("a/b/d", &values[1]), -ENOMEM, NULL);
+	zassert_equal_ptr(match_one("a/b/c"), &values[0], NULL);
+	zassert_is_null(match_one("a/b/d"), NULL);
+}
+
+/* Matching of each filter in turn, as done without the trie */
+static bool filter_match(const char *filter, const char *topic, size_t len)
+{
+	const char *end = topic + len;
+
+	if ((topic[0] == '$') && ((filter[0] == '+') || (filter[0] == '#'))) {
+		return false;
+	}
+
+	for (;;) {
+		if (filter[0] == '#') {
+			return true;
+		}
+
+		if (filter[0] == '+') {
+			filter++;
+			while ((topic < end) && (*topic != '/')) {
+				topic++;
+			}
+		} else {
+			while ((*filter != '\0') && (*filter != '/') &&
+			       (topic < end) && (*filter == *topic)) {
+				filter++;
+				topic++;
+			}
+		}
+
+		if ((*filter == '\0') && (topic == end)) {
+			return true;
+		}
+
+		if ((*filter == '/') && (topic == end) &&
+		    (strcmp(filter, "/#") == 0)) {
+			return true;
+		}
+
+		if ((*filter != '/') || (topic == end) || (*topic != '/')) {
+			return false;
+		}
+
+		filter++;
+		topic++;
+	}
+}
+
+static void benchmark_print(const char *name, u32_t cycles)
+{
+	u64_t ns = SYS_CLOCK_HW_CYCLES_TO_NS64(cycles);
+
+	TC_PRINT("%s: %u lookups in %u cycles\n", name,
+		 BENCHMARK_ITERATIONS, cycles);
+
+	if (ns > 0) {
+		TC_PRINT("%s: %u ns per lookup\n", name,
+			 (u32_t)(ns / BENCHMARK_ITERATIONS));
+	}
+}
+
+/* Dispatch a received message among the shadow topics and many application
+ * topics, as the AWS IoT library does.
+ */
+static void test_mqtt_topic_trie_benchmark(void)
+{
+	static char app_filters[BENCHMARK_APP_TOPICS][48];
+	static const char * const shadow_filters[] = {
+		SHADOW "get/accepted",
+		SHADOW "get/rejected",
+		SHADOW "update/accepted",
+		SHADOW "update/rejected",
+		SHADOW "update/delta",
+		SHADOW "delete/accepted",
+		SHADOW "delete/rejected",
+	};
+	static const char * const topics[] = {
+		SHADOW "update/delta",
+		"nrf-352656100000000/app/sensor31/cfg",
+		"nrf-352656100000000/app/sensor6/cmd/reset",
+		"nrf-352656100000000/unknown",
+	};
+	const char *filters[ARRAY_SIZE(shadow_filters) + BENCHMARK_APP_TOPICS];
+	static struct mqtt_topic_trie_node bench_nodes[128];
+	u32_t start, cycles;
+	size_t found = 0;
+
+	mqtt_topic_trie_init(&trie, bench_nodes, ARRAY_SIZE(bench_nodes));
+
+	for (size_t i = 0; i < ARRAY_SIZE(shadow_filters); i++) {
+		filters[i] = shadow_filters[i];
+	}
+
+	for (size_t i = 0; i < BENCHMARK_APP_TOPICS; i++) {
+		snprintf(app_filters[i], sizeof(app_filters[i]),
+			 (i % 2) ? "nrf-352656100000000/app/sensor%d/cfg" :
+				   "nrf-352656100000000/app/sensor%d/cmd/#",
+			 i);
+		filters[ARRAY_SIZE(shadow_filters) + i] = app_filters[i];
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(filters); i++) {
+		zassert_equal(mqtt_topic_trie_add(&trie, filters[i],
+						  strlen(filters[i]),
+						  (void *)filters[i]), 0,
+			      "Failed to add %s", filters[i]);
+	}
+
+	TC_PRINT("%u filters in %u nodes\n", ARRAY_SIZE(filters), trie.used);
+
+	start = k_cycle_get_32();
+
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		const char *topic = topics[i % ARRAY_SIZE(topics)];
+		size_t len = strlen(topic);
+
+		for (size_t j = 0; j < ARRAY_SIZE(filters); j++) {
+			if (filter_match(filters[j], topic, len)) {
+				found++;
+				break;
+			}
+		}
+	}
+
+	cycles = k_cycle_get_32() - start;
+	benchmark_print("linear", cycles);
+	zassert_equal(found, BENCHMARK_ITERATIONS * 3 / 4, NULL);
+
+	found = 0;
+	start = k_cycle_get_32();
+
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		const char *topic = topics[i % ARRAY_SIZE(topics)];
+		void *data;
+
+		found += (mqtt_topic_trie_match(&trie, topic, strlen(topic),
+						&data, 1) > 0);
+	}
+
+	cycles = k_cycle_get_32() - start;
+	benchmark_print("mqtt_topic_trie", cycles);
+	zassert_equal(found, BENCHMARK_ITERATIONS * 3 / 4, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(mqtt_topic_trie,
+			 ztest_unit_test(test_mqtt_topic_trie_exact),
+			 ztest_unit_test(test_mqtt_topic_trie_wildcards),
+			 ztest_unit_test(test_mqtt_topic_trie_dollar),
+			 ztest_unit_test(test_mqtt_topic_trie_invalid),
+			 ztest_unit_test(test_mqtt_topic_trie_full),
+			 ztest_unit_test(test_mqtt_topic_trie_benchmark)
+			 );
+
+	ztest_run_test_suite(mqtt_topic_trie);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <string.h>
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <ztest.h>
+#include <cJSON.h>
+#include "nrf_cloud_codec.h"
+#include "nrf_cloud_mem.h"
+#include "nrf_cloud_transport.h"
+
+#define DEVICE "{\"networkInfo\":{\"rsrp\":-97},\"gpsFix\":false}"
+#define SHADOW "{\"state\":{\"reported\":{\"DEVICE\":" DEVICE "}}}"
+
+void nct_dc_endpoint_get(struct nrf_cloud_data *tx_endpoint,
+			 struct nrf_cloud_data *rx_endpoint,
+			 struct nrf_cloud_data *m_endpoint)
+{
+	zassert_unreachable("Endpoints not used by shadow updates");
+}
+
+static int shadow_json_encode(const char *json, size_t len,
+			      struct nrf_cloud_data *output)
+{
+	const struct nrf_cloud_sensor_data sensor = {
+		.type = NRF_CLOUD_DEVICE_INFO,
+		.data.ptr = json,
+		.data.len = len,
+	};
+
+	return nrf_cloud_encode_shadow_json(&sensor, output);
+}
+
+static void output_check(const struct nrf_cloud_data *output,
+			 const char *expected)
+{
+	zassert_equal(output->len, strlen(expected), NULL);
+	zassert_mem_equal(output->ptr, expected, output->len,
+			  "Unexpected shadow update: %s", output->ptr);
+
+	nrf_cloud_free((void *)output->ptr);
+}
+
+static void test_nrf_cloud_codec_shadow_cjson(void)
+{
+	struct nrf_cloud_data output;
+	const struct nrf_cloud_sensor_data sensor = {
+		.type = NRF_CLOUD_DEVICE_INFO,
+		.data.ptr = cJSON_Parse(DEVICE),
+		.data.len = sizeof(cJSON),
+	};
+
+	/* The item is deleted by the encoder */
+	zassert_not_null(sensor.data.ptr, NULL);
+	zassert_equal(nrf_cloud_encode_shadow_data(&sensor, &output), 0, NULL);
+	output_check(&output, SHADOW);
+}
+
+static void test_nrf_cloud_codec_shadow_json(void)
+{
+	struct nrf_cloud_data output;
+
+	zassert_equal(shadow_json_encode(DEVICE, strlen(DEVICE), &output), 0,
+		      NULL);
+	output_check(&output, SHADOW);
+
+	/* The terminating NUL is not copied */
+	zassert_equal(shadow_json_encode(DEVICE, sizeof(DEVICE), &output), 0,
+		      NULL);
+	output_check(&output, SHADOW);
+
+	zassert_equal(shadow_json_encode("[1,true]", 8, &output), 0, NULL);
+	output_check(&output, "{\"state\":{\"reported\":{\"DEVICE\":[1,true]}}}");
+}
+
+static void test_nrf_cloud_codec_shadow_json_invalid(void)
+{
+	struct nrf_cloud_data output;
+	static const char *const invalid[] = {
+		"",
+		"{\"rsrp\":-97",
+		"{\"rsrp\":-97}}",
+		"{\"rsrp\":-97},{}",
+		"{\"rsrp\"}",
+		"rsrp",
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(invalid); i++) {
+		zassert_equal(shadow_json_encode(invalid[i],
+						 strlen(invalid[i]) + 1,
+						 &output),
+			      -EINVAL, "Accepted %s", invalid[i]);
+	}
+
+	zassert_equal(shadow_json_encode(NULL, 1, &output), -EINVAL, NULL);
+	zassert_equal(shadow_json_encode(DEVICE, 0, &output), -EINVAL, NULL);
+
+	/* Only the part before the length is validated and copied */
+	zassert_equal(shadow_json_encode(DEVICE, strlen(DEVICE) - 1, &output),
+		      -EINVAL, NULL);
+
+	/* More tokens than CONFIG_NRF_CLOUD_SHADOW_JSON_TOKENS */
+	zassert_equal(shadow_json_encode("[1,2,3,4,5,6,7,8]", 17, &output),
+		      -ENOMEM, NULL);
+}
+
+void test_main(void)
+{
+	zassert_equal(nrf_codec_init(), 0, NULL);
+
+	ztest_test_suite(nrf_cloud_codec,
+			 ztest_unit_test(test_nrf_cloud_codec_shadow_cjson),
+			 ztest_unit_test(test_nrf_cloud_codec_shadow_json),
+			 ztest_unit_test(test_nrf_cloud_codec_shadow_json_invalid)
+			 );
+
+	ztest_run_test_suite(nrf_cloud_codec);
+}